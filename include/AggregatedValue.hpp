@@ -0,0 +1,58 @@
+#ifndef __LIBSPEEDWIRE_AGGREGATEDVALUE_HPP__
+#define __LIBSPEEDWIRE_AGGREGATEDVALUE_HPP__
+
+#include <cstdint>
+#include <float.h>
+
+namespace libspeedwire {
+
+    /**
+     *  Class encapsulating aggregated statistics of all measurement values falling into a time bucket.
+     */
+    class AggregatedValue {
+    public:
+        double   min;       //!< Minimum measurement value
+        double   max;       //!< Maximum measurement value
+        double   sum;       //!< Sum of measurement values
+        uint32_t count;     //!< Number of measurement values
+        uint32_t time;      //!< Start time of the time bucket
+
+        AggregatedValue(void) : min(DBL_MAX), max(-DBL_MAX), sum(0.0), count(0), time(0) {}
+        AggregatedValue(const uint32_t t) : min(DBL_MAX), max(-DBL_MAX), sum(0.0), count(0), time(t) {}
+
+        /**
+         *  Add a measurement value to the aggregate.
+         *  @param value the measurement value
+         */
+        void add(const double value) {
+            if (value < min) min = value;
+            if (value > max) max = value;
+            sum += value;
+            ++count;
+        }
+
+        /**
+         *  Add another aggregate to this aggregate.
+         *  @param other the other aggregate
+         */
+        void add(const AggregatedValue& other) {
+            if (other.count > 0) {
+                if (other.min < min) min = other.min;
+                if (other.max > max) max = other.max;
+                sum   += other.sum;
+                count += other.count;
+            }
+        }
+
+        /**
+         *  Get the mean value of all aggregated measurement values.
+         *  @return the mean value, or 0.0 if the aggregate is empty
+         */
+        double getMean(void) const {
+            return (count > 0 ? sum / count : 0.0);
+        }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -2,18 +2,30 @@
 #define __LIBSPEEDWIRE_AVERAGINGPROCESSOR_HPP__
 
 #include <cstdint>
+#include <map>
 #include <Consumer.hpp>
 #include <ObisData.hpp>
 #include <ObisFilter.hpp>
 #include <SpeedwireData.hpp>
 #include <Measurement.hpp>
 #include <Producer.hpp>
+#include <SpeedwireAddressTable.hpp>
 
 namespace libspeedwire {
 
     /**
      *  Class AveragingProcessor implements the temporal averaging processing of obis elements received from emeter
      *  packets and inverter reply packets; this is useful to reduce the amount of data fed to the InfluxDB producer.
+     *
+     *  For each device and channel, the sum, count, minimum and maximum of all measurement values received within the
+     *  averaging time are accumulated. Once the averaging time has elapsed, consumers receive a separate element holding
+     *  the mean value of the window as its only measurement value, and the accumulator is reset. Elements without
+     *  measurement values, and all elements if the averaging time is 0, are passed on unmodified.
+     *
+     *  Several output intervals with different averaging times can be maintained concurrently, e.g. 1 s for live
+     *  dashboards, 1 min for a time series database and 15 min for billing. Each output interval has its own list of
+     *  consumers; all intervals are updated in a single pass over each received element. Interval 0 is defined by the
+     *  constructor arguments, further intervals are added by addInterval().
      */
     class AveragingProcessor : public ObisConsumer, SpeedwireConsumer {
 
@@ -25,34 +37,65 @@ namespace libspeedwire {
             INVERTER    //!< An inverter device.
         };
 
-        //! Struct holding a block of averaging related information for a given speedwire device.
+        //! Struct holding the averaging timer of a given speedwire device for a single output interval.
         typedef struct {
-            uint32_t      serialNumber;             //!< Serial number of the speedwire device.
-            DeviceType    deviceType;               //!< Device type.
             unsigned long averagingTime;            //!< Averaging time for data packets.
             unsigned long remainder;                //!< Remainding time for averaging data packets.
             uint32_t      currentTimestamp;         //!< Timestamp of the most recently received data packet.
             bool          currentTimestampIsValid;  //!< The current emeter timestamp has been initialized.
             bool          averagingTimeReached;     //!< Boolean indicating that the averaging time has been reached with this emeter obis packet.
+        } AveragingTimer;
+
+        //! Struct holding a block of averaging related information for a given speedwire device.
+        typedef struct {
+            SpeedwireAddress deviceAddress;         //!< Address of the speedwire device, i.e. susy ID and serial number.
+            DeviceType    deviceType;               //!< Device type.
+            std::vector<AveragingTimer> timers;     //!< Averaging timers, one for each output interval.
         } AveragingState;
 
-        unsigned long averagingTimeObisData;                    //!< Averaging time constant for obis data.
-        unsigned long averagingTimeSpeedwireData;               //!< Averaging time constant for speedwire data.
+        //! Struct holding the temporal aggregates of a single channel of a given device for a single output interval.
+        template<class T> struct ChannelState {
+            AggregatedValue current;    //!< Aggregate of the current averaging window
+            AggregatedValue last;       //!< Aggregate of the most recently completed averaging window
+            T               output;     //!< Element passed on to consumers, holding the mean value of the most recently completed averaging window
+        };
+
+        //! Struct holding the configuration of an output interval.
+        typedef struct {
+            unsigned long averagingTimeObisData;                    //!< Averaging time constant for obis data.
+            unsigned long averagingTimeSpeedwireData;               //!< Averaging time constant for speedwire data.
+            std::vector<ObisConsumer*> obisConsumerTable;           //!< Table of registered ObisConsumer
+            std::vector<SpeedwireConsumer*> speedwireConsumerTable; //!< Table of registered SpeedwireConsumer
+        } OutputInterval;
+
+        std::vector<OutputInterval> intervals;                  //!< Array holding all output intervals
         std::vector<AveragingState> states;                     //!< Array holding averaging states for alle knowne speedwire devices
-        std::vector<ObisConsumer*> obisConsumerTable;           //!< Table of registered ObisConsumer
-        std::vector<SpeedwireConsumer*> speedwireConsumerTable; //!< Table of registered SpeedwireConsumer
+        SpeedwireAddressTable stateTable;                       //!< Hash table mapping device addresses to indexes in array states
+        std::map<uint64_t, std::vector<ChannelState<ObisData> > >      obisChannels;      //!< Channel aggregates for obis data, one for each output interval, keyed by state index and obis key
+        std::map<uint64_t, std::vector<ChannelState<SpeedwireData> > > speedwireChannels; //!< Channel aggregates for speedwire data, one for each output interval, keyed by state index and data key
+        std::vector<ObisData*>      obisOutputs;                //!< Reusable buffer for the obis elements to be passed on to consumers, one for each output interval
+        std::vector<SpeedwireData*> speedwireOutputs;           //!< Reusable buffer for the speedwire elements to be passed on to consumers, one for each output interval
 
-        int initializeState(const uint32_t serial_number, const DeviceType& device_type);
-        int findStateIndex(const uint32_t serial_number);
-        bool process(const SpeedwireDevice& device, const DeviceType& device_type, Measurement& measurement);
+        int initializeState(const SpeedwireAddress& device_address, const DeviceType& device_type);
+        int findStateIndex(const SpeedwireAddress& device_address) const;
+        AveragingTimer initializeTimer(const DeviceType& device_type, const size_t interval) const;
+        void process(const int state_index, Measurement& measurement);
+        template<class T> void average(std::map<uint64_t, std::vector<ChannelState<T> > >& channels, const int state_index, T& element, std::vector<T*>& outputs);
+        static uint64_t toChannelKey(const int state_index, const uint32_t key) { return ((uint64_t)state_index << 32) | key; }
 
     public:
 
         AveragingProcessor(const unsigned long averagingTimeObisData, const unsigned long averagingTimeSpeedwireData);
         ~AveragingProcessor(void);
 
-        void addConsumer(ObisConsumer& obis_consumer);
-        void addConsumer(SpeedwireConsumer& speedwire_consumer);
+        size_t addInterval(const unsigned long averaging_time_obis_data, const unsigned long averaging_time_speedwire_data);
+        size_t getNumberOfIntervals(void) const { return intervals.size(); }
+
+        void addConsumer(ObisConsumer& obis_consumer, const size_t interval = 0);
+        void addConsumer(SpeedwireConsumer& speedwire_consumer, const size_t interval = 0);
+
+        bool getLastAggregate(const SpeedwireDevice& device, const ObisData& element, AggregatedValue& aggregate, const size_t interval = 0) const;
+        bool getLastAggregate(const SpeedwireDevice& device, const SpeedwireData& element, AggregatedValue& aggregate, const size_t interval = 0) const;
 
         virtual void consume(const SpeedwireDevice& device, ObisData& element);
         virtual void consume(const SpeedwireDevice& device, SpeedwireData& element);
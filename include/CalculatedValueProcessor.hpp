@@ -6,6 +6,7 @@
 #include <Producer.hpp>
 #include <ObisData.hpp>
 #include <SpeedwireData.hpp>
+#include <DerivedValueGraph.hpp>
 
 namespace libspeedwire {
 
@@ -15,6 +16,11 @@ namespace libspeedwire {
      *
      *  The class is implemented as an ObisConsumer and SpeedwireConsumer. Values are passed on the obis_consumer and
      *  speedwire_consumer configured
+     *
+     *  Derived values are declared once in the constructor as nodes of a DerivedValueGraph. At the end of each packet,
+     *  only those derived values are calculated, whose inputs changed with this packet.
+     *
+     *  All values of a packet are collected in a single ProducerFrame and passed on to the producer at the end of the packet.
      */
     class CalculatedValueProcessor : public ObisConsumer, SpeedwireConsumer {
 
@@ -23,6 +29,20 @@ namespace libspeedwire {
         ObisDataMap& obis_data_map;       //!< Reference to the data map, where all received obis values reside
         SpeedwireDataMap& speedwire_data_map;  //!< Reference to the data map, where all received inverter values reside
         Producer& producer;            //!< Reference to producer to receive the consumed and calculated values
+        DerivedValueGraph graph;       //!< Graph of derived values
+        ProducerSeriesTable series;    //!< Table of all series passed on to the producer
+        ProducerFrame frame;           //!< Frame collecting all values of the current packet
+        size_t signed_power_total_node; //!< Index of the node calculating the signed total power
+
+        //! Trigger identifiers of the derived value graph.
+        enum Trigger {
+            OBIS_DATA,                  //!< Evaluated at the end of emeter packets
+            INVERTER_DATA,              //!< Evaluated at the end of inverter packets
+            BATTERY_INVERTER_DATA       //!< Evaluated at the end of battery inverter packets
+        };
+
+        void produceTimeAccuratePower(const Measurement& signed_power);
+        void produceFrame(void);
 
     public:
 
@@ -0,0 +1,411 @@
+#ifndef __LIBSPEEDWIRE_COMPRESSEDMEASUREMENTVALUES_HPP__
+#define __LIBSPEEDWIRE_COMPRESSEDMEASUREMENTVALUES_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <MeasurementValues.hpp>
+#include <SpeedwireTime.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class implementing an append-only bit stream; bits are written and read msb first.
+     */
+    class BitStream {
+    public:
+        std::vector<uint8_t> bytes;     //!< Array of bytes holding the bit stream
+        size_t               num_bits;  //!< Number of bits written to the bit stream
+
+        BitStream(void) : num_bits(0) {}
+
+        /**
+         *  Append the n least significant bits of the given value.
+         *  @param value the value
+         *  @param n the number of bits, 0 ... 64
+         */
+        void write(const uint64_t value, unsigned n) {
+            while (n > 0) {
+                const unsigned bit_offset = (unsigned)(num_bits & 7u);
+                if (bit_offset == 0) {
+                    bytes.push_back(0);
+                }
+                const unsigned free_bits = 8u - bit_offset;
+                const unsigned chunk = (n < free_bits ? n : free_bits);
+                const uint8_t  bits = (uint8_t)((value >> (n - chunk)) & ((1u << chunk) - 1u));
+                bytes[num_bits >> 3] |= (uint8_t)(bits << (free_bits - chunk));
+                num_bits += chunk;
+                n -= chunk;
+            }
+        }
+
+        /**
+         *  Read n bits starting at the given bit position.
+         *  @param pos the bit position; it is advanced by n
+         *  @param n the number of bits, 0 ... 64
+         *  @return the bits as the least significant bits of the return value
+         */
+        uint64_t read(size_t& pos, unsigned n) const {
+            uint64_t value = 0;
+            while (n > 0) {
+                const unsigned bit_offset = (unsigned)(pos & 7u);
+                const unsigned avail_bits = 8u - bit_offset;
+                const unsigned chunk = (n < avail_bits ? n : avail_bits);
+                const uint8_t  bits = (uint8_t)((bytes[pos >> 3] >> (avail_bits - chunk)) & ((1u << chunk) - 1u));
+                value = (value << chunk) | bits;
+                pos += chunk;
+                n -= chunk;
+            }
+            return value;
+        }
+    };
+
+
+    /**
+     *  Class implementing a compressed block of measurement values and timestamps.
+     *  The encoding follows the Gorilla time series compression scheme:
+     *  - the first timestamp and value are stored uncompressed
+     *  - timestamps are stored as delta-of-delta values, using variable length bit patterns:
+     *    '0' for 0, '10' + 7 bits, '110' + 9 bits, '1110' + 12 bits, '1111' + 32 bits
+     *  - values are stored as xor of the previous value's ieee 754 bit pattern:
+     *    '0' for identical values, '10' + meaningful bits if the previous leading/trailing zero window fits,
+     *    '11' + 5 bits leading zeros + 6 bits meaningful bit count + meaningful bits otherwise
+     */
+    class CompressedMeasurementBlock {
+    public:
+        uint32_t  first_time;       //!< Timestamp of the first measurement in this block
+        uint32_t  last_time;        //!< Timestamp of the last measurement in this block
+        size_t    count;            //!< Number of measurements in this block
+        BitStream stream;           //!< Compressed measurement data
+
+    protected:
+        uint64_t  prev_bits;        //!< Bit pattern of the previous value
+        int32_t   prev_delta;       //!< Previous timestamp delta
+        unsigned  prev_leading;     //!< Leading zeros of the previous xor window
+        unsigned  prev_trailing;    //!< Trailing zeros of the previous xor window
+
+    public:
+        CompressedMeasurementBlock(void) : first_time(0), last_time(0), count(0), prev_bits(0), prev_delta(0), prev_leading(0xff), prev_trailing(0) {}
+
+        /**
+         *  Append a measurement to the block.
+         *  @param value the measurement value
+         *  @param time the measurement time
+         */
+        void addMeasurement(const double value, const uint32_t time) {
+            const uint64_t bits = toBits(value);
+            if (count == 0) {
+                first_time = time;
+                stream.write(time, 32);
+                stream.write(bits, 64);
+            }
+            else {
+                // encode delta-of-delta timestamp; modulo 2^32 arithmetic keeps timestamp wrap-arounds lossless
+                const int32_t delta = SpeedwireTime::calculateTimeDifference(time, last_time);
+                const int32_t dod = (int32_t)((uint32_t)delta - (uint32_t)prev_delta);
+                if (dod == 0) {
+                    stream.write(0x0, 1);
+                }
+                else if (dod >= -64 && dod <= 63) {
+                    stream.write(0x2, 2);
+                    stream.write((uint32_t)dod, 7);
+                }
+                else if (dod >= -256 && dod <= 255) {
+                    stream.write(0x6, 3);
+                    stream.write((uint32_t)dod, 9);
+                }
+                else if (dod >= -2048 && dod <= 2047) {
+                    stream.write(0xe, 4);
+                    stream.write((uint32_t)dod, 12);
+                }
+                else {
+                    stream.write(0xf, 4);
+                    stream.write((uint32_t)dod, 32);
+                }
+                prev_delta = delta;
+
+                // encode xor of value bit patterns
+                const uint64_t xor_bits = bits ^ prev_bits;
+                if (xor_bits == 0) {
+                    stream.write(0x0, 1);
+                }
+                else {
+                    unsigned leading  = countLeadingZeros(xor_bits);
+                    unsigned trailing = countTrailingZeros(xor_bits);
+                    if (leading > 31) leading = 31;     // must fit into 5 bits
+                    if (leading >= prev_leading && trailing >= prev_trailing) {
+                        stream.write(0x2, 2);
+                        stream.write(xor_bits >> prev_trailing, 64 - prev_leading - prev_trailing);
+                    }
+                    else {
+                        const unsigned meaningful = 64 - leading - trailing;
+                        stream.write(0x3, 2);
+                        stream.write(leading, 5);
+                        stream.write(meaningful & 0x3f, 6);    // 64 is encoded as 0
+                        stream.write(xor_bits >> trailing, meaningful);
+                        prev_leading  = leading;
+                        prev_trailing = trailing;
+                    }
+                }
+            }
+            prev_bits = bits;
+            last_time = time;
+            ++count;
+        }
+
+        /**
+         *  Class implementing a sequential decoder for a compressed block.
+         */
+        class Decoder {
+        protected:
+            const CompressedMeasurementBlock& block;
+            size_t   pos;
+            size_t   index;
+            uint32_t time;
+            int32_t  delta;
+            uint64_t bits;
+            unsigned leading;
+            unsigned trailing;
+
+        public:
+            Decoder(const CompressedMeasurementBlock& b) : block(b), pos(0), index(0), time(0), delta(0), bits(0), leading(0), trailing(0) {}
+
+            /**
+             *  Decode the next measurement.
+             *  @param pair the decoded measurement value and time
+             *  @return false if there are no more measurements in the block
+             */
+            bool next(TimestampDoublePair& pair) {
+                if (index >= block.count) {
+                    return false;
+                }
+                const BitStream& stream = block.stream;
+                if (index == 0) {
+                    time = (uint32_t)stream.read(pos, 32);
+                    bits = stream.read(pos, 64);
+                }
+                else {
+                    // decode delta-of-delta timestamp
+                    int32_t dod = 0;
+                    if (stream.read(pos, 1) != 0) {
+                        if (stream.read(pos, 1) == 0) {
+                            dod = signExtend(stream.read(pos, 7), 7);
+                        }
+                        else if (stream.read(pos, 1) == 0) {
+                            dod = signExtend(stream.read(pos, 9), 9);
+                        }
+                        else if (stream.read(pos, 1) == 0) {
+                            dod = signExtend(stream.read(pos, 12), 12);
+                        }
+                        else {
+                            dod = (int32_t)(uint32_t)stream.read(pos, 32);
+                        }
+                    }
+                    delta = (int32_t)((uint32_t)delta + (uint32_t)dod);
+                    time  = time + (uint32_t)delta;
+
+                    // decode xor of value bit patterns
+                    if (stream.read(pos, 1) != 0) {
+                        if (stream.read(pos, 1) != 0) {
+                            leading = (unsigned)stream.read(pos, 5);
+                            unsigned meaningful = (unsigned)stream.read(pos, 6);
+                            if (meaningful == 0) meaningful = 64;
+                            trailing = 64 - leading - meaningful;
+                        }
+                        const unsigned meaningful = 64 - leading - trailing;
+                        bits ^= (stream.read(pos, meaningful) << trailing);
+                    }
+                }
+                pair.time  = time;
+                pair.value = fromBits(bits);
+                ++index;
+                return true;
+            }
+        };
+
+        /**
+         *  Decode all measurements of this block and append them to the given vector.
+         *  @param pairs the output vector
+         *  @return the number of decoded measurements
+         */
+        size_t decode(std::vector<TimestampDoublePair>& pairs) const {
+            Decoder decoder(*this);
+            TimestampDoublePair pair;
+            while (decoder.next(pair)) {
+                pairs.push_back(pair);
+            }
+            return count;
+        }
+
+        //! Get the number of bytes occupied by the compressed data
+        size_t getCompressedSize(void) const { return stream.bytes.size(); }
+
+    protected:
+        static uint64_t toBits(const double value) { uint64_t bits; memcpy(&bits, &value, sizeof(bits)); return bits; }
+        static double fromBits(const uint64_t bits) { double value; memcpy(&value, &bits, sizeof(value)); return value; }
+
+        static int32_t signExtend(const uint64_t value, const unsigned n) {
+            const uint32_t sign = (uint32_t)1 << (n - 1);
+            return (int32_t)(((uint32_t)value ^ sign) - sign);
+        }
+
+        static unsigned countLeadingZeros(uint64_t x) {
+            unsigned n = 0;
+            if ((x & 0xffffffff00000000ull) == 0) { n += 32; x <<= 32; }
+            if ((x & 0xffff000000000000ull) == 0) { n += 16; x <<= 16; }
+            if ((x & 0xff00000000000000ull) == 0) { n +=  8; x <<=  8; }
+            if ((x & 0xf000000000000000ull) == 0) { n +=  4; x <<=  4; }
+            if ((x & 0xc000000000000000ull) == 0) { n +=  2; x <<=  2; }
+            if ((x & 0x8000000000000000ull) == 0) { n +=  1; }
+            return n;
+        }
+
+        static unsigned countTrailingZeros(uint64_t x) {
+            unsigned n = 0;
+            if ((x & 0x00000000ffffffffull) == 0) { n += 32; x >>= 32; }
+            if ((x & 0x000000000000ffffull) == 0) { n += 16; x >>= 16; }
+            if ((x & 0x00000000000000ffull) == 0) { n +=  8; x >>=  8; }
+            if ((x & 0x000000000000000full) == 0) { n +=  4; x >>=  4; }
+            if ((x & 0x0000000000000003ull) == 0) { n +=  2; x >>=  2; }
+            if ((x & 0x0000000000000001ull) == 0) { n +=  1; }
+            return n;
+        }
+    };
+
+
+    /**
+     *  Class implementing an append-only compressed store of measurement values together with their timestamps.
+     *  Measurements are appended to a sequence of compressed blocks holding a fixed number of measurements each.
+     *  The first timestamp of each block is kept uncompressed, such that time-wise seeks just decode a single block.
+     *  It can be used alongside the MeasurementValues ring buffer to retain a long measurement history.
+     */
+    class CompressedMeasurementValues {
+    protected:
+        std::deque<CompressedMeasurementBlock> blocks;  //!< Compressed blocks, ordered from oldest to newest
+        size_t values_per_block;                        //!< Maximum number of measurements per block
+        size_t max_blocks;                              //!< Maximum number of blocks; 0 means unlimited
+        size_t num_values;                              //!< Number of measurements in all blocks
+
+    public:
+        /**
+         *  Constructor.
+         *  @param values_per_block_ maximum number of measurements in a single block
+         *  @param max_blocks_ maximum number of blocks, the oldest block is discarded if exceeded; 0 means unlimited
+         */
+        CompressedMeasurementValues(const size_t values_per_block_ = 256, const size_t max_blocks_ = 0) :
+            values_per_block(values_per_block_ > 0 ? values_per_block_ : 1),
+            max_blocks(max_blocks_),
+            num_values(0) {}
+
+        /**
+         *  Append a new measurement. It is assumed that measurements are added with monotonically increasing timestamps.
+         *  @param value the measurement value
+         *  @param time the measurement time
+         */
+        void addMeasurement(const double value, const uint32_t time) {
+            if (blocks.size() == 0 || blocks.back().count >= values_per_block) {
+                blocks.push_back(CompressedMeasurementBlock());
+                if (max_blocks > 0 && blocks.size() > max_blocks) {
+                    num_values -= blocks.front().count;
+                    blocks.pop_front();
+                }
+            }
+            blocks.back().addMeasurement(value, time);
+            ++num_values;
+        }
+
+        /**
+         *  Append all measurements of the given ring buffer that are newer than the newest measurement in this store.
+         *  @param values the measurement values
+         *  @return the number of appended measurements
+         */
+        size_t addMeasurements(const MeasurementValues& values) {
+            size_t count = 0;
+            for (size_t i = 0; i < values.getNumberOfElements(); ++i) {
+                const TimestampDoublePair& pair = values.at(i);
+                if (num_values == 0 || SpeedwireTime::calculateTimeDifference(pair.time, blocks.back().last_time) > 0) {
+                    addMeasurement(pair.value, pair.time);
+                    ++count;
+                }
+            }
+            return count;
+        }
+
+        //! Delete all measurements
+        void clear(void) { blocks.clear(); num_values = 0; }
+
+        //! Get the number of measurements
+        size_t getNumberOfElements(void) const { return num_values; }
+
+        //! Get the number of compressed blocks
+        size_t getNumberOfBlocks(void) const { return blocks.size(); }
+
+        //! Get a reference to the compressed block with the given index; index 0 is the oldest block
+        const CompressedMeasurementBlock& getBlock(const size_t index) const { return blocks[index]; }
+
+        //! Get the number of bytes occupied by the compressed data of all blocks
+        size_t getCompressedSize(void) const {
+            size_t size = 0;
+            for (const auto& block : blocks) {
+                size += block.getCompressedSize();
+            }
+            return size;
+        }
+
+        /**
+         *  Find the index of the block holding the given time, i.e. the newest block starting at or before the given time.
+         *  @param time the time to search for
+         *  @return the block index; 0 if the time is older than the oldest block, (size_t)-1 if there are no blocks
+         */
+        size_t findBlockIndex(const uint32_t time) const {
+            if (blocks.size() == 0) {
+                return (size_t)-1;
+            }
+            size_t low = 0;
+            size_t high = blocks.size();
+            while ((low + 1) < high) {
+                const size_t mid = (low + high) / 2u;
+                if (SpeedwireTime::calculateTimeDifference(blocks[mid].first_time, time) <= 0) {
+                    low = mid;
+                }
+                else {
+                    high = mid;
+                }
+            }
+            return low;
+        }
+
+        /**
+         *  Decode all measurements in the given time range.
+         *  @param from start time of the range
+         *  @param to end time of the range; measurements with this timestamp are included
+         *  @param pairs the output vector
+         *  @return the number of decoded measurements
+         */
+        size_t decode(const uint32_t from, const uint32_t to, std::vector<TimestampDoublePair>& pairs) const {
+            size_t count = 0;
+            for (size_t i = findBlockIndex(from); i < blocks.size(); ++i) {
+                const CompressedMeasurementBlock& block = blocks[i];
+                if (SpeedwireTime::calculateTimeDifference(block.first_time, to) > 0) {
+                    break;
+                }
+                CompressedMeasurementBlock::Decoder decoder(block);
+                TimestampDoublePair pair;
+                while (decoder.next(pair)) {
+                    if (SpeedwireTime::calculateTimeDifference(pair.time, to) > 0) {
+                        return count;
+                    }
+                    if (SpeedwireTime::calculateTimeDifference(pair.time, from) >= 0) {
+                        pairs.push_back(pair);
+                        ++count;
+                    }
+                }
+            }
+            return count;
+        }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __LIBSPEEDWIRE_DEADBANDPRODUCER_HPP__
+#define __LIBSPEEDWIRE_DEADBANDPRODUCER_HPP__
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <Producer.hpp>
+#include <MeasurementType.hpp>
+#include <SpeedwireDevice.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class DeadbandProducer implements a pipeline stage between the processors and a Producer, that suppresses
+     *  values that did not change significantly since the most recently passed on value of the same channel.
+     *
+     *  A deadband can be configured per Quantity or per MeasurementType, where the MeasurementType configuration takes
+     *  precedence. A value is passed on, if it deviates from the most recently passed on value by more than the absolute
+     *  deadband, or by more than the relative deadband times the magnitude of the most recently passed on value. A deadband
+     *  of 0 is disabled; if both are 0, only changed values are passed on. Regardless of the deadband, a value is passed on if the heartbeat interval has
+     *  elapsed since the most recently passed on value of its channel. Values without a deadband configuration are always
+     *  passed on.
+     *
+     *  Channels are identified by the device address, the measurement type and the wire.
+     */
+    class DeadbandProducer : public Producer {
+
+    protected:
+
+        //! Struct holding a deadband configuration.
+        typedef struct {
+            double absolute;    //!< Absolute deadband in units of the measurement
+            double relative;    //!< Relative deadband, e.g. 0.01 for 1%
+        } Deadband;
+
+        //! Struct holding the state of a single channel.
+        typedef struct {
+            double   value;     //!< The most recently passed on value
+            uint64_t tick;      //!< Local tick count in ms of the most recently passed on value
+        } ChannelState;
+
+        typedef std::pair<uint64_t, uint32_t> ChannelKey;   //!< Channel key consisting of device address key and measurement type and wire key
+
+        Producer& producer;                                 //!< Reference to the producer receiving all values passed on
+        uint64_t heartbeat_ms;                              //!< Heartbeat interval in ms; 0 to disable heartbeats
+        std::map<Quantity, Deadband> quantityDeadbands;     //!< Deadband configuration per quantity
+        std::map<uint32_t, Deadband> typeDeadbands;         //!< Deadband configuration per measurement type
+        std::map<ChannelKey, ChannelState> channels;        //!< Channel states
+        uint64_t numberOfPassedValues;                      //!< Number of values passed on
+        uint64_t numberOfSuppressedValues;                  //!< Number of values suppressed
+        ProducerFrame filteredFrame;                        //!< Frame holding the values passed on from the most recent frame
+
+        const Deadband* findDeadband(const MeasurementType& type) const;
+        bool pass(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value);
+        virtual uint64_t getTickCountInMs(void) const;
+
+    public:
+        DeadbandProducer(Producer& producer, const unsigned long heartbeat_in_seconds = 0);
+        virtual ~DeadbandProducer(void);
+
+        void setDeadband(const Quantity quantity, const double absolute, const double relative = 0.0);
+        void setDeadband(const MeasurementType& type, const double absolute, const double relative = 0.0);
+        void setHeartbeat(const unsigned long heartbeat_in_seconds);
+
+        /** Get the number of values passed on to the producer. */
+        uint64_t getNumberOfPassedValues(void) const { return numberOfPassedValues; }
+
+        /** Get the number of values suppressed. */
+        uint64_t getNumberOfSuppressedValues(void) const { return numberOfSuppressedValues; }
+
+        virtual void flush(void);
+        virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms = 0);
+        virtual void produce(const ProducerFrame& frame, const ProducerSeriesTable& table);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef __LIBSPEEDWIRE_DERIVEDVALUEGRAPH_HPP__
+#define __LIBSPEEDWIRE_DERIVEDVALUEGRAPH_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <Measurement.hpp>
+#include <ObisData.hpp>
+#include <SpeedwireData.hpp>
+#include <SpeedwireDevice.hpp>
+#include <Producer.hpp>
+
+namespace libspeedwire {
+
+    //! Source of a measurement referenced by a derived value node.
+    enum class DerivedValueSource {
+        OBIS_DATA,          //!< An element of the obis data map.
+        SPEEDWIRE_DATA,     //!< An element of the speedwire data map.
+        DERIVED_VALUE       //!< The output of a previously declared derived value node.
+    };
+
+    /**
+     *  Class referencing a measurement by its source and key. References are resolved to direct pointers
+     *  by the DerivedValueGraph.
+     */
+    class DerivedValueRef {
+    public:
+        DerivedValueSource source;      //!< Source of the measurement
+        uint32_t           key;         //!< Key of the measurement, i.e. the obis or speedwire data key
+        bool               optional;    //!< The node is also evaluated if this input cannot be resolved or holds no measurements
+
+        DerivedValueRef(const DerivedValueSource src, const uint32_t k, const bool opt = false) : source(src), key(k), optional(opt) {}
+
+        //! Reference an element of the obis data map.
+        static DerivedValueRef obis(const ObisData& element, const bool optional = false) { return DerivedValueRef(DerivedValueSource::OBIS_DATA, element.toKey(), optional); }
+        //! Reference an element of the speedwire data map.
+        static DerivedValueRef speedwire(const SpeedwireData& element, const bool optional = false) { return DerivedValueRef(DerivedValueSource::SPEEDWIRE_DATA, element.toKey(), optional); }
+        //! Reference the output of a derived value node.
+        static DerivedValueRef derived(const ObisData& element, const bool optional = false) { return DerivedValueRef(DerivedValueSource::DERIVED_VALUE, element.toKey(), optional); }
+        //! Reference the output of a derived value node.
+        static DerivedValueRef derived(const SpeedwireData& element, const bool optional = false) { return DerivedValueRef(DerivedValueSource::DERIVED_VALUE, element.toKey(), optional); }
+    };
+
+    //! Input slot of a derived value node.
+    struct DerivedValueInput {
+        DerivedValueRef    ref;             //!< Declared reference
+        const Measurement* measurement;     //!< Resolved measurement, or NULL if the reference could not be resolved
+        std::vector<std::pair<uint32_t, uint32_t> > times;  //!< Serial number of each evaluating device and the time of the newest measurement seen by the most recent evaluation for it
+        bool               changed;         //!< The input has changed since the most recent evaluation of the node for the evaluating device
+
+        DerivedValueInput(const DerivedValueRef& r) : ref(r), measurement(NULL), times(), changed(false) {}
+
+        /**
+         *  Get the time of the newest measurement seen by the most recent evaluation for the given device.
+         *  Several devices, like several inverters, can update the same input measurement, even within the same second;
+         *  therefore changes are tracked separately for each device.
+         *  @param serial_number the serial number of the evaluating device
+         *  @return a reference to the time; it is 0 if the node has not yet been evaluated for this device
+         */
+        uint32_t& getTime(const uint32_t serial_number) {
+            for (auto& entry : times) {
+                if (entry.first == serial_number) {
+                    return entry.second;
+                }
+            }
+            times.push_back(std::pair<uint32_t, uint32_t>(serial_number, 0));
+            return times.back().second;
+        }
+    };
+
+    class DerivedValueNode;
+
+    /**
+     *  Formula calculating a derived value from the inputs of a node. The formula sets the node result,
+     *  usually by calling node.setResult(), and returns true if a result is to be produced.
+     */
+    typedef std::function<bool(DerivedValueNode& node, const SpeedwireDevice& device, const uint32_t time)> DerivedValueFormula;
+
+    /**
+     *  Class implementing a node of the derived value graph, i.e. a formula together with its input slots and its output.
+     */
+    class DerivedValueNode {
+    public:
+        uint32_t            key;            //!< Key of the output measurement, used to reference this node as an input
+        DerivedValueSource  source;         //!< Source of the output definition, i.e. obis data or speedwire data
+        unsigned int        trigger;        //!< Trigger identifier; the node is only evaluated for this trigger
+        std::vector<DerivedValueInput> inputs;  //!< Input slots
+        DerivedValueFormula formula;        //!< Formula calculating the derived value
+        Measurement         value;          //!< Measurement holding the derived values, unless mapped is set
+        Measurement*        output;         //!< Resolved output measurement
+        bool                mapped;         //!< Write the derived values into the obis or speedwire data map entry instead
+        uint32_t            serialNumber;   //!< Serial number of the device to produce the derived value for, or 0 for the originating device
+        TimestampDoublePair result;         //!< Result of the most recent evaluation
+        bool                enabled;        //!< All required inputs and the output could be resolved
+        bool                updated;        //!< The node produced a result in the most recent evaluation pass of its trigger
+
+        DerivedValueNode(const Measurement& definition, const uint32_t k, const DerivedValueSource src, const unsigned int trig, const DerivedValueFormula& f);
+
+        /** Get the resolved input measurement with the given index; the input must be resolved. */
+        const Measurement& input(const size_t i) const { return *inputs[i].measurement; }
+
+        /** Check if the input with the given index is resolved and holds measurements. */
+        bool hasInput(const size_t i) const { return (inputs[i].measurement != NULL && inputs[i].measurement->measurementValues.getNumberOfElements() > 0); }
+
+        /**
+         *  Set the result of the current evaluation and add it to the output measurement.
+         *  @param value the derived value
+         *  @param time the time of the derived value
+         */
+        void setResult(const double value, const uint32_t time) {
+            result = TimestampDoublePair(value, time);
+            output->measurementValues.addMeasurement(value, time);
+        }
+    };
+
+    /**
+     *  Class DerivedValueGraph implements a directed acyclic graph of values derived from obis data and speedwire data,
+     *  like signed power, totals, losses or efficiencies.
+     *
+     *  Nodes are declared at startup by their output definition, their inputs and their formula. Nodes can only reference
+     *  outputs of previously declared nodes, so the declaration order is a topological order of the graph. Input references
+     *  are resolved once to direct pointers into the data maps; they are resolved again, if elements are added to or removed
+     *  from any of the data maps, as indicated by the map generation. Upon evaluation, only those nodes are evaluated whose
+     *  inputs changed since their most recent evaluation for the same device, so adding a derived value does not add map
+     *  lookups to the per packet processing.
+     */
+    class DerivedValueGraph {
+
+    protected:
+        ObisDataMap&      obis_data_map;        //!< Reference to the data map, where all received obis values reside
+        SpeedwireDataMap& speedwire_data_map;   //!< Reference to the data map, where all received inverter values reside
+        std::vector<DerivedValueNode> nodes;    //!< Nodes in declaration order
+        bool              resolved;             //!< All references have been resolved
+        uint32_t          obis_map_generation;      //!< Generation of the obis data map at the time of the most recent resolution
+        uint32_t          speedwire_map_generation; //!< Generation of the speedwire data map at the time of the most recent resolution
+        ProducerSeriesTable producerSeries;     //!< Series table used if results are passed on to a producer
+        ProducerFrame     producerFrame;        //!< Frame used if results are passed on to a producer
+
+        Measurement* find(const DerivedValueSource source, const uint32_t key, const size_t node_index);
+        DerivedValueNode& add(DerivedValueNode&& node, const std::vector<DerivedValueRef>& inputs);
+
+    public:
+        DerivedValueGraph(ObisDataMap& obis_map, SpeedwireDataMap& speedwire_map);
+        ~DerivedValueGraph(void);
+
+        DerivedValueNode& add(const ObisData& output, const unsigned int trigger, const std::vector<DerivedValueRef>& inputs, const DerivedValueFormula& formula);
+        DerivedValueNode& add(const SpeedwireData& output, const unsigned int trigger, const std::vector<DerivedValueRef>& inputs, const DerivedValueFormula& formula);
+
+        void resolve(void);
+        size_t evaluate(const SpeedwireDevice& device, const unsigned int trigger, const uint32_t time, ProducerFrame& frame, ProducerSeriesTable& table);
+        size_t evaluate(const SpeedwireDevice& device, const unsigned int trigger, const uint32_t time, Producer& producer);
+
+        /** Get the number of nodes. */
+        size_t size(void) const { return nodes.size(); }
+
+        /** Get the node with the given index, i.e. the position in declaration order. */
+        const DerivedValueNode& getNode(const size_t index) const { return nodes[index]; }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -3,7 +3,10 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cfloat>
+#include <cmath>
 #include <vector>
+#include <algorithm>
 #include <MeasurementValues.hpp>
 
 #define DEBUG_LOGGING (defined(_DEBUG) && 0)
@@ -32,6 +35,14 @@ namespace libspeedwire {
         StatisticalEstimates(const double m, const double var, const double sl, const double sl_var) : mean(m), variance(var), slope(sl), sloped_variance(sl_var) {}
     };
 
+    /**
+     *  Enumeration of the available change point detection methods for piecewise constant approximations.
+     */
+    enum class SegmentationMethod {
+        TOTAL_VARIATION,    //!< Simplified total variation of sliding window variances; fast but heuristic
+        PELT                //!< Pruned exact linear time (PELT) optimal partitioning; optimal for the given penalty
+    };
+
     class LineSegmentEstimator {
     public:
 
@@ -85,6 +96,105 @@ namespace libspeedwire {
             return totalVariationOfLinearRegressionValues(mvalues, window_size, estimates, changepoints);
         }
 
+        /**
+         *  Find mean value change points by pruned exact linear time (PELT) optimal partitioning.
+         *  The cost of each segment is the sum of squared differences to the segment mean; each additional segment
+         *  adds the given penalty to the total cost. The resulting segmentation minimizes the total cost, while the
+         *  pruning step keeps the runtime linear in the number of values for signals with regularly spaced changes.
+         *  @param mvalues input measurement values
+         *  @param penalty the cost added for each change point; larger values result in fewer change points
+         *  @param changepoints output vector holding indexes of change points; the index points to the last index before the change point
+         *  @return the number of change points
+         */
+        static size_t findChangePointsOfMeanValuesPELT(const MeasurementValues& mvalues, const double penalty, std::vector<size_t>& changepoints) {
+            const size_t num_values = mvalues.getNumberOfElements();
+            if (num_values < 2) {
+                return changepoints.size();
+            }
+
+            // cumulative sums of values and squared values; this allows to calculate segment costs in O(1)
+            std::vector<double> y_sum(num_values + 1), y_sq_sum(num_values + 1);
+            y_sum[0] = y_sq_sum[0] = 0.0;
+            for (size_t i = 0; i < num_values; ++i) {
+                const double value = mvalues.at(i).value;
+                y_sum[i + 1]    = y_sum[i]    + value;
+                y_sq_sum[i + 1] = y_sq_sum[i] + value * value;
+            }
+
+            // optimal_cost[t] is the minimum total cost for values 0 .. t-1, last_start[t] is the start index of the last segment
+            std::vector<double> optimal_cost(num_values + 1);
+            std::vector<size_t> last_start(num_values + 1);
+            std::vector<size_t> candidates, pruned_candidates;
+            std::vector<double> candidate_costs;
+            candidates.reserve(num_values + 1);
+            pruned_candidates.reserve(num_values + 1);
+            candidate_costs.reserve(num_values + 1);
+            optimal_cost[0] = -penalty;
+            last_start[0] = 0;
+            candidates.push_back(0);
+
+            for (size_t t = 1; t <= num_values; ++t) {
+                // find the best start index of the last segment among all remaining candidates
+                double min_cost = DBL_MAX;
+                size_t min_start = 0;
+                candidate_costs.clear();
+                for (const size_t s : candidates) {
+                    const double cost = optimal_cost[s] + segmentCost(y_sum, y_sq_sum, s, t);
+                    candidate_costs.push_back(cost);
+                    if (cost + penalty < min_cost) {
+                        min_cost  = cost + penalty;
+                        min_start = s;
+                    }
+                }
+                optimal_cost[t] = min_cost;
+                last_start[t] = min_start;
+
+                // prune candidates that can never become optimal again
+                pruned_candidates.clear();
+                for (size_t i = 0; i < candidates.size(); ++i) {
+                    if (candidate_costs[i] <= min_cost) {
+                        pruned_candidates.push_back(candidates[i]);
+                    }
+                }
+                pruned_candidates.push_back(t);
+                candidates.swap(pruned_candidates);
+            }
+
+            // backtrack segment start indexes from the end of the value range
+            const size_t first_new = changepoints.size();
+            for (size_t t = num_values; last_start[t] > 0; t = last_start[t]) {
+                changepoints.push_back(last_start[t] - 1);
+            }
+            std::reverse(changepoints.begin() + first_new, changepoints.end());
+#if DEBUG_LOGGING
+            for (size_t i = first_new; i < changepoints.size(); ++i) {
+                printf("pelt change point found at %d\n", (int)changepoints[i]);
+            }
+#endif
+            return changepoints.size();
+        }
+
+        /**
+         *  Estimate a default penalty for PELT change point detection. The noise variance is estimated from the
+         *  differences of consecutive values, which are largely insensitive to steps in the mean value; the penalty
+         *  is then derived from the bayesian information criterion: 2 * variance * ln(n).
+         *  @param mvalues input measurement values
+         *  @return the penalty
+         */
+        static double estimatePenaltyPELT(const MeasurementValues& mvalues) {
+            const size_t num_values = mvalues.getNumberOfElements();
+            if (num_values < 2) {
+                return 0.0;
+            }
+            double diff_sq_sum = 0.0;
+            for (size_t i = 1; i < num_values; ++i) {
+                const double diff = mvalues.at(i).value - mvalues.at(i - 1).value;
+                diff_sq_sum += diff * diff;
+            }
+            const double variance = diff_sq_sum / (2 * (num_values - 1));
+            return 2.0 * variance * log((double)num_values);
+        }
+
         /**
          *  Find mean value intervals by simplified total variation.
          *  @param mvalues input measurement values
@@ -93,22 +203,25 @@ namespace libspeedwire {
          */
         static size_t findPiecewiseConstantIntervals(const MeasurementValues& mvalues, std::vector<MeasurementValueInterval>& intervals) {
             std::vector<size_t> changes;
-            if (findChangePointsOfMeanValues(mvalues, changes) > 0) {
-                double avg0 = mvalues.estimateMean(0, changes[0]);
-                intervals.push_back(MeasurementValueInterval(0, changes[0], avg0));
+            findChangePointsOfMeanValues(mvalues, changes);
+            return convertChangePointsToConstantIntervals(mvalues, changes, intervals);
+        }
 
-                for (size_t i = 1; i < changes.size(); ++i) {
-                    double avg = mvalues.estimateMean(changes[i - 1] + 1, changes[i]);
-                    intervals.push_back(MeasurementValueInterval(changes[i - 1] + 1, changes[i], avg));
-                }
-                double avgn = mvalues.estimateMean(changes[changes.size() - 1] + 1, mvalues.getNumberOfElements() - 1);
-                intervals.push_back(MeasurementValueInterval(changes[changes.size() - 1] + 1, mvalues.getNumberOfElements() - 1, avgn));
-            }
-            else {
-                double avg = mvalues.estimateMean();
-                intervals.push_back(MeasurementValueInterval(0, mvalues.getNumberOfElements() - 1, avg));
+        /**
+         *  Find mean value intervals by the given segmentation method.
+         *  @param mvalues input measurement values
+         *  @param intervals output vector holding interval definitions
+         *  @param method the change point detection method
+         *  @param penalty the cost added for each change point (PELT only); if <= 0, a penalty is estimated from the measurement values
+         *  @return the number of intervals
+         */
+        static size_t findPiecewiseConstantIntervals(const MeasurementValues& mvalues, std::vector<MeasurementValueInterval>& intervals, const SegmentationMethod method, const double penalty = 0.0) {
+            if (method == SegmentationMethod::PELT) {
+                std::vector<size_t> changes;
+                findChangePointsOfMeanValuesPELT(mvalues, (penalty > 0.0 ? penalty : estimatePenaltyPELT(mvalues)), changes);
+                return convertChangePointsToConstantIntervals(mvalues, changes, intervals);
             }
-            return intervals.size();
+            return findPiecewiseConstantIntervals(mvalues, intervals);
         }
 
         /**
@@ -140,6 +253,45 @@ namespace libspeedwire {
 
     protected:
 
+        /**
+         *  Calculate the cost of the segment of values s .. t-1, i.e. the sum of squared differences to the segment mean.
+         *  @param y_sum cumulative sums of values
+         *  @param y_sq_sum cumulative sums of squared values
+         *  @param s start index of the segment
+         *  @param t end index of the segment; the value with index t is not included
+         *  @return the segment cost
+         */
+        static double segmentCost(const std::vector<double>& y_sum, const std::vector<double>& y_sq_sum, const size_t s, const size_t t) {
+            const double sum = y_sum[t] - y_sum[s];
+            return (y_sq_sum[t] - y_sq_sum[s]) - sum * sum / (double)(t - s);
+        }
+
+        /**
+         *  Convert the given change points into mean value intervals.
+         *  @param mvalues input measurement values
+         *  @param changes input change points; each index points to the last index before the change point
+         *  @param intervals output vector holding interval definitions
+         *  @return the number of intervals
+         */
+        static size_t convertChangePointsToConstantIntervals(const MeasurementValues& mvalues, const std::vector<size_t>& changes, std::vector<MeasurementValueInterval>& intervals) {
+            if (changes.size() > 0) {
+                double avg0 = mvalues.estimateMean(0, changes[0]);
+                intervals.push_back(MeasurementValueInterval(0, changes[0], avg0));
+
+                for (size_t i = 1; i < changes.size(); ++i) {
+                    double avg = mvalues.estimateMean(changes[i - 1] + 1, changes[i]);
+                    intervals.push_back(MeasurementValueInterval(changes[i - 1] + 1, changes[i], avg));
+                }
+                double avgn = mvalues.estimateMean(changes[changes.size() - 1] + 1, mvalues.getNumberOfElements() - 1);
+                intervals.push_back(MeasurementValueInterval(changes[changes.size() - 1] + 1, mvalues.getNumberOfElements() - 1, avgn));
+            }
+            else {
+                double avg = mvalues.estimateMean();
+                intervals.push_back(MeasurementValueInterval(0, mvalues.getNumberOfElements() - 1, avg));
+            }
+            return intervals.size();
+        }
+
         /**
          *  Estimate statistical parameters for each values in the given measurement values.
          *  A sliding window around each value is used to estimate:
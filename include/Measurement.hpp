@@ -4,18 +4,21 @@
 #include <string>
 #include <MeasurementType.hpp>
 #include <MeasurementValues.hpp>
+#include <MeasurementPyramid.hpp>
 
 namespace libspeedwire {
 
     /**
      *  Class holding measurement values together with their corresponding measurement type definition.
+     *  The measurement type definition is interned in the MeasurementTypeRegistry and referenced by pointer,
+     *  so copying a measurement does not copy any strings.
      */
     class Measurement {
     public:
-        MeasurementType   measurementType;
+        const MeasurementDescriptor* descriptor; //!< Interned measurement type, wire and full name
         MeasurementValues measurementValues;
+        MeasurementPyramid measurementPyramid;  //!< Optional multi-resolution history; disabled unless levels are added
         Wire              wire;
-        std::string       description;
 
         /**
          *  Constructor.
@@ -23,25 +26,100 @@ namespace libspeedwire {
          *  @param wire_   measurement wire
          */
         Measurement(const MeasurementType& mType, const Wire& mWire) :
-            measurementType(mType),
+            descriptor(&MeasurementTypeRegistry::getInstance().intern(mType, mWire)),
             measurementValues(0),
-            wire(mWire),
-            description(mType.getFullName(mWire)) {
+            measurementPyramid(),
+            wire(mWire) {
         }
 
+        /**
+         *  Constructor.
+         *  @param mDescriptor interned measurement type and wire
+         */
+        Measurement(const MeasurementDescriptor& mDescriptor) :
+            descriptor(&mDescriptor),
+            measurementValues(0),
+            measurementPyramid(),
+            wire(mDescriptor.wire) {
+        }
+
+        /** Get the measurement type. */
+        const MeasurementType& getMeasurementType(void) const { return descriptor->measurementType; }
+
+        /** Get the description, i.e. the full name of the measurement type and wire. */
+        const std::string& getDescription(void) const { return descriptor->fullName; }
+
         /**
          *  Add a new measurement value.
          *  @param value the measurement value
          *  @param time the measurement time
          */
         void addMeasurement(const int32_t  raw_value, const uint32_t time) {
-            measurementValues.addMeasurement((double)raw_value / (double)measurementType.divisor, time);
+            addMeasurementValue((double)raw_value / (double)getMeasurementType().divisor, time);
         }
         void addMeasurement(const uint32_t raw_value, const uint32_t time) {
-            measurementValues.addMeasurement((double)raw_value / (double)measurementType.divisor, time);
+            addMeasurementValue((double)raw_value / (double)getMeasurementType().divisor, time);
         }
         void addMeasurement(const uint64_t raw_value, const uint32_t time) {
-            measurementValues.addMeasurement((double)raw_value / (double)measurementType.divisor, time);
+            addMeasurementValue((double)raw_value / (double)getMeasurementType().divisor, time);
+        }
+
+        /**
+         *  Add arrays of new measurement values, e.g. to replay yield history or to backfill from persistent storage.
+         *  Raw values are scaled by the reciprocal of the divisor, and the ring buffer is written in bulk.
+         *  @param raw_values pointer to the first raw measurement value
+         *  @param times pointer to the first measurement time
+         *  @param n number of measurements
+         */
+        void addMeasurements(const int32_t* const raw_values, const uint32_t* const times, const size_t n) {
+            addRawMeasurements(raw_values, times, n);
+        }
+        void addMeasurements(const uint32_t* const raw_values, const uint32_t* const times, const size_t n) {
+            addRawMeasurements(raw_values, times, n);
+        }
+        void addMeasurements(const uint64_t* const raw_values, const uint32_t* const times, const size_t n) {
+            addRawMeasurements(raw_values, times, n);
+        }
+
+        /**
+         *  Add arrays of new measurement values, that have already been converted to the measurement unit.
+         *  @param values pointer to the first measurement value
+         *  @param times pointer to the first measurement time
+         *  @param n number of measurements
+         */
+        void addMeasurementValues(const double* const values, const uint32_t* const times, const size_t n) {
+            measurementValues.addMeasurements(values, times, n);
+            if (measurementPyramid.isEnabled()) {
+                for (size_t i = 0; i < n; ++i) {
+                    measurementPyramid.addMeasurement(values[i], times[i]);
+                }
+            }
+        }
+
+        /**
+         *  Add a new measurement value, that has already been converted to the measurement unit.
+         *  @param value the measurement value
+         *  @param time the measurement time
+         */
+        void addMeasurementValue(const double value, const uint32_t time) {
+            measurementValues.addMeasurement(value, time);
+            if (measurementPyramid.isEnabled()) {
+                measurementPyramid.addMeasurement(value, time);
+            }
+        }
+
+    protected:
+        //! Convert and add arrays of raw measurement values of any integer type
+        template<class RawType> void addRawMeasurements(const RawType* const raw_values, const uint32_t* const times, const size_t n) {
+            const double reciprocal = 1.0 / (double)getMeasurementType().divisor;
+            measurementValues.generateNewElements(n, [raw_values, times, reciprocal](const size_t i) {
+                return TimestampDoublePair((double)raw_values[i] * reciprocal, times[i]);
+            });
+            if (measurementPyramid.isEnabled()) {
+                for (size_t i = 0; i < n; ++i) {
+                    measurementPyramid.addMeasurement((double)raw_values[i] * reciprocal, times[i]);
+                }
+            }
         }
     };
 
@@ -0,0 +1,250 @@
+#ifndef __LIBSPEEDWIRE_MEASUREMENTPYRAMID_HPP__
+#define __LIBSPEEDWIRE_MEASUREMENTPYRAMID_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <RingBuffer.hpp>
+#include <AggregatedValue.hpp>
+#include <SpeedwireTime.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class encapsulating a single aggregation level, i.e. a ring buffer of aggregates with a fixed bucket length.
+     *  The most recent bucket is kept open until a measurement with a timestamp beyond the bucket is added.
+     */
+    class MeasurementAggregationLevel : public RingBuffer<AggregatedValue> {
+    public:
+        uint32_t        bucket_length;  //!< Length of a time bucket, in the time unit of the measurement timestamps
+        AggregatedValue current;        //!< Currently open time bucket
+
+        /**
+         *  Constructor.
+         *  @param length the length of a time bucket in the time unit of the measurement timestamps
+         *  @param capacity the maximum number of closed time buckets
+         */
+        MeasurementAggregationLevel(const uint32_t length, const size_t capacity) : RingBuffer(capacity), bucket_length(length > 0 ? length : 1) {}
+
+        /**
+         *  Add a new measurement to the aggregation level. If the measurement belongs to a new time bucket, the currently open
+         *  bucket is closed and moved to the ring buffer. Measurements older than the open bucket are added to the open bucket.
+         *  @param value the measurement value
+         *  @param time the measurement time
+         */
+        void addMeasurement(const double value, const uint32_t time) {
+            const uint32_t bucket_time = time - (time % bucket_length);
+            if (current.count == 0) {
+                current.time = bucket_time;
+            }
+            else if (SpeedwireTime::calculateTimeDifference(bucket_time, current.time) > 0) {
+                addNewElement(current);
+                current = AggregatedValue(bucket_time);
+            }
+            current.add(value);
+        }
+
+        /**
+         *  Get the start time of the oldest time bucket held by this level.
+         *  @return the start time
+         */
+        uint32_t getOldestTime(void) const {
+            return (getNumberOfElements() > 0 ? at(0).time : current.time);
+        }
+
+        /**
+         *  Check if this level holds aggregates back to the given time.
+         *  @param time the time to check
+         *  @return true if the oldest time bucket starts at or before the given time
+         */
+        bool covers(const uint32_t time) const {
+            return ((getNumberOfElements() > 0 || current.count > 0) && SpeedwireTime::calculateTimeDifference(getOldestTime(), time) <= 0);
+        }
+
+        /**
+         *  Aggregate all time buckets overlapping the given time range.
+         *  The result is exact if the range boundaries are aligned to multiples of the bucket length.
+         *  @param from start time of the range
+         *  @param to end time of the range; measurements with this timestamp are included
+         *  @param result the aggregate to add the time buckets to
+         */
+        void aggregate(const uint32_t from, const uint32_t to, AggregatedValue& result) const {
+            const size_t num_buckets = getNumberOfElements();
+
+            // binary search for the first bucket ending after the start of the range
+            size_t low = 0;
+            size_t high = num_buckets;
+            while (low < high) {
+                const size_t mid = (low + high) / 2u;
+                if (SpeedwireTime::calculateTimeDifference(at(mid).time + bucket_length, from) <= 0) {
+                    low = mid + 1;
+                }
+                else {
+                    high = mid;
+                }
+            }
+            for (size_t i = low; i < num_buckets && SpeedwireTime::calculateTimeDifference(at(i).time, to) <= 0; ++i) {
+                result.add(at(i));
+            }
+            if (current.count > 0 &&
+                SpeedwireTime::calculateTimeDifference(current.time + bucket_length, from) > 0 &&
+                SpeedwireTime::calculateTimeDifference(current.time, to) <= 0) {
+                result.add(current);
+            }
+        }
+    };
+
+
+    /**
+     *  Class implementing a multi-resolution downsampling pyramid for measurement values.
+     *  Each level holds aggregates (min, max, mean and count) of a fixed bucket length; levels are updated incrementally
+     *  for each new measurement. Range queries are answered from the coarsest adequate level, with partial buckets at the
+     *  edges of the range filled from finer levels, such that their cost depends on the number of buckets in the range
+     *  rather than the number of raw measurement values.
+     *  By default the pyramid holds no levels and is disabled.
+     */
+    class MeasurementPyramid {
+    protected:
+        std::vector<MeasurementAggregationLevel> levels;    //!< Aggregation levels, ordered from finest to coarsest
+
+    public:
+        MeasurementPyramid(void) {}
+
+        /**
+         *  Add an aggregation level. Levels must be added from the finest to the coarsest bucket length.
+         *  @param bucket_length the length of a time bucket in the time unit of the measurement timestamps
+         *  @param capacity the maximum number of time buckets kept for this level
+         */
+        void addLevel(const uint32_t bucket_length, const size_t capacity) {
+            levels.push_back(MeasurementAggregationLevel(bucket_length, capacity));
+        }
+
+        /**
+         *  Add the default levels with bucket lengths of 1 s, 10 s, 1 min and 15 min. The capacities are chosen to
+         *  retain 10 minutes, 1 hour, 1 day and 1 week of history respectively.
+         *  @param time_units_per_second the number of timestamp units per second, e.g. 1000 for emeter and 1 for inverter timestamps
+         */
+        void addDefaultLevels(const uint32_t time_units_per_second) {
+            addLevel(time_units_per_second,            600);
+            addLevel(time_units_per_second * 10,       360);
+            addLevel(time_units_per_second * 60,      1440);
+            addLevel(time_units_per_second * 60 * 15,  672);
+        }
+
+        /**
+         *  Remove all aggregation levels; this disables the pyramid.
+         */
+        void clear(void) {
+            levels.clear();
+        }
+
+        /**
+         *  Check if the pyramid holds any aggregation levels.
+         *  @return true if there is at least one level
+         */
+        bool isEnabled(void) const {
+            return (levels.size() > 0);
+        }
+
+        //! Get the number of aggregation levels
+        size_t getNumberOfLevels(void) const { return levels.size(); }
+
+        //! Get a reference to the aggregation level with the given index; index 0 is the finest level
+        const MeasurementAggregationLevel& getLevel(const size_t index) const { return levels[index]; }
+
+        /**
+         *  Add a new measurement to all aggregation levels.
+         *  @param value the measurement value
+         *  @param time the measurement time
+         */
+        void addMeasurement(const double value, const uint32_t time) {
+            for (auto& level : levels) {
+                level.addMeasurement(value, time);
+            }
+        }
+
+        /**
+         *  Find the coarsest level adequate for the given time range. A level is adequate, if at least one of its time
+         *  buckets lies entirely within the time range and if it holds aggregates back to the first of these buckets.
+         *  If no level is adequate, the finest level is used for short time ranges and the coarsest level for time ranges
+         *  beyond the history of all other levels.
+         *  @param from start time of the range
+         *  @param to end time of the range
+         *  @param num_levels the number of finest levels to consider; by default all levels are considered
+         *  @return the level index, or (size_t)-1 if there are no levels
+         */
+        size_t findAdequateLevel(const uint32_t from, const uint32_t to, const size_t num_levels = (size_t)-1) const {
+            const size_t n = (num_levels < levels.size() ? num_levels : levels.size());
+            if (n == 0) {
+                return (size_t)-1;
+            }
+            for (size_t i = n; i-- > 1; ) {
+                const uint32_t length = levels[i].bucket_length;
+                const uint32_t first = getFirstBucketTime(from, length);
+                const uint32_t end = getEndBucketTime(to, length);
+                if (SpeedwireTime::calculateTimeDifference(end, first) >= (int32_t)length && levels[i].covers(first)) {
+                    return i;
+                }
+            }
+            return (levels[0].covers(from) ? 0 : n - 1);
+        }
+
+        /**
+         *  Aggregate all measurement values in the given time range. The whole time buckets inside the range are taken
+         *  from the coarsest adequate level, the partial buckets at both edges of the range are filled from finer levels.
+         *  The result is exact down to the bucket length of the finest level holding the edges.
+         *  @param from start time of the range
+         *  @param to end time of the range; measurements with this timestamp are included
+         *  @return the aggregate; its count is 0 if there are no measurements in the range
+         */
+        AggregatedValue aggregate(const uint32_t from, const uint32_t to) const {
+            AggregatedValue result(from);
+            aggregate(from, to, levels.size(), result);
+            return result;
+        }
+
+    protected:
+
+        //! Get the start time of the first time bucket beginning at or after the given time
+        static uint32_t getFirstBucketTime(const uint32_t from, const uint32_t length) {
+            const uint32_t remainder = from % length;
+            return (remainder == 0 ? from : from + (length - remainder));
+        }
+
+        //! Get the end time of the last time bucket ending at or before the given inclusive end time
+        static uint32_t getEndBucketTime(const uint32_t to, const uint32_t length) {
+            const uint32_t end = to + 1;
+            return end - (end % length);
+        }
+
+        /**
+         *  Aggregate all measurement values in the given time range using the given number of finest levels.
+         *  @param from start time of the range
+         *  @param to end time of the range; measurements with this timestamp are included
+         *  @param num_levels the number of finest levels to use
+         *  @param result the aggregate to add the measurement values to
+         */
+        void aggregate(const uint32_t from, const uint32_t to, const size_t num_levels, AggregatedValue& result) const {
+            const size_t index = findAdequateLevel(from, to, num_levels);
+            if (index == (size_t)-1) {
+                return;
+            }
+            const MeasurementAggregationLevel& level = levels[index];
+            const uint32_t first = getFirstBucketTime(from, level.bucket_length);
+            const uint32_t end = getEndBucketTime(to, level.bucket_length);
+            if (index == 0 || SpeedwireTime::calculateTimeDifference(end, first) < (int32_t)level.bucket_length) {
+                level.aggregate(from, to, result);      // no finer level available
+                return;
+            }
+            if (SpeedwireTime::calculateTimeDifference(first, from) > 0) {
+                aggregate(from, first - 1, index, result);
+            }
+            level.aggregate(first, end - 1, result);
+            if (SpeedwireTime::calculateTimeDifference(to, end) >= 0) {
+                aggregate(end, to, index, result);
+            }
+        }
+    };
+
+}   // namespace libspeedwire
+
+#endif
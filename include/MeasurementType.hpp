@@ -1,7 +1,12 @@
 #ifndef __LIBSPEEDWIRE_MEASUREMENTTYPE_HPP__
 #define __LIBSPEEDWIRE_MEASUREMENTTYPE_HPP__
 
+#include <cstdint>
 #include <string>
+#include <map>
+#include <deque>
+#include <tuple>
+#include <mutex>
 
 namespace libspeedwire {
 
@@ -107,6 +112,9 @@ namespace libspeedwire {
 
         std::string getFullName(const Wire wire) const;
 
+        /** Get a key for this measurement type, composed of its direction, type and quantity. */
+        uint32_t toKey(void) const { return ((uint32_t)direction << 16) | ((uint32_t)type << 8) | (uint32_t)quantity; }
+
 
         // pre-defined instances for emeter measurement types
         // these definitions are used by static initializers; to avoid static initialization ordering issues, define them as methods
@@ -151,6 +159,50 @@ namespace libspeedwire {
         static MeasurementType Currency(void) { return MeasurementType(Direction::NO_DIRECTION, Type::NO_TYPE, Quantity::CURRENCY, "Eur", 1); }
     };
 
+
+    /**
+     *  Class holding an interned pair of measurement type and wire together with its full name.
+     *  Instances are owned by the MeasurementTypeRegistry and remain valid for the lifetime of the program.
+     */
+    class MeasurementDescriptor {
+    public:
+        const MeasurementType& measurementType; //!< Interned measurement type
+        const Wire             wire;            //!< Measurement wire
+        const std::string      fullName;        //!< Full name, i.e. measurementType.getFullName(wire)
+        const uint32_t         id;              //!< Unique id of this descriptor; ids are assigned in ascending order starting from 0
+
+        MeasurementDescriptor(const MeasurementType& mType, const Wire mWire, const uint32_t mId) :
+            measurementType(mType), wire(mWire), fullName(mType.getFullName(mWire)), id(mId) {}
+    };
+
+
+    /**
+     *  Class implementing a global registry of interned measurement types and measurement descriptors. Equal measurement
+     *  types and equal pairs of measurement type and wire are stored only once, so that measurements can reference them
+     *  by pointer instead of holding string copies. The registry is thread-safe.
+     */
+    class MeasurementTypeRegistry {
+    protected:
+        typedef std::tuple<int, int, int, unsigned long, std::string, std::string, bool> TypeKey;  //!< Key consisting of direction, type, quantity, divisor, unit, name and instantaneous flag
+
+        mutable std::mutex mutex;                                        //!< Mutex protecting the tables below
+        std::deque<MeasurementType> types;                               //!< Interned measurement types
+        std::map<TypeKey, const MeasurementType*> typeIndex;             //!< Map from measurement type key to interned measurement type
+        std::deque<MeasurementDescriptor> descriptors;                   //!< Interned descriptors indexed by id
+        std::map<std::pair<const MeasurementType*, Wire>, const MeasurementDescriptor*> descriptorIndex;   //!< Map from interned measurement type and wire to descriptor
+
+        MeasurementTypeRegistry(void) {}
+        const MeasurementType& internType(const MeasurementType& type);
+
+    public:
+        static MeasurementTypeRegistry& getInstance(void);
+
+        const MeasurementType& intern(const MeasurementType& type);
+        const MeasurementDescriptor& intern(const MeasurementType& type, const Wire wire);
+        const MeasurementDescriptor& getDescriptor(const uint32_t id) const;
+        size_t getNumberOfDescriptors(void) const;
+    };
+
 }   // namespace libspeedwire
 
 #endif
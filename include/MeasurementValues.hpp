@@ -6,6 +6,7 @@
 #include <vector>
 #include <float.h>
 #include <RingBuffer.hpp>
+#include <AggregatedValue.hpp>
 #include <SpeedwireTime.hpp>
 
 namespace libspeedwire {
@@ -48,24 +49,93 @@ namespace libspeedwire {
             addNewElement(pair);
         }
 
+        /**
+         *  Add an array of new measurements to the ring buffer. If the buffer is full, the oldest measurements are replaced.
+         *  @param pairs pointer to the first measurement
+         *  @param n number of measurements
+         */
+        void addMeasurements(const TimestampDoublePair* const pairs, const size_t n) {
+            addNewElements(pairs, n);
+        }
+
+        /**
+         *  Add arrays of new measurement values and times to the ring buffer. If the buffer is full, the oldest measurements are replaced.
+         *  @param values pointer to the first measurement value
+         *  @param times pointer to the first measurement time
+         *  @param n number of measurements
+         */
+        void addMeasurements(const double* const values, const uint32_t* const times, const size_t n) {
+            generateNewElements(n, [values, times](const size_t i) { return TimestampDoublePair(values[i], times[i]); });
+        }
+
+        /**
+         *  Get the index of the newest measurement in the ring buffer with a timestamp at or before the given time.
+         *  As measurements are usually sampled at near-uniform time intervals, the index is first estimated by
+         *  interpolation search; if this does not converge within two probes, binary search is used.
+         *  @param time the time to compare with
+         *  @return index in ring buffer, or (size_t)-1 if the buffer is empty or the time is before the oldest measurement
+         */
+        size_t findLowerIndex(const uint32_t time) const {
+            const size_t num_measurements = getNumberOfElements();
+            if (num_measurements == 0) {
+                return (size_t)-1;
+            }
+            // use signed time differences relative to the oldest measurement
+            const uint32_t base_time = at(0).time;
+            const int32_t target = SpeedwireTime::calculateTimeDifference(time, base_time);
+            if (target < 0) {
+                return (size_t)-1;
+            }
+            size_t  low = 0;
+            size_t  high = num_measurements - 1;
+            int32_t low_time = 0;
+            int32_t high_time = SpeedwireTime::calculateTimeDifference(at(high).time, base_time);
+            if (target >= high_time) {
+                return high;
+            }
+            // interpolation search; invariant: low_time <= target < high_time
+            for (int probe = 0; probe < 2 && (low + 1) < high; ++probe) {
+                size_t guess = low + (size_t)(((double)target - low_time) / ((double)high_time - low_time) * (high - low));
+                if (guess <= low)  guess = low + 1;
+                if (guess >= high) guess = high - 1;
+                const int32_t guess_time = SpeedwireTime::calculateTimeDifference(at(guess).time, base_time);
+                if (guess_time <= target) {
+                    low = guess;
+                    low_time = guess_time;
+                }
+                else {
+                    high = guess;
+                    high_time = guess_time;
+                }
+            }
+            // binary search fallback
+            while ((low + 1) < high) {
+                const size_t mid = (low + high) / 2u;
+                if (SpeedwireTime::calculateTimeDifference(at(mid).time, base_time) <= target) {
+                    low = mid;
+                }
+                else {
+                    high = mid;
+                }
+            }
+            return low;
+        }
+
         /**
          *  Get the index in the ring buffer time-wise closest to the given time.
          *  @return index in ring buffer
          */
         size_t findClosestIndex(const uint32_t time) const {
-            if (getNumberOfElements() > 0) {
-                // binary search
-                size_t low = 0;
-                size_t high = getNumberOfElements() - 1;
-                while ((low + 1) < high) {
-                    const size_t mid = (low + high) / 2u;
-                    if (SpeedwireTime::calculateTimeDifference(time, at(mid).time) > 0) {  // use signed difference
-                        low = mid;
-                    }
-                    else {
-                        high = mid;
-                    }
+            const size_t num_measurements = getNumberOfElements();
+            if (num_measurements > 0) {
+                const size_t low = findLowerIndex(time);
+                if (low == (size_t)-1) {
+                    return 0;
                 }
+                if (low >= (num_measurements - 1)) {
+                    return low;
+                }
+                const size_t high = low + 1;
                 const bool low_is_closer = (SpeedwireTime::calculateAbsTimeDifference(time, at(low).time) < SpeedwireTime::calculateAbsTimeDifference(time, at(high).time));
                 return (low_is_closer ? low : high);
             }
@@ -86,34 +156,72 @@ namespace libspeedwire {
         }
 
         /**
-         *  Interpolate the two measurement values time-wise closest to the given time.
+         *  Interpolate the two measurement values time-wise enclosing the given time. If the time is outside
+         *  the time range of the ring buffer, the two oldest or the two newest measurement values are used.
          *  @param the time to compare with
          *  @return the interpolated measurement value
          */
         double interpolateClosestValues(const uint32_t time) const {
-            const size_t index_center = findClosestIndex(time);
-            if (index_center != (size_t)-1) {
-                const size_t num_measurements = getNumberOfElements();
-                if (num_measurements > 1) {
-                    const size_t index_before = (index_center > 0 ? (index_center - 1) : index_center);
-                    const size_t index_after  = (index_center < (num_measurements - 1) ? (index_center + 1) : index_center);
-                    const uint32_t diff_before = SpeedwireTime::calculateAbsTimeDifference(time, at(index_before).time);
-                    const uint32_t diff_center = SpeedwireTime::calculateAbsTimeDifference(time, at(index_center).time);
-                    const uint32_t diff_after  = SpeedwireTime::calculateAbsTimeDifference(time, at(index_after).time);
-                    if (index_after == index_center || (index_before != index_center && diff_before <= diff_after)) {
-                        // the element prior to the closest element is time-wise closer than the element after the closest element,
-                        // or, the closest index is the newest element; in both cases interpolate with the element prior to newest
-                        return (diff_center * at(index_before).value + diff_before * at(index_center).value) / (diff_before + diff_center);
-                    }
-                    // the element after the closest element is time-wise closer than the element prior the closest element,
-                    // or, the closest index is the oldest element; in both cases interpolate with the prior to oldest element
-                    return (diff_after * at(index_center).value + diff_center * at(index_after).value) / (diff_center + diff_after);
+            const size_t num_measurements = getNumberOfElements();
+            if (num_measurements > 1) {
+                const size_t lower = findLowerIndex(time);
+                const size_t low   = (lower == (size_t)-1 ? 0 : (lower < (num_measurements - 1) ? lower : num_measurements - 2));
+                const TimestampDoublePair& low_pair  = at(low);
+                const TimestampDoublePair& high_pair = at(low + 1);
+                const uint32_t diff_low  = SpeedwireTime::calculateAbsTimeDifference(time, low_pair.time);
+                const uint32_t diff_high = SpeedwireTime::calculateAbsTimeDifference(time, high_pair.time);
+                if ((diff_low + diff_high) == 0) {
+                    return high_pair.value;
                 }
-                return at(index_center).value;
+                return (diff_high * low_pair.value + diff_low * high_pair.value) / ((double)diff_low + diff_high);
+            }
+            if (num_measurements == 1) {
+                return at(0).value;
             }
             return 0.0;
         }
 
+        /**
+         *  Get the measurements in the given time range as up to two contiguous spans of the underlying element array.
+         *  @param from start time of the range
+         *  @param to end time of the range; measurements with this timestamp are included
+         *  @param first the span holding the older measurements of the range
+         *  @param second the span holding the newer measurements of the range; it is empty unless the range wraps around
+         *  @return the number of measurements in the range
+         */
+        size_t findRange(const uint32_t from, const uint32_t to, Span& first, Span& second) const {
+            first = second = Span();
+            const size_t last = findLowerIndex(to);
+            if (last == (size_t)-1) {
+                return 0;
+            }
+            const size_t lower = findLowerIndex(from);
+            size_t start = 0;
+            if (lower != (size_t)-1) {
+                start = (at(lower).time == from ? lower : lower + 1);
+            }
+            return getSpans(start, last, first, second);
+        }
+
+        /**
+         *  Aggregate minimum, maximum, sum and count of all measurements in the given time range.
+         *  @param from start time of the range
+         *  @param to end time of the range; measurements with this timestamp are included
+         *  @return the aggregate; its count is 0 if there are no measurements in the range
+         */
+        AggregatedValue aggregate(const uint32_t from, const uint32_t to) const {
+            AggregatedValue result(from);
+            Span first, second;
+            findRange(from, to, first, second);
+            for (const auto& pair : first) {
+                result.add(pair.value);
+            }
+            for (const auto& pair : second) {
+                result.add(pair.value);
+            }
+            return result;
+        }
+
         /**
          *  Estimate the sample mean, aka average value, of all measurements in the ring buffer.
          *  @return average value
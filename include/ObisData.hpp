@@ -130,18 +130,19 @@ namespace libspeedwire {
      */
     class ObisDataMap : public std::map<uint32_t, ObisData> {
         static ObisDataMap allPredefined;
+        uint32_t generation;    // incremented whenever elements are added or removed
 
     public:
         /**
          *  Default constructor.
          */
-        ObisDataMap(void) : std::map<uint32_t, ObisData>() {}
+        ObisDataMap(void) : std::map<uint32_t, ObisData>(), generation(0) {}
 
         /**
          *  Construct a new map from the given vector of ObisData elements.
          *  @param elements the vector of ObisData elements
          */
-        ObisDataMap(const std::vector<ObisData>& elements) {
+        ObisDataMap(const std::vector<ObisData>& elements) : generation(0) {
             this->add(elements);
         }
 
@@ -149,7 +150,7 @@ namespace libspeedwire {
          *  Add a new element to the map of emeter obis data elements.
          *  @param element The ObisData element to be added to the map
          */
-        void add(const ObisData& element) { operator[](element.toKey()) = element; }
+        void add(const ObisData& element) { operator[](element.toKey()) = element; ++generation; }
 
         /**
          *  Add a vector of elements to the map of emeter obis data elements.
@@ -167,8 +168,16 @@ namespace libspeedwire {
          */
         void remove(const ObisData& entry) {
             erase(entry.toKey());
+            ++generation;
         }
 
+        /**
+         *  Get the generation of the map; it is incremented whenever elements are added by add() or removed by remove(),
+         *  such that pointers to map elements can be re-validated cheaply.
+         *  @return the generation
+         */
+        uint32_t getGeneration(void) const { return generation; }
+
         static const ObisDataMap& getAllPredefined(void);
     };
 
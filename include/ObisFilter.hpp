@@ -17,6 +17,7 @@ namespace libspeedwire {
      *  The general idea is that the ObisData instances held by the filter will hold the most recent obis data
      *  values. Also aggregation of consecutively received obis data is done inside the ObisData instances held
      *  by the filter. Registered onsumers will recieve a reference to the ObisData instance held by the filter.
+     *  These references must not be accessed from other threads; use an ObisSnapshot consumer instead.
      */
     class ObisFilter {
 
@@ -0,0 +1,74 @@
+#ifndef __LIBSPEEDWIRE_OBISSNAPSHOT_HPP__
+#define __LIBSPEEDWIRE_OBISSNAPSHOT_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <Consumer.hpp>
+#include <ObisData.hpp>
+#include <SeqLock.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Struct holding a copy of the most recent measurement of an obis channel.
+     */
+    typedef struct {
+        uint32_t key;           //!< Obis key, see ObisType::toKey()
+        uint32_t serialNumber;  //!< Serial number of the originating emeter device
+        double   value;         //!< Measurement value
+        uint32_t time;          //!< Measurement time
+        uint64_t count;         //!< Number of measurements received for this obis channel so far
+    } ObisSnapshotValue;
+
+
+    /**
+     *  Class ObisSnapshot publishes the most recent measurement values of each obis channel to reader threads.
+     *
+     *  An ObisSnapshot instance is registered as ObisConsumer, usually to the ObisFilter, and is fed by the receive thread.
+     *  It keeps a copy of the latest value and of the most recent measurement values of each obis channel, each protected
+     *  by a sequence lock. Reader threads, like status endpoints or exporters, can take consistent copies at any time
+     *  without blocking the receive thread; they never touch the ObisData instances held by the filter.
+     *
+     *  The set of obis channels is fixed at construction time.
+     */
+    class ObisSnapshot : public ObisConsumer {
+
+    protected:
+
+        //! Class holding the published data of a single obis channel.
+        class Channel {
+        public:
+            SeqLock       lock;         //!< Sequence lock protecting all members below
+            uint32_t      serialNumber; //!< Serial number of the originating emeter device
+            uint64_t      count;        //!< Number of measurements written so far
+            std::vector<TimestampDoublePair> tail;  //!< Circular buffer holding the most recent measurements
+
+            Channel(void) : serialNumber(0), count(0) {}
+        };
+
+        std::map<uint32_t, Channel> channels;   //!< Published data for each obis channel; the map itself is never modified after construction
+        size_t tail_length;                     //!< Number of most recent measurements held for each obis channel
+
+        const Channel* findChannel(const uint32_t key) const;
+
+    public:
+
+        ObisSnapshot(const ObisDataMap& obis_map, const size_t tail_length = 1);
+        ~ObisSnapshot(void);
+
+        // writer side, called from the receive thread
+        virtual void consume(const SpeedwireDevice& device, ObisData& element);
+
+        // reader side, can be called from any thread
+        bool   getLatest(const uint32_t key, ObisSnapshotValue& value) const;
+        size_t getSnapshot(std::vector<ObisSnapshotValue>& values) const;
+        size_t getTail(const uint32_t key, const size_t max_elements, std::vector<TimestampDoublePair>& values) const;
+
+        //! Get the number of most recent measurements held for each obis channel
+        size_t getTailLength(void) const { return tail_length; }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef __LIBSPEEDWIRE_PERSISTENTMEASUREMENTVALUES_HPP__
+#define __LIBSPEEDWIRE_PERSISTENTMEASUREMENTVALUES_HPP__
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <type_traits>
+#include <MeasurementValues.hpp>
+#include <SeqLock.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class implementing a file-backed, memory-mapped ring buffer of measurement values and timestamps.
+     *
+     *  The file consists of a fixed size header followed by an array of fixed size records. The header holds the
+     *  total number of records ever written; it is updated only after the record itself has been written, such that
+     *  a crash never exposes a partially written record. Each record carries the lower 32-bit of its sequence number;
+     *  records written just before a crash, but not yet accounted for in the header, are recovered when the file is
+     *  reopened. A reopened file is usable immediately without any parsing; other processes can open the file in
+     *  read-only mode and read it concurrently. Readers re-check the record sequence number after copying a record,
+     *  such that a record being overwritten by the writer is never returned.
+     *
+     *  The file uses the native byte order of the host.
+     */
+    class PersistentMeasurementValues {
+    public:
+
+        //! File header, 64 bytes
+        struct Header {
+            char     magic[8];          //!< File magic "SPWMVAL1"
+            uint32_t header_size;       //!< Size of the header in bytes
+            uint32_t record_size;       //!< Size of a single record in bytes
+            uint64_t capacity;          //!< Maximum number of records in the file
+            std::atomic<uint32_t> write_count_low;  //!< Lower 32-bit of the total number of records written; the next record goes to index write_count % capacity
+            std::atomic<uint32_t> write_count_high; //!< Upper 32-bit of the total number of records written
+            SeqLock  write_lock;        //!< Sequence lock guarding updates of the upper 32-bit of the write count
+            uint8_t  reserved[28];
+        };
+
+        //! Measurement record, 16 bytes
+        struct Record {
+            double   value;             //!< Measurement value
+            uint32_t time;              //!< Measurement time
+            std::atomic<uint32_t> sequence; //!< Lower 32-bit of the record sequence number plus 1, skipping 0; 0 marks an empty record or a record being written
+        };
+
+        // the layout of existing files must not change silently with the compiler or its packing rules
+        static_assert(sizeof(Header) == 64, "the file header must be 64 bytes");
+        static_assert(sizeof(Record) == 16, "a record must be 16 bytes");
+        static_assert(std::is_trivially_copyable<Header>::value, "the file header must be trivially copyable");
+        static_assert(std::is_trivially_copyable<Record>::value, "a record must be trivially copyable");
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomic fields must have the size of their values");
+
+        static const char magic[8];
+
+    protected:
+        std::string path;
+        Header* header;
+        Record* records;
+        size_t  mapped_size;
+        bool    read_only;
+#ifdef _WIN32
+        void*   file_handle;
+        void*   mapping_handle;
+#else
+        int     file_fd;
+#endif
+
+        void* map(const std::string& path, const size_t size, const bool map_read_only, size_t& file_size, bool& resized);
+        void recover(void);
+        uint64_t getWriteCount(void) const;
+        bool tryGetWriteCount(uint64_t& count) const;
+        void setWriteCount(const uint64_t count);
+        static uint32_t getSequenceNumber(const uint64_t count);
+
+        // instances own the file mapping and cannot be copied
+        PersistentMeasurementValues(const PersistentMeasurementValues& rhs) = delete;
+        PersistentMeasurementValues& operator=(const PersistentMeasurementValues& rhs) = delete;
+
+    public:
+        PersistentMeasurementValues(void);
+        ~PersistentMeasurementValues(void);
+
+        // open a file; the file is created if it does not exist or if its capacity does not match the given capacity
+        bool open(const std::string& path, const size_t capacity);
+        // open an existing file for reading; the file is never modified; fails if the write count is locked by a crashed writer
+        bool openReadOnly(const std::string& path);
+        void close(void);
+        bool isOpen(void) const { return header != NULL; }
+        bool isReadOnly(void) const { return read_only; }
+        bool flush(void);
+
+        // add measurement values and access them; index 0 is the oldest measurement
+        void addMeasurement(const double value, const uint32_t time);
+        size_t getNumberOfElements(void) const;
+        size_t getMaximumNumberOfElements(void) const;
+        TimestampDoublePair at(const size_t index) const;
+
+        // restore the most recent measurements into the given ring buffer
+        size_t restore(MeasurementValues& values) const;
+    };
+
+}   // namespace libspeedwire
+
+#endif
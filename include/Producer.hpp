@@ -1,11 +1,122 @@
 #ifndef __LIBSPEEDWIRE_PRODUCER_HPP__
 #define __LIBSPEEDWIRE_PRODUCER_HPP__
 
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 #include <MeasurementType.hpp>
 #include <SpeedwireDevice.hpp>
 
 namespace libspeedwire {
 
+    /**
+     *  Class holding the metadata of a time series, i.e. the device and the interned measurement type and wire.
+     */
+    class ProducerSeries {
+    public:
+        SpeedwireDevice              device;        //!< The device generating the data
+        const MeasurementDescriptor* descriptor;    //!< The interned measurement type and wire of the data
+
+        ProducerSeries(const SpeedwireDevice& dev, const MeasurementDescriptor& desc) : device(dev), descriptor(&desc) {}
+
+        /** Get the measurement type of the data. */
+        const MeasurementType& getMeasurementType(void) const { return descriptor->measurementType; }
+
+        /** Get the Wire enumeration value. */
+        Wire getWire(void) const { return descriptor->wire; }
+
+        /** Get the full name of the measurement, derived from measurement type and wire. */
+        const std::string& getName(void) const { return descriptor->fullName; }
+    };
+
+
+    /**
+     *  Class implementing a table mapping time series metadata to series ids. Series ids are assigned in ascending
+     *  order starting from 0 and remain stable for the lifetime of the table, so producers can cache information
+     *  derived from the metadata, like serialized tags, indexed by series id.
+     */
+    class ProducerSeriesTable {
+    protected:
+        typedef std::pair<uint64_t, uint32_t> Key;  //!< Key consisting of device address key and measurement descriptor id
+        std::vector<ProducerSeries> series;         //!< Series metadata indexed by series id
+        std::map<Key, uint32_t>     index;          //!< Map from key to series id
+
+    public:
+        /**
+         *  Get the series id for the given metadata; a new series id is assigned, if the series is not yet known.
+         *  @param device The device generating the data
+         *  @param descriptor The interned measurement type and wire of the data
+         *  @return The series id
+         */
+        uint32_t getSeriesId(const SpeedwireDevice& device, const MeasurementDescriptor& descriptor) {
+            const Key key(device.deviceAddress.toKey(), descriptor.id);
+            const auto it = index.find(key);
+            if (it != index.end()) {
+                return it->second;
+            }
+            const uint32_t id = (uint32_t)series.size();
+            series.push_back(ProducerSeries(device, descriptor));
+            index[key] = id;
+            return id;
+        }
+
+        /**
+         *  Get the series id for the given metadata; a new series id is assigned, if the series is not yet known.
+         *  @param device The device generating the data
+         *  @param type The measurement type of the data
+         *  @param wire The Wire enumeration value
+         *  @return The series id
+         */
+        uint32_t getSeriesId(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire) {
+            return getSeriesId(device, MeasurementTypeRegistry::getInstance().intern(type, wire));
+        }
+
+        /** Get the metadata of the given series id. */
+        const ProducerSeries& operator[](const uint32_t id) const { return series[id]; }
+
+        /** Get the number of known series. */
+        size_t size(void) const { return series.size(); }
+    };
+
+
+    /**
+     *  Struct holding a single value of a time series.
+     */
+    struct ProducerSample {
+        uint32_t series;            //!< The series id in the ProducerSeriesTable
+        uint32_t time;              //!< The measurement timestamp
+        double   value;             //!< The data value itself
+    };
+
+
+    /**
+     *  Class holding a contiguous array of time series values, usually all values obtained from a single packet.
+     */
+    class ProducerFrame {
+    public:
+        std::vector<ProducerSample> samples;    //!< Array of values
+
+        /**
+         *  Add a value to the frame.
+         *  @param series The series id in the ProducerSeriesTable
+         *  @param value The data value itself
+         *  @param time The measurement timestamp
+         */
+        void add(const uint32_t series, const double value, const uint32_t time) {
+            const ProducerSample sample = { series, time, value };
+            samples.push_back(sample);
+        }
+
+        /** Remove all values from the frame; the allocated memory is retained. */
+        void clear(void) { samples.clear(); }
+
+        /** Get the number of values in the frame. */
+        size_t size(void) const { return samples.size(); }
+    };
+
+
     /**
      *  Interface to be implemented by any producer like InfluxDBProducer.
      */
@@ -26,6 +137,19 @@ namespace libspeedwire {
          * @param time_in_ms The measurement timestamp in ms since unix epoch start
          */
         virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms = 0) = 0;
+
+        /**
+         * Callback to produce a frame of data to the next stage in the processing pipeline. Producers can override this
+         * to handle all values of a packet with a single call; the default implementation calls produce() for each value.
+         * @param frame The frame of data
+         * @param table The table holding the metadata of all series referenced by the frame
+         */
+        virtual void produce(const ProducerFrame& frame, const ProducerSeriesTable& table) {
+            for (const auto& sample : frame.samples) {
+                const ProducerSeries& series = table[sample.series];
+                produce(series.device, series.getMeasurementType(), series.getWire(), sample.value, sample.time);
+            }
+        }
     };
 
 }   // namespace libspeedwire
@@ -1,6 +1,7 @@
 #ifndef __LIBSPEEDWIRE_RINGBUFFER_HPP__
 #define __LIBSPEEDWIRE_RINGBUFFER_HPP__
 
+#include <cstddef>
 #include <vector>
 
 namespace libspeedwire {
@@ -15,6 +16,21 @@ namespace libspeedwire {
         using const_reference = const T&;
         using size_type = size_t;
 
+        /**
+         *  Class describing a contiguous range of ring buffer elements inside the underlying element array.
+         */
+        class Span {
+        public:
+            const T* data;  //!< Pointer to the first element
+            size_t   size;  //!< Number of elements
+
+            Span(void) : data(NULL), size(0) {}
+            Span(const T* const d, const size_t s) : data(d), size(s) {}
+
+            const T* begin(void) const { return data; }
+            const T* end(void) const { return data + size; }
+        };
+
         std::vector<T>  data_vector;    //!< Array of ring buffer elements
         std::vector<T*> ref_vector;     //!< Array of references to ring buffer elements, it is twice as big as the array of ring buffer elements and provides contiguous access to elements without wrap around
         size_t          write_pointer;  //!< Write pointer pointing to the next element to write to
@@ -52,8 +68,13 @@ namespace libspeedwire {
          */
         void setMaximumNumberOfElements(const size_t new_capacity) {
             clear();
-            data_vector.reserve(new_capacity);
-            ref_vector.reserve(2 * new_capacity);
+            if (data_vector.capacity() != new_capacity) {
+                // reserve() never shrinks the capacity, therefore swap in new empty vectors first
+                std::vector<T>().swap(data_vector);
+                std::vector<T*>().swap(ref_vector);
+                data_vector.reserve(new_capacity);
+                ref_vector.reserve(2 * new_capacity);
+            }
         }
 
         /**
@@ -85,6 +106,75 @@ namespace libspeedwire {
             }
         }
 
+        /**
+         *  Add an array of new elements to the ring buffer. If the buffer is full, the oldest elements are replaced.
+         *  @param values pointer to the first element
+         *  @param n number of elements
+         */
+        void addNewElements(const T* const values, const size_t n) {
+            generateNewElements(n, [values](const size_t i) -> const T& { return values[i]; });
+        }
+
+        /**
+         *  Add n new elements to the ring buffer, where each element is obtained from the given generator function.
+         *  Elements are written in at most two contiguous spans of the element array; elements that would be overwritten
+         *  within the same call are skipped once the ring buffer is full. Element references are updated once per call,
+         *  rather than once per element.
+         *  @param n number of elements
+         *  @param generator function or lambda returning the element with the given index 0 ... n-1
+         */
+        template<class Generator> void generateNewElements(const size_t n, Generator generator) {
+            const size_t capacity = data_vector.capacity();
+            if (capacity == 0) {
+                for (size_t i = 0; i < n; ++i) {
+                    addNewElement(generator(i));
+                }
+                return;
+            }
+            size_t i = 0;
+
+            // during the initial ring buffer fill-up, append elements and update references to data elements
+            const size_t size = data_vector.size();
+            if (size < capacity && n > 0) {
+                const size_t n_append = (n < capacity - size ? n : capacity - size);
+                for (; i < n_append; ++i) {
+                    data_vector.push_back(generator(i));
+                }
+                const size_t new_size = data_vector.size();
+                ref_vector.resize(new_size * 2, NULL);
+                for (size_t j = 0; j < new_size; ++j) {
+                    ref_vector.data()[j] = ref_vector.data()[j + new_size] = &data_vector.data()[j];
+                }
+                write_pointer = (new_size >= capacity ? 0 : new_size);
+            }
+
+            // skip elements that would be overwritten within this call anyway
+            if (n - i > capacity) {
+                const size_t n_skip = n - i - capacity;
+                write_pointer = (write_pointer + n_skip) % capacity;
+                i += n_skip;
+            }
+
+            // overwrite the oldest elements; the first span ends at the end of the element array, the second span starts at its beginning
+            if (i < n) {
+                T* const data = data_vector.data();
+                const size_t n_overwrite = n - i;
+                const size_t n_first = (n_overwrite < capacity - write_pointer ? n_overwrite : capacity - write_pointer);
+                T* dest = data + write_pointer;
+                for (const size_t end = i + n_first; i < end; ++i) {
+                    *dest++ = generator(i);
+                }
+                dest = data;
+                while (i < n) {
+                    *dest++ = generator(i++);
+                }
+                write_pointer += n_overwrite;
+                if (write_pointer >= capacity) {
+                    write_pointer -= capacity;
+                }
+            }
+        }
+
         /**
          *  Remove elements from the ring buffer. Non-existing elements are silently ignored.
          *  @param offs index of the first element to be removed
@@ -152,6 +242,31 @@ namespace libspeedwire {
             return operator[](0);
         }
 
+        /**
+         *  Get the given range of ring buffer elements as up to two contiguous spans of the underlying element array.
+         *  The second span is only needed if the range wraps around the end of the element array; otherwise it is empty.
+         *  @param from ring buffer index of the first element
+         *  @param to ring buffer index of the last element; the element with index to is included
+         *  @param first the span holding the older elements of the range
+         *  @param second the span holding the newer elements of the range
+         *  @return the total number of elements in both spans; 0 if the range is empty or out of bounds
+         */
+        size_t getSpans(const size_t from, const size_t to, Span& first, Span& second) const {
+            first = second = Span();
+            const size_t size = data_vector.size();
+            if (from > to || to >= size) {
+                return 0;
+            }
+            const size_t start = getDataVectorIndex(from);
+            const size_t n = to - from + 1;
+            const size_t n_first = (size - start < n ? size - start : n);
+            first = Span(data_vector.data() + start, n_first);
+            if (n_first < n) {
+                second = Span(data_vector.data(), n - n_first);
+            }
+            return n;
+        }
+
         //
         //  Methods exposing the internal representation
         //
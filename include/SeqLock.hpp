@@ -0,0 +1,102 @@
+#ifndef __LIBSPEEDWIRE_SEQLOCK_HPP__
+#define __LIBSPEEDWIRE_SEQLOCK_HPP__
+
+#include <cstdint>
+#include <atomic>
+
+namespace libspeedwire {
+
+    /**
+     *  Class implementing a sequence lock for a single writer and any number of readers.
+     *  The writer never blocks; readers copy the protected data and retry if the writer modified it in the meantime.
+     *  The sequence number is odd while a write is in progress.
+     *
+     *  Writer:
+     *      lock.beginWrite(); ... modify data ...; lock.endWrite();
+     *  Reader:
+     *      uint32_t seq; do { seq = lock.beginRead(); ... copy data ...; } while (lock.retryRead(seq));
+     */
+    class SeqLock {
+    protected:
+        std::atomic<uint32_t> sequence;
+
+    public:
+        SeqLock(void) : sequence(0) {}
+
+        //! Mark the start of a write operation; must only be called by the single writer thread
+        void beginWrite(void) {
+            sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        //! Mark the end of a write operation; must only be called by the single writer thread
+        void endWrite(void) {
+            sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        //! Check if a write operation is in progress, e.g. left behind by a crashed writer of a shared memory mapping
+        bool isWriting(void) const {
+            return ((sequence.load(std::memory_order_relaxed) & 1u) != 0);
+        }
+
+        //! Mark the start of a read operation; waits while a write is in progress and returns the sequence number
+        uint32_t beginRead(void) const {
+            uint32_t seq;
+            while (((seq = sequence.load(std::memory_order_acquire)) & 1u) != 0) {}
+            return seq;
+        }
+
+        //! Mark the start of a read operation, but give up after the given number of attempts while a write is in progress;
+        //! this avoids spinning forever on a sequence lock left behind by a crashed writer of a shared memory mapping
+        bool tryBeginRead(uint32_t& seq, const uint32_t max_spins) const {
+            for (uint32_t i = 0; i <= max_spins; ++i) {
+                if (((seq = sequence.load(std::memory_order_acquire)) & 1u) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //! Check if the data read since beginRead() may be inconsistent and the read must be repeated
+        bool retryRead(const uint32_t seq) const {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return (sequence.load(std::memory_order_relaxed) != seq);
+        }
+    };
+
+
+    /**
+     *  Class template implementing a value of a trivially copyable type, published by a single writer
+     *  and read by any number of readers without blocking the writer.
+     */
+    template<class T> class SeqLockValue {
+    protected:
+        SeqLock lock;
+        T value;
+
+    public:
+        SeqLockValue(void) : value() {}
+        SeqLockValue(const T& v) : value(v) {}
+
+        //! Publish a new value; must only be called by the single writer thread
+        void store(const T& v) {
+            lock.beginWrite();
+            value = v;
+            lock.endWrite();
+        }
+
+        //! Get a consistent copy of the most recently published value
+        T load(void) const {
+            T result;
+            uint32_t seq;
+            do {
+                seq = lock.beginRead();
+                result = value;
+            } while (lock.retryRead(seq));
+            return result;
+        }
+    };
+
+}   // namespace libspeedwire
+
+#endif
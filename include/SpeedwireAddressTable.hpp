@@ -0,0 +1,87 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREADDRESSTABLE_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREADDRESSTABLE_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <SpeedwireDevice.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class implementing an open addressing hash table mapping speedwire addresses to integer indexes, e.g. indexes
+     *  into a vector of per-device state information. Collisions are resolved by linear probing; the table size is a
+     *  power of two and the table is rehashed whenever it becomes half full. Entries cannot be removed individually.
+     */
+    class SpeedwireAddressTable {
+    protected:
+        //! Struct holding a single hash table slot.
+        typedef struct {
+            uint64_t key;       //!< Address key, see SpeedwireAddress::toKey()
+            int      index;     //!< Mapped index, or -1 if the slot is empty
+        } Slot;
+
+        std::vector<Slot> slots;    //!< Hash table slots
+        size_t            count;    //!< Number of occupied slots
+
+        size_t findSlot(const uint64_t key, const uint32_t hash) const {
+            const size_t mask = slots.size() - 1;
+            size_t i = hash & mask;
+            while (slots[i].index >= 0 && slots[i].key != key) {
+                i = (i + 1) & mask;
+            }
+            return i;
+        }
+
+        void rehash(const size_t new_size) {
+            std::vector<Slot> old_slots(new_size, Slot{ 0, -1 });
+            old_slots.swap(slots);
+            for (const auto& slot : old_slots) {
+                if (slot.index >= 0) {
+                    const SpeedwireAddress address((uint16_t)(slot.key >> 32), (uint32_t)slot.key);
+                    slots[findSlot(slot.key, address.hash())] = slot;
+                }
+            }
+        }
+
+    public:
+        SpeedwireAddressTable(void) : slots(16, Slot{ 0, -1 }), count(0) {}
+
+        /**
+         *  Find the index mapped to the given address.
+         *  @param address the speedwire address
+         *  @return the index, or -1 if the address is not in the table
+         */
+        int find(const SpeedwireAddress& address) const {
+            return slots[findSlot(address.toKey(), address.hash())].index;
+        }
+
+        /**
+         *  Map the given address to the given index; an existing mapping for the address is replaced.
+         *  @param address the speedwire address
+         *  @param index the index; it must not be negative
+         */
+        void insert(const SpeedwireAddress& address, const int index) {
+            if (2 * (count + 1) > slots.size()) {
+                rehash(2 * slots.size());
+            }
+            Slot& slot = slots[findSlot(address.toKey(), address.hash())];
+            if (slot.index < 0) {
+                ++count;
+            }
+            slot.key = address.toKey();
+            slot.index = index;
+        }
+
+        //! Remove all entries
+        void clear(void) {
+            slots.assign(16, Slot{ 0, -1 });
+            count = 0;
+        }
+
+        //! Get the number of entries
+        size_t size(void) const { return count; }
+    };
+
+}   // namespace libspeedwire
+
+#endif
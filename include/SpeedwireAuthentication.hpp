@@ -7,6 +7,7 @@
 #include <array>
 #include <SpeedwireCommand.hpp>
 #include <SpeedwireDevice.hpp>
+#include <SpeedwireInverterProtocol.hpp>
 #include <SpeedwireAuthentication.hpp>
 
 namespace libspeedwire {
@@ -65,14 +66,65 @@ namespace libspeedwire {
     };
 
 
+    /**
+     *  Class holding the login state of a single device, as tracked by the session cache of SpeedwireAuthentication.
+     */
+    class SpeedwireSession {
+    public:
+        SpeedwireDevice device;         //!< Device the local device is logged in to
+        uint64_t        loginTime;      //!< Tick count of the most recent successful login
+        uint64_t        expiryTime;     //!< Tick count when the session lapses on the device
+
+        SpeedwireSession(void) : device(), loginTime(0), expiryTime(0) {}
+    };
+
+
     /**
      *  Class encapsulating methods for speedwire device login and logoff.
+     *
+     *  Login requests to several devices or interfaces are sent at once and their responses are collected together,
+     *  such that a login takes a single round trip time instead of one round trip time per device and interface.
+     *  Responses to broadcast login requests are collected until all known devices on the interface responded, or until
+     *  the timeout if there are unknown or missing devices.
+     *  Successful logins of the local device are tracked in a session cache; refreshSessions() re-authenticates
+     *  devices shortly before their sessions lapse, instead of after a query failed with error code 0x0017.
      */
     class SpeedwireAuthentication : public SpeedwireCommand {
+    protected:
+
+        //! Struct holding a single login request of a concurrent login.
+        typedef struct {
+            std::string      if_address;    //!< Local interface to send the request on
+            SpeedwireAddress dst;           //!< Device address to log in to, or the broadcast address
+            SpeedwireAddress src;           //!< Device address to log in
+            SocketIndex      socket_index;  //!< Index of the socket the response is received on
+            SpeedwireCommandTokenIndex token_index; //!< Command token of the request
+            SpeedwireCommandToken token;    //!< Copy of the command token, matching broadcast responses after the token expired
+            std::vector<SpeedwireAddress> responders;   //!< Devices that responded to a broadcast request without error code
+            bool             done;          //!< True if the request is completed
+            bool             success;       //!< True if a response without error code was received
+        } LoginRequest;
+
+        std::map<uint64_t, SpeedwireSession> sessions;  //!< Session cache, keyed by device address key
+        uint32_t session_timeout_in_ms;                 //!< Lifetime of a session after a successful login
+        uint32_t relogin_margin_in_ms;                  //!< Time before the end of a session to re-authenticate
+
+        virtual uint64_t getTickCountInMs(void) const;
+        void addLoginRequest(std::vector<LoginRequest>& requests, const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src) const;
+        bool login(std::vector<LoginRequest>& requests, const Credentials& credentials, const int timeout_in_ms);
+        void sendLoginRequests(std::vector<LoginRequest>& requests, const Credentials& credentials);
+        bool receiveLoginResponses(std::vector<LoginRequest>& requests, const int timeout_in_ms);
+        bool hasAllResponses(const LoginRequest& request) const;
+        bool checkLoginReply(const SpeedwireInverterProtocol& inverter_packet);
+        void updateSessions(const LoginRequest& request);
+        static bool needsLogin(const SpeedwireDevice& device);
 
     public:
-        SpeedwireAuthentication(const LocalHost& localhost, const std::vector<SpeedwireDevice>& devices) : SpeedwireCommand(localhost, devices) {}
-        ~SpeedwireAuthentication(void) {}
+        static constexpr uint32_t login_timeout_in_s = 0x00000384;      //!< Session timeout requested by login commands, i.e. 900 seconds
+
+        SpeedwireAuthentication(const LocalHost& localhost, const std::vector<SpeedwireDevice>& devices) : SpeedwireCommand(localhost, devices),
+            sessions(), session_timeout_in_ms(login_timeout_in_s * 1000), relogin_margin_in_ms(60000) {}
+        virtual ~SpeedwireAuthentication(void) {}
 
         // synchronous login command methods - send command requests and wait for the response
         bool login(const Credentials& credentials, const int timeout_in_ms);
@@ -89,6 +141,18 @@ namespace libspeedwire {
         // asynchronous send command methods - send command requests and return immediately
         SpeedwireCommandTokenIndex sendLoginRequest(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials);
         bool sendLogoffRequest(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src);
+
+        // session cache - track the login state of each device and re-authenticate before sessions lapse
+        bool isLoggedIn(const SpeedwireDevice& device) const;
+        std::vector<SpeedwireDevice> getExpiringSessions(void) const;
+        int  refreshSessions(const Credentials& credentials, const int timeout_in_ms = 1000);
+        void invalidateSessions(void) { sessions.clear(); }
+
+        /** Set the lifetime of a session after a successful login. */
+        void setSessionTimeout(const uint32_t timeout_in_ms) { session_timeout_in_ms = timeout_in_ms; }
+
+        /** Set the time before the end of a session when refreshSessions() re-authenticates the device. */
+        void setReloginMargin(const uint32_t margin_in_ms) { relogin_margin_in_ms = margin_in_ms; }
     };
 
 }   // namespace libspeedwire
@@ -2,15 +2,22 @@
 #define __LIBSPEEDWIRE_SPEEDWIRECOMMAND_HPP__
 
 #include <cstdint>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
+#include <random>
+#include <functional>
 #include <SpeedwireDiscovery.hpp>
 #include <SpeedwireHeader.hpp>
 #include <SpeedwireSocket.hpp>
+#include <TimerWheel.hpp>
 
 namespace libspeedwire {
 
+    // forward declaration
+    class SpeedwireReceiveDispatcher;
+
     enum class Command : uint32_t {
         NONE                  = 0x00000000,
 
@@ -82,30 +89,111 @@ namespace libspeedwire {
         std::string peer_ip_address;    //!< IP address of the speedwire device the query was send to
         Command     command;            //!< Command identifier of the query
         uint32_t    create_time;        //!< Creation time of the query as lower 32-bit of unix epoch timestamp
+        uint64_t    create_tick;        //!< Creation time of the query as tick count
+        uint64_t    deadline;           //!< Tick count when the request is retransmitted or the token expires, or 0 if there is no deadline
+        uint32_t    retransmissions;    //!< Number of retransmissions of the request so far
+        std::string interface_ip_address;   //!< IP address of the local interface the request was sent from
+        std::vector<uint8_t> request;   //!< Request packet, kept for retransmission; empty if the request cannot be retransmitted
     } SpeedwireCommandToken;
 
 
+    /**
+     *  Struct SpeedwireRetransmissionPolicy defines the deadlines of command tokens. If a token does not receive its reply
+     *  within timeoutInMs, the request is retransmitted up to maxRetransmissions times; the interval before the n-th
+     *  retransmission is timeoutInMs * backoffFactor^(n-1), randomly varied by +-jitter to avoid synchronized retransmissions.
+     *  Once all retransmissions are used up, the token expires. A timeout of 0 disables deadlines altogether.
+     */
+    typedef struct {
+        uint32_t timeoutInMs;           //!< Initial timeout in milliseconds, or 0 for no deadline
+        uint32_t maxRetransmissions;    //!< Maximum number of retransmissions
+        double   backoffFactor;         //!< Factor applied to the timeout after each retransmission
+        double   jitter;                //!< Relative random variation of retransmission intervals, e.g. 0.1 for +-10%
+    } SpeedwireRetransmissionPolicy;
+
+    //! Callback receiving a token that expired, i.e. that did not receive a reply despite all retransmissions.
+    typedef std::function<void(const SpeedwireCommandToken& token)> SpeedwireCommandTokenCallback;
+
+    //! Callback retransmitting the request of a token; it returns false if the request could not be sent.
+    typedef std::function<bool(const SpeedwireCommandToken& token)> SpeedwireRetransmitCallback;
+
+
     /**
      *  Class SpeedwireCommandTokenRepository holds SpeedwireCommandTokens from when the command is send
      *  to the peer until the corresponding reply is received.
+     *
+     *  Tokens are stored in a slot map. The index returned by add() is a stable handle consisting of a slot number
+     *  and a generation count; it remains valid until the token is removed and is not affected by adding or removing
+     *  other tokens. Stale handles are detected, i.e. removing a token twice is harmless. Tokens are found by susy id,
+     *  serial number and packet id through an open addressing hash table and are linked in creation order, so that
+     *  expire() only visits expired tokens. add(), find() and remove() take constant time.
+     *
+     *  Tokens get a deadline according to the retransmission policy. Deadlines are driven by a hierarchical timer wheel on
+     *  the tick clock; calls to advance() retransmit requests through the retransmit callback and remove expired tokens,
+     *  passing them to all registered expiry callbacks.
      */
     typedef int SpeedwireCommandTokenIndex;
 
     class SpeedwireCommandTokenRepository {
     public:
-        SpeedwireCommandTokenIndex add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const std::string& peer_ip_address, const Command command);
+        SpeedwireCommandTokenIndex add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const std::string& peer_ip_address, const Command command,
+                                       const std::string& interface_ip_address = std::string(), const void* const request = NULL, const size_t request_size = 0);
         int  find(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) const;
         void remove(const SpeedwireCommandTokenIndex index);
         void clear(void);
         int  expire(const int timeout_in_ms);
         const SpeedwireCommandToken& at(const SpeedwireCommandTokenIndex index) const;
+        bool isValid(const SpeedwireCommandTokenIndex index) const;
         int  size(void) const;
         bool needs_login;
 
-        SpeedwireCommandTokenRepository(void) { needs_login = false; }
+        int  advance(const uint64_t now);
+        uint64_t getNextDeadline(void) const;
+        void setRetransmissionPolicy(const SpeedwireRetransmissionPolicy& policy);
+        const SpeedwireRetransmissionPolicy& getRetransmissionPolicy(void) const { return retransmission_policy; }
+        void setRetransmitCallback(const SpeedwireRetransmitCallback& callback) { retransmit_callback = callback; }
+        void addExpiryCallback(const void* const owner, const SpeedwireCommandTokenCallback& callback);
+        void removeExpiryCallback(const void* const owner);
+
+        SpeedwireCommandTokenRepository(void);
 
     protected:
-        std::vector<SpeedwireCommandToken> token;
+        //! Struct holding a single slot of the slot map.
+        typedef struct {
+            SpeedwireCommandToken token;    //!< The token; it is kept after removal, so that stale handles can still be dereferenced
+            uint64_t key;                   //!< Hash key of the token
+            uint16_t generation;            //!< Generation count, incremented whenever the slot is reused
+            bool     used;                  //!< The slot holds a token
+            int      prev;                  //!< Previous slot in creation order, or -1
+            int      next;                  //!< Next slot in creation order or in the free list, or -1
+        } Slot;
+
+        std::vector<Slot> slots;            //!< Slot map
+        std::vector<int>  table;            //!< Open addressing hash table holding slot numbers, or -1 for empty buckets
+        int    free_list;                   //!< First free slot, or -1
+        int    oldest;                      //!< Oldest token in creation order, or -1
+        int    newest;                      //!< Newest token in creation order, or -1
+        size_t count;                       //!< Number of tokens
+        TimerWheel<SpeedwireCommandTokenIndex> timers;          //!< Deadlines of tokens
+        SpeedwireRetransmissionPolicy retransmission_policy;    //!< Retransmission policy applied to new tokens
+        SpeedwireRetransmitCallback   retransmit_callback;      //!< Callback retransmitting requests
+        std::vector<std::pair<const void*, SpeedwireCommandTokenCallback> > expiry_callbacks;  //!< Callbacks receiving expired tokens, together with their owners
+        std::minstd_rand              random;                   //!< Random number generator for jitter
+
+        //! Get the hash key; reply packet ids are matched with bit 15 set
+        static uint64_t toKey(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) {
+            return ((uint64_t)serialnumber << 32) | ((uint64_t)susyid << 16) | (uint16_t)(packetid | 0x8000);
+        }
+        //! Get the hash value of the given key; fibonacci hashing
+        static size_t hash(const uint64_t key) { return (size_t)((key * 0x9e3779b97f4a7c15ull) >> 32); }
+
+        static int toSlot(const SpeedwireCommandTokenIndex index) { return index & 0xffff; }
+        static SpeedwireCommandTokenIndex toIndex(const int slot, const uint16_t generation) { return ((int)generation << 16) | slot; }
+
+        size_t findBucket(const uint64_t key) const;
+        void   eraseBucket(size_t bucket);
+        void   rehash(const size_t new_size);
+        void   removeSlot(const int slot);
+        uint64_t getRetransmissionInterval(const uint32_t retransmissions);
     };
 
 
@@ -124,11 +212,14 @@ namespace libspeedwire {
         std::vector<SpeedwireSocket> sockets;
         SocketMap socket_map;
 
-        static uint16_t packet_id;
+        static std::atomic<uint16_t> packet_id;    // shared by all instances, such that packet ids are unique across threads
 
         // query tokens are used to match inverter command requests with their responses
         SpeedwireCommandTokenRepository token_repository;
 
+        // dispatcher receiving packets that arrive while waiting for a response, but do not belong to it
+        SpeedwireReceiveDispatcher* dispatcher;
+
     public:
         SpeedwireCommand(const LocalHost& localhost, const std::vector<SpeedwireDevice>& devices);
         ~SpeedwireCommand(void);
@@ -137,10 +228,14 @@ namespace libspeedwire {
         int32_t query(const SpeedwireDevice& peer, const Command command, const uint32_t first_register, const uint32_t last_register, void* udp_buffer, const size_t udp_buffer_size, const int timeout_in_ms = 1000);
         SpeedwireDevice queryDeviceType(const SpeedwireDevice& peer, const int timeout_in_ms = 1000);
 
+        // parse a device type reply packet and augment the device information with the device class and device model
+        static bool parseDeviceTypeReply(const SpeedwireHeader& speedwire_packet, SpeedwireDevice& info);
+
         // asynchronous send command method - send command requests and return immediately
         SpeedwireCommandTokenIndex sendQueryRequest(const SpeedwireDevice& peer, const Command command, const uint32_t first_register, const uint32_t last_register);
 
-        // synchronous receive method - receive command reply packet for the given command token; this method will block until the packet is received or it times out
+        // synchronous receive method - receive command reply packet for the given command token; this method will block until the packet is received or it times out;
+        // with a timeout of 0 it returns immediately; other packets received meanwhile are passed to the receive dispatcher, if there is one
         // (for asynchronous receive handling, see class SpeedwireReceiveDispatcher)
         int32_t receiveResponse(const SpeedwireCommandTokenIndex index, SpeedwireSocket& socket, void* udp_buffer, const size_t udp_buffer_size, const int poll_timeout_in_ms);
 
@@ -154,13 +249,27 @@ namespace libspeedwire {
         // get token repository
         SpeedwireCommandTokenRepository& getTokenRepository(void);
 
+        // retransmit requests and expire tokens whose deadlines have passed
+        int processTokenDeadlines(void);
+        bool retransmit(const SpeedwireCommandToken& token);
+
+        // set the dispatcher receiving unrelated packets that arrive while waiting for a response; NULL drops them
+        void setReceiveDispatcher(SpeedwireReceiveDispatcher* receive_dispatcher) { dispatcher = receive_dispatcher; }
+
         // get socket map
         const SocketMap& getSocketMap(void) const { return socket_map; }
 
-        // increment packet id and return it
+        // get sockets, e.g. to receive reply packets by a SpeedwireReceiveDispatcher
+        const std::vector<SpeedwireSocket>& getSockets(void) const { return sockets; }
+
+        // increment packet id and return it; this is thread-safe
         static uint16_t getIncrementedPacketID(void) {
-            packet_id = (packet_id + 1) | 0x8000;
-            return packet_id;
+            uint16_t current = packet_id.load(std::memory_order_relaxed);
+            uint16_t next;
+            do {
+                next = (uint16_t)((current + 1) | 0x8000);
+            } while (!packet_id.compare_exchange_weak(current, next, std::memory_order_relaxed));
+            return next;
         }
     };
 
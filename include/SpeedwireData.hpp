@@ -462,18 +462,19 @@ namespace libspeedwire {
      */
     class SpeedwireDataMap : public std::map<uint32_t, SpeedwireData> {
         static SpeedwireDataMap globalMap;  // map containing all known definitions
+        uint32_t generation;                // incremented whenever elements are added or removed
 
     public:
         /**
          *  Default constructor.
          */
-        SpeedwireDataMap(void) : std::map<uint32_t, SpeedwireData>() {}
+        SpeedwireDataMap(void) : std::map<uint32_t, SpeedwireData>(), generation(0) {}
 
         /**
          *  Construct a new map from the given vector of SpeedwireData elements.
          *  @param elements the vector of SpeedwireData elements
          */
-        SpeedwireDataMap(const std::vector<SpeedwireData>& elements) {
+        SpeedwireDataMap(const std::vector<SpeedwireData>& elements) : generation(0) {
             this->add(elements);
         }
 
@@ -481,7 +482,7 @@ namespace libspeedwire {
          *  Add a new element to the map of speedwire inverter reply data elements.
          *  @param element The SpeedwireData element to be added to the map
          */
-        void add(const SpeedwireData& element) { operator[](element.toKey()) = element; }
+        void add(const SpeedwireData& element) { operator[](element.toKey()) = element; ++generation; }
 
         /**
          *  Add a vector of elements to the map of emeter obis data elements.
@@ -499,8 +500,16 @@ namespace libspeedwire {
          */
         void remove(const SpeedwireData& entry) {
             erase(entry.toKey());
+            ++generation;
         }
 
+        /**
+         *  Get the generation of the map; it is incremented whenever elements are added by add() or removed by remove(),
+         *  such that pointers to map elements can be re-validated cheaply.
+         *  @return the generation
+         */
+        uint32_t getGeneration(void) const { return generation; }
+
         static SpeedwireDataMap &getGlobalMap(void);
     };
 
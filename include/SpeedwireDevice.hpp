@@ -63,6 +63,15 @@ namespace libspeedwire {
 
         bool isBroadcast(void) const { return (susyID == 0xffff && serialNumber == 0xffffffff); }
 
+        /** Get a unique 64-bit key for this address. */
+        uint64_t toKey(void) const { return ((uint64_t)susyID << 32) | serialNumber; }
+
+        /** Get a 32-bit hash value for this address; the bits are mixed such that any subset of bits can be used as a hash table index. */
+        uint32_t hash(void) const {
+            uint64_t h = toKey() * 0x9e3779b97f4a7c15ull;   // fibonacci hashing
+            return (uint32_t)(h >> 32);
+        }
+
         /** Convert SpeedwireAddress to a string */
         std::string toString(void) const {
             char buffer[256] = { 0 };
@@ -72,17 +81,20 @@ namespace libspeedwire {
 
         /** Get a reference to a local device address. This can be used as a source device for commands. */
         static const SpeedwireAddress& getLocalAddress(void) {
-            static SpeedwireAddress local(0x0078, 0x3a28be52);
+            // the initialization of function-local statics is thread-safe
+            static const SpeedwireAddress local = createLocalAddress();
+            return local;
+        }
+
+        /** Create the local device address. */
+        static SpeedwireAddress createLocalAddress(void) {
+            SpeedwireAddress local(0x0078, 0x3a28be52);
             // assign different serial numbers for libspeedwire instances running on different nodes
             // based on the least-significant byte of the local interfaces ip address
-            static bool initialized = false;
-            if (!initialized) {
-                initialized = true;
-                for (const auto& if_addr : LocalHost::getInstance().getLocalIPv4Addresses()) {
-                    if (if_addr.substr(0, 7) == "192.168") {
-                        uint8_t byte0 = (uint8_t)((AddressConversion::toInAddress(if_addr).s_addr >> 24) & 0xff);
-                        local.serialNumber = ((local.serialNumber / 1000) * 1000) + byte0;
-                    }
+            for (const auto& if_addr : LocalHost::getInstance().getLocalIPv4Addresses()) {
+                if (if_addr.substr(0, 7) == "192.168") {
+                    uint8_t byte0 = (uint8_t)((AddressConversion::toInAddress(if_addr).s_addr >> 24) & 0xff);
+                    local.serialNumber = ((local.serialNumber / 1000) * 1000) + byte0;
                 }
             }
             return local;
@@ -2,13 +2,19 @@
 #define __LIBSPEEDWIRE_SPEEDWIREDISCOVERY_HPP__
 
 #include <cstdint>
+#include <string>
 #include <vector>
+#include <memory>
 #include <LocalHost.hpp>
+#include <SpeedwireHeader.hpp>
 #include <SpeedwireSocket.hpp>
 #include <SpeedwireDevice.hpp>
 
 namespace libspeedwire {
 
+    // forward declaration
+    class SpeedwireCommand;
+
     /**
      *  Class implementing a discovery mechanism for speedwire devices.
      *  Discovery is performed against all potential devices on all local subnets that are connected to the different
@@ -17,27 +23,62 @@ namespace libspeedwire {
      *  - multicast speedwire discovery requests to all interfaces
      *  - unicast speedwire discovery requests to pre-registered hosts
      *  - unicast speedwire discovery requests to all hosts on the network (only if the network prefix is < /16)
+     *
+     *  The state machine is event-driven: startDiscovery() starts it and each call to processDiscovery() sends the packets
+     *  that are due and handles the packets received until the next event. Device type queries for devices with
+     *  incomplete information are sent concurrently, as soon as the first sequence of discovery packets is sent.
+     *  If devices were pre-registered or required, discovery completes as soon as all of them are seen, unless a full
+     *  scan is requested; otherwise it completes once no further packets arrive. As getDevices() reflects all devices
+     *  found so far, data collection can start while discovery is still running in the background.
      */
     class SpeedwireDiscovery {
 
     protected:
+        static constexpr uint32_t max_wait_time_in_ms   = 2000;     //!< Time to wait for replies after the last discovery packet
+        static constexpr uint32_t burst_interval_in_ms  = 10;       //!< Interval between bursts of unicast scan packets
+        static constexpr uint32_t step_interval_in_ms   = 200;      //!< Interval after multicast and pre-registered device requests
+        static constexpr size_t   burst_size            = 10;       //!< Number of unicast scan packets per burst
+        static constexpr size_t   max_retries           = 3;        //!< Number of times the sequence of discovery packets is sent
+
         const LocalHost& localhost;
 
         std::vector<SpeedwireDevice> speedwireDevices;
 
-        bool sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter);
+        // discovery state
+        std::vector<SpeedwireSocket> sockets;               //!< Receive sockets of the running discovery
+        std::unique_ptr<std::vector<SpeedwireDevice> > interfaceDevices;   //!< Placeholder devices, one for each local interface, used to open the command sockets
+        std::unique_ptr<SpeedwireCommand> command;                          //!< Command instance sending device type queries; it refers to the placeholder devices
+        std::vector<int>             deviceTypeQueries;     //!< Command tokens of device type queries in flight
+        std::vector<std::string>     queriedDevices;        //!< Ip addresses of devices that were already sent a device type query
+        bool     running;                                   //!< The discovery is running
+        bool     earlyCompletion;                           //!< Complete as soon as all pre-registered and required devices are seen
+        size_t   broadcastCounter;                          //!< Multicast request state of the packet sequence
+        size_t   preregCounter;                             //!< Pre-registered device request state of the packet sequence
+        size_t   subnetCounter;                             //!< Next host address of the unicast scan
+        size_t   socketCounter;                             //!< Interface of the unicast scan, or 0xffffffff if there is no unicast scan
+        size_t   numRetries;                                //!< Remaining number of discovery packet sequences
+        uint64_t nextSendTime;                              //!< Tick count when the next discovery packets are due
+        uint64_t lastSendTime;                              //!< Tick count when the most recent discovery packets were sent
+
+        virtual uint64_t getTickCountInMs(void) const;
+        void reset(const bool full_scan);
+        bool checkCompletion(const uint64_t now) const;
+        bool sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter, size_t& num_packets);
         bool recvDiscoveryPackets(const SpeedwireSocket& socket);
+        bool processDiscoveryPacket(const SpeedwireHeader& packet, const std::string& peer_ip_address, const std::string& socket_interface_address);
+        bool processDeviceTypeReply(const SpeedwireHeader& packet, const std::string& peer_ip_address);
         bool sendMulticastDiscoveryRequestToSockets(void);
         bool sendMulticastDiscoveryRequestToDevices(void);
         bool sendUnicastDiscoveryRequestToDevices(void);
-        bool sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter);
+        bool sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter, size_t& num_packets);
         int pollSockets(const std::vector<SpeedwireSocket>& sockets, int timeout);
         bool completeDeviceInformation(void);
 
     public:
 
         SpeedwireDiscovery(LocalHost& localhost);
-        ~SpeedwireDiscovery(void);
+        SpeedwireDiscovery(SpeedwireDiscovery&& rhs) = default;                 // movable, but not copyable, the command instance is owned
+        virtual ~SpeedwireDiscovery(void);
 
         bool preRegisterDevice(const std::string peer_ip_address);
         bool requireDevice(const uint32_t serial_number);
@@ -52,7 +93,13 @@ namespace libspeedwire {
         unsigned long getNumberOfFullyRegisteredDevices(void) const;
         unsigned long getNumberOfDevices(void) const;
 
+        // synchronous discovery - blocks until discovery is complete
         int discoverDevices(const bool full_scan = false);
+
+        // asynchronous discovery - start the discovery and drive it by calling processDiscovery() until it returns false
+        bool startDiscovery(const bool full_scan = false);
+        bool processDiscovery(const int timeout_in_ms = 0);
+        bool isDiscoveryRunning(void) const { return running; }
     };
 
 }   // namespace libspeedwire
@@ -0,0 +1,99 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREPOLLSCHEDULER_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREPOLLSCHEDULER_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <SpeedwireQueryEngine.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class holding the parameters used to adapt the poll intervals of a SpeedwirePollScheduler.
+     */
+    class SpeedwirePollPolicy {
+    public:
+        double   speedupFactor;         //!< Factor applied to the interval if values changed by more than the volatility threshold
+        double   slowdownFactor;        //!< Factor applied to the interval if values did not change at all
+        double   darknessFactor;        //!< Factor applied to the interval if all values are NaN, e.g. inverters at night
+        double   volatilityThreshold;   //!< Relative change of a value considered volatile, e.g. 0.05 for 5%
+        uint32_t burstWindowInMs;       //!< Entries due within this time window are polled together with the entries due now
+        uint32_t darknessPolls;         //!< Number of consecutive polls with all values NaN, after which an entry is considered dark
+
+        SpeedwirePollPolicy(void) : speedupFactor(0.5), slowdownFactor(1.5), darknessFactor(4.0), volatilityThreshold(0.05), burstWindowInMs(250), darknessPolls(3) {}
+    };
+
+    //! Handle of a poll entry as returned by SpeedwirePollScheduler::add().
+    typedef uint32_t SpeedwirePollHandle;
+
+
+    /**
+     *  Class SpeedwirePollScheduler implements an adaptive polling scheduler on top of SpeedwireQueryEngine.
+     *
+     *  Each poll entry is a query for a register range of a device, together with a target interval and the range
+     *  the interval may be adapted within. Calls to poll() submit the queries of all entries that are due, including
+     *  those due within the burst window, in a single burst to the query engine; entries polled together stay in
+     *  phase. Once a reply is received, the interval of the entry is adapted to the observed data:
+     *  - if all values are NaN, like the values of inverters at night, the interval is stretched by the darkness factor;
+     *    once the entry stays dark for the configured number of polls, it is polled at its maximum interval,
+     *  - if an entry that has been dark returns values again, e.g. at dawn, the interval is reset to the target interval,
+     *  - if any value changed by more than the volatility threshold, the interval is shortened by the speedup factor,
+     *  - if no value changed at all, the interval is stretched by the slowdown factor,
+     *  - otherwise the interval converges back towards the target interval.
+     *  Failed queries stretch the interval by the slowdown factor to reduce the load on unresponsive devices.
+     */
+    class SpeedwirePollScheduler {
+    protected:
+
+        //! Struct holding a single poll entry.
+        typedef struct {
+            SpeedwireDevice device;             //!< Device to query
+            Command  command;                   //!< Command identifier of the query
+            uint32_t firstRegister;             //!< First register id of the query
+            uint32_t lastRegister;              //!< Last register id of the query
+            uint32_t targetInterval;            //!< Target poll interval in milliseconds
+            uint32_t minInterval;               //!< Lower bound of the adapted poll interval in milliseconds
+            uint32_t maxInterval;               //!< Upper bound of the adapted poll interval in milliseconds
+            uint32_t interval;                  //!< Current adapted poll interval in milliseconds
+            uint64_t lastPollTime;              //!< Tick count of the burst the entry was most recently polled in
+            uint64_t nextPollTime;              //!< Tick count when the entry is due
+            bool     inFlight;                  //!< True if the query of the entry is submitted and not yet completed
+            size_t   numPolls;                  //!< Number of completed polls
+            size_t   numNanPolls;               //!< Number of consecutive polls where all values were NaN
+            std::vector<double> values;         //!< Values of the most recent reply, NaN for NaN values
+        } Entry;
+
+        SpeedwireQueryEngine&  engine;          //!< Query engine used to send queries
+        SpeedwirePollPolicy    policy;          //!< Interval adaptation parameters
+        SpeedwireQueryCallback callback;        //!< Callback receiving all query results
+        std::vector<Entry>     entries;         //!< Poll entries, indexed by poll handle
+
+        virtual uint64_t getTickCountInMs(void) const;
+        void complete(const SpeedwirePollHandle handle, const SpeedwireQueryResult& result);
+        void adapt(Entry& entry, const std::vector<double>& values);
+        static std::vector<double> getValues(const std::vector<uint8_t>& packet);
+
+    public:
+        SpeedwirePollScheduler(SpeedwireQueryEngine& engine, const SpeedwireQueryCallback& callback);
+        virtual ~SpeedwirePollScheduler(void) {}
+
+        SpeedwirePollHandle add(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register,
+                                const uint32_t interval_in_ms, const uint32_t min_interval_in_ms, const uint32_t max_interval_in_ms);
+        size_t   poll(void);
+        uint64_t getNextPollTime(void) const;
+
+        /** Set the interval adaptation parameters. */
+        void setPolicy(const SpeedwirePollPolicy& poll_policy) { policy = poll_policy; }
+
+        /** Get the interval adaptation parameters. */
+        const SpeedwirePollPolicy& getPolicy(void) const { return policy; }
+
+        /** Get the current adapted poll interval of the given entry in milliseconds. */
+        uint32_t getInterval(const SpeedwirePollHandle handle) const { return (handle < entries.size() ? entries[handle].interval : 0); }
+
+        /** Get the number of poll entries. */
+        size_t size(void) const { return entries.size(); }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREQUERYENGINE_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREQUERYENGINE_HPP__
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireDevice.hpp>
+#include <SpeedwireReceiveDispatcher.hpp>
+#include <TimerWheel.hpp>
+
+namespace libspeedwire {
+
+    //! Completion status of an asynchronous query.
+    enum class SpeedwireQueryStatus {
+        SUCCESS,        //!< A valid reply packet with error code 0 was received
+        ERROR_CODE,     //!< A valid reply packet with a non-zero error code was received
+        TIMEOUT,        //!< No reply packet was received within the timeout
+        SEND_FAILURE    //!< The query request packet could not be sent
+    };
+
+    /**
+     *  Class holding the completion information of an asynchronous query.
+     */
+    class SpeedwireQueryResult {
+    public:
+        uint32_t             id;                //!< Query id as returned by SpeedwireQueryEngine::submit()
+        SpeedwireDevice      device;            //!< Device the query was sent to
+        Command              command;           //!< Command identifier of the query
+        uint32_t             firstRegister;     //!< First register id of the query
+        uint32_t             lastRegister;      //!< Last register id of the query
+        SpeedwireQueryStatus status;            //!< Completion status
+        uint16_t             errorCode;         //!< Error code of the reply packet, if status is SUCCESS or ERROR_CODE
+        uint32_t             roundTripTime;     //!< Time between sending the request and completion in milliseconds
+        std::vector<uint8_t> packet;            //!< Reply packet data, if status is SUCCESS or ERROR_CODE
+
+        SpeedwireQueryResult(void) : id(0), device(), command(Command::NONE), firstRegister(0), lastRegister(0),
+            status(SpeedwireQueryStatus::TIMEOUT), errorCode(0), roundTripTime(0), packet() {}
+    };
+
+    //! Callback receiving the completion information of an asynchronous query.
+    typedef std::function<void(const SpeedwireQueryResult& result)> SpeedwireQueryCallback;
+
+
+    /**
+     *  Class SpeedwireQueryEngine implements a pipelined asynchronous query engine on top of SpeedwireCommand.
+     *
+     *  Queries are submitted together with a completion callback and queued per device. Queued queries are sent as
+     *  soon as the number of queries in flight for their device is below the per device limit, so that many queries
+     *  are in flight across devices at the same time. Reply packets are matched to their queries by command token;
+     *  the engine is an inverter packet receiver and is registered with a SpeedwireReceiveDispatcher, so that reply
+     *  packets are received together with any other packets arriving on the same sockets. Query timeouts are driven
+     *  by a timer wheel on the tick clock; requests are retransmitted according to the retransmission policy of the
+     *  token repository.
+     *
+     *  A typical poll sweep submits all queries and then calls run(), which returns once all queries are completed;
+     *  it takes roughly one round trip time plus transmit time instead of one round trip time per query.
+     *  Callbacks may submit further queries, but must not call send(), expire() or run().
+     */
+    class SpeedwireQueryEngine : public InverterPacketReceiverBase {
+    protected:
+
+        //! Struct holding a submitted query.
+        typedef struct {
+            SpeedwireQueryResult   result;      //!< Completion information, filled in step by step
+            SpeedwireQueryCallback callback;    //!< Completion callback
+            uint16_t               packetId;    //!< Packet id of the request, once it is sent
+            uint64_t               sendTime;    //!< Tick count when the request was sent
+            uint64_t               deadline;    //!< Tick count when the query times out
+        } Query;
+
+        //! Struct holding the queries of a single device.
+        typedef struct {
+            std::deque<uint32_t> pending;       //!< Ids of queued queries not yet sent
+            size_t               inFlight;      //!< Number of queries sent but not yet completed
+        } DeviceQueue;
+
+        SpeedwireCommand& command;                          //!< Command instance used to send requests and check replies
+        size_t   maxInFlightPerDevice;                      //!< Maximum number of queries in flight per device
+        int      timeoutInMs;                               //!< Timeout of each query in milliseconds
+        uint32_t nextId;                                    //!< Id of the next submitted query
+        size_t   numPending;                                //!< Number of queued queries not yet sent
+        size_t   numCompleted;                              //!< Number of completed queries
+        std::map<uint32_t, Query>       queries;            //!< All submitted queries not yet completed, keyed by query id
+        std::map<uint64_t, uint32_t>    tokens;             //!< Ids of queries in flight, keyed by token key
+        std::map<uint64_t, DeviceQueue> devices;            //!< Device queues, keyed by device address key
+        TimerWheel<uint32_t>            timers;             //!< Timeouts of queries in flight
+
+        //! Get the token key from the device address and packet id; reply packet ids are matched with bit 15 set
+        static uint64_t toTokenKey(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) {
+            return ((uint64_t)serialnumber << 32) | ((uint64_t)susyid << 16) | (uint16_t)(packetid | 0x8000);
+        }
+
+        virtual uint64_t getTickCountInMs(void) const;
+        virtual SpeedwireCommandTokenIndex sendRequest(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register);
+        void complete(const uint32_t id, const SpeedwireQueryStatus status, const uint64_t now);
+        void removeToken(const SpeedwireQueryResult& result, const uint16_t packetid);
+        void tokenExpired(const SpeedwireCommandToken& token);
+
+    public:
+        SpeedwireQueryEngine(LocalHost& host, SpeedwireCommand& command, const size_t max_in_flight_per_device = 1, const int timeout_in_ms = 1000);
+        virtual ~SpeedwireQueryEngine(void);
+
+        uint32_t submit(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register, const SpeedwireQueryCallback& callback);
+        size_t send(void);
+        size_t expire(void);
+        int    run(SpeedwireReceiveDispatcher& dispatcher, const std::vector<SpeedwireSocket>& sockets, const int max_wait_time_in_ms);
+
+        virtual void receive(SpeedwireHeader& packet, struct sockaddr& src);
+
+        /** Set the maximum number of queries in flight per device; it must be at least 1. */
+        void setMaxInFlightPerDevice(const size_t max_in_flight) { maxInFlightPerDevice = (max_in_flight > 0 ? max_in_flight : 1); }
+
+        /** Set the timeout of queries sent from now on. */
+        void setTimeout(const int timeout_in_ms) { timeoutInMs = timeout_in_ms; }
+
+        /** Get the number of queued queries not yet sent. */
+        size_t getNumberOfPendingQueries(void) const { return numPending; }
+
+        /** Get the number of queries sent but not yet completed. */
+        size_t getNumberOfQueriesInFlight(void) const { return queries.size() - numPending; }
+
+        /** Check if all submitted queries are completed. */
+        bool isIdle(void) const { return queries.empty(); }
+    };
+
+}   // namespace libspeedwire
+
+#endif
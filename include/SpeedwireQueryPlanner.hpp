@@ -0,0 +1,68 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREQUERYPLANNER_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREQUERYPLANNER_HPP__
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <SpeedwireData.hpp>
+#include <SpeedwireQueryEngine.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class holding a single query of a query plan, i.e. a register range of a single command.
+     */
+    class SpeedwireQueryRange {
+    public:
+        Command  command;                       //!< Command identifier of the query
+        uint32_t firstRegister;                 //!< First register id of the query
+        uint32_t lastRegister;                  //!< Last register id of the query
+        size_t   replySize;                     //!< Estimated size of the reply packet in bytes
+        std::vector<SpeedwireData> elements;    //!< Requested elements covered by the register range
+
+        SpeedwireQueryRange(void) : command(Command::NONE), firstRegister(0), lastRegister(0), replySize(0), elements() {}
+    };
+
+    //! A query plan is a sequence of register range queries.
+    typedef std::vector<SpeedwireQueryRange> SpeedwireQueryPlan;
+
+
+    /**
+     *  Class SpeedwireQueryPlanner translates a set of requested SpeedwireData elements into the minimum number of
+     *  register range queries.
+     *
+     *  Elements are grouped by command and sorted by register id. Consecutive registers are merged into a single
+     *  register range, as long as the gap between them does not exceed the given number of registers and the estimated
+     *  reply still fits into a single packet. The reply size is estimated from the requested elements and from the
+     *  known elements of the global SpeedwireDataMap inside the gaps, as the device replies with all registers it has
+     *  within the range. Plans are cached, such that repeated sweeps over the same elements are planned only once.
+     */
+    class SpeedwireQueryPlanner {
+    protected:
+        size_t   maxReplySize;                                          //!< Maximum size of a reply packet in bytes
+        uint32_t maxGap;                                                //!< Maximum number of unrequested registers between merged registers
+        std::map<std::vector<uint64_t>, SpeedwireQueryPlan> cache;      //!< Cached plans, keyed by the sorted keys of their elements
+
+        static size_t getRecordSize(const Command command, const SpeedwireDataType type);
+        size_t getGapSize(const Command command, const uint32_t first_register, const uint32_t last_register) const;
+        SpeedwireQueryPlan createPlan(std::vector<SpeedwireData> elements) const;
+
+    public:
+        static constexpr size_t reply_header_size = 24 + 8 + 8 + 6 + 4 + 4 + 4;  //!< Size of a reply packet without register data, including the trailer
+        static constexpr size_t max_udp_payload_size = 1472;                     //!< Maximum udp payload size of an unfragmented ethernet frame
+
+        SpeedwireQueryPlanner(const size_t max_reply_size = max_udp_payload_size, const uint32_t max_gap_in_registers = 0x40);
+
+        const SpeedwireQueryPlan& getPlan(const std::vector<SpeedwireData>& elements);
+        size_t submit(SpeedwireQueryEngine& engine, const SpeedwireDevice& peer, const std::vector<SpeedwireData>& elements, const SpeedwireQueryCallback& callback);
+
+        /** Get the number of cached plans. */
+        size_t getNumberOfCachedPlans(void) const { return cache.size(); }
+
+        /** Remove all cached plans, e.g. after the global SpeedwireDataMap was modified. */
+        void clear(void) { cache.clear(); }
+    };
+
+}   // namespace libspeedwire
+
+#endif
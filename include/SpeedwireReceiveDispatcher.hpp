@@ -119,6 +119,7 @@ namespace libspeedwire {
         ~SpeedwireReceiveDispatcher(void);
 
         int  dispatch(const std::vector<SpeedwireSocket>& sockets, const int poll_timeout_in_ms);
+        int  dispatch(SpeedwireHeader& packet, struct sockaddr& src);
 
         void registerReceiver(SpeedwirePacketReceiverBase& receiver);
         void registerReceiver(EmeterPacketReceiverBase& receiver);
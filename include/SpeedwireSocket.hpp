@@ -11,10 +11,32 @@
 #endif
 
 #include <string>
+#include <vector>
 #include <LocalHost.hpp>
 
 namespace libspeedwire {
 
+    /**
+     *  Class holding a single packet of a batched send operation, i.e. a reference to the packet data and its destination address.
+     *  The packet data is not copied and must remain valid until the packet is sent.
+     */
+    class SpeedwireSocketPacket {
+    public:
+        const void*   buff;             //!< Pointer to the packet data
+        unsigned long size;             //!< Size of the packet data in bytes
+        union {
+            struct sockaddr     addr;   //!< Generic destination address, addr.sa_family determines the address family
+            struct sockaddr_in  addr4;  //!< Ipv4 destination address
+            struct sockaddr_in6 addr6;  //!< Ipv6 destination address
+        } dest;
+
+        SpeedwireSocketPacket(const void* const buff, const unsigned long size, const struct sockaddr_in& dest);
+        SpeedwireSocketPacket(const void* const buff, const unsigned long size, const struct sockaddr_in6& dest);
+
+        bool isMulticast(void) const;
+    };
+
+
     /**
      *  Class implementing a platform neutral socket abstraction for speedwire multicast traffic.
      */
@@ -35,6 +57,7 @@ namespace libspeedwire {
 
         int openSocketV4(const std::string& local_interface_address, const bool multicast);
         int openSocketV6(const std::string& local_interface_address, const bool multicast);
+        int sendBurst(const SpeedwireSocketPacket* const packets, const size_t num_packets) const;
 
     public:
 
@@ -75,6 +98,9 @@ namespace libspeedwire {
         int sendto(const void* const buff, const unsigned long size, const std::string& dest) const;
         int sendto(const void* const buff, const unsigned long size, const struct sockaddr_in& dest, const struct in_addr& local_interface_address) const;
         int sendto(const void* const buff, const unsigned long size, const struct sockaddr_in6& dest, const struct in6_addr& local_interface_address) const;
+
+        // send a batch of packets, optionally paced in bursts of the given number of packets
+        int sendto(const std::vector<SpeedwireSocketPacket>& packets, const size_t burst_size = 0, const uint32_t burst_gap_in_us = 0) const;
     };
 
 }   // namespace libspeedwire
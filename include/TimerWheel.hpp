@@ -0,0 +1,207 @@
+#ifndef __LIBSPEEDWIRE_TIMERWHEEL_HPP__
+#define __LIBSPEEDWIRE_TIMERWHEEL_HPP__
+
+#include <cstdint>
+#include <vector>
+
+namespace libspeedwire {
+
+    /**
+     *  Class implementing a hierarchical timer wheel. Each level is a circular array of slots; a slot of level 0 holds the
+     *  timers expiring within one tick, a slot of level n holds the timers expiring within num_slots^n ticks. Timers are
+     *  scheduled on the lowest level covering their deadline and are cascaded down to the next lower level, once the
+     *  lower level wraps around to their slot. Scheduling a timer is O(1); advancing the wheel visits one slot of level 0
+     *  per elapsed tick and cascades each timer at most once per level. Timers with deadlines beyond the range of the
+     *  highest level remain in their slot until their round has come.
+     *
+     *  Timers cannot be cancelled; the owner is expected to ignore expired values that are no longer relevant.
+     *  All times are given in milliseconds, e.g. obtained from LocalHost::getTickCountInMs().
+     */
+    template<class T> class TimerWheel {
+    protected:
+        //! Struct holding a single timer.
+        typedef struct {
+            uint64_t deadline;  //!< Expiry time of the timer
+            T        value;     //!< Value passed to the expiry callback
+        } Timer;
+
+        typedef std::vector<Timer> Slot;
+
+        std::vector<std::vector<Slot> > levels;     //!< Levels, each holding num_slots slots
+        unsigned int bits;                          //!< Number of bits of the slot index, i.e. num_slots == 1 << bits
+        uint64_t mask;                              //!< Mask of the slot index, i.e. num_slots - 1
+        uint64_t resolution;                        //!< Duration of a tick in milliseconds
+        uint64_t current;                           //!< Current tick, i.e. the most recent time passed to advance() divided by the resolution
+        size_t   count;                             //!< Number of scheduled timers
+
+        //! Predicate accepting all timers
+        struct AnyTimer {
+            bool operator()(const T&) const { return true; }
+        };
+
+        //! Insert the given timer into the lowest level covering its deadline, relative to the current tick
+        void insert(const Timer& timer) {
+            uint64_t tick = timer.deadline / resolution;
+            if (tick < current) {
+                tick = current;
+            }
+            const uint64_t delta = tick - current;
+            size_t level = 0;
+            while ((level + 1) < levels.size() && (delta >> (bits * (level + 1))) != 0) {
+                ++level;
+            }
+            levels[level][(tick >> (bits * level)) & mask].push_back(timer);
+        }
+
+        //! Move the timers of the higher level slots, where the given tick is the start of their time span, down to lower levels
+        void cascade(const uint64_t tick) {
+            for (size_t level = 1; level < levels.size(); ++level) {
+                if ((tick & ((1ull << (bits * level)) - 1)) != 0) {
+                    break;
+                }
+                Slot slot;
+                slot.swap(levels[level][(tick >> (bits * level)) & mask]);
+                for (const auto& timer : slot) {
+                    insert(timer);
+                }
+            }
+        }
+
+        //! Expire the timers of the given level 0 slot with a deadline at or before the given time
+        template<class Callback> size_t expireSlot(const uint64_t tick, const uint64_t now, Callback& expire) {
+            Slot& slot = levels[0][tick & mask];
+            size_t expired = 0;
+            for (size_t j = 0; j < slot.size(); ) {
+                if (slot[j].deadline <= now) {
+                    const T value = slot[j].value;
+                    slot[j] = slot.back();
+                    slot.pop_back();
+                    --count;
+                    ++expired;
+                    expire(value);
+                }
+                else {
+                    ++j;
+                }
+            }
+            return expired;
+        }
+
+    public:
+        /**
+         *  Constructor.
+         *  @param num_slots the number of slots per level; it is rounded up to the next power of two
+         *  @param resolution_in_ms the duration of a tick in milliseconds
+         *  @param now the current time; if unknown, the wheel is synchronized to the clock by the first call to advance()
+         *  @param num_levels the number of levels; the wheel covers num_slots^num_levels ticks without extra rounds
+         */
+        TimerWheel(const size_t num_slots, const uint64_t resolution_in_ms, const uint64_t now, const size_t num_levels = 3) :
+            levels(),
+            bits(0),
+            mask(0),
+            resolution(resolution_in_ms > 0 ? resolution_in_ms : 1),
+            current(0),
+            count(0) {
+            while ((1ull << bits) < num_slots && bits < 16) {
+                ++bits;
+            }
+            mask = (1ull << bits) - 1;
+            levels.resize(num_levels > 0 ? num_levels : 1, std::vector<Slot>((size_t)1 << bits));
+            current = now / resolution;
+        }
+
+        /**
+         *  Schedule a timer; deadlines in the past expire upon the next call to advance().
+         *  @param deadline the expiry time
+         *  @param value the value passed to the expiry callback
+         */
+        void schedule(const uint64_t deadline, const T& value) {
+            const Timer timer = { deadline, value };
+            insert(timer);
+            ++count;
+        }
+
+        /**
+         *  Advance the wheel to the given time and call the expiry callback for all timers with a deadline at or before it.
+         *  The callback may schedule new timers.
+         *  @param now the current time
+         *  @param expire callback with signature void(const T& value), called once for each expired timer
+         *  @return the number of expired timers
+         */
+        template<class Callback> size_t advance(const uint64_t now, Callback expire) {
+            const uint64_t tick = now / resolution;
+            if (count == 0) {
+                current = tick;     // resynchronize, e.g. if the wheel was constructed before the clock started
+                return 0;
+            }
+            if (tick < current) {
+                return 0;
+            }
+            // revisit the current tick, as it may hold timers expiring later within the tick; then step through the elapsed ticks
+            size_t expired = expireSlot(current, now, expire);
+            while (current < tick && count > 0) {
+                ++current;
+                cascade(current);
+                expired += expireSlot(current, now, expire);
+            }
+            current = tick;
+            return expired;
+        }
+
+        /**
+         *  Get the earliest deadline of all scheduled timers.
+         *  @return the earliest deadline, or (uint64_t)-1 if there are no scheduled timers
+         */
+        uint64_t getNextDeadline(void) const {
+            return getNextDeadline(AnyTimer());
+        }
+
+        /**
+         *  Get the earliest deadline of all scheduled timers, whose value is still pending. As timers cannot be cancelled,
+         *  this allows the owner to skip timers that are no longer relevant. Slots are visited in the order of their
+         *  time spans; the scan of a level stops at the first slot holding a pending timer, except for the highest level,
+         *  which can hold timers of later rounds.
+         *  @param is_pending predicate with signature bool(const T& value), returning true for pending timers
+         *  @return the earliest deadline, or (uint64_t)-1 if there are no pending timers
+         */
+        template<class Predicate> uint64_t getNextDeadline(Predicate is_pending) const {
+            uint64_t next = (uint64_t)-1;
+            if (count == 0) {
+                return next;
+            }
+            const size_t num_slots = (size_t)mask + 1;
+            for (size_t level = 0; level < levels.size(); ++level) {
+                const bool highest = (level + 1 == levels.size());
+                const uint64_t span = (current >> (bits * level));
+                bool found = false;
+                for (size_t i = 0; i < num_slots && (found == false || highest); ++i) {
+                    // level 0 starts at the current tick, higher levels start at the time span following the current one
+                    const Slot& slot = levels[level][(span + i + (level > 0 ? 1 : 0)) & mask];
+                    for (const auto& timer : slot) {
+                        if (is_pending(timer.value)) {
+                            if (timer.deadline < next) next = timer.deadline;
+                            found = true;
+                        }
+                    }
+                }
+            }
+            return next;
+        }
+
+        /** Get the number of scheduled timers. */
+        size_t size(void) const { return count; }
+
+        /** Remove all scheduled timers. */
+        void clear(void) {
+            for (auto& level : levels) {
+                for (auto& slot : level) {
+                    slot.clear();
+                }
+            }
+            count = 0;
+        }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -7,11 +7,12 @@ using namespace libspeedwire;
 
 /**
  * Constructor of the AveragingProcessor instance.
- * @param averaging_time Constant averaging time for data received from any of the emeter or inverter data inputs.
+ * @param averaging_time_obis_data Averaging time for data received from emeter data inputs of output interval 0.
+ * @param averaging_time_speedwire_data Averaging time for data received from inverter data inputs of output interval 0.
  */
-AveragingProcessor::AveragingProcessor(const unsigned long averaging_time_obis_data, const unsigned long averaging_time_speedwire_data) :
-    averagingTimeObisData(averaging_time_obis_data),
-    averagingTimeSpeedwireData(averaging_time_speedwire_data) {}
+AveragingProcessor::AveragingProcessor(const unsigned long averaging_time_obis_data, const unsigned long averaging_time_speedwire_data) {
+    addInterval(averaging_time_obis_data, averaging_time_speedwire_data);
+}
 
 
 /**
@@ -21,108 +22,240 @@ AveragingProcessor::~AveragingProcessor(void) {}
 
 
 /**
- * Initialize/add a block of state keeping variables for averaging measurement value of the given device.
- * @param serial_number The serial number of the device.
+ * Add an output interval.
+ * @param averaging_time_obis_data Averaging time for data received from emeter data inputs.
+ * @param averaging_time_speedwire_data Averaging time for data received from inverter data inputs.
+ * @return Index of the new output interval; use it to register consumers for this interval.
+ */
+size_t AveragingProcessor::addInterval(const unsigned long averaging_time_obis_data, const unsigned long averaging_time_speedwire_data) {
+    OutputInterval interval;
+    interval.averagingTimeObisData      = averaging_time_obis_data;
+    interval.averagingTimeSpeedwireData = averaging_time_speedwire_data;
+    intervals.push_back(interval);
+    const size_t index = intervals.size() - 1;
+
+    // add timers for the new interval to all known devices
+    for (auto& state : states) {
+        state.timers.push_back(initializeTimer(state.deviceType, index));
+    }
+    return index;
+}
+
+
+/**
+ * Initialize an averaging timer for the given device type and output interval.
  * @param device_type The device identifier.
- * @return Index of the newly initialized/added variable block in vector states.
+ * @param interval The index of the output interval.
+ * @return The initialized timer.
  */
-int AveragingProcessor::initializeState(const uint32_t serial_number, const DeviceType& device_type) {
-    AveragingState device_state;
-    device_state.serialNumber            = serial_number;
-    device_state.deviceType              = device_type;
-    device_state.remainder               = 0;
-    device_state.currentTimestamp        = 0;
-    device_state.currentTimestampIsValid = false;
-    device_state.averagingTimeReached    = false;
-    device_state.averagingTime           = 0;
+AveragingProcessor::AveragingTimer AveragingProcessor::initializeTimer(const DeviceType& device_type, const size_t interval) const {
+    AveragingTimer timer;
+    timer.remainder               = 0;
+    timer.currentTimestamp        = 0;
+    timer.currentTimestampIsValid = false;
+    timer.averagingTimeReached    = false;
+    timer.averagingTime           = 0;
     if (device_type == DeviceType::EMETER) {
-        device_state.averagingTime = averagingTimeObisData;
+        timer.averagingTime = intervals[interval].averagingTimeObisData;
     }
     else if (device_type == DeviceType::INVERTER) {
-        device_state.averagingTime = averagingTimeSpeedwireData / 1000;
+        timer.averagingTime = intervals[interval].averagingTimeSpeedwireData / 1000;
+    }
+    return timer;
+}
+
+
+/**
+ * Initialize/add a block of state keeping variables for averaging measurement value of the given device.
+ * @param device_address The address of the device.
+ * @param device_type The device identifier.
+ * @return Index of the newly initialized/added variable block in vector states.
+ */
+int AveragingProcessor::initializeState(const SpeedwireAddress& device_address, const DeviceType& device_type) {
+    AveragingState device_state;
+    device_state.deviceAddress = device_address;
+    device_state.deviceType    = device_type;
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        device_state.timers.push_back(initializeTimer(device_type, i));
     }
     states.push_back(device_state);
-    return (int)states.size() - 1;
+    const int index = (int)states.size() - 1;
+    stateTable.insert(device_address, index);
+    return index;
 }
 
 
 /**
  * Find block of state keeping variables for averaging measurement value of the given device.
- * @param serial_number The serial number of the device.
+ * @param device_address The address of the device.
  * @return Index of the variable block in vector states, or -1 if there is none.
  */
-int AveragingProcessor::findStateIndex(const uint32_t serial_number) {
-    for (int i = 0; i < states.size(); i++) {
-        if (states[i].serialNumber == serial_number) {
-            return i;
-        }
-    }
-    return -1;
+int AveragingProcessor::findStateIndex(const SpeedwireAddress& device_address) const {
+    return stateTable.find(device_address);
 }
 
 
 /**
  * Add an obis consumer to receive the result of the AveragingProcessor.
  * @param obis_consumer Reference to the ObisConsumer.
+ * @param interval Index of the output interval.
  */
-void AveragingProcessor::addConsumer(ObisConsumer& obis_consumer) {
-    obisConsumerTable.push_back(&obis_consumer);
+void AveragingProcessor::addConsumer(ObisConsumer& obis_consumer, const size_t interval) {
+    if (interval < intervals.size()) {
+        intervals[interval].obisConsumerTable.push_back(&obis_consumer);
+    }
 }
 
 
 /**
  * Add an speedwire consumer to receive the result of the AveragingProcessor.
  * @param speedwire_consumer Reference to the SpeedwireConsumer.
+ * @param interval Index of the output interval.
  */
-void AveragingProcessor::addConsumer(SpeedwireConsumer& speedwire_consumer) {
-    speedwireConsumerTable.push_back(&speedwire_consumer);
+void AveragingProcessor::addConsumer(SpeedwireConsumer& speedwire_consumer, const size_t interval) {
+    if (interval < intervals.size()) {
+        intervals[interval].speedwireConsumerTable.push_back(&speedwire_consumer);
+    }
 }
 
 
 /**
  * Internal implementation for temporal averaging of emeter obis values or inverter values.
- * @param device The originating inverter device.
- * @param device_type The device type.
- * @param type The measurement type.
+ * Updates the averaging timers of all output intervals of the given device.
+ * @param state_index The index of the originating device in vector states.
  * @param measurement The measurement value.
- * @return true if the averaging time perios has elapsed, false otherwise.
  */
-bool AveragingProcessor::process(const SpeedwireDevice& device, const DeviceType& device_type, Measurement& measurement) {
-
-    // find device
-    int index = findStateIndex(device.deviceAddress.serialNumber);
-    if (index < 0) {
-        index = initializeState(device.deviceAddress.serialNumber, device_type);
-    }
-    AveragingState& state = states[index];
+void AveragingProcessor::process(const int state_index, Measurement& measurement) {
+    AveragingState& state = states[state_index];
 
     // get the most recent measurement timestamp
     uint32_t measurementTime = measurement.measurementValues.getNewestElement().time;
 
-    // if no averaging is intended, leave the measurement value as is
-    if (state.averagingTime == 0) {
-        state.averagingTimeReached = true;
-    }
-    // if averaging is intended, run averaging timer state-machine
-    else {
-        // initialize current timestamp
-        if (state.currentTimestampIsValid == false) {
-            state.averagingTimeReached = false;
+    for (auto& timer : state.timers) {
+        // if no averaging is intended, leave the measurement value as is
+        if (timer.averagingTime == 0) {
+            timer.averagingTimeReached = true;
         }
-        // check if this is the first measurement of a new measurement block
-        else if (measurementTime != state.currentTimestamp) {
-            state.remainder += measurementTime - state.currentTimestamp;
-            state.averagingTimeReached = (state.remainder >= state.averagingTime);
-            //printf("averagingTimeReached %d\n", state.averagingTimeReached);
-            if (state.averagingTimeReached == true) {
-                state.remainder %= state.averagingTime;
+        // if averaging is intended, run averaging timer state-machine
+        else {
+            // initialize current timestamp
+            if (timer.currentTimestampIsValid == false) {
+                timer.averagingTimeReached = false;
+            }
+            // check if this is the first measurement of a new measurement block
+            else if (measurementTime != timer.currentTimestamp) {
+                timer.remainder += measurementTime - timer.currentTimestamp;
+                timer.averagingTimeReached = (timer.remainder >= timer.averagingTime);
+                //printf("averagingTimeReached %d\n", timer.averagingTimeReached);
+                if (timer.averagingTimeReached == true) {
+                    timer.remainder %= timer.averagingTime;
+                }
             }
         }
+        timer.currentTimestamp = measurementTime;
+        timer.currentTimestampIsValid = true;
+    }
+}
+
+
+/**
+ * Internal implementation for the aggregation of a channel over the averaging windows of all output intervals.
+ * @param channels The map of channel aggregates.
+ * @param state_index The index of the originating device in vector states.
+ * @param element The received element.
+ * @param outputs Array receiving, for each output interval, a pointer to the element to be passed on to consumers, or NULL if nothing is to be passed on.
+ */
+template<class T> void AveragingProcessor::average(std::map<uint64_t, std::vector<ChannelState<T> > >& channels, const int state_index, T& element, std::vector<T*>& outputs) {
+    const std::vector<AveragingTimer>& timers = states[state_index].timers;
+    outputs.assign(timers.size(), NULL);
+
+    // pass on elements without measurement values
+    if (element.measurementValues.getNumberOfElements() == 0) {
+        for (size_t i = 0; i < timers.size(); ++i) {
+            outputs[i] = (timers[i].averagingTimeReached ? &element : NULL);
+        }
+        return;
+    }
+
+    // find or create channel states
+    const uint64_t key = toChannelKey(state_index, element.toKey());
+    auto it = channels.find(key);
+    if (it == channels.end()) {
+        it = channels.insert(std::make_pair(key, std::vector<ChannelState<T> >())).first;
+    }
+    std::vector<ChannelState<T> >& channel_states = it->second;
+    while (channel_states.size() < timers.size()) {
+        channel_states.push_back(ChannelState<T>());
+        ChannelState<T>& channel = channel_states.back();
+        channel.output = element;
+        channel.output.measurementValues.setMaximumNumberOfElements(1);
+        channel.output.measurementPyramid.clear();
+    }
+
+    // once the averaging time has elapsed, emit and reset the aggregate; the newest measurement value crossing
+    // the window boundary belongs to the next window and is accumulated afterwards
+    const TimestampDoublePair& newest = element.measurementValues.getNewestElement();
+    for (size_t i = 0; i < timers.size(); ++i) {
+        const AveragingTimer& timer = timers[i];
+        // pass on elements if no averaging is intended
+        if (timer.averagingTime == 0) {
+            outputs[i] = &element;
+            continue;
+        }
+        ChannelState<T>& channel = channel_states[i];
+        if (timer.averagingTimeReached == true && channel.current.count > 0) {
+            channel.last = channel.current;
+            channel.last.time = newest.time;
+            channel.current = AggregatedValue();
+            channel.output.measurementValues.addMeasurement(channel.last.getMean(), newest.time);
+            outputs[i] = &channel.output;
+        }
+        channel.current.add(newest.value);
     }
-    state.currentTimestamp = measurementTime;
-    state.currentTimestampIsValid = true;
+}
 
-    return state.averagingTimeReached;
+
+/**
+ * Get the aggregate of the most recently completed averaging window of the given obis channel.
+ * @param device The originating emeter device.
+ * @param element The obis channel.
+ * @param aggregate The aggregate; its time is the end time of the window, i.e. the time of the first measurement after the window.
+ * @param interval Index of the output interval.
+ * @return true if an aggregate is available, false otherwise.
+ */
+bool AveragingProcessor::getLastAggregate(const SpeedwireDevice& device, const ObisData& element, AggregatedValue& aggregate, const size_t interval) const {
+    const int index = findStateIndex(device.deviceAddress);
+    if (index < 0) {
+        return false;
+    }
+    const auto& it = obisChannels.find(toChannelKey(index, element.toKey()));
+    if (it != obisChannels.end() && interval < it->second.size() && it->second[interval].last.count > 0) {
+        aggregate = it->second[interval].last;
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * Get the aggregate of the most recently completed averaging window of the given inverter channel.
+ * @param device The originating inverter device.
+ * @param element The inverter channel.
+ * @param aggregate The aggregate; its time is the end time of the window, i.e. the time of the first measurement after the window.
+ * @param interval Index of the output interval.
+ * @return true if an aggregate is available, false otherwise.
+ */
+bool AveragingProcessor::getLastAggregate(const SpeedwireDevice& device, const SpeedwireData& element, AggregatedValue& aggregate, const size_t interval) const {
+    const int index = findStateIndex(device.deviceAddress);
+    if (index < 0) {
+        return false;
+    }
+    const auto& it = speedwireChannels.find(toChannelKey(index, element.toKey()));
+    if (it != speedwireChannels.end() && interval < it->second.size() && it->second[interval].last.count > 0) {
+        aggregate = it->second[interval].last;
+        return true;
+    }
+    return false;
 }
 
 
@@ -133,9 +266,18 @@ bool AveragingProcessor::process(const SpeedwireDevice& device, const DeviceType
  */
 void AveragingProcessor::consume(const SpeedwireDevice& device, ObisData &element) {
     //element.print(stdout);
-    if (process(device, DeviceType::EMETER, element) == true) {
-        for (int i = 0; i < obisConsumerTable.size(); ++i) {
-            obisConsumerTable[i]->consume(device, element);
+    int index = findStateIndex(device.deviceAddress);
+    if (index < 0) {
+        index = initializeState(device.deviceAddress, DeviceType::EMETER);
+    }
+    process(index, element);
+    average(obisChannels, index, element, obisOutputs);
+    for (size_t i = 0; i < obisOutputs.size(); ++i) {
+        if (obisOutputs[i] != NULL) {
+            const std::vector<ObisConsumer*>& obisConsumerTable = intervals[i].obisConsumerTable;
+            for (size_t j = 0; j < obisConsumerTable.size(); ++j) {
+                obisConsumerTable[j]->consume(device, *obisOutputs[i]);
+            }
         }
     }
 }
@@ -148,9 +290,18 @@ void AveragingProcessor::consume(const SpeedwireDevice& device, ObisData &elemen
  */
 void AveragingProcessor::consume(const SpeedwireDevice& device, SpeedwireData& element) {
     //element.print(stdout); fprintf(stdout, "speedwire_currentTimestamp %ld\n", speedwire_currentTimestamp);
-    if (process(device, DeviceType::INVERTER, element) == true) {
-        for (int i = 0; i < speedwireConsumerTable.size(); ++i) {
-            speedwireConsumerTable[i]->consume(device, element);
+    int index = findStateIndex(device.deviceAddress);
+    if (index < 0) {
+        index = initializeState(device.deviceAddress, DeviceType::INVERTER);
+    }
+    process(index, element);
+    average(speedwireChannels, index, element, speedwireOutputs);
+    for (size_t i = 0; i < speedwireOutputs.size(); ++i) {
+        if (speedwireOutputs[i] != NULL) {
+            const std::vector<SpeedwireConsumer*>& speedwireConsumerTable = intervals[i].speedwireConsumerTable;
+            for (size_t j = 0; j < speedwireConsumerTable.size(); ++j) {
+                speedwireConsumerTable[j]->consume(device, *speedwireOutputs[i]);
+            }
         }
     }
 }
@@ -163,10 +314,16 @@ void AveragingProcessor::consume(const SpeedwireDevice& device, SpeedwireData& e
  */
 void AveragingProcessor::endOfObisData(const SpeedwireDevice& device, const uint32_t time) {
     // if averaging time has been reached, signal end of obis data
-    int index = findStateIndex(device.deviceAddress.serialNumber);
-    if (index >= 0 && states[index].averagingTimeReached == true) {
-        for (int i = 0; i < obisConsumerTable.size(); ++i) {
-            obisConsumerTable[i]->endOfObisData(device, time);
+    const int index = findStateIndex(device.deviceAddress);
+    if (index >= 0) {
+        const std::vector<AveragingTimer>& timers = states[index].timers;
+        for (size_t i = 0; i < timers.size(); ++i) {
+            if (timers[i].averagingTimeReached == true) {
+                const std::vector<ObisConsumer*>& obisConsumerTable = intervals[i].obisConsumerTable;
+                for (size_t j = 0; j < obisConsumerTable.size(); ++j) {
+                    obisConsumerTable[j]->endOfObisData(device, time);
+                }
+            }
         }
     }
 }
@@ -179,10 +336,16 @@ void AveragingProcessor::endOfObisData(const SpeedwireDevice& device, const uint
  */
 void AveragingProcessor::endOfSpeedwireData(const SpeedwireDevice& device, const uint32_t time) {
     // if averaging time has been reached, signal end of obis data
-    int index = findStateIndex(device.deviceAddress.serialNumber);
-    if (index >= 0 && states[index].averagingTimeReached == true) {
-        for (int i = 0; i < speedwireConsumerTable.size(); ++i) {
-            speedwireConsumerTable[i]->endOfSpeedwireData(device, time);
+    const int index = findStateIndex(device.deviceAddress);
+    if (index >= 0) {
+        const std::vector<AveragingTimer>& timers = states[index].timers;
+        for (size_t i = 0; i < timers.size(); ++i) {
+            if (timers[i].averagingTimeReached == true) {
+                const std::vector<SpeedwireConsumer*>& speedwireConsumerTable = intervals[i].speedwireConsumerTable;
+                for (size_t j = 0; j < speedwireConsumerTable.size(); ++j) {
+                    speedwireConsumerTable[j]->endOfSpeedwireData(device, time);
+                }
+            }
         }
     }
 }
@@ -5,18 +5,205 @@
 using namespace libspeedwire;
 
 
-// Calculate difference between all positive and negative measurement values and store it in diff values
+// Subtract negative from positive measurement values of contiguous arrays and store the result in diff; pairs with
+// different timestamps are skipped. The differences are calculated in a dense loop without data-dependent stores, such that
+// the compiler can vectorize it; pairs with different timestamps are only removed in a second pass, if there are any.
+static size_t subtractValues(const TimestampDoublePair* const pos, const TimestampDoublePair* const neg, const size_t n, TimestampDoublePair* const diff) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < n; ++i) {
+        diff[i].value = pos[i].value - neg[i].value;
+        diff[i].time  = pos[i].time;
+        mismatches += (pos[i].time != neg[i].time ? 1 : 0);
+    }
+    if (mismatches == 0) {
+        return n;
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (pos[i].time == neg[i].time) {
+            diff[k++] = diff[i];
+        }
+    }
+    return k;
+}
+
+
+// Calculate difference between positive and negative measurement values and append it to diff values. If the diff values
+// are in sync with the positive values, i.e. their newest timestamp is found there, only newer pairs are appended.
+// Otherwise all diff values are recalculated. Pairs are aligned at the newest measurement of each ring buffer.
 static void calculateValueDiffs(Measurement& diff, const Measurement& pos, const Measurement& neg) {
     const MeasurementValues& pos_values = pos.measurementValues;
     const MeasurementValues& neg_values = neg.measurementValues;
     MeasurementValues& diff_values = diff.measurementValues;
-    diff_values.clear();
-    for (size_t i = 0; i < pos_values.getNumberOfElements(); ++i) {
-        if (pos_values[i].time == neg_values[i].time) {
-            double signed_value = pos_values[i].value - neg_values[i].value;
-            diff_values.addMeasurement(signed_value, pos_values[i].time);
+    const size_t pos_n = pos_values.getNumberOfElements();
+    const size_t neg_n = neg_values.getNumberOfElements();
+    const size_t n = (pos_n < neg_n ? pos_n : neg_n);
+
+    // find the first pair that is not yet contained in diff values
+    size_t from = 0;
+    if (diff_values.getNumberOfElements() > 0) {
+        const uint32_t last_time = diff_values.getNewestElement().time;
+        const size_t last_index = pos_values.findLowerIndex(last_time);
+        if (last_index != (size_t)-1 && pos_values.at(last_index).time == last_time && last_index + 1 + n >= pos_n) {
+            from = last_index + 1 + n - pos_n;
+        }
+        else {
+            diff_values.clear();
+        }
+    }
+    if (from >= n) {
+        return;
+    }
+
+    // get contiguous spans of both arrays and subtract them chunk by chunk
+    MeasurementValues::Span pos_spans[2], neg_spans[2];
+    pos_values.getSpans(pos_n - n + from, pos_n - 1, pos_spans[0], pos_spans[1]);
+    neg_values.getSpans(neg_n - n + from, neg_n - 1, neg_spans[0], neg_spans[1]);
+    const TimestampDoublePair* p = pos_spans[0].data;
+    const TimestampDoublePair* q = neg_spans[0].data;
+    size_t p_left = pos_spans[0].size;
+    size_t q_left = neg_spans[0].size;
+    TimestampDoublePair buffer[64];
+    for (size_t remaining = n - from; remaining > 0; ) {
+        size_t m = (p_left < q_left ? p_left : q_left);
+        if (m > sizeof(buffer) / sizeof(buffer[0])) m = sizeof(buffer) / sizeof(buffer[0]);
+        diff_values.addMeasurements(buffer, subtractValues(p, q, m, buffer));
+        p += m; p_left -= m;
+        q += m; q_left -= m;
+        if (p_left == 0) { p = pos_spans[1].data; p_left = pos_spans[1].size; }
+        if (q_left == 0) { q = neg_spans[1].data; q_left = neg_spans[1].size; }
+        remaining -= m;
+    }
+}
+
+
+// Formula for signed power: the difference between positive and negative power
+static bool calculateSignedPower(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t time) {
+    calculateValueDiffs(*node.output, node.input(0), node.input(1));
+    node.result = TimestampDoublePair(node.output->measurementValues.estimateMean(), time);
+    return true;
+}
+
+
+// Formula for total power: the sum of all input powers, if their timestamps are at most 1 second apart
+static bool calculateTotalPower(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    const uint32_t value1_time = node.input(0).measurementValues.getNewestElement().time;
+    double total = 0.0;
+    for (size_t i = 0; i < node.inputs.size(); ++i) {
+        const MeasurementValues& values = node.input(i).measurementValues;
+        if (SpeedwireTime::calculateAbsTimeDifference(value1_time, values.getNewestElement().time) > 1) {
+            return false;
+        }
+        total += values.estimateMean();
+    }
+    node.setResult(total, value1_time);
+    return true;
+}
+
+
+// Formula for the total power loss: dc power - ac power, if their timestamps are at most 2 seconds apart
+static bool calculatePowerLoss(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    const TimestampDoublePair& dc = node.input(0).measurementValues.getNewestElement();
+    const TimestampDoublePair& ac = node.input(1).measurementValues.getNewestElement();
+    if (SpeedwireTime::calculateAbsTimeDifference(dc.time, ac.time) > 2) {
+        return false;
+    }
+    node.setResult(dc.value - ac.value, ac.time);
+    return true;
+}
+
+
+// Formula for the total power efficiency: ac power / dc power, if their timestamps are at most 2 seconds apart
+static bool calculatePowerEfficiency(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    const TimestampDoublePair& dc = node.input(0).measurementValues.getNewestElement();
+    const TimestampDoublePair& ac = node.input(1).measurementValues.getNewestElement();
+    if (SpeedwireTime::calculateAbsTimeDifference(dc.time, ac.time) > 2) {
+        return false;
+    }
+    node.setResult((dc.value > 0 ? (ac.value / dc.value) * 100.0 : 0.0), ac.time);
+    return true;
+}
+
+
+// Formula for the total power consumption of the house from emeter power, inverter ac power and battery inverter ac power
+static bool calculateHouseholdPower(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    static const uint32_t max_age = 120;       // maximum age of data in seconds
+    const MeasurementValues& pos = node.input(0).measurementValues;
+    const MeasurementValues& neg = node.input(1).measurementValues;
+
+    // get current time to check the age of data
+    uint64_t current_time = LocalHost::getUnixEpochTimeInMs();
+    uint32_t inverter_time = (uint32_t)(current_time / 1000);   // inverter timestamps are in seconds
+    uint32_t emeter_time = (uint32_t)current_time;            // emeter timestamps are in milliseconds
+
+    uint32_t feed_in_time = neg.getNewestElement().time;
+    uint32_t grid_age = SpeedwireTime::calculateAbsTimeDifference(emeter_time, feed_in_time);
+    if (grid_age >= max_age * 1000) {
+        return false;
+    }
+    double neg_average_value = neg.estimateMean();
+
+    // inverter ac power is only considered, if it has been calculated from the same inverter packet
+    double ac_total = 0.0;
+    uint32_t ac_time = 0;
+    uint32_t ac_age = max_age;
+    if (node.hasInput(2) && node.inputs[2].changed) {
+        const TimestampDoublePair& ac = node.input(2).measurementValues.getNewestElement();
+        ac_total = ac.value;
+        ac_time = ac.time;
+        ac_age = (uint32_t)SpeedwireTime::calculateAbsTimeDifference(inverter_time, ac_time);
+    }
+
+    // calculate total power consumption of the house: positive power from grid + inverter power - negative power to grid
+    double household;
+    if (ac_total == 0.0) {
+        household = pos.estimateMean() - neg_average_value;
+    }
+    else {
+        uint32_t ac_time_emeter = SpeedwireTime::convertInverterToEmeterTime(ac_time, current_time);
+        household = pos.interpolateClosestValues(ac_time_emeter) + ac_total - neg.interpolateClosestValues(ac_time_emeter);
+        if (household < 0.0) household = 0.0;  // this can happen if there is a steep change in solar production or energy consumption and measurements are taken at different points in time
+    }
+    // consider battery inverter power: household power + battery inverter power
+    if (node.hasInput(3)) {
+        const MeasurementValues& battery = node.input(3).measurementValues;
+        uint32_t value1_time = battery.getNewestElement().time;
+        uint32_t bat_ac_age = (uint32_t)SpeedwireTime::calculateAbsTimeDifference(inverter_time, value1_time);
+        if (value1_time != 0 && SpeedwireTime::calculateAbsTimeDifference(bat_ac_age, ac_age) <= 10) {
+            household += battery.interpolateClosestValues(ac_time);
+            if (household < 0.0) household = 0.0;  // this can happen if there is a steep change in solar production or energy consumption and measurements are taken at different points in time
         }
     }
+    node.setResult(household, feed_in_time);
+    return true;
+}
+
+
+// Formula for the monetary income from grid feed-in
+static bool calculateIncomeFeedIn(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    const uint32_t feed_in_time = node.input(0).measurementValues.getNewestElement().time;
+    double feed_in = node.input(1).measurementValues.estimateMean() * (0.09 / 1000.0);   // assuming  9 cents per kWh
+    node.setResult(feed_in, feed_in_time);
+    return true;
+}
+
+
+// Formula for the monetary savings from self-consumption
+static bool calculateIncomeSelfConsumption(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    const uint32_t feed_in_time = node.input(0).measurementValues.getNewestElement().time;
+    const double ac_total = (node.hasInput(2) && node.inputs[2].changed ? node.input(2).measurementValues.getNewestElement().value : 0.0);
+    double self_consumption = (ac_total - node.input(1).measurementValues.estimateMean()) * (0.30 / 1000);  // assuming 30 cents per kWh
+    node.setResult(self_consumption, feed_in_time);
+    return true;
+}
+
+
+// Formula for the total monetary income: income from grid feed-in + savings from self-consumption
+static bool calculateIncomeTotal(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    const TimestampDoublePair& feed_in = node.input(0).measurementValues.getNewestElement();
+    const TimestampDoublePair& self_consumption = node.input(1).measurementValues.getNewestElement();
+    node.setResult(feed_in.value + self_consumption.value, feed_in.time);
+    return true;
 }
 
 
@@ -29,7 +216,46 @@ static void calculateValueDiffs(Measurement& diff, const Measurement& pos, const
 CalculatedValueProcessor::CalculatedValueProcessor(ObisDataMap& obis_map, SpeedwireDataMap& speedwire_map, Producer& _producer) :
     obis_data_map(obis_map),
     speedwire_data_map(speedwire_map),
-    producer(_producer) {
+    producer(_producer),
+    graph(obis_map, speedwire_map),
+    series(),
+    frame(),
+    signed_power_total_node(0) {
+    typedef DerivedValueRef Ref;
+
+    // signed power L1, L2, L3 and total; these are written into the obis data map
+    graph.add(ObisData::SignedActivePowerL1, OBIS_DATA, { Ref::obis(ObisData::PositiveActivePowerL1), Ref::obis(ObisData::NegativeActivePowerL1) }, calculateSignedPower).mapped = true;
+    graph.add(ObisData::SignedActivePowerL2, OBIS_DATA, { Ref::obis(ObisData::PositiveActivePowerL2), Ref::obis(ObisData::NegativeActivePowerL2) }, calculateSignedPower).mapped = true;
+    graph.add(ObisData::SignedActivePowerL3, OBIS_DATA, { Ref::obis(ObisData::PositiveActivePowerL3), Ref::obis(ObisData::NegativeActivePowerL3) }, calculateSignedPower).mapped = true;
+    graph.add(ObisData::SignedActivePowerTotal, OBIS_DATA, { Ref::obis(ObisData::PositiveActivePowerTotal), Ref::obis(ObisData::NegativeActivePowerTotal) }, calculateSignedPower).mapped = true;
+    signed_power_total_node = graph.size() - 1;
+
+    // total battery inverter ac power
+    graph.add(SpeedwireData::BatteryPowerACTotal, BATTERY_INVERTER_DATA,
+              { Ref::speedwire(SpeedwireData::BatteryPowerL1), Ref::speedwire(SpeedwireData::BatteryPowerL2), Ref::speedwire(SpeedwireData::BatteryPowerL3) }, calculateTotalPower);
+
+    // total dc power, total pv inverter ac power, power loss and efficiency
+    graph.add(SpeedwireData::InverterPowerDCTotal, INVERTER_DATA,
+              { Ref::speedwire(SpeedwireData::InverterPowerMPP1), Ref::speedwire(SpeedwireData::InverterPowerMPP2) }, calculateTotalPower);
+    graph.add(SpeedwireData::InverterPowerACTotal, INVERTER_DATA,
+              { Ref::speedwire(SpeedwireData::InverterPowerL1), Ref::speedwire(SpeedwireData::InverterPowerL2), Ref::speedwire(SpeedwireData::InverterPowerL3) }, calculateTotalPower);
+    graph.add(SpeedwireData::InverterPowerLoss, INVERTER_DATA,
+              { Ref::derived(SpeedwireData::InverterPowerDCTotal), Ref::derived(SpeedwireData::InverterPowerACTotal) }, calculatePowerLoss);
+    graph.add(SpeedwireData::InverterPowerEfficiency, INVERTER_DATA,
+              { Ref::derived(SpeedwireData::InverterPowerDCTotal), Ref::derived(SpeedwireData::InverterPowerACTotal) }, calculatePowerEfficiency);
+
+    // household power consumption and income; these are produced for a virtual household device
+    const uint32_t household_serial = 0xcafebabe;
+    graph.add(SpeedwireData::HouseholdPowerTotal, INVERTER_DATA,
+              { Ref::obis(ObisData::PositiveActivePowerTotal), Ref::obis(ObisData::NegativeActivePowerTotal),
+                Ref::derived(SpeedwireData::InverterPowerACTotal, true), Ref::derived(SpeedwireData::BatteryPowerACTotal, true) }, calculateHouseholdPower).serialNumber = household_serial;
+    graph.add(SpeedwireData::HouseholdIncomeFeedIn, INVERTER_DATA,
+              { Ref::derived(SpeedwireData::HouseholdPowerTotal), Ref::obis(ObisData::NegativeActivePowerTotal) }, calculateIncomeFeedIn).serialNumber = household_serial;
+    graph.add(SpeedwireData::HouseholdIncomeSelfConsumption, INVERTER_DATA,
+              { Ref::derived(SpeedwireData::HouseholdPowerTotal), Ref::obis(ObisData::NegativeActivePowerTotal),
+                Ref::derived(SpeedwireData::InverterPowerACTotal, true) }, calculateIncomeSelfConsumption).serialNumber = household_serial;
+    graph.add(SpeedwireData::HouseholdIncomeTotal, INVERTER_DATA,
+              { Ref::derived(SpeedwireData::HouseholdIncomeFeedIn), Ref::derived(SpeedwireData::HouseholdIncomeSelfConsumption) }, calculateIncomeTotal).serialNumber = household_serial;
 }
 
 
@@ -45,7 +271,7 @@ CalculatedValueProcessor::~CalculatedValueProcessor(void) { }
  * @param element A reference to a received ObisData instance, holding output data of the ObisFilter.
  */
 void CalculatedValueProcessor::consume(const SpeedwireDevice& device, ObisData& element) {
-    producer.produce(device, element.measurementType, element.wire, element.measurementValues.estimateMean(), element.measurementValues.getNewestElement().time);
+    frame.add(series.getSeriesId(device, *element.descriptor), element.measurementValues.estimateMean(), element.measurementValues.getNewestElement().time);
 }
 
 
@@ -55,7 +281,7 @@ void CalculatedValueProcessor::consume(const SpeedwireDevice& device, ObisData&
  * @param element A reference to a received SpeedwireData instance.
  */
 void CalculatedValueProcessor::consume(const SpeedwireDevice& device, SpeedwireData& element) {
-    producer.produce(device, element.measurementType, element.wire, element.measurementValues.estimateMean(), element.measurementValues.getNewestElement().time);
+    frame.add(series.getSeriesId(device, *element.descriptor), element.measurementValues.estimateMean(), element.measurementValues.getNewestElement().time);
 }
 
 
@@ -65,116 +291,95 @@ void CalculatedValueProcessor::consume(const SpeedwireDevice& device, SpeedwireD
  * @param timestamp The timestamp associated with the just finished emeter packet.
  */
 void CalculatedValueProcessor::endOfObisData(const SpeedwireDevice& device, const uint32_t timestamp) {
-    ObisDataMap::const_iterator pos, neg, end = obis_data_map.end();
-    ObisDataMap::iterator sig;
-
-    // calculate signed power L1
-    if ((pos = obis_data_map.find(ObisData::PositiveActivePowerL1.toKey())) != end &&
-        (neg = obis_data_map.find(ObisData::NegativeActivePowerL1.toKey())) != end &&
-        (sig = obis_data_map.find(ObisData::SignedActivePowerL1.toKey())) != end) {
-        calculateValueDiffs(sig->second, pos->second, neg->second);
-        producer.produce(device, ObisData::SignedActivePowerL1.measurementType, ObisData::SignedActivePowerL1.wire, sig->second.measurementValues.estimateMean(), timestamp);
-    }
-
-    // calculate signed power L2
-    if ((pos = obis_data_map.find(ObisData::PositiveActivePowerL2.toKey())) != end &&
-        (neg = obis_data_map.find(ObisData::NegativeActivePowerL2.toKey())) != end &&
-        (sig = obis_data_map.find(ObisData::SignedActivePowerL2.toKey())) != end) {
-        calculateValueDiffs(sig->second, pos->second, neg->second);
-        producer.produce(device, ObisData::SignedActivePowerL2.measurementType, ObisData::SignedActivePowerL2.wire, sig->second.measurementValues.estimateMean(), timestamp);
-    }
+    graph.evaluate(device, OBIS_DATA, timestamp, frame, series);
 
-    // calculate signed power L3
-    if ((pos = obis_data_map.find(ObisData::PositiveActivePowerL3.toKey())) != end &&
-        (neg = obis_data_map.find(ObisData::NegativeActivePowerL3.toKey())) != end &&
-        (sig = obis_data_map.find(ObisData::SignedActivePowerL3.toKey())) != end) {
-        calculateValueDiffs(sig->second, pos->second, neg->second);
-        producer.produce(device, ObisData::SignedActivePowerL3.measurementType, ObisData::SignedActivePowerL3.wire, sig->second.measurementValues.estimateMean(), timestamp);
+    // feed time-accurate signed total power measurements
+    if (graph.getNode(signed_power_total_node).updated == true) {
+        produceTimeAccuratePower(*graph.getNode(signed_power_total_node).output);
     }
+    produceFrame();
+}
 
-    // calculate signed total power
-    if ((pos = obis_data_map.find(ObisData::PositiveActivePowerTotal.toKey())) != end &&
-        (neg = obis_data_map.find(ObisData::NegativeActivePowerTotal.toKey())) != end &&
-        (sig = obis_data_map.find(ObisData::SignedActivePowerTotal.toKey())) != end) {
-        calculateValueDiffs(sig->second, pos->second, neg->second);
-        producer.produce(device, ObisData::SignedActivePowerTotal.measurementType, ObisData::SignedActivePowerTotal.wire, sig->second.measurementValues.estimateMean(), timestamp);
 
+/**
+ * Experimental setup to feed time-accurate power measurements, derived from piecewise constant intervals of the given power measurements.
+ * @param signed_power The signed total power.
+ */
+void CalculatedValueProcessor::produceTimeAccuratePower(const Measurement& signed_power) {
 #if 1
-        // experimental setup to feed time-accurate power measurements
-        static uint32_t last_time = 0;
-        SpeedwireDevice experimental_device;
-        experimental_device.deviceAddress.serialNumber = 1234567890;
-        const MeasurementValues& mvalues = sig->second.measurementValues;
-        std::vector<MeasurementValueInterval> intervals;
-        LineSegmentEstimator::findPiecewiseConstantIntervals(mvalues, intervals);
-        for (auto& iv : intervals) {
-            if (SpeedwireTime::calculateTimeDifference(mvalues[iv.end_index].time, last_time) <= 0) {
+    // experimental setup to feed time-accurate power measurements
+    static uint32_t last_time = 0;
+    SpeedwireDevice experimental_device;
+    experimental_device.deviceAddress.serialNumber = 1234567890;
+    const uint32_t experimental_series = series.getSeriesId(experimental_device, *ObisData::SignedActivePowerTotal.descriptor);
+    const MeasurementValues& mvalues = signed_power.measurementValues;
+    std::vector<MeasurementValueInterval> intervals;
+    LineSegmentEstimator::findPiecewiseConstantIntervals(mvalues, intervals);
+    for (auto& iv : intervals) {
+        if (SpeedwireTime::calculateTimeDifference(mvalues[iv.end_index].time, last_time) <= 0) {
 #ifdef _DEBUG
-                printf("interval %d %d - %lu %lu : %lf  => skipped\n", (int)iv.start_index, (int)iv.end_index, mvalues[iv.start_index].time, mvalues[iv.end_index].time, iv.mean_value);
+            printf("interval %d %d - %lu %lu : %lf  => skipped\n", (int)iv.start_index, (int)iv.end_index, mvalues[iv.start_index].time, mvalues[iv.end_index].time, iv.mean_value);
 #endif
-                continue;
-            }
-            while (SpeedwireTime::calculateTimeDifference(mvalues[iv.start_index].time, last_time) <= 0 && iv.start_index < (mvalues.getNumberOfElements() - 1)) {
+            continue;
+        }
+        while (SpeedwireTime::calculateTimeDifference(mvalues[iv.start_index].time, last_time) <= 0 && iv.start_index < (mvalues.getNumberOfElements() - 1)) {
 #ifdef _DEBUG
-                printf("interval %d %d - %lu %lu : %lf  => incremented start index\n", (int)iv.start_index, (int)iv.end_index, mvalues[iv.start_index].time, mvalues[iv.end_index].time, iv.mean_value);
+            printf("interval %d %d - %lu %lu : %lf  => incremented start index\n", (int)iv.start_index, (int)iv.end_index, mvalues[iv.start_index].time, mvalues[iv.end_index].time, iv.mean_value);
 #endif
-                iv.start_index++;
-            }
+            iv.start_index++;
+        }
 #ifdef _DEBUG
-            printf("interval %d %d - %lu %lu : %lf\n", (int)iv.start_index, (int)iv.end_index, mvalues[iv.start_index].time, mvalues[iv.end_index].time, iv.mean_value);
+        printf("interval %d %d - %lu %lu : %lf\n", (int)iv.start_index, (int)iv.end_index, mvalues[iv.start_index].time, mvalues[iv.end_index].time, iv.mean_value);
 #endif
-            producer.produce(experimental_device, ObisData::SignedActivePowerTotal.measurementType, ObisData::SignedActivePowerTotal.wire, iv.mean_value, mvalues[iv.start_index].time);
-            producer.produce(experimental_device, ObisData::SignedActivePowerTotal.measurementType, ObisData::SignedActivePowerTotal.wire, iv.mean_value, mvalues[iv.end_index].time);
-        }
-        last_time = mvalues[intervals[intervals.size() - 1].end_index].time;
+        frame.add(experimental_series, iv.mean_value, mvalues[iv.start_index].time);
+        frame.add(experimental_series, iv.mean_value, mvalues[iv.end_index].time);
+    }
+    last_time = mvalues[intervals[intervals.size() - 1].end_index].time;
 #else
-        static MeasurementValues experimentalValues(1024);
+    static MeasurementValues experimentalValues(1024);
 
-        // experimental setup to feed time-accurate power measurements
-        for (size_t i = 0; i < sig->second.measurementValues.getNumberOfElements(); ++i) {
-            const TimestampDoublePair& pair = sig->second.measurementValues.at(i);
-            experimentalValues.addMeasurement(pair.value, pair.time);
-        }
-        static uint32_t last_time = 0;
-        SpeedwireDevice experimental_device;
-        experimental_device.serialNumber = 1234567890;
-        std::vector<MeasurementValueInterval> intervals;
-        if (LineSegmentEstimator::findPiecewiseConstantIntervals(experimentalValues, intervals) > 0) {
-            intervals.erase(intervals.end() - 1);
-            for (auto& iv : intervals) {
-                if (SpeedwireTime::calculateTimeDifference(experimentalValues[iv.end_index].time, last_time) <= 0) {
+    // experimental setup to feed time-accurate power measurements
+    for (size_t i = 0; i < signed_power.measurementValues.getNumberOfElements(); ++i) {
+        const TimestampDoublePair& pair = signed_power.measurementValues.at(i);
+        experimentalValues.addMeasurement(pair.value, pair.time);
+    }
+    static uint32_t last_time = 0;
+    SpeedwireDevice experimental_device;
+    experimental_device.serialNumber = 1234567890;
+    std::vector<MeasurementValueInterval> intervals;
+    if (LineSegmentEstimator::findPiecewiseConstantIntervals(experimentalValues, intervals) > 0) {
+        intervals.erase(intervals.end() - 1);
+        for (auto& iv : intervals) {
+            if (SpeedwireTime::calculateTimeDifference(experimentalValues[iv.end_index].time, last_time) <= 0) {
 #ifdef _DEBUG
-                    printf("interval %d %d - %lu %lu : %lf  => skipped\n", (int)iv.start_index, (int)iv.end_index, experimentalValues[iv.start_index].time, experimentalValues[iv.end_index].time, iv.mean_value);
+                printf("interval %d %d - %lu %lu : %lf  => skipped\n", (int)iv.start_index, (int)iv.end_index, experimentalValues[iv.start_index].time, experimentalValues[iv.end_index].time, iv.mean_value);
 #endif
-                    continue;
-                }
-                while (SpeedwireTime::calculateTimeDifference(experimentalValues[iv.start_index].time, last_time) <= 0 && iv.start_index < (experimentalValues.getNumberOfElements() - 1)) {
+                continue;
+            }
+            while (SpeedwireTime::calculateTimeDifference(experimentalValues[iv.start_index].time, last_time) <= 0 && iv.start_index < (experimentalValues.getNumberOfElements() - 1)) {
 #ifdef _DEBUG
-                    printf("interval %d %d - %lu %lu : %lf  => incremented start index\n", (int)iv.start_index, (int)iv.end_index, experimentalValues[iv.start_index].time, experimentalValues[iv.end_index].time, iv.mean_value);
+                printf("interval %d %d - %lu %lu : %lf  => incremented start index\n", (int)iv.start_index, (int)iv.end_index, experimentalValues[iv.start_index].time, experimentalValues[iv.end_index].time, iv.mean_value);
 #endif
-                    iv.start_index++;
-                }
+                iv.start_index++;
+            }
 #ifdef _DEBUG
-                printf("interval %d %d - %lu %lu : %lf\n", (int)iv.start_index, (int)iv.end_index, experimentalValues[iv.start_index].time, experimentalValues[iv.end_index].time, iv.mean_value);
+            printf("interval %d %d - %lu %lu : %lf\n", (int)iv.start_index, (int)iv.end_index, experimentalValues[iv.start_index].time, experimentalValues[iv.end_index].time, iv.mean_value);
 #endif
-                producer.produce(experimental_device, ObisData::SignedActivePowerTotal.measurementType, ObisData::SignedActivePowerTotal.wire, iv.mean_value, experimentalValues[iv.start_index].time);
-                producer.produce(experimental_device, ObisData::SignedActivePowerTotal.measurementType, ObisData::SignedActivePowerTotal.wire, iv.mean_value, experimentalValues[iv.end_index].time);
-            }
+            producer.produce(experimental_device, ObisData::SignedActivePowerTotal.getMeasurementType(), ObisData::SignedActivePowerTotal.wire, iv.mean_value, experimentalValues[iv.start_index].time);
+            producer.produce(experimental_device, ObisData::SignedActivePowerTotal.getMeasurementType(), ObisData::SignedActivePowerTotal.wire, iv.mean_value, experimentalValues[iv.end_index].time);
         }
+    }
 
-        //std::vector<MeasurementValueInterval> intervals2;
-        //LineSegmentEstimator::findPiecewiseLinearIntervals(experimentalValues, intervals2);
+    //std::vector<MeasurementValueInterval> intervals2;
+    //LineSegmentEstimator::findPiecewiseLinearIntervals(experimentalValues, intervals2);
 
-        // clear all measurements that have been sent to the producer
-        if (intervals.size() > 0) {
-            size_t end_index = intervals[intervals.size() - 1].end_index;
-            last_time = experimentalValues[end_index].time;
-            experimentalValues.removeElements(0, end_index + 1);
-        }
-#endif
+    // clear all measurements that have been sent to the producer
+    if (intervals.size() > 0) {
+        size_t end_index = intervals[intervals.size() - 1].end_index;
+        last_time = experimentalValues[end_index].time;
+        experimentalValues.removeElements(0, end_index + 1);
     }
-
-    producer.flush();
+#endif
 }
 
 
@@ -184,120 +389,23 @@ void CalculatedValueProcessor::endOfObisData(const SpeedwireDevice& device, cons
  * @param timestamp The unix epoch time associated with the just finished inverter packet.
  */
 void CalculatedValueProcessor::endOfSpeedwireData(const SpeedwireDevice& device, const uint32_t timestamp) {
-    SpeedwireDataMap::const_iterator value1, value2, value3, end = speedwire_data_map.end();
-    uint32_t value1_time, value2_time, value3_time;
-    double dc_total = 0.0;
-    double ac_total = 0.0;
-    static const uint32_t max_age = 120;       // maximum age of data in seconds
-    uint32_t dc_age = max_age;
-    uint32_t ac_age = max_age;
-    uint32_t dc_time = 0;
-    uint32_t ac_time = 0;
-
     if (device.deviceClass == "Battery-Inverter") {
-        // calculate total battery inverter ac power
-        if ((value1 = speedwire_data_map.find(SpeedwireData::BatteryPowerL1.toKey())) != end &&
-            (value2 = speedwire_data_map.find(SpeedwireData::BatteryPowerL2.toKey())) != end &&
-            (value3 = speedwire_data_map.find(SpeedwireData::BatteryPowerL3.toKey())) != end &&
-            (value1_time = value1->second.measurementValues.getNewestElement().time,
-                value2_time = value2->second.measurementValues.getNewestElement().time,
-                value3_time = value3->second.measurementValues.getNewestElement().time,
-                SpeedwireTime::calculateAbsTimeDifference(value1_time, value2_time) <= 1 &&
-                SpeedwireTime::calculateAbsTimeDifference(value1_time, value3_time) <= 1)) {
-            ac_total = value1->second.measurementValues.estimateMean() + value2->second.measurementValues.estimateMean() + value3->second.measurementValues.estimateMean();
-            producer.produce(device, SpeedwireData::BatteryPowerACTotal.measurementType, SpeedwireData::BatteryPowerACTotal.wire, ac_total, value1_time);
-        }
+        graph.evaluate(device, BATTERY_INVERTER_DATA, timestamp, frame, series);
     }
     else {
-        // get current time to check the age of data
-        uint64_t current_time = LocalHost::getUnixEpochTimeInMs();
-        uint32_t inverter_time = (uint32_t)(current_time / 1000);   // inverter timestamps are in seconds
-        uint32_t emeter_time = (uint32_t)current_time;            // emeter timestamps are in milliseconds
-
-        // calculate total dc power
-        if ((value1 = speedwire_data_map.find(SpeedwireData::InverterPowerMPP1.toKey())) != end &&
-            (value2 = speedwire_data_map.find(SpeedwireData::InverterPowerMPP2.toKey())) != end &&
-            (value1_time = value1->second.measurementValues.getNewestElement().time,
-                value2_time = value2->second.measurementValues.getNewestElement().time,
-                SpeedwireTime::calculateAbsTimeDifference(value1_time, value2_time) <= 1)) {
-            dc_age = (uint32_t)SpeedwireTime::calculateAbsTimeDifference(inverter_time, value1_time);
-            dc_time = value1_time;
-            //if (dc_age < max_age) {
-            dc_total = value1->second.measurementValues.estimateMean() + value2->second.measurementValues.estimateMean();
-            producer.produce(device, SpeedwireData::InverterPowerDCTotal.measurementType, SpeedwireData::InverterPowerDCTotal.wire, dc_total, value1_time);
-            //}
-        }
+        graph.evaluate(device, INVERTER_DATA, timestamp, frame, series);
+    }
+    produceFrame();
+}
 
-        // calculate total pv inverter ac power
-        if ((value1 = speedwire_data_map.find(SpeedwireData::InverterPowerL1.toKey())) != end &&
-            (value2 = speedwire_data_map.find(SpeedwireData::InverterPowerL2.toKey())) != end &&
-            (value3 = speedwire_data_map.find(SpeedwireData::InverterPowerL3.toKey())) != end &&
-            (value1_time = value1->second.measurementValues.getNewestElement().time,
-                value2_time = value2->second.measurementValues.getNewestElement().time,
-                value3_time = value3->second.measurementValues.getNewestElement().time,
-                SpeedwireTime::calculateAbsTimeDifference(value1_time, value2_time) <= 1 &&
-                SpeedwireTime::calculateAbsTimeDifference(value1_time, value3_time) <= 1)) {
-            ac_age = (uint32_t)SpeedwireTime::calculateAbsTimeDifference(inverter_time, value1_time);
-            ac_time = value1_time;
-            //if (ac_age < max_age) {
-            ac_total = value1->second.measurementValues.estimateMean() + value2->second.measurementValues.estimateMean() + value3->second.measurementValues.estimateMean();
-            producer.produce(device, SpeedwireData::InverterPowerACTotal.measurementType, SpeedwireData::InverterPowerACTotal.wire, ac_total, value1_time);
-            //}
-
-            if (SpeedwireTime::calculateAbsTimeDifference(dc_age, ac_age) <= 2) {
-                // calculate total power loss
-                double loss = dc_total - ac_total;
-                producer.produce(device, SpeedwireData::InverterPowerLoss.measurementType, SpeedwireData::InverterPowerLoss.wire, loss, value1_time);
-
-                // calculate total power efficiency
-                double efficiency = (dc_total > 0 ? (ac_total / dc_total) * 100.0 : 0.0);
-                producer.produce(device, SpeedwireData::InverterPowerEfficiency.measurementType, SpeedwireData::InverterPowerEfficiency.wire, efficiency, value1_time);
-            }
-        }
 
-        ObisDataMap::const_iterator pos, neg;
-        if ((pos = obis_data_map.find(ObisData::PositiveActivePowerTotal.toKey())) != obis_data_map.end() &&
-            (neg = obis_data_map.find(ObisData::NegativeActivePowerTotal.toKey())) != obis_data_map.end()) {
-            uint32_t feed_in_time = neg->second.measurementValues.getNewestElement().time;
-            uint32_t grid_age = SpeedwireTime::calculateAbsTimeDifference(emeter_time, feed_in_time);
-            if (grid_age < max_age * 1000) {
-                double neg_average_value = neg->second.measurementValues.estimateMean();
-
-                // calculate total power consumption of the house: positive power from grid + inverter power - negative power to grid
-                double household;
-                if (ac_total == 0.0) {
-                    household = pos->second.measurementValues.estimateMean() - neg_average_value;
-                }
-                else {
-                    uint32_t ac_time_emeter = SpeedwireTime::convertInverterToEmeterTime(ac_time, current_time);
-                    //household = pos->second.measurementValues.findClosestMeasurement(ac_time_emeter).value + ac_total - neg->second.measurementValues.findClosestMeasurement(ac_time_emeter).value;
-                    household = pos->second.measurementValues.interpolateClosestValues(ac_time_emeter) + ac_total - neg->second.measurementValues.interpolateClosestValues(ac_time_emeter);
-                    if (household < 0.0) household = 0.0;  // this can happen if there is a steep change in solar production or energy consumption and measurements are taken at different points in time
-                }
-                // consider battery inverter power: household power + battery inverter power
-                if ((value1 = speedwire_data_map.find(SpeedwireData::BatteryPowerACTotal.toKey())) != end &&
-                    (value1_time = value1->second.measurementValues.getNewestElement().time)) {
-                    uint32_t bat_ac_age = (uint32_t)SpeedwireTime::calculateAbsTimeDifference(inverter_time, value1_time);
-                    if (SpeedwireTime::calculateAbsTimeDifference(bat_ac_age, ac_age) <= 10) {
-                        household += value1->second.measurementValues.interpolateClosestValues(ac_time);
-                        if (household < 0.0) household = 0.0;  // this can happen if there is a steep change in solar production or energy consumption and measurements are taken at different points in time
-                    }
-                }
-
-                SpeedwireDevice household_device;
-                household_device.deviceAddress.serialNumber = 0xcafebabe;
-
-                producer.produce(household_device, SpeedwireData::HouseholdPowerTotal.measurementType, SpeedwireData::HouseholdPowerTotal.wire, household, feed_in_time);
-
-                // calculate monetary income from grid feed and savings from self-consumption
-                double feed_in = neg_average_value * (0.09 / 1000.0);             // assuming  9 cents per kWh
-                double self_consumption = (ac_total - neg_average_value) * (0.30 / 1000);  // assuming 30 cents per kWh
-                double total = feed_in + self_consumption;
-                producer.produce(household_device, SpeedwireData::HouseholdIncomeFeedIn.measurementType, SpeedwireData::HouseholdIncomeFeedIn.wire, feed_in, feed_in_time);
-                producer.produce(household_device, SpeedwireData::HouseholdIncomeSelfConsumption.measurementType, SpeedwireData::HouseholdIncomeSelfConsumption.wire, self_consumption, feed_in_time);
-                producer.produce(household_device, SpeedwireData::HouseholdIncomeTotal.measurementType, SpeedwireData::HouseholdIncomeTotal.wire, total, feed_in_time);
-            }
-        }
+/**
+ * Pass on all values collected for the current packet to the producer and flush it.
+ */
+void CalculatedValueProcessor::produceFrame(void) {
+    if (frame.size() > 0) {
+        producer.produce(frame, series);
+        frame.clear();
     }
     producer.flush();
 }
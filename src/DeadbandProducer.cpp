@@ -0,0 +1,176 @@
+#include <math.h>
+#include <DeadbandProducer.hpp>
+#include <LocalHost.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of the DeadbandProducer instance.
+ * @param _producer Reference to the producer receiving all values passed on.
+ * @param heartbeat_in_seconds Heartbeat interval; values are passed on at least once per interval, 0 to disable heartbeats.
+ */
+DeadbandProducer::DeadbandProducer(Producer& _producer, const unsigned long heartbeat_in_seconds) :
+    producer(_producer),
+    heartbeat_ms((uint64_t)heartbeat_in_seconds * 1000),
+    numberOfPassedValues(0),
+    numberOfSuppressedValues(0) {
+}
+
+
+/**
+ * Destructor.
+ */
+DeadbandProducer::~DeadbandProducer(void) {}
+
+
+/**
+ * Configure the deadband for all measurement types of the given quantity.
+ * @param quantity The quantity, e.g. Quantity::STATUS.
+ * @param absolute The absolute deadband in units of the measurement; 0 to disable.
+ * @param relative The relative deadband, e.g. 0.01 for 1%; 0 to disable.
+ */
+void DeadbandProducer::setDeadband(const Quantity quantity, const double absolute, const double relative) {
+    Deadband deadband = { absolute, relative };
+    quantityDeadbands[quantity] = deadband;
+}
+
+
+/**
+ * Configure the deadband for the given measurement type; this takes precedence over the configuration of its quantity.
+ * @param type The measurement type, identified by its direction, type and quantity.
+ * @param absolute The absolute deadband in units of the measurement; 0 to disable.
+ * @param relative The relative deadband, e.g. 0.01 for 1%; 0 to disable.
+ */
+void DeadbandProducer::setDeadband(const MeasurementType& type, const double absolute, const double relative) {
+    Deadband deadband = { absolute, relative };
+    typeDeadbands[type.toKey()] = deadband;
+}
+
+
+/**
+ * Configure the heartbeat interval.
+ * @param heartbeat_in_seconds Heartbeat interval; values are passed on at least once per interval, 0 to disable heartbeats.
+ */
+void DeadbandProducer::setHeartbeat(const unsigned long heartbeat_in_seconds) {
+    heartbeat_ms = (uint64_t)heartbeat_in_seconds * 1000;
+}
+
+
+/**
+ * Find the deadband configuration for the given measurement type.
+ * @param type The measurement type.
+ * @return A pointer to the deadband configuration, or NULL if there is none.
+ */
+const DeadbandProducer::Deadband* DeadbandProducer::findDeadband(const MeasurementType& type) const {
+    if (typeDeadbands.size() > 0) {
+        const auto it = typeDeadbands.find(type.toKey());
+        if (it != typeDeadbands.end()) {
+            return &it->second;
+        }
+    }
+    const auto it = quantityDeadbands.find(type.quantity);
+    if (it != quantityDeadbands.end()) {
+        return &it->second;
+    }
+    return NULL;
+}
+
+
+/**
+ * Get the local tick count used for heartbeats.
+ * @return The tick count in ms.
+ */
+uint64_t DeadbandProducer::getTickCountInMs(void) const {
+    return LocalHost::getTickCountInMs();
+}
+
+
+/**
+ * Flush the producer.
+ */
+void DeadbandProducer::flush(void) {
+    producer.flush();
+}
+
+
+/**
+ * Check if the given value is to be passed on, i.e. if it is outside the deadband or if the heartbeat interval has elapsed.
+ * The channel state is updated for values passed on.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @return true if the value is to be passed on, false otherwise
+ */
+bool DeadbandProducer::pass(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value) {
+    const Deadband* const deadband = findDeadband(type);
+    if (deadband == NULL) {
+        ++numberOfPassedValues;
+        return true;
+    }
+
+    const uint64_t tick = getTickCountInMs();
+    const ChannelKey key(device.deviceAddress.toKey(), (type.toKey() << 8) | (uint32_t)wire);
+    auto it = channels.find(key);
+    if (it != channels.end()) {
+        ChannelState& state = it->second;
+        const double deviation = fabs(value - state.value);
+        bool outside;
+        if (deadband->absolute == 0.0 && deadband->relative == 0.0) {
+            outside = (deviation != 0.0);
+        }
+        else {
+            outside = (deadband->absolute > 0.0 && deviation > deadband->absolute) ||
+                      (deadband->relative > 0.0 && deviation > deadband->relative * fabs(state.value));
+        }
+        const bool heartbeat = (heartbeat_ms > 0 && (tick - state.tick) >= heartbeat_ms);
+        if (outside == false && heartbeat == false) {
+            ++numberOfSuppressedValues;
+            return false;
+        }
+        state.value = value;
+        state.tick = tick;
+    }
+    else {
+        ChannelState state = { value, tick };
+        channels[key] = state;
+    }
+    ++numberOfPassedValues;
+    return true;
+}
+
+
+/**
+ * Callback to produce the given data to the next stage in the processing pipeline. The data is only passed on,
+ * if it is outside the deadband or if the heartbeat interval has elapsed.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp in ms since unix epoch start
+ */
+void DeadbandProducer::produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+    if (pass(device, type, wire, value) == true) {
+        producer.produce(device, type, wire, value, time_in_ms);
+    }
+}
+
+
+/**
+ * Callback to produce a frame of data to the next stage in the processing pipeline. Only those values are passed on
+ * as a single frame, that are outside the deadband or where the heartbeat interval has elapsed.
+ * @param frame The frame of data
+ * @param table The table holding the metadata of all series referenced by the frame
+ */
+void DeadbandProducer::produce(const ProducerFrame& frame, const ProducerSeriesTable& table) {
+    filteredFrame.clear();
+    for (const auto& sample : frame.samples) {
+        const ProducerSeries& series = table[sample.series];
+        if (pass(series.device, series.getMeasurementType(), series.getWire(), sample.value) == true) {
+            filteredFrame.samples.push_back(sample);
+        }
+    }
+    if (filteredFrame.size() > 0) {
+        producer.produce(filteredFrame, table);
+    }
+}
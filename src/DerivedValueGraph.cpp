@@ -0,0 +1,233 @@
+#include <DerivedValueGraph.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of a derived value node.
+ * @param definition The measurement definition of the derived value, i.e. its measurement type and wire.
+ * @param k The key of the output measurement.
+ * @param src The source of the output definition.
+ * @param trig The trigger identifier.
+ * @param f The formula calculating the derived value.
+ */
+DerivedValueNode::DerivedValueNode(const Measurement& definition, const uint32_t k, const DerivedValueSource src, const unsigned int trig, const DerivedValueFormula& f) :
+    key(k),
+    source(src),
+    trigger(trig),
+    inputs(),
+    formula(f),
+    value(*definition.descriptor),
+    output(NULL),
+    mapped(false),
+    serialNumber(0),
+    result(),
+    enabled(false),
+    updated(false) {
+    value.measurementValues.setMaximumNumberOfElements(16);
+}
+
+
+/**
+ * Constructor of the DerivedValueGraph instance.
+ * @param obis_map       Reference to the data map, where all received obis values reside.
+ * @param speedwire_map  Reference to the data map, where all received inverter values reside.
+ */
+DerivedValueGraph::DerivedValueGraph(ObisDataMap& obis_map, SpeedwireDataMap& speedwire_map) :
+    obis_data_map(obis_map),
+    speedwire_data_map(speedwire_map),
+    nodes(),
+    resolved(false),
+    obis_map_generation(0),
+    speedwire_map_generation(0),
+    producerSeries(),
+    producerFrame() {
+}
+
+
+/**
+ * Destructor.
+ */
+DerivedValueGraph::~DerivedValueGraph(void) {}
+
+
+/**
+ * Declare a derived value, that is defined as obis data.
+ * @param output The definition of the derived value.
+ * @param trigger The trigger identifier; the node is evaluated by calls to evaluate() for this trigger.
+ * @param inputs The input references; only outputs of previously declared nodes can be referenced.
+ * @param formula The formula calculating the derived value.
+ * @return A reference to the new node; it is valid until the next node is declared.
+ */
+DerivedValueNode& DerivedValueGraph::add(const ObisData& output, const unsigned int trigger, const std::vector<DerivedValueRef>& inputs, const DerivedValueFormula& formula) {
+    return add(DerivedValueNode(output, output.toKey(), DerivedValueSource::OBIS_DATA, trigger, formula), inputs);
+}
+
+
+/**
+ * Declare a derived value, that is defined as speedwire data.
+ * @param output The definition of the derived value.
+ * @param trigger The trigger identifier; the node is evaluated by calls to evaluate() for this trigger.
+ * @param inputs The input references; only outputs of previously declared nodes can be referenced.
+ * @param formula The formula calculating the derived value.
+ * @return A reference to the new node; it is valid until the next node is declared.
+ */
+DerivedValueNode& DerivedValueGraph::add(const SpeedwireData& output, const unsigned int trigger, const std::vector<DerivedValueRef>& inputs, const DerivedValueFormula& formula) {
+    return add(DerivedValueNode(output, output.toKey(), DerivedValueSource::SPEEDWIRE_DATA, trigger, formula), inputs);
+}
+
+
+/**
+ * Internal implementation to add a node together with its input slots.
+ * @param node The node.
+ * @param inputs The input references.
+ * @return A reference to the new node.
+ */
+DerivedValueNode& DerivedValueGraph::add(DerivedValueNode&& node, const std::vector<DerivedValueRef>& inputs) {
+    for (const auto& ref : inputs) {
+        node.inputs.push_back(DerivedValueInput(ref));
+    }
+    nodes.push_back(std::move(node));
+    resolved = false;
+    return nodes.back();
+}
+
+
+/**
+ * Internal implementation to find the measurement referenced by the given source and key.
+ * @param source The source of the measurement.
+ * @param key The key of the measurement.
+ * @param node_index Index of the referencing node; only nodes declared before it are considered.
+ * @return A pointer to the measurement, or NULL if there is no such measurement.
+ */
+Measurement* DerivedValueGraph::find(const DerivedValueSource source, const uint32_t key, const size_t node_index) {
+    switch (source) {
+    case DerivedValueSource::OBIS_DATA: {
+        ObisDataMap::iterator it = obis_data_map.find(key);
+        return (it != obis_data_map.end() ? &it->second : NULL);
+    }
+    case DerivedValueSource::SPEEDWIRE_DATA: {
+        SpeedwireDataMap::iterator it = speedwire_data_map.find(key);
+        return (it != speedwire_data_map.end() ? &it->second : NULL);
+    }
+    case DerivedValueSource::DERIVED_VALUE:
+        for (size_t i = 0; i < node_index; ++i) {
+            if (nodes[i].key == key) {
+                return (nodes[i].enabled ? nodes[i].output : NULL);
+            }
+        }
+        break;
+    }
+    return NULL;
+}
+
+
+/**
+ * Resolve all input and output references of all nodes to direct pointers. A node is disabled, if any of its
+ * required inputs or its mapped output cannot be resolved. This is called implicitly by evaluate().
+ */
+void DerivedValueGraph::resolve(void) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        DerivedValueNode& node = nodes[i];
+        node.output = (node.mapped ? find(node.source, node.key, i) : &node.value);
+        node.enabled = (node.output != NULL);
+        for (auto& input : node.inputs) {
+            const Measurement* const measurement = find(input.ref.source, input.ref.key, i);
+            if (measurement != input.measurement) {
+                input.measurement = measurement;
+                input.times.clear();
+                input.changed = false;
+            }
+            if (measurement == NULL && input.ref.optional == false) {
+                node.enabled = false;
+            }
+        }
+    }
+    obis_map_generation = obis_data_map.getGeneration();
+    speedwire_map_generation = speedwire_data_map.getGeneration();
+    resolved = true;
+}
+
+
+/**
+ * Evaluate all enabled nodes of the given trigger, where at least one input changed since their most recent
+ * evaluation for the given device, and pass their results on to the producer as a single frame.
+ * @param device The originating device.
+ * @param trigger The trigger identifier.
+ * @param time The timestamp associated with the just finished packet.
+ * @param producer The producer to receive the derived values.
+ * @return The number of derived values passed on to the producer.
+ */
+size_t DerivedValueGraph::evaluate(const SpeedwireDevice& device, const unsigned int trigger, const uint32_t time, Producer& producer) {
+    producerFrame.clear();
+    const size_t count = evaluate(device, trigger, time, producerFrame, producerSeries);
+    if (count > 0) {
+        producer.produce(producerFrame, producerSeries);
+    }
+    return count;
+}
+
+
+/**
+ * Evaluate all enabled nodes of the given trigger, where at least one input changed since their most recent
+ * evaluation for the given device, and add their results to the given frame.
+ * @param device The originating device.
+ * @param trigger The trigger identifier.
+ * @param time The timestamp associated with the just finished packet.
+ * @param frame The frame to receive the derived values.
+ * @param table The series table to look up series ids.
+ * @return The number of derived values added to the frame.
+ */
+size_t DerivedValueGraph::evaluate(const SpeedwireDevice& device, const unsigned int trigger, const uint32_t time, ProducerFrame& frame, ProducerSeriesTable& table) {
+    if (resolved == false || obis_map_generation != obis_data_map.getGeneration() || speedwire_map_generation != speedwire_data_map.getGeneration()) {
+        resolve();
+    }
+    size_t count = 0;
+    for (auto& node : nodes) {
+        if (node.trigger != trigger) {
+            continue;
+        }
+        node.updated = false;
+        if (node.enabled == false) {
+            continue;
+        }
+
+        // check if any input has changed since the most recent evaluation for this device; required inputs must hold measurements
+        bool changed = false;
+        bool complete = true;
+        for (auto& input : node.inputs) {
+            input.changed = false;
+            if (input.measurement != NULL && input.measurement->measurementValues.getNumberOfElements() > 0) {
+                input.changed = (input.measurement->measurementValues.getNewestElement().time != input.getTime(device.deviceAddress.serialNumber));
+                changed |= input.changed;
+            }
+            else if (input.ref.optional == false) {
+                complete = false;
+            }
+        }
+        if (changed == false || complete == false) {
+            continue;
+        }
+
+        // evaluate the formula and add the result to the frame
+        if (node.formula(node, device, time) == true) {
+            uint32_t series;
+            if (node.serialNumber != 0) {
+                SpeedwireDevice derived_device;
+                derived_device.deviceAddress.serialNumber = node.serialNumber;
+                series = table.getSeriesId(derived_device, *node.output->descriptor);
+            }
+            else {
+                series = table.getSeriesId(device, *node.output->descriptor);
+            }
+            frame.add(series, node.result.value, node.result.time);
+            node.updated = true;
+            ++count;
+        }
+        for (auto& input : node.inputs) {
+            if (input.changed == true) {
+                input.getTime(device.deviceAddress.serialNumber) = input.measurement->measurementValues.getNewestElement().time;
+            }
+        }
+    }
+    return count;
+}
@@ -3,6 +3,7 @@
 #include <cstring>
 #include <stdio.h>
 #include <chrono>
+#include <mutex>
 
 #ifdef _WIN32
 #include <Winsock2.h>
@@ -26,6 +27,9 @@ using namespace libspeedwire;
 
 LocalHost *LocalHost::instance = NULL;
 
+//! Mutex protecting the creation of the static instance
+static std::mutex instance_mutex;
+
 
 /**
  *  Constructor
@@ -38,9 +42,11 @@ LocalHost::LocalHost(void) {}
 LocalHost::~LocalHost(void) {}
 
 /**
- *  Get singleton instance. The cache of the returned instance cache is fully initialized.
+ *  Get singleton instance. The cache of the returned instance cache is fully initialized. This method is thread-safe.
  */
 LocalHost& LocalHost::getInstance(void) {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+
     // check if instance has been instanciated
     if (instance == NULL) {
 
@@ -36,6 +36,76 @@ std::string MeasurementType::getFullName(const Wire wire) const {
     return name;
 }
 
+
+/**
+ *  Get the global registry instance; it is created upon first use, so it can be used by static initializers.
+ *  @return A reference to the registry
+ */
+MeasurementTypeRegistry& MeasurementTypeRegistry::getInstance(void) {
+    static MeasurementTypeRegistry instance;
+    return instance;
+}
+
+//! Internal implementation to intern a measurement type; the mutex must be locked by the caller
+const MeasurementType& MeasurementTypeRegistry::internType(const MeasurementType& type) {
+    const TypeKey key((int)type.direction, (int)type.type, (int)type.quantity, type.divisor, type.unit, type.name, type.instaneous);
+    const auto it = typeIndex.find(key);
+    if (it != typeIndex.end()) {
+        return *it->second;
+    }
+    types.push_back(type);
+    typeIndex[key] = &types.back();
+    return types.back();
+}
+
+/**
+ *  Get the interned instance of the given measurement type.
+ *  @param type The measurement type
+ *  @return A reference to the interned measurement type; it remains valid for the lifetime of the program
+ */
+const MeasurementType& MeasurementTypeRegistry::intern(const MeasurementType& type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return internType(type);
+}
+
+/**
+ *  Get the interned descriptor of the given measurement type and wire.
+ *  @param type The measurement type
+ *  @param wire The measurement wire
+ *  @return A reference to the interned descriptor; it remains valid for the lifetime of the program
+ */
+const MeasurementDescriptor& MeasurementTypeRegistry::intern(const MeasurementType& type, const Wire wire) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const MeasurementType& interned_type = internType(type);
+    const std::pair<const MeasurementType*, Wire> key(&interned_type, wire);
+    const auto it = descriptorIndex.find(key);
+    if (it != descriptorIndex.end()) {
+        return *it->second;
+    }
+    descriptors.emplace_back(interned_type, wire, (uint32_t)descriptors.size());
+    descriptorIndex[key] = &descriptors.back();
+    return descriptors.back();
+}
+
+/**
+ *  Get the descriptor with the given id.
+ *  @param id The descriptor id; it must be less than getNumberOfDescriptors()
+ *  @return A reference to the descriptor
+ */
+const MeasurementDescriptor& MeasurementTypeRegistry::getDescriptor(const uint32_t id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return descriptors[id];
+}
+
+/**
+ *  Get the number of interned descriptors.
+ *  @return The number of descriptors
+ */
+size_t MeasurementTypeRegistry::getNumberOfDescriptors(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return descriptors.size();
+}
+
 std::string libspeedwire::toString(const Direction direction) {
     if (direction == Direction::POSITIVE) return "positive";
     if (direction == Direction::NEGATIVE) return "negative";
@@ -65,7 +65,6 @@ uint32_t ObisType::toKey(void) const {
 ObisData::ObisData(void) :
     ObisType(0, 0, 0, 0),
     Measurement(MeasurementType(Direction::NO_DIRECTION, Type::NO_TYPE, Quantity::NO_QUANTITY, "", 0), Wire::NO_WIRE) {
-    description = "";
 }
 
 /**
@@ -95,10 +94,10 @@ void ObisData::print(FILE *file) const {
     double      value  = measurementValue.value;
     std::string string = measurementValues.value_string;
     if (string.length() > 0) {
-        fprintf(file, "%-31s  %lu  %s  => %s\n", description.c_str(), timer, ObisType::toString().c_str(), string.c_str());
+        fprintf(file, "%-31s  %lu  %s  => %s\n", getDescription().c_str(), timer, ObisType::toString().c_str(), string.c_str());
     }
     else {
-        fprintf(file, "%-31s  %lu  %s  => %lf %s\n", description.c_str(), timer, ObisType::toString().c_str(), value, measurementType.unit.c_str());
+        fprintf(file, "%-31s  %lu  %s  => %lf %s\n", getDescription().c_str(), timer, ObisType::toString().c_str(), value, getMeasurementType().unit.c_str());
     }
 }
 
@@ -129,10 +128,10 @@ std::array<uint8_t, 12> ObisData::toByteArray(void) const {
         break;
     case 4:
     case 7:
-        SpeedwireEmeterProtocol::setObisValue4(byte_array.data(), (uint32_t)(measurementValue.value * measurementType.divisor));
+        SpeedwireEmeterProtocol::setObisValue4(byte_array.data(), (uint32_t)(measurementValue.value * getMeasurementType().divisor));
         break;
     case 8:
-        SpeedwireEmeterProtocol::setObisValue8(byte_array.data(), (uint64_t)(measurementValue.value * measurementType.divisor));
+        SpeedwireEmeterProtocol::setObisValue8(byte_array.data(), (uint64_t)(measurementValue.value * getMeasurementType().divisor));
         break;
     }
     return byte_array;
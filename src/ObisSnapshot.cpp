@@ -0,0 +1,131 @@
+#include <ObisSnapshot.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of the ObisSnapshot instance.
+ * @param obis_map Map of obis channels to be published; usually the filter map of the ObisFilter.
+ * @param tail_length_ Number of most recent measurements held for each obis channel.
+ */
+ObisSnapshot::ObisSnapshot(const ObisDataMap& obis_map, const size_t tail_length_) :
+    tail_length(tail_length_ > 0 ? tail_length_ : 1) {
+    for (const auto& entry : obis_map) {
+        Channel& channel = channels[entry.first];
+        channel.tail.resize(tail_length);
+    }
+}
+
+
+/**
+ * Destructor.
+ */
+ObisSnapshot::~ObisSnapshot(void) {}
+
+
+/**
+ * Find the published data of the given obis channel.
+ * @param key The obis key.
+ * @return Pointer to the channel, or NULL if there is none.
+ */
+const ObisSnapshot::Channel* ObisSnapshot::findChannel(const uint32_t key) const {
+    const auto& it = channels.find(key);
+    if (it != channels.end()) {
+        return &(it->second);
+    }
+    return NULL;
+}
+
+
+/**
+ * Callback to consume the given obis data element - publishes the most recent measurement value.
+ * This method must only be called from a single thread.
+ * @param device The originating emeter device.
+ * @param element A reference to an ObisData instance, holding output data of the ObisFilter.
+ */
+void ObisSnapshot::consume(const SpeedwireDevice& device, ObisData& element) {
+    auto it = channels.find(element.toKey());
+    if (it == channels.end() || element.measurementValues.getNumberOfElements() == 0) {
+        return;
+    }
+    Channel& channel = it->second;
+    channel.lock.beginWrite();
+    channel.serialNumber = device.deviceAddress.serialNumber;
+    channel.tail[channel.count % tail_length] = element.measurementValues.getNewestElement();
+    ++channel.count;
+    channel.lock.endWrite();
+}
+
+
+/**
+ * Get a consistent copy of the most recent measurement of the given obis channel.
+ * @param key The obis key.
+ * @param value The copy of the most recent measurement.
+ * @return true if there is a measurement for the given key, false otherwise.
+ */
+bool ObisSnapshot::getLatest(const uint32_t key, ObisSnapshotValue& value) const {
+    const Channel* const channel = findChannel(key);
+    if (channel == NULL) {
+        return false;
+    }
+    uint32_t seq;
+    do {
+        seq = channel->lock.beginRead();
+        value.key = key;
+        value.serialNumber = channel->serialNumber;
+        value.count = channel->count;
+        if (value.count > 0) {
+            const TimestampDoublePair& pair = channel->tail[(value.count - 1) % tail_length];
+            value.value = pair.value;
+            value.time  = pair.time;
+        }
+    } while (channel->lock.retryRead(seq));
+    return (value.count > 0);
+}
+
+
+/**
+ * Get a copy of the most recent measurement of all obis channels. Each element is consistent in itself;
+ * elements of different obis channels may stem from different emeter packets.
+ * @param values The vector receiving the copies; obis channels without any measurement are omitted.
+ * @return The number of elements appended to the vector.
+ */
+size_t ObisSnapshot::getSnapshot(std::vector<ObisSnapshotValue>& values) const {
+    size_t count = 0;
+    ObisSnapshotValue value;
+    for (const auto& entry : channels) {
+        if (getLatest(entry.first, value) == true) {
+            values.push_back(value);
+            ++count;
+        }
+    }
+    return count;
+}
+
+
+/**
+ * Get a consistent copy of the most recent measurements of the given obis channel, oldest first.
+ * @param key The obis key.
+ * @param max_elements The maximum number of measurements to copy; it is limited by the tail length.
+ * @param values The vector receiving the copies; the vector is cleared first.
+ * @return The number of copied measurements.
+ */
+size_t ObisSnapshot::getTail(const uint32_t key, const size_t max_elements, std::vector<TimestampDoublePair>& values) const {
+    values.clear();
+    const Channel* const channel = findChannel(key);
+    if (channel == NULL) {
+        return 0;
+    }
+    values.reserve(tail_length);
+    uint32_t seq;
+    do {
+        values.clear();
+        seq = channel->lock.beginRead();
+        const uint64_t count = channel->count;
+        uint64_t num = (count < tail_length ? count : tail_length);
+        if (num > max_elements) num = max_elements;
+        for (uint64_t i = count - num; i < count; ++i) {
+            values.push_back(channel->tail[i % tail_length]);
+        }
+    } while (channel->lock.retryRead(seq));
+    return values.size();
+}
@@ -0,0 +1,464 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstring>
+#include <atomic>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+#endif
+
+#include <Logger.hpp>
+#include <PersistentMeasurementValues.hpp>
+using namespace libspeedwire;
+
+static Logger logger("PersistentMeasurementValues");
+
+//! Number of attempts to read the write count while it is being updated, before the writer is considered crashed
+static const uint32_t max_read_spins = 1000000;
+
+const char PersistentMeasurementValues::magic[8] = { 'S', 'P', 'W', 'M', 'V', 'A', 'L', '1' };
+
+
+/**
+ *  Constructor
+ */
+PersistentMeasurementValues::PersistentMeasurementValues(void) :
+    path(),
+    header(NULL),
+    records(NULL),
+    mapped_size(0),
+    read_only(false) {
+#ifdef _WIN32
+    file_handle = INVALID_HANDLE_VALUE;
+    mapping_handle = NULL;
+#else
+    file_fd = -1;
+#endif
+}
+
+
+/**
+ *  Destructor
+ */
+PersistentMeasurementValues::~PersistentMeasurementValues(void) {
+    close();
+}
+
+
+/**
+ *  Open the given file and map it into memory. If the file does not exist, or if its layout does not match the
+ *  given capacity, the file is (re-)created and initialized as an empty ring buffer.
+ *  @param file_path the path of the file
+ *  @param capacity the maximum number of measurements held by the file
+ *  @return true on success, false otherwise
+ */
+bool PersistentMeasurementValues::open(const std::string& file_path, const size_t capacity) {
+    close();
+    if (capacity == 0) {
+        return false;
+    }
+    const size_t size = sizeof(Header) + capacity * sizeof(Record);
+    size_t file_size = 0;
+    bool resized = false;
+    void* addr = map(file_path, size, false, file_size, resized);
+    if (addr == NULL) {
+        return false;
+    }
+    path = file_path;
+    mapped_size = file_size;
+    read_only = false;
+    header = (Header*)addr;
+    records = (Record*)((uint8_t*)addr + sizeof(Header));
+
+    // check the file layout; initialize the file if it does not match
+    const bool valid = (!resized &&
+                        memcmp(header->magic, magic, sizeof(magic)) == 0 &&
+                        header->header_size == sizeof(Header) &&
+                        header->record_size == sizeof(Record) &&
+                        header->capacity == capacity);
+    if (valid) {
+        recover();
+    }
+    else {
+        memset(addr, 0, size);
+        header->header_size = sizeof(Header);
+        header->record_size = sizeof(Record);
+        header->capacity = capacity;
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(header->magic, magic, sizeof(magic));    // the magic is written last to mark the header as valid
+    }
+    return true;
+}
+
+
+/**
+ *  Open the given file read-only and map it into memory. The capacity is taken from the file header. The file is
+ *  never truncated, initialized or recovered, such that it can be read while another process is writing to it.
+ *  @param file_path the path of the file
+ *  @return true on success, false if the file does not exist, if its layout is not valid, or if the write count is still
+ *          locked, e.g. because the writer crashed while updating it; the writer repairs the lock when it reopens the file
+ */
+bool PersistentMeasurementValues::openReadOnly(const std::string& file_path) {
+    close();
+    size_t file_size = 0;
+    bool resized = false;
+    void* addr = map(file_path, 0, true, file_size, resized);
+    if (addr == NULL) {
+        return false;
+    }
+    path = file_path;
+    mapped_size = file_size;
+    read_only = true;
+    header = (Header*)addr;
+    records = (Record*)((uint8_t*)addr + sizeof(Header));
+
+    // check the file layout
+    const bool valid = (memcmp(header->magic, magic, sizeof(magic)) == 0 &&
+                        header->header_size == sizeof(Header) &&
+                        header->record_size == sizeof(Record) &&
+                        header->capacity > 0 &&
+                        header->capacity == (file_size - sizeof(Header)) / sizeof(Record) &&
+                        (file_size - sizeof(Header)) % sizeof(Record) == 0);
+    if (!valid) {
+        logger.print(LogLevel::LOG_ERROR, "invalid file layout in %s", file_path.c_str());
+        close();
+        return false;
+    }
+
+    // check that the write count can be read
+    uint64_t count = 0;
+    if (!tryGetWriteCount(count)) {
+        logger.print(LogLevel::LOG_ERROR, "write count is locked in %s, the file is being written", file_path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ *  Open the given file and map it into memory.
+ *  @param file_path the path of the file
+ *  @param size the required file size; ignored in read-only mode
+ *  @param map_read_only if true, the existing file is mapped read-only; otherwise the file is created or resized as needed
+ *  @param file_size the size of the mapping
+ *  @param resized set to true if the file has been created or resized
+ *  @return the address of the mapping, or NULL on failure
+ */
+void* PersistentMeasurementValues::map(const std::string& file_path, const size_t size, const bool map_read_only, size_t& file_size, bool& resized) {
+    resized = false;
+    file_size = size;
+
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(file_path.c_str(), (map_read_only ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE), FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            (map_read_only ? OPEN_EXISTING : OPEN_ALWAYS), FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) {
+        logger.print(LogLevel::LOG_ERROR, "cannot open file %s (error %lu)", file_path.c_str(), (unsigned long)GetLastError());
+        return NULL;
+    }
+    LARGE_INTEGER current_size;
+    if (!GetFileSizeEx(fh, &current_size)) {
+        current_size.QuadPart = 0;
+    }
+    if (map_read_only) {
+        file_size = (size_t)current_size.QuadPart;
+        if (file_size < sizeof(Header)) {
+            logger.print(LogLevel::LOG_ERROR, "file %s is too small", file_path.c_str());
+            CloseHandle(fh);
+            return NULL;
+        }
+    }
+    else if ((uint64_t)current_size.QuadPart != (uint64_t)size) {
+        LARGE_INTEGER new_size;
+        new_size.QuadPart = (LONGLONG)size;
+        if (!SetFilePointerEx(fh, new_size, NULL, FILE_BEGIN) || !SetEndOfFile(fh)) {
+            logger.print(LogLevel::LOG_ERROR, "cannot resize file %s (error %lu)", file_path.c_str(), (unsigned long)GetLastError());
+            CloseHandle(fh);
+            return NULL;
+        }
+        resized = true;
+    }
+    HANDLE mh = CreateFileMappingA(fh, NULL, (map_read_only ? PAGE_READONLY : PAGE_READWRITE), (DWORD)((uint64_t)file_size >> 32), (DWORD)(file_size & 0xffffffff), NULL);
+    void* addr = (mh != NULL ? MapViewOfFile(mh, (map_read_only ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS), 0, 0, file_size) : NULL);
+    if (addr == NULL) {
+        logger.print(LogLevel::LOG_ERROR, "cannot map file %s (error %lu)", file_path.c_str(), (unsigned long)GetLastError());
+        if (mh != NULL) CloseHandle(mh);
+        CloseHandle(fh);
+        return NULL;
+    }
+    file_handle = fh;
+    mapping_handle = mh;
+#else
+    int fd = (map_read_only ? ::open(file_path.c_str(), O_RDONLY) : ::open(file_path.c_str(), O_RDWR | O_CREAT, 0644));
+    if (fd < 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot open file %s (%s)", file_path.c_str(), strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        st.st_size = 0;
+    }
+    if (map_read_only) {
+        file_size = (size_t)st.st_size;
+        if (file_size < sizeof(Header)) {
+            logger.print(LogLevel::LOG_ERROR, "file %s is too small", file_path.c_str());
+            ::close(fd);
+            return NULL;
+        }
+    }
+    else if ((uint64_t)st.st_size != (uint64_t)size) {
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)size) != 0) {
+            logger.print(LogLevel::LOG_ERROR, "cannot resize file %s (%s)", file_path.c_str(), strerror(errno));
+            ::close(fd);
+            return NULL;
+        }
+        resized = true;
+    }
+    void* addr = mmap(NULL, file_size, (map_read_only ? PROT_READ : PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        logger.print(LogLevel::LOG_ERROR, "cannot map file %s (%s)", file_path.c_str(), strerror(errno));
+        ::close(fd);
+        return NULL;
+    }
+    file_fd = fd;
+#endif
+    return addr;
+}
+
+
+/**
+ *  Unmap and close the file.
+ */
+void PersistentMeasurementValues::close(void) {
+    if (header == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(header);
+    CloseHandle((HANDLE)mapping_handle);
+    CloseHandle((HANDLE)file_handle);
+    file_handle = INVALID_HANDLE_VALUE;
+    mapping_handle = NULL;
+#else
+    munmap(header, mapped_size);
+    ::close(file_fd);
+    file_fd = -1;
+#endif
+    header = NULL;
+    records = NULL;
+    mapped_size = 0;
+    read_only = false;
+    path.clear();
+}
+
+
+/**
+ *  Flush the mapped memory to the file; this is only needed to protect against power loss, not against process crashes.
+ *  @return true on success, false otherwise
+ */
+bool PersistentMeasurementValues::flush(void) {
+    if (header == NULL || read_only) {
+        return false;
+    }
+#ifdef _WIN32
+    return (FlushViewOfFile(header, mapped_size) != 0 && FlushFileBuffers((HANDLE)file_handle) != 0);
+#else
+    return (msync(header, mapped_size, MS_SYNC) == 0);
+#endif
+}
+
+
+/**
+ *  Recover records that have been written before a crash, but have not been accounted for in the header.
+ */
+void PersistentMeasurementValues::recover(void) {
+    // a crash while updating the upper 32-bit of the write count leaves the sequence lock in writing state
+    if (header->write_lock.isWriting()) {
+        header->write_lock.endWrite();
+    }
+    const uint64_t capacity = header->capacity;
+    const uint64_t write_count = getWriteCount();
+    uint64_t count = write_count;
+    for (uint64_t i = 0; i < capacity; ++i) {
+        const Record& record = records[count % capacity];
+        if (record.sequence.load(std::memory_order_relaxed) != getSequenceNumber(count)) {
+            break;
+        }
+        ++count;
+    }
+    if (count != write_count) {
+        logger.print(LogLevel::LOG_INFO_0, "recovered %lu records in %s", (unsigned long)(count - write_count), path.c_str());
+        setWriteCount(count);
+    }
+}
+
+
+/**
+ *  Get the total number of records written. The 64-bit write count is split into two 32-bit halves, as 64-bit
+ *  atomics are not lock-free on all targets. The upper half only changes when the lower half wraps around; such
+ *  updates are guarded by a sequence lock.
+ *  @return the write count
+ */
+uint64_t PersistentMeasurementValues::getWriteCount(void) const {
+    uint32_t seq, high, low;
+    do {
+        seq = header->write_lock.beginRead();
+        high = header->write_count_high.load(std::memory_order_relaxed);
+        low = header->write_count_low.load(std::memory_order_acquire);
+    } while (header->write_lock.retryRead(seq));
+    return ((uint64_t)high << 32) | low;
+}
+
+
+/**
+ *  Try to get the total number of records written; in contrast to getWriteCount(), this gives up if the sequence lock
+ *  stays in writing state, as it does if the writer crashed while updating the upper 32-bit of the write count.
+ *  @param count the write count
+ *  @return true on success, false if the write count is locked
+ */
+bool PersistentMeasurementValues::tryGetWriteCount(uint64_t& count) const {
+    uint32_t seq, high, low;
+    do {
+        if (!header->write_lock.tryBeginRead(seq, max_read_spins)) {
+            return false;
+        }
+        high = header->write_count_high.load(std::memory_order_relaxed);
+        low = header->write_count_low.load(std::memory_order_acquire);
+    } while (header->write_lock.retryRead(seq));
+    count = ((uint64_t)high << 32) | low;
+    return true;
+}
+
+
+/**
+ *  Get the sequence number stored in the record with the given write count; this is the lower 32-bit of the
+ *  write count plus 1, skipping 0 which marks empty records and records being written.
+ *  @param count the write count of the record
+ *  @return the sequence number
+ */
+uint32_t PersistentMeasurementValues::getSequenceNumber(const uint64_t count) {
+    const uint32_t sequence = (uint32_t)(count + 1);
+    return (sequence != 0 ? sequence : 1);
+}
+
+
+/**
+ *  Set the total number of records written; there must be at most one writer.
+ *  @param count the new write count
+ */
+void PersistentMeasurementValues::setWriteCount(const uint64_t count) {
+    const uint32_t high = (uint32_t)(count >> 32);
+    if (high == header->write_count_high.load(std::memory_order_relaxed)) {
+        header->write_count_low.store((uint32_t)count, std::memory_order_release);
+    }
+    else {
+        header->write_lock.beginWrite();
+        header->write_count_high.store(high, std::memory_order_relaxed);
+        header->write_count_low.store((uint32_t)count, std::memory_order_relaxed);
+        header->write_lock.endWrite();
+    }
+}
+
+
+/**
+ *  Add a new measurement to the file. The oldest measurement is overwritten if the file is full.
+ *  The record sequence number is cleared while the record is written and the write count is incremented
+ *  afterwards, such that concurrent readers and crash recovery never see a partially written record.
+ *  @param value the measurement value
+ *  @param time the measurement time
+ */
+void PersistentMeasurementValues::addMeasurement(const double value, const uint32_t time) {
+    if (header == NULL || read_only) {
+        return;
+    }
+    const uint64_t count = getWriteCount();
+    Record& record = records[count % header->capacity];
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.value = value;
+    record.time = time;
+    record.sequence.store(getSequenceNumber(count), std::memory_order_release);
+    setWriteCount(count + 1);
+}
+
+
+/**
+ *  Get the number of measurements in the file.
+ */
+size_t PersistentMeasurementValues::getNumberOfElements(void) const {
+    if (header == NULL) {
+        return 0;
+    }
+    const uint64_t count = getWriteCount();
+    return (size_t)(count < header->capacity ? count : header->capacity);
+}
+
+
+/**
+ *  Get the maximum number of measurements held by the file.
+ */
+size_t PersistentMeasurementValues::getMaximumNumberOfElements(void) const {
+    return (header != NULL ? (size_t)header->capacity : 0);
+}
+
+
+/**
+ *  Get the measurement with the given index; index 0 is the oldest measurement in the file.
+ *  The record sequence number is checked before and after copying the record; if the writer has started to
+ *  overwrite the record in the meantime, the read is retried with the updated write count. If the write count
+ *  has not changed yet, the record is being overwritten and is no longer available.
+ *  @param index the index
+ *  @return the measurement; if the index is out of bounds or the record is no longer available, a measurement
+ *          with value 0.0 and time 0 is returned
+ */
+TimestampDoublePair PersistentMeasurementValues::at(const size_t index) const {
+    if (header != NULL) {
+        const uint64_t capacity = header->capacity;
+        uint64_t count = getWriteCount();
+        for (;;) {
+            const uint64_t num_elements = (count < capacity ? count : capacity);
+            if (index >= num_elements) {
+                break;
+            }
+            const uint64_t sequence = count - num_elements + index;
+            const Record& record = records[sequence % capacity];
+            const uint32_t expected = getSequenceNumber(sequence);
+            if (record.sequence.load(std::memory_order_acquire) == expected) {
+                const TimestampDoublePair pair(record.value, record.time);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (record.sequence.load(std::memory_order_relaxed) == expected) {
+                    return pair;
+                }
+            }
+            const uint64_t new_count = getWriteCount();
+            if (new_count == count) {
+                break;
+            }
+            count = new_count;
+        }
+    }
+    return TimestampDoublePair(0.0, 0);
+}
+
+
+/**
+ *  Copy the most recent measurements into the given ring buffer, oldest first. This is used to warm up
+ *  in-memory measurement histories after a restart.
+ *  @param values the ring buffer
+ *  @return the number of copied measurements
+ */
+size_t PersistentMeasurementValues::restore(MeasurementValues& values) const {
+    const size_t num_elements = getNumberOfElements();
+    const size_t num_restore = (num_elements < values.getMaximumNumberOfElements() ? num_elements : values.getMaximumNumberOfElements());
+    for (size_t i = num_elements - num_restore; i < num_elements; ++i) {
+        const TimestampDoublePair pair = at(i);
+        values.addMeasurement(pair.value, pair.time);
+    }
+    return num_restore;
+}
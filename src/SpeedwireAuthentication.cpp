@@ -1,4 +1,13 @@
 #define _CRT_SECURE_NO_WARNINGS (1)
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#define poll(a, b, c)  WSAPoll((a), (b), (c))
+#else
+#include <poll.h>
+#endif
+
+#include <algorithm>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +17,7 @@
 #include <Logger.hpp>
 #include <SpeedwireByteEncoding.hpp>
 #include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireReceiveDispatcher.hpp>
 #include <SpeedwireTime.hpp>
 #include <SpeedwireCommand.hpp>
 #include <SpeedwireAuthentication.hpp>
@@ -18,34 +28,36 @@ static Logger logger("SpeedwireAuthentication");
 
 /**
  *  Login this local device from to other devices. This is done by sending a broadcast login command for this device to each local interface.
+ *  All login requests are sent at once and their responses are collected together.
  */
 bool SpeedwireAuthentication::login(const Credentials& credentials, const int timeout_in_ms) {
-    bool result = true;
+    std::vector<LoginRequest> requests;
     const SpeedwireAddress& local_address     = SpeedwireAddress::getLocalAddress();
     const SpeedwireAddress& broadcast_address = SpeedwireAddress::getBroadcastAddress();
     for (const auto& entry : socket_map) {
-        result &= login(entry.first, broadcast_address, local_address, credentials, timeout_in_ms);
+        addLoginRequest(requests, entry.first, broadcast_address, local_address);
     }
     for (const auto& device : devices) {
         if (!AddressConversion::resideOnSameSubnet(device.deviceIpAddress, device.interfaceIpAddress, 24) && device.interfaceIpAddress.length() > 0) { // FIXME: hard coded prefix
-            result &= login(device.interfaceIpAddress, device.deviceAddress, local_address, credentials, timeout_in_ms);
+            addLoginRequest(requests, device.interfaceIpAddress, device.deviceAddress, local_address);
         }
     }
-    return result;
+    return login(requests, credentials, timeout_in_ms);
 }
 
 /**
  *  Login all devices to all other devices. This is done by sending a broadcast login command for each device to each local interface.
+ *  All login requests are sent at once and their responses are collected together.
  */
 bool SpeedwireAuthentication::loginAnyToAny(const Credentials& credentials, const int timeout_in_ms) {
-    bool result = true;
+    std::vector<LoginRequest> requests;
     const SpeedwireAddress& broadcast_address = SpeedwireAddress::getBroadcastAddress();
     for (const auto& device : devices) {
         for (const auto& entry : socket_map) {
-            result &= login(entry.first, broadcast_address, device.deviceAddress, credentials, timeout_in_ms);
+            addLoginRequest(requests, entry.first, broadcast_address, device.deviceAddress);
         }
     }
-    return result;
+    return login(requests, credentials, timeout_in_ms);
 }
 
 /**
@@ -59,67 +71,350 @@ bool SpeedwireAuthentication::login(const SpeedwireDevice& dst_peer, const Crede
  *  synchronous login method - send inverter login command to the given peer, wait for the response and check for error codes
  */
 bool SpeedwireAuthentication::login(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials, const int timeout_in_ms) {
-    logger.print(LogLevel::LOG_INFO_0, "login susyid %u serial %lu => susyid %u serial %lu time 0x%016llx",
-        src.susyID, src.serialNumber, dst.susyID, dst.serialNumber, localhost.getUnixEpochTimeInMs());
+    std::vector<LoginRequest> requests;
+    addLoginRequest(requests, if_address, dst, src);
+    return login(requests, credentials, timeout_in_ms);
+}
 
-    // determine receive socket
-    SocketIndex socket_index = socket_map[if_address];
-    if (socket_index < 0) {
-        logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
-        return false;
+/**
+ *  Append a login request to the given list of login requests.
+ */
+void SpeedwireAuthentication::addLoginRequest(std::vector<LoginRequest>& requests, const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src) const {
+    LoginRequest request;
+    request.if_address   = if_address;
+    request.dst          = dst;
+    request.src          = src;
+    request.socket_index = -1;
+    request.token_index  = -1;
+    request.token        = SpeedwireCommandToken();
+    request.done         = false;
+    request.success      = false;
+    requests.push_back(request);
+}
+
+/**
+ *  Concurrent login method - send all given login requests at once, then wait for their responses and check them for error codes.
+ *  @param requests the login requests; on return, each request is marked as done and holds its result
+ *  @param credentials the credentials used for all login requests
+ *  @param timeout_in_ms the overall timeout
+ *  @return true if all login requests succeeded
+ */
+bool SpeedwireAuthentication::login(std::vector<LoginRequest>& requests, const Credentials& credentials, const int timeout_in_ms) {
+    sendLoginRequests(requests, credentials);
+    return receiveLoginResponses(requests, timeout_in_ms);
+}
+
+/**
+ *  Send all given login requests at once, without waiting for their responses.
+ *  @param requests the login requests; requests that cannot be sent are marked as done
+ *  @param credentials the credentials used for all login requests
+ */
+void SpeedwireAuthentication::sendLoginRequests(std::vector<LoginRequest>& requests, const Credentials& credentials) {
+    for (auto& request : requests) {
+        logger.print(LogLevel::LOG_INFO_0, "login susyid %u serial %lu => susyid %u serial %lu time 0x%016llx",
+            request.src.susyID, request.src.serialNumber, request.dst.susyID, request.dst.serialNumber, localhost.getUnixEpochTimeInMs());
+        request.done = true;
+        request.success = false;
+
+        // determine receive socket
+        const SocketMap::const_iterator it = socket_map.find(request.if_address);
+        if (it == socket_map.end() || it->second < 0) {
+            logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
+            continue;
+        }
+        request.socket_index = it->second;
+
+        // send login request to peer
+        request.token_index = sendLoginRequest(request.if_address, request.dst, request.src, credentials);
+        if (request.token_index < 0) {
+            continue;
+        }
+        request.token = token_repository.at(request.token_index);
+        request.done = false;
     }
-    SpeedwireSocket& socket = sockets[socket_index];
+}
 
-    // send login request to peer
-    SpeedwireCommandTokenIndex token_index = sendLoginRequest(if_address, dst, src, credentials);
-    if (token_index < 0) {
-        return false;
+/**
+ *  Wait for the responses to the given login requests and check them for error codes. Requests are retransmitted according
+ *  to the retransmission policy of the token repository, while waiting for the responses. Unicast requests complete with
+ *  their response; broadcast requests collect the responses of all devices, until each known device reachable through the
+ *  interface has responded or until the timeout, and succeed if at least one device responded without error code.
+ *  @param requests the login requests; on return, each request is marked as done and holds its result
+ *  @param timeout_in_ms the overall timeout
+ *  @return true if all login requests succeeded
+ */
+bool SpeedwireAuthentication::receiveLoginResponses(std::vector<LoginRequest>& requests, const int timeout_in_ms) {
+
+    // prepare a pollfd structure for each socket involved
+    std::vector<struct pollfd> pollfds;
+    std::vector<SocketIndex>   pollsockets;
+    size_t pending = 0;
+    for (const auto& request : requests) {
+        if (request.done == true) {
+            continue;
+        }
+        ++pending;
+        if (std::find(pollsockets.begin(), pollsockets.end(), request.socket_index) == pollsockets.end()) {
+            struct pollfd pfd;
+            pfd.fd      = sockets[request.socket_index].getSocketFd();
+            pfd.events  = POLLIN;
+            pfd.revents = 0;
+            pollfds.push_back(pfd);
+            pollsockets.push_back(request.socket_index);
+        }
     }
 
-    // wait for the response
+    // collect the responses
+    const uint64_t end_time = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
     unsigned char response_buffer[2048];
-    int32_t nbytes = receiveResponse(token_index, socket, response_buffer, sizeof(response_buffer), timeout_in_ms);
-    if (nbytes <= 0) {
-        return false;
-    }
+    while (pending > 0) {
+
+        // retransmit or expire tokens whose deadlines have passed; broadcast requests keep collecting responses until the timeout
+        processTokenDeadlines();
+        for (auto& request : requests) {
+            if (request.done == false && request.dst.isBroadcast() == false && token_repository.isValid(request.token_index) == false) {
+                request.done = true;
+                --pending;
+            }
+        }
+        if (pending == 0) {
+            break;
+        }
 
-    // check error code
-    const SpeedwireHeader speedwire_packet(response_buffer, sizeof(response_buffer));
-    if (speedwire_packet.isValidData2Packet()) {
-        const SpeedwireData2Packet data2_packet(speedwire_packet);
+        // limit the poll timeout to the next token deadline, so that retransmissions are sent in time
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (now >= end_time) {
+            break;
+        }
+        uint64_t wait_time = end_time - now;
+        const uint64_t next_deadline = token_repository.getNextDeadline();
+        if (next_deadline < end_time) {
+            wait_time = (next_deadline > now ? next_deadline - now : 0);
+        }
 
-        if (data2_packet.isInverterProtocolID()) {
-            const SpeedwireInverterProtocol inverter_packet(data2_packet);
-//          logger.print(LogLevel::LOG_INFO_1, "%s\n", inverter_packet.toString().c_str());
+        // wait for packets on any of the sockets
+        int pollresult = poll(pollfds.data(), (unsigned long)pollfds.size(), (int)wait_time);
+        if (pollresult == 0) {
+            continue;
+        }
+        if (pollresult < 0) {
+            logger.print(LogLevel::LOG_ERROR, "poll failure");
+            break;
+        }
 
+        for (size_t i = 0; i < pollfds.size(); ++i) {
+            if ((pollfds[i].revents & POLLIN) == 0) {
+                continue;
+            }
 
-            uint16_t error_code = inverter_packet.getErrorCode();
-            if (error_code != 0x0000) {
-                if (error_code == 0x0017) {
-                    logger.print(LogLevel::LOG_ERROR, "lost connection - not authenticated (error code 0x0017)");
-                    token_repository.needs_login = true;
-                }
-                else if (token_repository.at(token_index).command == Command::LOGIN) { // login command
-                    if (error_code == 0x0100) {
-                        logger.print(LogLevel::LOG_ERROR, "invalid password - not authenticated");
-                    }
-                    else {
-                        logger.print(LogLevel::LOG_ERROR, "login failure - not authenticated");
+            // read packet data
+            SpeedwireSocket& socket = sockets[pollsockets[i]];
+            struct sockaddr src;
+            int nbytes = -1;
+            if (socket.isIpv4()) {
+                nbytes = socket.recvfrom(response_buffer, sizeof(response_buffer), AddressConversion::toSockAddrIn(src));
+            }
+            else if (socket.isIpv6()) {
+                nbytes = socket.recvfrom(response_buffer, sizeof(response_buffer), AddressConversion::toSockAddrIn6(src));
+            }
+            if (nbytes <= 0) {
+                continue;
+            }
+
+            // check if the response is an inverter packet
+            SpeedwireHeader speedwire_packet(response_buffer, nbytes);
+            bool matched = false;
+            if (speedwire_packet.isValidData2Packet()) {
+                const SpeedwireData2Packet data2_packet(speedwire_packet);
+                if (data2_packet.isInverterProtocolID()) {
+                    const SpeedwireInverterProtocol inverter_packet(data2_packet);
+
+                    // match the response to a pending login request on the same socket
+                    const uint16_t packet_id = (inverter_packet.getPacketID() | 0x8000);
+                    for (auto& request : requests) {
+                        if (request.done == false && request.socket_index == pollsockets[i] &&
+                            request.token.packetid == packet_id && checkReply(speedwire_packet, src, request.token) == true) {
+                            const bool success = checkLoginReply(inverter_packet);
+                            if (request.dst.isBroadcast()) {
+                                const SpeedwireAddress responder(inverter_packet.getSrcSusyID(), inverter_packet.getSrcSerialNumber());
+                                if (success && std::find(request.responders.begin(), request.responders.end(), responder) == request.responders.end()) {
+                                    request.responders.push_back(responder);
+                                }
+                                request.success = (request.responders.size() > 0);
+                                if (hasAllResponses(request)) {
+                                    request.done = true;
+                                    --pending;
+                                }
+                            }
+                            else {
+                                request.success = success;
+                                request.done = true;
+                                --pending;
+                                token_repository.remove(request.token_index);
+                            }
+                            matched = true;
+                            break;
+                        }
                     }
                 }
-                else {
-                    logger.print(LogLevel::LOG_ERROR, "query error code received");
-                }
-                token_repository.remove(token_index);
-                return false;
             }
+
+            // pass any other packet on to the receive dispatcher instead of dropping it
+            if (matched == false && dispatcher != NULL) {
+                dispatcher->dispatch(speedwire_packet, src);
+            }
+        }
+    }
+
+    // remove the tokens of unanswered and broadcast requests and update the session cache
+    bool result = true;
+    for (auto& request : requests) {
+        if (request.token_index >= 0 && token_repository.isValid(request.token_index)) {
+            token_repository.remove(request.token_index);
+        }
+        if (request.success == false) {
+            result = false;
+        }
+        request.done = true;
+        updateSessions(request);
+    }
+    return result;
+}
+
+/**
+ *  Check if all known devices reachable through the interface of the given broadcast login request have responded.
+ *  @return true if all known devices requiring a login responded, false if there are no such devices
+ */
+bool SpeedwireAuthentication::hasAllResponses(const LoginRequest& request) const {
+    bool known = false;
+    for (const auto& device : devices) {
+        if (device.interfaceIpAddress != request.if_address || needsLogin(device) == false) {
+            continue;
         }
+        if (std::find(request.responders.begin(), request.responders.end(), device.deviceAddress) == request.responders.end()) {
+            return false;
+        }
+        known = true;
+    }
+    return known;
+}
+
+/**
+ *  Check the error code of a login response packet
+ *  @return true if the login succeeded
+ */
+bool SpeedwireAuthentication::checkLoginReply(const SpeedwireInverterProtocol& inverter_packet) {
+    uint16_t error_code = inverter_packet.getErrorCode();
+    if (error_code != 0x0000) {
+        if (error_code == 0x0017) {
+            logger.print(LogLevel::LOG_ERROR, "lost connection - not authenticated (error code 0x0017)");
+            token_repository.needs_login = true;
+        }
+        else if (error_code == 0x0100) {
+            logger.print(LogLevel::LOG_ERROR, "invalid password - not authenticated");
+        }
+        else {
+            logger.print(LogLevel::LOG_ERROR, "login failure - not authenticated");
+        }
+        return false;
     }
-    token_repository.remove(token_index);
     return true;
 }
 
 
+/**
+ *  Get the current tick count; this can be overridden for testing purposes.
+ *  @return the tick count in milliseconds
+ */
+uint64_t SpeedwireAuthentication::getTickCountInMs(void) const {
+    return LocalHost::getTickCountInMs();
+}
+
+/**
+ *  Check if the given device needs a login, i.e. if it is not an emeter.
+ */
+bool SpeedwireAuthentication::needsLogin(const SpeedwireDevice& device) {
+    return (device.deviceClass != toString(SpeedwireDeviceClass::EMETER) && device.deviceAddress.isComplete());
+}
+
+/**
+ *  Update the session cache from the result of a login request of the local device. A broadcast login starts
+ *  sessions with the devices that responded to it; failed unicast logins end the sessions.
+ */
+void SpeedwireAuthentication::updateSessions(const LoginRequest& request) {
+    if (!(request.src == SpeedwireAddress::getLocalAddress())) {
+        return;
+    }
+    const uint64_t now = getTickCountInMs();
+    for (const auto& device : devices) {
+        const bool matches = (request.dst.isBroadcast() ?
+            std::find(request.responders.begin(), request.responders.end(), device.deviceAddress) != request.responders.end() :
+            device.deviceAddress == request.dst);
+        if (matches == false || needsLogin(device) == false) {
+            continue;
+        }
+        if (request.success) {
+            SpeedwireSession& session = sessions[device.deviceAddress.toKey()];
+            session.device     = device;
+            session.loginTime  = now;
+            session.expiryTime = now + session_timeout_in_ms;
+        }
+        else if (request.dst.isBroadcast() == false) {
+            sessions.erase(device.deviceAddress.toKey());
+        }
+    }
+}
+
+/**
+ *  Check if the local device has a session with the given device that has not lapsed yet.
+ */
+bool SpeedwireAuthentication::isLoggedIn(const SpeedwireDevice& device) const {
+    const std::map<uint64_t, SpeedwireSession>::const_iterator it = sessions.find(device.deviceAddress.toKey());
+    return (it != sessions.end() && it->second.expiryTime > getTickCountInMs());
+}
+
+/**
+ *  Get all devices requiring a login, where the local device has no session or where the session lapses within the relogin margin.
+ *  If a query failed with error code 0x0017, all devices requiring a login are returned.
+ */
+std::vector<SpeedwireDevice> SpeedwireAuthentication::getExpiringSessions(void) const {
+    std::vector<SpeedwireDevice> result;
+    const uint64_t threshold = getTickCountInMs() + relogin_margin_in_ms;
+    for (const auto& device : devices) {
+        if (needsLogin(device) == false) {
+            continue;
+        }
+        const std::map<uint64_t, SpeedwireSession>::const_iterator it = sessions.find(device.deviceAddress.toKey());
+        if (token_repository.needs_login == true || it == sessions.end() || it->second.expiryTime <= threshold) {
+            result.push_back(device);
+        }
+    }
+    return result;
+}
+
+/**
+ *  Re-authenticate the local device with all devices returned by getExpiringSessions(). All login requests are sent at once.
+ *  @return the number of successful logins, or -1 if any login failed
+ */
+int SpeedwireAuthentication::refreshSessions(const Credentials& credentials, const int timeout_in_ms) {
+    const std::vector<SpeedwireDevice> expiring = getExpiringSessions();
+    if (expiring.size() == 0) {
+        return 0;
+    }
+    std::vector<LoginRequest> requests;
+    const SpeedwireAddress& local_address = SpeedwireAddress::getLocalAddress();
+    for (const auto& device : expiring) {
+        addLoginRequest(requests, device.interfaceIpAddress, device.deviceAddress, local_address);
+    }
+    token_repository.needs_login = false;
+    if (login(requests, credentials, timeout_in_ms) == false) {
+        token_repository.needs_login = true;
+        return -1;
+    }
+    return (int)requests.size();
+}
+
+
 /**
  *  Logoff this local device from all other devices. This is done by sending a broadcast logoff command for this device to each local interface.
  */
@@ -166,6 +461,15 @@ bool SpeedwireAuthentication::logoff(const std::string& if_address, const Speedw
     logger.print(LogLevel::LOG_INFO_0, "logoff susyid %u serial %lu => susyid %u serial %lu time 0x%016llx",
         src.susyID, src.serialNumber, dst.susyID, dst.serialNumber, localhost.getUnixEpochTimeInMs());
 
+    // end the sessions of the local device
+    if (src == SpeedwireAddress::getLocalAddress()) {
+        for (const auto& device : devices) {
+            if (dst.isBroadcast() ? device.interfaceIpAddress == if_address : device.deviceAddress == dst) {
+                sessions.erase(device.deviceAddress.toKey());
+            }
+        }
+    }
+
     return sendLogoffRequest(if_address, dst, src);
 }
 
@@ -203,7 +507,7 @@ SpeedwireCommandTokenIndex SpeedwireAuthentication::sendLoginRequest(const std::
     request.setPacketID(packet_id);
     request.setCommandID(Command::LOGIN);
     request.setFirstRegisterID((uint32_t)credentials.getUserName());    // user: 0x7  installer: 0xa
-    request.setLastRegisterID(0x00000384);     // timeout
+    request.setLastRegisterID(login_timeout_in_s);     // timeout
     request.setDataUint32(0, SpeedwireTime::getInverterTimeNow());
     request.setDataUint32(4, 0x00000000);
     std::array<uint8_t, 12> encoded_password = credentials.getEncodedPassWord();
@@ -235,7 +539,8 @@ SpeedwireCommandTokenIndex SpeedwireAuthentication::sendLoginRequest(const std::
     }
 
     // add a query token; this is used to match reply packets to this request packet
-    SpeedwireCommandTokenIndex index = token_repository.add(dst.susyID, dst.serialNumber, packet_id, dst_ip_address, Command::LOGIN);
+    SpeedwireCommandTokenIndex index = token_repository.add(dst.susyID, dst.serialNumber, packet_id, dst_ip_address, Command::LOGIN,
+                                                            if_address, request_buffer, sizeof(request_buffer));
 
     return index;
 }
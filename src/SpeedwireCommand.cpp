@@ -19,6 +19,7 @@
 #include <SpeedwireByteEncoding.hpp>
 #include <SpeedwireDevice.hpp>
 #include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireReceiveDispatcher.hpp>
 #include <SpeedwireSocket.hpp>
 #include <SpeedwireSocketFactory.hpp>
 #include <SpeedwireCommand.hpp>
@@ -26,12 +27,13 @@ using namespace libspeedwire;
 
 static Logger logger("SpeedwireCommand");
 
-uint16_t SpeedwireCommand::packet_id = 0x8001;
+std::atomic<uint16_t> SpeedwireCommand::packet_id(0x8001);
 
 
 SpeedwireCommand::SpeedwireCommand(const LocalHost &_localhost, const std::vector<SpeedwireDevice> &_devices) :
     localhost(_localhost),
-    devices(_devices) {
+    devices(_devices),
+    dispatcher(NULL) {
     // loop across all speedwire devices
     for (auto& device : devices) {
         // check if there is already a map entry for the interface ip address
@@ -48,6 +50,7 @@ SpeedwireCommand::SpeedwireCommand(const LocalHost &_localhost, const std::vecto
             }
         }
     }
+    token_repository.setRetransmitCallback([this](const SpeedwireCommandToken& token) { return retransmit(token); });
 }
 
 SpeedwireCommand::~SpeedwireCommand(void) {
@@ -182,7 +185,8 @@ SpeedwireCommandTokenIndex SpeedwireCommand::sendQueryRequest(const SpeedwireDev
     }
 
     // add a query token; this is used to match reply packets to this request packet
-    SpeedwireCommandTokenIndex index = token_repository.add(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id, peer.deviceIpAddress, command);
+    SpeedwireCommandTokenIndex index = token_repository.add(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id, peer.deviceIpAddress, command,
+                                                            peer.interfaceIpAddress, request_buffer, sizeof(request_buffer));
 
     return index;
 }
@@ -227,50 +231,63 @@ SpeedwireDevice SpeedwireCommand::queryDeviceType(const SpeedwireDevice& peer, c
 
         // parse reply packet
         SpeedwireHeader speedwire_packet(udp_packet, nbytes);
-        if (speedwire_packet.isValidData2Packet()) {
-            if (!speedwire_packet.isValidData2Packet(true)) {
-                printf("is valid speedwire packet, but minor deviations from standard detected\n");
-            }
+        parseDeviceTypeReply(speedwire_packet, info);
+    }
+    //printf("%s\n", info.toString().c_str());
+    return info;
+}
 
-            SpeedwireData2Packet data2_packet(speedwire_packet);
-            if (data2_packet.isInverterProtocolID()) {
 
-                SpeedwireInverterProtocol inverter_packet(data2_packet);
-                //LocalHost::hexdump(udp_packet, nbytes);
-                //printf("%s\n", inverter_packet.toString().c_str());
+/**
+ *  parse a device type reply packet and augment the given device information with the device class and device model
+ *  @return true if the packet is a valid inverter packet
+ */
+bool SpeedwireCommand::parseDeviceTypeReply(const SpeedwireHeader& speedwire_packet, SpeedwireDevice& info) {
+    if (speedwire_packet.isValidData2Packet()) {
+        if (!speedwire_packet.isValidData2Packet(true)) {
+            printf("is valid speedwire packet, but minor deviations from standard detected\n");
+        }
 
-                std::vector<SpeedwireRawData> raw_data_vector = inverter_packet.getRawDataElements();
+        SpeedwireData2Packet data2_packet(speedwire_packet);
+        if (data2_packet.isInverterProtocolID()) {
 
-                // augment the device information with data obtained the peer
-                for (auto& raw_data : raw_data_vector) {
-                    if (raw_data.id == SpeedwireData::InverterDeviceClass.id && (raw_data.type & SpeedwireDataType::TypeMask) == SpeedwireDataType::Status32) {
-                        SpeedwireRawDataStatus32 status_data(raw_data);
-                        size_t index = status_data.getSelectionIndex();
-                        if (index != (size_t)-1) {
-                            SpeedwireDeviceClass device_class = (SpeedwireDeviceClass)status_data.getValue(index);;
-                            info.deviceClass = libspeedwire::toString(device_class);
-                        }
+            SpeedwireInverterProtocol inverter_packet(data2_packet);
+            //LocalHost::hexdump(udp_packet, nbytes);
+            //printf("%s\n", inverter_packet.toString().c_str());
+
+            std::vector<SpeedwireRawData> raw_data_vector = inverter_packet.getRawDataElements();
+
+            // augment the device information with data obtained the peer
+            for (auto& raw_data : raw_data_vector) {
+                if (raw_data.id == SpeedwireData::InverterDeviceClass.id && (raw_data.type & SpeedwireDataType::TypeMask) == SpeedwireDataType::Status32) {
+                    SpeedwireRawDataStatus32 status_data(raw_data);
+                    size_t index = status_data.getSelectionIndex();
+                    if (index != (size_t)-1) {
+                        SpeedwireDeviceClass device_class = (SpeedwireDeviceClass)status_data.getValue(index);;
+                        info.deviceClass = libspeedwire::toString(device_class);
                     }
-                    else if (raw_data.id == SpeedwireData::InverterDeviceType.id && (raw_data.type & SpeedwireDataType::TypeMask) == SpeedwireDataType::Status32) {
-                        SpeedwireRawDataStatus32 status_data(raw_data);
-                        size_t index = status_data.getSelectionIndex();
-                        if (index != (size_t)-1) {
-                            SpeedwireDeviceModel device_model = (SpeedwireDeviceModel)status_data.getValue(index);;
-                            SpeedwireDeviceType device = SpeedwireDeviceType::fromDeviceModel(device_model);
-                            info.deviceModel = device.name;
-                        }
+                }
+                else if (raw_data.id == SpeedwireData::InverterDeviceType.id && (raw_data.type & SpeedwireDataType::TypeMask) == SpeedwireDataType::Status32) {
+                    SpeedwireRawDataStatus32 status_data(raw_data);
+                    size_t index = status_data.getSelectionIndex();
+                    if (index != (size_t)-1) {
+                        SpeedwireDeviceModel device_model = (SpeedwireDeviceModel)status_data.getValue(index);;
+                        SpeedwireDeviceType device = SpeedwireDeviceType::fromDeviceModel(device_model);
+                        info.deviceModel = device.name;
                     }
                 }
             }
+            return true;
         }
     }
-    //printf("%s\n", info.toString().c_str());
-    return info;
+    return false;
 }
 
 
 /**
  *  synchronously receive inverter reply; for asynchronous receiption please use class SpeedwireReceiveDispatcher
+ *  the request is retransmitted according to the retransmission policy of the token repository, while waiting for the reply
+ *  a timeout of 0 polls the socket once without blocking; packets other than the reply are passed to the receive dispatcher, if there is one
  */
 int32_t SpeedwireCommand::receiveResponse(const SpeedwireCommandTokenIndex token_index, SpeedwireSocket& socket, void* udp_buffer, const size_t udp_buffer_size, const int timeout_in_ms) {
 
@@ -280,16 +297,36 @@ int32_t SpeedwireCommand::receiveResponse(const SpeedwireCommandTokenIndex token
     pollfds.events  = POLLIN;
     pollfds.revents = 0;
 
-    // enter packet receive wait loop - any udp packets received before the inverter packet or before the timeout kicks in are skipped(!)
+    // enter packet receive wait loop - any udp packets received before the inverter packet or before the timeout kicks in are dispatched
+    const uint64_t end_time = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
     int  nbytes = -1;
     bool valid  = false;
+    bool first  = true;
     while (valid == false && nbytes != 0) {
 
+        // retransmit or expire tokens whose deadlines have passed, even if packets keep arriving
+        processTokenDeadlines();
+        if (token_repository.isValid(token_index) == false) {
+            return 0;
+        }
+
+        // limit the poll timeout to the next token deadline, so that retransmissions are sent in time
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (now >= end_time && first == false) {
+            return 0;
+        }
+        first = false;
+        uint64_t wait_time = (end_time > now ? end_time - now : 0);
+        const uint64_t next_deadline = token_repository.getNextDeadline();
+        if (next_deadline < end_time) {
+            wait_time = (next_deadline > now ? next_deadline - now : 0);
+        }
+
         // wait for a packet on the configured socket
-        int pollresult = poll(&pollfds, 1, timeout_in_ms);
+        int pollresult = poll(&pollfds, 1, (int)wait_time);
         if (pollresult == 0) {
             //perror("poll timeout in SpeedwireCommand");
-            return 0;
+            continue;
         }
         if (pollresult < 0) {
             logger.print(LogLevel::LOG_ERROR, "poll failure");
@@ -319,14 +356,20 @@ int32_t SpeedwireCommand::receiveResponse(const SpeedwireCommandTokenIndex token
                 // check if the reply is an inverter packet
                 if (data2_packet.isInverterProtocolID()) {
 
-                    // check reply packet for validity
+                    // check reply packet for validity; avoid noisy diagnostics for replies to other requests
                     const SpeedwireCommandToken& token = token_repository.at(token_index);
-                    if (checkReply(speedwire_packet, src, token) == true) {
+                    SpeedwireInverterProtocol inverter_packet(data2_packet);
+                    if ((inverter_packet.getPacketID() | 0x8000) == token.packetid && checkReply(speedwire_packet, src, token) == true) {
                         valid = true;
                         token_repository.remove(token_index);
                     }
                 }
             }
+
+            // pass any other packet on to the receive dispatcher instead of dropping it
+            if (valid == false && nbytes > 0 && dispatcher != NULL) {
+                dispatcher->dispatch(speedwire_packet, src);
+            }
         }
     }
     return nbytes;
@@ -362,6 +405,31 @@ SpeedwireCommandTokenRepository& SpeedwireCommand::getTokenRepository(void) {
 }
 
 
+/**
+ *  retransmit requests and expire tokens whose deadlines have passed; this is called implicitly while waiting in receiveResponse()
+ *  @return the number of expired tokens
+ */
+int SpeedwireCommand::processTokenDeadlines(void) {
+    return token_repository.advance(LocalHost::getTickCountInMs());
+}
+
+
+/**
+ *  retransmit the request packet of the given token to its peer
+ *  @return true if the request packet was sent
+ */
+bool SpeedwireCommand::retransmit(const SpeedwireCommandToken& token) {
+    const SocketMap::const_iterator it = socket_map.find(token.interface_ip_address);
+    if (token.request.size() == 0 || it == socket_map.end() || it->second < 0) {
+        return false;
+    }
+    SpeedwireSocket& socket = sockets[it->second];
+    logger.print(LogLevel::LOG_INFO_1, "retransmit packet id 0x%04x to %s", token.packetid, token.peer_ip_address.c_str());
+    int nsent = socket.sendto(token.request.data(), (unsigned long)token.request.size(), token.peer_ip_address);
+    return (nsent > 0);
+}
+
+
 /**
  *  check reply packet for correctness
  */
@@ -462,56 +530,320 @@ bool SpeedwireCommand::checkReply(const SpeedwireHeader& speedwire_reply_packet,
 
 //=====================================================================================
 
-SpeedwireCommandTokenIndex SpeedwireCommandTokenRepository::add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const std::string& peer_ip_address, const Command command) {
-    uint32_t create_time = (uint32_t)LocalHost::getUnixEpochTimeInMs();
-    SpeedwireCommandToken new_token = { susyid, serialnumber, packetid, peer_ip_address, command, create_time };
-    token.push_back(new_token);
-    return (SpeedwireCommandTokenIndex)token.size()-1;
+/**
+ *  constructor; the repository is empty
+ */
+SpeedwireCommandTokenRepository::SpeedwireCommandTokenRepository(void) :
+    needs_login(false),
+    slots(),
+    table(16, -1),
+    free_list(-1),
+    oldest(-1),
+    newest(-1),
+    count(0),
+    timers(256, 16, LocalHost::getTickCountInMs()),
+    retransmission_policy(),
+    retransmit_callback(),
+    expiry_callbacks(),
+    random((std::minstd_rand::result_type)LocalHost::getTickCountInMs()) {
+    retransmission_policy.timeoutInMs = 0;
+    retransmission_policy.maxRetransmissions = 0;
+    retransmission_policy.backoffFactor = 2.0;
+    retransmission_policy.jitter = 0.0;
 }
 
-void SpeedwireCommandTokenRepository::remove(const SpeedwireCommandTokenIndex index) {
-    int i = 0;
-    for (std::vector<SpeedwireCommandToken>::iterator it = token.begin(); it != token.end(); ++it, ++i) {
-        if (i == index) {
-            it = token.erase(it);
-            break;
+/**
+ *  add a new token; an existing token with the same susy id, serial number and packet id is replaced
+ *  the token deadline is set according to the retransmission policy; the request packet is kept for retransmission
+ *  @return a stable handle to the token, or -1 if the repository is full
+ */
+SpeedwireCommandTokenIndex SpeedwireCommandTokenRepository::add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const std::string& peer_ip_address, const Command command,
+                                                                const std::string& interface_ip_address, const void* const request, const size_t request_size) {
+    const uint64_t key = toKey(susyid, serialnumber, packetid);
+
+    // a packet id is only reused after 32768 packets; any token still holding it is stale
+    const size_t bucket = findBucket(key);
+    if (table[bucket] >= 0) {
+        removeSlot(table[bucket]);
+    }
+
+    // allocate a slot from the free list, or append a new slot
+    int slot = free_list;
+    if (slot >= 0) {
+        free_list = slots[slot].next;
+    }
+    else {
+        if (slots.size() > 0xffff) {
+            logger.print(LogLevel::LOG_ERROR, "token repository is full");
+            return -1;
         }
+        slot = (int)slots.size();
+        slots.push_back(Slot());
+        slots[slot].generation = 0;
+    }
+    Slot& s = slots[slot];
+    s.token.susyid = susyid;
+    s.token.serialnumber = serialnumber;
+    s.token.packetid = packetid;
+    s.token.peer_ip_address = peer_ip_address;
+    s.token.command = command;
+    s.token.create_time = (uint32_t)LocalHost::getUnixEpochTimeInMs();
+    s.token.create_tick = LocalHost::getTickCountInMs();
+    s.token.deadline = 0;
+    s.token.retransmissions = 0;
+    s.token.interface_ip_address = interface_ip_address;
+    if (request != NULL && request_size > 0 && retransmission_policy.maxRetransmissions > 0) {
+        s.token.request.assign((const uint8_t*)request, (const uint8_t*)request + request_size);
+    }
+    else {
+        s.token.request.clear();
+    }
+    s.key = key;
+    s.used = true;
+
+    // append the slot to the creation order list
+    s.prev = newest;
+    s.next = -1;
+    if (newest >= 0) {
+        slots[newest].next = slot;
+    }
+    else {
+        oldest = slot;
+    }
+    newest = slot;
+
+    // insert the slot into the hash table; keep the table at most half full
+    if ((count + 1) * 2 > table.size()) {
+        rehash(table.size() * 2);
+    }
+    table[findBucket(key)] = slot;
+    ++count;
+
+    // schedule the token deadline
+    const SpeedwireCommandTokenIndex index = toIndex(slot, s.generation);
+    if (retransmission_policy.timeoutInMs > 0) {
+        s.token.deadline = s.token.create_tick + retransmission_policy.timeoutInMs;
+        timers.schedule(s.token.deadline, index);
+    }
+    return index;
+}
+
+/**
+ *  remove the token with the given handle; stale handles are ignored
+ */
+void SpeedwireCommandTokenRepository::remove(const SpeedwireCommandTokenIndex index) {
+    if (isValid(index)) {
+        removeSlot(toSlot(index));
     }
 }
 
+/**
+ *  find the token with the given susy id, serial number and packet id
+ *  @return a stable handle to the token, or -1 if there is no such token
+ */
 int SpeedwireCommandTokenRepository::find(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) const {
-    for (int i = 0; i < token.size(); ++i) {
-        const SpeedwireCommandToken& t = token[i];
-        if (t.susyid == susyid && t.serialnumber == serialnumber && t.packetid == (packetid | 0x8000)) {
-            return i;
-        }
+    const int slot = table[findBucket(toKey(susyid, serialnumber, packetid))];
+    if (slot >= 0) {
+        return toIndex(slot, slots[slot].generation);
     }
     return -1;
 }
 
+/**
+ *  get the token with the given handle; if the token has been removed meanwhile, its last content is returned
+ */
 const SpeedwireCommandToken& SpeedwireCommandTokenRepository::at(const SpeedwireCommandTokenIndex index) const {
-    return token[index];
+    return slots[toSlot(index)].token;
+}
+
+/**
+ *  check if the given handle refers to a token in the repository
+ */
+bool SpeedwireCommandTokenRepository::isValid(const SpeedwireCommandTokenIndex index) const {
+    if (index < 0) {
+        return false;
+    }
+    const size_t slot = (size_t)toSlot(index);
+    return (slot < slots.size() && slots[slot].used == true && toIndex((int)slot, slots[slot].generation) == index);
 }
 
+/**
+ *  remove all tokens; all handles become stale
+ */
 void SpeedwireCommandTokenRepository::clear(void) {
-    token.clear();
+    while (oldest >= 0) {
+        removeSlot(oldest);
+    }
 }
 
+/**
+ *  remove all tokens older than the given timeout; tokens are visited in creation order, so only the expired tokens are visited
+ *  @return the number of removed tokens
+ */
 int SpeedwireCommandTokenRepository::expire(const int timeout_in_ms) {
-    uint32_t now = (uint32_t)LocalHost::getUnixEpochTimeInMs();
+    const uint64_t now = LocalHost::getTickCountInMs();
     int count = 0;
-    for (std::vector<SpeedwireCommandToken>::iterator it = token.begin(); it != token.end(); /*nop*/) {
-        if ((now - it->create_time) > (uint32_t)timeout_in_ms) {
-            it = token.erase(it);
-            ++count;
+    while (oldest >= 0 && (now - slots[oldest].token.create_tick) > (uint64_t)timeout_in_ms) {
+        removeSlot(oldest);
+        ++count;
+    }
+    return count;
+}
+
+/**
+ *  process all token deadlines up to the given time; requests with retransmissions left are retransmitted
+ *  through the retransmit callback and get a new deadline, all other tokens are removed and passed to the expiry callbacks
+ *  @param now the current tick count
+ *  @return the number of expired tokens
+ */
+int SpeedwireCommandTokenRepository::advance(const uint64_t now) {
+    int expired = 0;
+    timers.advance(now, [this, now, &expired](const SpeedwireCommandTokenIndex index) {
+        if (isValid(index) == false) {
+            return;     // the token received its reply meanwhile
         }
-        else {
-            ++it;
+        const int slot = toSlot(index);
+        const SpeedwireCommandToken& token = slots[slot].token;
+        if (token.retransmissions < retransmission_policy.maxRetransmissions && token.request.size() > 0 &&
+            retransmit_callback && retransmit_callback(token) == true) {
+            SpeedwireCommandToken& retransmitted_token = slots[slot].token;
+            ++retransmitted_token.retransmissions;
+            retransmitted_token.deadline = now + getRetransmissionInterval(retransmitted_token.retransmissions);
+            timers.schedule(retransmitted_token.deadline, index);
+            return;
+        }
+        const SpeedwireCommandToken expired_token = slots[slot].token;
+        removeSlot(slot);
+        ++expired;
+        for (size_t i = 0; i < expiry_callbacks.size(); ++i) {
+            expiry_callbacks[i].second(expired_token);
+        }
+    });
+    return expired;
+}
+
+/**
+ *  get the earliest token deadline
+ *  @return the earliest deadline as tick count, or (uint64_t)-1 if there is no deadline
+ */
+uint64_t SpeedwireCommandTokenRepository::getNextDeadline(void) const {
+    return timers.getNextDeadline([this](const SpeedwireCommandTokenIndex index) { return isValid(index); });
+}
+
+/**
+ *  add a callback receiving expired tokens; several owners, e.g. several query engines, can share the repository
+ *  @param owner the owner of the callback; a callback previously added by the same owner is replaced
+ *  @param callback the callback
+ */
+void SpeedwireCommandTokenRepository::addExpiryCallback(const void* const owner, const SpeedwireCommandTokenCallback& callback) {
+    for (auto& entry : expiry_callbacks) {
+        if (entry.first == owner) {
+            entry.second = callback;
+            return;
+        }
+    }
+    expiry_callbacks.push_back(std::make_pair(owner, callback));
+}
+
+/**
+ *  remove the expiry callback added by the given owner
+ *  @param owner the owner of the callback
+ */
+void SpeedwireCommandTokenRepository::removeExpiryCallback(const void* const owner) {
+    for (size_t i = 0; i < expiry_callbacks.size(); ++i) {
+        if (expiry_callbacks[i].first == owner) {
+            expiry_callbacks.erase(expiry_callbacks.begin() + i);
+            return;
         }
     }
-    return count;
 }
 
+/**
+ *  set the retransmission policy; it applies to tokens added from now on
+ */
+void SpeedwireCommandTokenRepository::setRetransmissionPolicy(const SpeedwireRetransmissionPolicy& policy) {
+    retransmission_policy = policy;
+}
+
+/**
+ *  get the interval until the deadline following the given retransmission, i.e. timeout * backoff^n varied by +-jitter
+ */
+uint64_t SpeedwireCommandTokenRepository::getRetransmissionInterval(const uint32_t retransmissions) {
+    double interval = retransmission_policy.timeoutInMs;
+    for (uint32_t i = 0; i < retransmissions; ++i) {
+        interval *= retransmission_policy.backoffFactor;
+    }
+    if (retransmission_policy.jitter > 0.0) {
+        std::uniform_real_distribution<double> distribution(1.0 - retransmission_policy.jitter, 1.0 + retransmission_policy.jitter);
+        interval *= distribution(random);
+    }
+    return (interval >= 1.0 ? (uint64_t)interval : 1);
+}
+
+/**
+ *  get the number of tokens
+ */
 int SpeedwireCommandTokenRepository::size(void) const {
-    return (int)token.size();
+    return (int)count;
+}
+
+/**
+ *  find the hash table bucket holding the given key, or the empty bucket where it would be inserted
+ */
+size_t SpeedwireCommandTokenRepository::findBucket(const uint64_t key) const {
+    const size_t mask = table.size() - 1;
+    size_t i = hash(key) & mask;
+    while (table[i] >= 0 && slots[table[i]].key != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/**
+ *  erase the given hash table bucket; subsequent entries of the probe sequence are shifted backwards, so no tombstones are needed
+ */
+void SpeedwireCommandTokenRepository::eraseBucket(size_t bucket) {
+    const size_t mask = table.size() - 1;
+    size_t i = bucket;
+    size_t j = bucket;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (table[j] < 0) {
+            break;
+        }
+        // move the entry at j to i, unless its home bucket k lies cyclically within (i, j]
+        const size_t k = hash(slots[table[j]].key) & mask;
+        const bool stays = (i <= j ? (i < k && k <= j) : (i < k || k <= j));
+        if (stays == false) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i] = -1;
+}
+
+/**
+ *  resize the hash table and re-insert all tokens
+ */
+void SpeedwireCommandTokenRepository::rehash(const size_t new_size) {
+    table.assign(new_size, -1);
+    for (int slot = oldest; slot >= 0; slot = slots[slot].next) {
+        table[findBucket(slots[slot].key)] = slot;
+    }
+}
+
+/**
+ *  remove the token in the given slot from the hash table and the creation order list, and put the slot onto the free list
+ */
+void SpeedwireCommandTokenRepository::removeSlot(const int slot) {
+    Slot& s = slots[slot];
+    eraseBucket(findBucket(s.key));
+    if (s.prev >= 0) slots[s.prev].next = s.next; else oldest = s.next;
+    if (s.next >= 0) slots[s.next].prev = s.prev; else newest = s.prev;
+    s.used = false;
+    s.generation = (uint16_t)((s.generation + 1) & 0x7fff);
+    s.prev = -1;
+    s.next = free_list;
+    free_list = slot;
+    --count;
 }
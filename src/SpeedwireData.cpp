@@ -569,7 +569,6 @@ SpeedwireData::SpeedwireData(const Command command, const uint32_t id, const uin
 SpeedwireData::SpeedwireData(void) :
     SpeedwireRawData((Command)0, 0, 0, SpeedwireDataType::Unsigned32, 0, NULL, 0),
     Measurement(MeasurementType(Direction::NO_DIRECTION, Type::NO_TYPE, Quantity::NO_QUANTITY, "", 0), Wire::NO_WIRE) {
-    description = "";
 }
 
 
@@ -665,7 +664,7 @@ bool SpeedwireData::consume(const SpeedwireRawData& data) {
 std::string SpeedwireData::toString(void) const {
     TimestampDoublePair measurementValue = measurementValues.getNewestElement();
     char buff[256];
-    snprintf(buff, sizeof(buff), "%-16s  time %lu  %s  => %lf %s\n", description.c_str(), measurementValue.time, SpeedwireRawData::toString().c_str(), measurementValue.value, measurementType.unit.c_str());
+    snprintf(buff, sizeof(buff), "%-16s  time %lu  %s  => %lf %s\n", getDescription().c_str(), measurementValue.time, SpeedwireRawData::toString().c_str(), measurementValue.value, getMeasurementType().unit.c_str());
     return std::string(buff);
 }
 
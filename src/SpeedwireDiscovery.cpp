@@ -14,6 +14,7 @@
 #include <poll.h>
 #endif
 
+#include <algorithm>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,7 +37,24 @@ using namespace libspeedwire;
  *  Constructor.
  *  @param host A reference to the LocalHost instance of this machine.
  */
-SpeedwireDiscovery::SpeedwireDiscovery(LocalHost& host) : localhost(host) {}
+SpeedwireDiscovery::SpeedwireDiscovery(LocalHost& host) :
+    localhost(host),
+    speedwireDevices(),
+    sockets(),
+    interfaceDevices(),
+    command(),
+    deviceTypeQueries(),
+    queriedDevices(),
+    running(false),
+    earlyCompletion(false),
+    broadcastCounter(0),
+    preregCounter(0),
+    subnetCounter(1),
+    socketCounter(0xffffffff),
+    numRetries(0),
+    nextSendTime(0),
+    lastSendTime(0) {
+}
 
 
 /**
@@ -47,6 +65,15 @@ SpeedwireDiscovery::~SpeedwireDiscovery(void) {
 }
 
 
+/**
+ *  Get the current tick count; this can be overridden for testing purposes.
+ *  @return The tick count in milliseconds.
+ */
+uint64_t SpeedwireDiscovery::getTickCountInMs(void) const {
+    return LocalHost::getTickCountInMs();
+}
+
+
 /**
  *  Pre-register a device IP address, i.e. just provide the ip address of the device.
  *  A pre-registered device is explicitly queried during the device discovery process. As this discovery 
@@ -204,59 +231,192 @@ unsigned long SpeedwireDiscovery::getNumberOfDevices(void) const {
 
 
 /**
- *  Try to find SMA devices on the networks connected to this host.
+ *  Try to find SMA devices on the networks connected to this host. This method blocks until the discovery is complete.
+ *  @param full_scan If true, unicast discovery requests are sent to all hosts on the local subnets.
  *  @return the number of discovered devices
  */
 int SpeedwireDiscovery::discoverDevices(const bool full_scan) {
+    if (startDiscovery(full_scan)) {
+        while (processDiscovery(max_wait_time_in_ms)) {}
+    }
+
+    // return the number of discovered and fully registered devices
+    return getNumberOfFullyRegisteredDevices();
+}
+
+
+/**
+ *  Start the discovery of SMA devices on the networks connected to this host; the discovery is then driven by calls
+ *  to processDiscovery(). Devices found so far are available from getDevices() while the discovery is running.
+ *  @param full_scan If true, unicast discovery requests are sent to all hosts on the local subnets.
+ *  @return true if the discovery is started
+ */
+bool SpeedwireDiscovery::startDiscovery(const bool full_scan) {
 
     // get a list of all local ipv4 interface addresses
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
 
-    // allocate a pollfd structure for each local ip address and populate it with the socket fds
-    std::vector<SpeedwireSocket> sockets = SpeedwireSocketFactory::getInstance(localhost)->getRecvSockets(SpeedwireSocketFactory::SocketType::ANYCAST, localIPs);
-
-    // configure state machine for discovery requests
-    const uint64_t maxWaitTimeInMillis = 2000u;
-    size_t broadcast_counter = 0;
-    size_t prereg_counter = 0;
-    size_t subnet_counter = 1;
-    size_t socket_counter = (full_scan ? 0 : 0xffffffff);
-    size_t num_retries = 3;
-
-    uint64_t startTimeInMillis = localhost.getTickCountInMs();
-    while ((localhost.getTickCountInMs() - startTimeInMillis) < maxWaitTimeInMillis) {
-        int num_sends = ((broadcast_counter == 0 || prereg_counter == 0) ? 1 : 10);
-        //printf("broadcast_counter %llu prereg_counter %llu subnet_counter %llu  socket_counter %llu\n", broadcast_counter, prereg_counter, subnet_counter, socket_counter);
-
-        // send discovery request packet and update counters
-        if (num_retries > 0) {
-            for (int i = 0; i < num_sends; ++i) {
-                if (sendNextDiscoveryPacket(broadcast_counter, prereg_counter, subnet_counter, socket_counter) == false) {
-                    --num_retries;
-                    broadcast_counter = 0;  // retry multicast discovery of unknown devices
-                    prereg_counter = 0;     // retry unicast discovery of pre-registered devices
-                    break;  // done with sending all discovery packets
-                }
-                startTimeInMillis = localhost.getTickCountInMs();
+    // get the receive sockets for all local ip addresses
+    sockets = SpeedwireSocketFactory::getInstance(localhost)->getRecvSockets(SpeedwireSocketFactory::SocketType::ANYCAST, localIPs);
+    if (sockets.size() == 0) {
+        running = false;
+        return false;
+    }
+
+    // open a command instance with a socket for each local interface to send device type queries;
+    // device type queries are retransmitted once and then given up
+    // both are kept on the heap, such that the command keeps referring to the placeholder devices if this instance is moved
+    command.reset();
+    interfaceDevices.reset(new std::vector<SpeedwireDevice>());
+    for (const auto& if_addr : localIPs) {
+        SpeedwireDevice device;
+        device.interfaceIpAddress = if_addr;
+        interfaceDevices->push_back(device);
+    }
+    command.reset(new SpeedwireCommand(localhost, *interfaceDevices));
+    SpeedwireRetransmissionPolicy policy;
+    policy.timeoutInMs = 500;
+    policy.maxRetransmissions = 1;
+    policy.backoffFactor = 2.0;
+    policy.jitter = 0.1;
+    command->getTokenRepository().setRetransmissionPolicy(policy);
+
+    reset(full_scan);
+    return true;
+}
+
+
+/**
+ *  Reset the discovery state machine to the start of the packet sequence.
+ *  @param full_scan If true, unicast discovery requests are sent to all hosts on the local subnets.
+ */
+void SpeedwireDiscovery::reset(const bool full_scan) {
+    deviceTypeQueries.clear();
+    queriedDevices.clear();
+    broadcastCounter = 0;
+    preregCounter = 0;
+    subnetCounter = 1;
+    socketCounter = (full_scan ? 0 : 0xffffffff);
+    numRetries = max_retries;
+    nextSendTime = getTickCountInMs();
+    lastSendTime = nextSendTime;
+    // there is no point in waiting for further devices, once all devices of interest are seen
+    earlyCompletion = (full_scan == false && (getNumberOfPreRegisteredIPDevices() + getNumberOfMissingDevices()) > 0);
+    running = true;
+}
+
+
+/**
+ *  Drive the discovery state machine. Discovery packets that are due are sent, device type queries are sent for devices
+ *  with incomplete information, and inbound packets are received and analyzed until the next discovery packets are due
+ *  or until the given timeout.
+ *  @param timeout_in_ms The maximum time to wait for inbound packets; 0 returns immediately after receiving pending packets.
+ *  @return true if the discovery is still running, false if it is complete
+ */
+bool SpeedwireDiscovery::processDiscovery(const int timeout_in_ms) {
+    if (running == false) {
+        return false;
+    }
+    uint64_t now = getTickCountInMs();
+
+    // send discovery request packets and update counters
+    if (numRetries > 0 && now >= nextSendTime) {
+        const size_t num_sends = ((broadcastCounter == 0 || preregCounter == 0) ? 1 : burst_size);
+        //printf("broadcast_counter %llu prereg_counter %llu subnet_counter %llu  socket_counter %llu\n", broadcastCounter, preregCounter, subnetCounter, socketCounter);
+        for (size_t i = 0; i < num_sends; ) {
+            size_t num_packets = num_sends - i;
+            if (sendNextDiscoveryPacket(broadcastCounter, preregCounter, subnetCounter, socketCounter, num_packets) == false) {
+                --numRetries;
+                broadcastCounter = 0;   // retry multicast discovery of unknown devices
+                preregCounter = 0;      // retry unicast discovery of pre-registered devices
+                break;  // done with sending all discovery packets
             }
+            i += (num_packets > 0 ? num_packets : 1);
+            lastSendTime = now;
         }
-        else {
-            broadcast_counter = localIPs.size();
-            prereg_counter = localIPs.size();
+        nextSendTime = now + (num_sends > 1 ? burst_interval_in_ms : step_interval_in_ms);
+    }
+
+    // once the first sequence of discovery packets is sent, query device type information from the peers concurrently
+    if (numRetries < max_retries) {
+        completeDeviceInformation();
+    }
+
+    // retransmit or give up device type queries whose deadlines have passed
+    if (command != NULL) {
+        command->processTokenDeadlines();
+        SpeedwireCommandTokenRepository& repository = command->getTokenRepository();
+        for (std::vector<int>::iterator it = deviceTypeQueries.begin(); it != deviceTypeQueries.end(); ) {
+            if (repository.isValid(*it) == false) {
+                printf("timeout in device type query for %s\n", repository.at(*it).peer_ip_address.c_str());
+                it = deviceTypeQueries.erase(it);
+            }
+            else {
+                it++;
+            }
         }
+    }
 
-        // wait for inbound packets on any of the configured sockets
-        pollSockets(sockets, (num_sends > 1 ? 10 : 200));
+    // wait for inbound packets on any of the configured sockets until the next event
+    uint64_t next_event = (numRetries > 0 ? nextSendTime : lastSendTime + max_wait_time_in_ms);
+    if (command != NULL && command->getTokenRepository().getNextDeadline() < next_event) {
+        next_event = command->getTokenRepository().getNextDeadline();
+    }
+    uint64_t wait_time = (next_event > now ? next_event - now : 0);
+    if (wait_time > (uint64_t)(timeout_in_ms > 0 ? timeout_in_ms : 0)) {
+        wait_time = (timeout_in_ms > 0 ? timeout_in_ms : 0);
     }
+    pollSockets(sockets, (int)wait_time);
 
-    // try to get further information about the devices by querying device type information from the peers
-    completeDeviceInformation();
+    // check if the discovery is complete
+    if (checkCompletion(getTickCountInMs())) {
+        running = false;
+        for (auto index : deviceTypeQueries) {
+            command->getTokenRepository().remove(index);
+        }
+        deviceTypeQueries.clear();
+        for (auto& device : speedwireDevices) {
+            printf("%s\n", device.toString().c_str());
+        }
+    }
+    return running;
+}
 
-    // return the number of discovered and fully registered devices
-    return getNumberOfFullyRegisteredDevices();
+
+/**
+ *  Check if the discovery is complete. This is the case once all pre-registered and required devices are seen,
+ *  if early completion is enabled, or once all sequences of discovery packets are sent and no further packets arrived
+ *  within the maximum wait time. Device type queries in flight are always waited for.
+ *  @param now The current tick count in milliseconds.
+ *  @return true if the discovery is complete
+ */
+bool SpeedwireDiscovery::checkCompletion(const uint64_t now) const {
+    if (deviceTypeQueries.size() > 0) {
+        return false;
+    }
+    if (earlyCompletion && getNumberOfPreRegisteredIPDevices() == 0 && getNumberOfMissingDevices() == 0) {
+        bool pending = false;
+        for (const auto& device : speedwireDevices) {
+            if (device.isComplete() == false && device.deviceIpAddress.length() != 0 &&
+                std::find(queriedDevices.begin(), queriedDevices.end(), device.deviceIpAddress) == queriedDevices.end()) {
+                pending = true;     // a device type query is still to be sent
+            }
+        }
+        if (pending == false) {
+            return true;
+        }
+    }
+    return (numRetries == 0 && (now - lastSendTime) >= max_wait_time_in_ms);
 }
 
 
+/**
+ *  Wait for inbound packets on the given sockets and analyze them. Once the first packets are received, all further
+ *  packets that are already pending are received without waiting.
+ *  @param sockets The sockets to receive from.
+ *  @param timeout The maximum time to wait for the first packets in milliseconds.
+ *  @return the number of received packets, or -1 on poll failure
+ */
 int SpeedwireDiscovery::pollSockets(const std::vector<SpeedwireSocket>& sockets, int timeout) {
     // prepare pollfd structure
     std::vector<struct pollfd> fds;
@@ -265,6 +425,9 @@ int SpeedwireDiscovery::pollSockets(const std::vector<SpeedwireSocket>& sockets,
         pfd.fd = socket.getSocketFd();
         fds.push_back(pfd);
     }
+    if (fds.size() == 0) {
+        return 0;
+    }
 
     int result = 0;
     while (true) {
@@ -275,28 +438,24 @@ int SpeedwireDiscovery::pollSockets(const std::vector<SpeedwireSocket>& sockets,
         }
 
         // wait for inbound packets on any of the configured sockets
-        //fprintf(stdout, "poll() ...\n");
-        int result = poll(fds.data(), (uint32_t)fds.size(), timeout);
-        if (result < 0) {   // error
+        int pollresult = poll(fds.data(), (uint32_t)fds.size(), timeout);
+        if (pollresult < 0) {   // error
             perror("poll failed");
             return -1;
         }
-        else if (result == 0) {  // timeout
-            //fprintf(stdout, "... timeout\n");
+        else if (pollresult == 0) {  // timeout
             break;
         }
-        else {
-            //fprintf(stdout, "... done\n");
-
-            // determine the socket that received a packet
-            // read packet data, analyze it and create a device information record
-            for (int j = 0; j < fds.size(); ++j) {
-                if ((fds[j].revents & POLLIN) != 0) {
-                    recvDiscoveryPackets(sockets[j]);
-                    ++result;
-                }
+
+        // determine the socket that received a packet
+        // read packet data, analyze it and create a device information record
+        for (size_t j = 0; j < fds.size(); ++j) {
+            if ((fds[j].revents & POLLIN) != 0) {
+                recvDiscoveryPackets(sockets[j]);
+                ++result;
             }
         }
+        timeout = 0;    // drain pending packets without waiting
     }
     return result;
 }
@@ -308,26 +467,31 @@ int SpeedwireDiscovery::pollSockets(const std::vector<SpeedwireSocket>& sockets,
  *  - multicast speedwire discovery requests to all interfaces
  *  - unicast speedwire discovery requests to pre-registered devices
  *  - unicast speedwire discovery requests to all hosts on the network (only if the network prefix is < /16)
+ *  The num_packets parameter provides the maximum number of unicast requests of a full scan to be sent as a single burst;
+ *  on return it holds the number of requests actually sent in this step.
  */
-bool SpeedwireDiscovery::sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter) {
+bool SpeedwireDiscovery::sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter, size_t& num_packets) {
 
     // sequentially first send multicast speedwire discovery requests
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
     if (broadcast_counter < localIPs.size()) {
         broadcast_counter = localIPs.size();
         sendMulticastDiscoveryRequestToSockets();
+        num_packets = 1;
         return true;
     }
     // followed by pre-registered ip addresses
     if (prereg_counter < localIPs.size()) {
         prereg_counter = localIPs.size();
         sendUnicastDiscoveryRequestToDevices();
+        num_packets = 1;
         return true;
     }
     // followed by a full scan based on unicast speedwire discovery requests
     if (socket_counter < localIPs.size()) {
-        return sendUnicastDiscoveryRequestToSockets(subnet_counter, socket_counter);
+        return sendUnicastDiscoveryRequestToSockets(subnet_counter, socket_counter, num_packets);
     }
+    num_packets = 0;
     return false;
 }
 
@@ -401,8 +565,10 @@ bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToDevices(void) {
 
 /**
  *  Send unicast discovery packets to each ip address in the subnet of each socket. This is used for full subnet scans.
+ *  Up to num_packets consecutive ip addresses are sent as a single batch; on return num_packets holds the number of
+ *  requests actually sent.
  */
-bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter) {
+bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter, size_t& num_packets) {
     // determine address range of local subnet
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
     const std::string& addr = localIPs[socket_counter];
@@ -417,21 +583,27 @@ bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToSockets(size_t& subnet_cou
         fprintf(stdout, "starting full scan for interface %s for ip addresses 1 ... %lu\n", addr.c_str(), max_subnet_counter);
     }
     if (subnet_counter < max_subnet_counter && socket_counter < localIPs.size()) {
-        // assemble address of the recipient
-        struct in_addr inaddr = AddressConversion::toInAddress(addr);
-        uint32_t saddr = ntohl(inaddr.s_addr);      // ip address of the interface
-        saddr = saddr & (~max_subnet_counter);      // mask subnet addresses, such that the subnet part is 0
-        saddr = saddr + (uint32_t)subnet_counter;   // add subnet address
-        sockaddr_in sockaddr;
-        sockaddr.sin_family = AF_INET;
-        sockaddr.sin_addr.s_addr = htonl(saddr);
-        sockaddr.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
-        // send to socket
-        SpeedwireSocket socket = SpeedwireSocketFactory::getInstance(localhost)->getSendSocket(SpeedwireSocketFactory::SocketType::UNICAST, addr);
-        //fprintf(stdout, "send unicast discovery request to %s (via interface %s)\n", AddressConversion::toString(sockaddr).c_str(), socket.getLocalInterfaceAddress().c_str());
         const std::array<uint8_t, 58> unicast_request = SpeedwireDiscoveryProtocol::getUnicastRequest();
-        int nbytes = socket.sendto(unicast_request.data(), (unsigned long)unicast_request.size(), sockaddr);
-        ++subnet_counter;
+        std::vector<SpeedwireSocketPacket> packets;
+        while (subnet_counter < max_subnet_counter && packets.size() < (num_packets > 0 ? num_packets : 1)) {
+            // assemble address of the recipient
+            struct in_addr inaddr = AddressConversion::toInAddress(addr);
+            uint32_t saddr = ntohl(inaddr.s_addr);      // ip address of the interface
+            saddr = saddr & (~max_subnet_counter);      // mask subnet addresses, such that the subnet part is 0
+            saddr = saddr + (uint32_t)subnet_counter;   // add subnet address
+            sockaddr_in sockaddr;
+            memset(&sockaddr, 0, sizeof(sockaddr));
+            sockaddr.sin_family = AF_INET;
+            sockaddr.sin_addr.s_addr = htonl(saddr);
+            sockaddr.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+            packets.push_back(SpeedwireSocketPacket(unicast_request.data(), (unsigned long)unicast_request.size(), sockaddr));
+            ++subnet_counter;
+        }
+        // send to socket as a single batch
+        SpeedwireSocket socket = SpeedwireSocketFactory::getInstance(localhost)->getSendSocket(SpeedwireSocketFactory::SocketType::UNICAST, addr);
+        //fprintf(stdout, "send %lu unicast discovery requests (via interface %s)\n", (unsigned long)packets.size(), socket.getLocalInterfaceAddress().c_str());
+        socket.sendto(packets);
+        num_packets = packets.size();
         return true;
     }
     // proceed with the next local interface
@@ -439,8 +611,10 @@ bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToSockets(size_t& subnet_cou
         fprintf(stdout, "completed full scan for interface %s\n", addr.c_str());
         subnet_counter = 1;
         ++socket_counter;
+        num_packets = 0;
         return true;
     }
+    num_packets = 0;
     return false;
 }
 
@@ -468,89 +642,107 @@ bool SpeedwireDiscovery::recvDiscoveryPackets(const SpeedwireSocket& socket) {
     }
     if (nbytes > 0) {
         SpeedwireHeader protocol(udp_packet, nbytes);
+        result = processDiscoveryPacket(protocol, peer_ip_address, (socket.isIpAny() ? std::string() : socket.getLocalInterfaceAddress()));
+    }
+    return result;
+}
+
 
-        // check for speedwire device discovery responses
-        if (protocol.isValidDiscoveryPacket()) {
-
-            // find ip address tag packet
-            SpeedwireDiscoveryProtocol discovery_packet(protocol);
-            struct in_addr in;
-            in.s_addr = discovery_packet.getIPv4Address();
-            if (in.s_addr != 0) {
-                std::string ip = AddressConversion::toString(in);
-                printf("received speedwire discovery response packet from %s - ipaddr tag %s\n", peer_ip_address.c_str(), ip.c_str());
-                preRegisterDevice(ip);
+/**
+ *  Analyze a received packet and create or update a device information record.
+ *  @param protocol The received packet.
+ *  @param peer_ip_address The ip address of the packet sender.
+ *  @param socket_interface_address The interface address of the receiving socket, or an empty string if the socket is bound to any interface.
+ *  @return true if a device information record was created or updated
+ */
+bool SpeedwireDiscovery::processDiscoveryPacket(const SpeedwireHeader& protocol, const std::string& peer_ip_address, const std::string& socket_interface_address) {
+    bool result = false;
+
+    // check for speedwire device discovery responses
+    if (protocol.isValidDiscoveryPacket()) {
+
+        // find ip address tag packet
+        SpeedwireDiscoveryProtocol discovery_packet(protocol);
+        struct in_addr in;
+        in.s_addr = discovery_packet.getIPv4Address();
+        if (in.s_addr != 0) {
+            std::string ip = AddressConversion::toString(in);
+            printf("received speedwire discovery response packet from %s - ipaddr tag %s\n", peer_ip_address.c_str(), ip.c_str());
+            preRegisterDevice(ip);
+        }
+    }
+    else if (protocol.isValidData2Packet()) {
+
+        SpeedwireData2Packet data2_packet(protocol);
+        uint16_t length = data2_packet.getTagLength();
+        uint16_t protocolID = data2_packet.getProtocolID();
+
+        // check for emeter protocol
+        if (SpeedwireData2Packet::isEmeterProtocolID(protocolID) || SpeedwireData2Packet::isExtendedEmeterProtocolID(protocolID)) {
+            //LocalHost::hexdump(udp_packet, nbytes);
+            SpeedwireEmeterProtocol emeter(protocol);
+            SpeedwireDevice device;
+            device.deviceAddress = SpeedwireAddress(emeter.getSusyID(), emeter.getSerialNumber());
+            const SpeedwireDeviceType &device_type = SpeedwireDeviceType::fromSusyID(device.deviceAddress.susyID);
+            if (device_type.deviceClass != SpeedwireDeviceClass::UNKNOWN) {
+                device.deviceClass = toString(device_type.deviceClass);
+                device.deviceModel = device_type.name;
+            }
+            else {
+                device.deviceClass = "Emeter";
+                device.deviceModel = "Emeter";
+            }
+            device.deviceIpAddress = peer_ip_address;
+            device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(peer_ip_address);
+            if (device.interfaceIpAddress == "") {
+                device.interfaceIpAddress = socket_interface_address;
+            }
+            if (registerDevice(device)) {
+                printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.c_str());
+                result = true;
             }
         }
-        else if (protocol.isValidData2Packet()) {
-
-            SpeedwireData2Packet data2_packet(protocol);
-            uint16_t length = data2_packet.getTagLength();
-            uint16_t protocolID = data2_packet.getProtocolID();
-
-            // check for emeter protocol
-            if (SpeedwireData2Packet::isEmeterProtocolID(protocolID) || SpeedwireData2Packet::isExtendedEmeterProtocolID(protocolID)) {
-                //LocalHost::hexdump(udp_packet, nbytes);
-                SpeedwireEmeterProtocol emeter(protocol);
-                SpeedwireDevice device;
-                device.deviceAddress = SpeedwireAddress(emeter.getSusyID(), emeter.getSerialNumber());
-                const SpeedwireDeviceType &device_type = SpeedwireDeviceType::fromSusyID(device.deviceAddress.susyID);
-                if (device_type.deviceClass != SpeedwireDeviceClass::UNKNOWN) {
-                    device.deviceClass = toString(device_type.deviceClass);
-                    device.deviceModel = device_type.name;
-                }
-                else {
-                    device.deviceClass = "Emeter";
-                    device.deviceModel = "Emeter";
-                }
-                device.deviceIpAddress = peer_ip_address;
-                device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(peer_ip_address);
-                if (device.interfaceIpAddress == "" && socket.isIpAny() == false) {
-                    device.interfaceIpAddress = socket.getLocalInterfaceAddress();
-                }
-                if (registerDevice(device)) {
-                    printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.c_str());
-                    result = true;
-                }
+        // check for replies to device type queries
+        else if (SpeedwireData2Packet::isInverterProtocolID(protocolID) && processDeviceTypeReply(protocol, peer_ip_address)) {
+            result = true;
+        }
+        // check for inverter protocol and ignore loopback packets
+        else if (SpeedwireData2Packet::isInverterProtocolID(protocolID) &&
+            SpeedwireDiscoveryProtocol(protocol).isUnicastResponsePacket()) {
+            SpeedwireInverterProtocol inverter_packet(protocol);
+            //LocalHost::hexdump(udp_packet, nbytes);
+            //printf("%s\n", inverter_packet.toString().c_str());
+            SpeedwireDevice device;
+            device.deviceAddress = SpeedwireAddress(inverter_packet.getSrcSusyID(), inverter_packet.getSrcSerialNumber());
+            device.deviceClass = "Inverter";
+            device.deviceModel = "Inverter";
+            device.deviceIpAddress = peer_ip_address;
+            device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(peer_ip_address);
+            if (device.interfaceIpAddress.length() == 0) {
+                device.interfaceIpAddress = socket_interface_address;
             }
-            // check for inverter protocol and ignore loopback packets
-            else if (SpeedwireData2Packet::isInverterProtocolID(protocolID) &&
-                SpeedwireDiscoveryProtocol(protocol).isUnicastResponsePacket()) {
-                SpeedwireInverterProtocol inverter_packet(protocol);
-                //LocalHost::hexdump(udp_packet, nbytes);
-                //printf("%s\n", inverter_packet.toString().c_str());
-                SpeedwireDevice device;
-                device.deviceAddress = SpeedwireAddress(inverter_packet.getSrcSusyID(), inverter_packet.getSrcSerialNumber());
-                device.deviceClass = "Inverter";
-                device.deviceModel = "Inverter";
-                device.deviceIpAddress = peer_ip_address;
-                device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(peer_ip_address);
-                if (device.interfaceIpAddress.length() == 0 && socket.isIpAny() == false) {
-                    device.interfaceIpAddress = socket.getLocalInterfaceAddress();
-                }
-                // try to get further information about the device by examining the susy id; this is not accurate
-                const SpeedwireDeviceType& device_type = SpeedwireDeviceType::fromSusyID(device.deviceAddress.susyID);
-                if (device_type.deviceClass != SpeedwireDeviceClass::UNKNOWN) {
-                    device.deviceClass = toString(device_type.deviceClass);
-                    device.deviceModel = device_type.name;
-                }
-                if (registerDevice(device)) {
-                    printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.c_str());
-                    result = true;
-                }
-#if 0
-                // dump reply information; this is just the src susyid and serialnumber together with some unknown bits
-                printf("%s\n", inverter_packet.toString().c_str());
-                std::vector<SpeedwireRawData> raw_data = inverter_packet.getRawDataElements();
-                for (auto& rd : raw_data) {
-                    printf("%s\n", rd.toString().c_str());
-                }
-#endif
+            // try to get further information about the device by examining the susy id; this is not accurate
+            const SpeedwireDeviceType& device_type = SpeedwireDeviceType::fromSusyID(device.deviceAddress.susyID);
+            if (device_type.deviceClass != SpeedwireDeviceClass::UNKNOWN) {
+                device.deviceClass = toString(device_type.deviceClass);
+                device.deviceModel = device_type.name;
             }
-            else if (!SpeedwireData2Packet::isInverterProtocolID(protocolID)) {
-                printf("received unknown response packet 0x%04x\n", protocolID);
-                perror("unexpected response");
+            if (registerDevice(device)) {
+                printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.c_str());
+                result = true;
+            }
+#if 0
+            // dump reply information; this is just the src susyid and serialnumber together with some unknown bits
+            printf("%s\n", inverter_packet.toString().c_str());
+            std::vector<SpeedwireRawData> raw_data = inverter_packet.getRawDataElements();
+            for (auto& rd : raw_data) {
+                printf("%s\n", rd.toString().c_str());
             }
+#endif
+        }
+        else if (!SpeedwireData2Packet::isInverterProtocolID(protocolID)) {
+            printf("received unknown response packet 0x%04x\n", protocolID);
+            perror("unexpected response");
         }
     }
     return result;
@@ -558,33 +750,82 @@ bool SpeedwireDiscovery::recvDiscoveryPackets(const SpeedwireSocket& socket) {
 
 
 /**
- *  Receive a discovery packet, analyze it and create a device information record.
+ *  Match a received packet against the device type queries in flight and update the device information record
+ *  with the device class and device model from the reply.
+ *  @param packet The received packet.
+ *  @param peer_ip_address The ip address of the packet sender.
+ *  @return true if the packet is a reply to a device type query
  */
-bool SpeedwireDiscovery::completeDeviceInformation(void) {
-    const uint32_t max_retries = 1;
-    uint32_t num_retries = 0;
-
-    while (num_retries < max_retries) {
-        // try to get further information about the device by querying device type information from the peer
-        for (auto& device : speedwireDevices) {
-            if (device.interfaceIpAddress.length() == 0 || device.interfaceIpAddress == "0.0.0.0") {
-                device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(device.deviceIpAddress);
-            }
-            // if the ip address and interface address is known, just query the device
-            if (device.isComplete() == false && device.deviceIpAddress.length() != 0 && device.interfaceIpAddress.length() != 0) {
-                SpeedwireCommand command(localhost, speedwireDevices);
-                SpeedwireDevice updatedDevice = command.queryDeviceType(device);
-                if (updatedDevice.isComplete() == true) {
-                    registerDevice(updatedDevice);
-                    printf("%s\n", updatedDevice.toString().c_str());
+bool SpeedwireDiscovery::processDeviceTypeReply(const SpeedwireHeader& packet, const std::string& peer_ip_address) {
+    if (command == NULL || deviceTypeQueries.size() == 0) {
+        return false;
+    }
+    // replies are matched by packet id and ip address, as pre-registered devices are queried by their broadcast address
+    const SpeedwireInverterProtocol inverter_packet(packet);
+    SpeedwireCommandTokenRepository& repository = command->getTokenRepository();
+    for (std::vector<int>::iterator it = deviceTypeQueries.begin(); it != deviceTypeQueries.end(); ++it) {
+        const SpeedwireCommandToken& token = repository.at(*it);
+        if ((uint16_t)(inverter_packet.getPacketID() | 0x8000) == (uint16_t)(token.packetid | 0x8000) && token.peer_ip_address == peer_ip_address) {
+            for (auto& device : speedwireDevices) {
+                if (device.deviceIpAddress == peer_ip_address) {
+                    SpeedwireDevice info = device;
+                    if (info.deviceAddress.isComplete() == false) {
+                        info.deviceAddress = SpeedwireAddress(inverter_packet.getSrcSusyID(), inverter_packet.getSrcSerialNumber());
+                    }
+                    SpeedwireCommand::parseDeviceTypeReply(packet, info);
+                    if (info.isComplete() == true) {
+                        if (device.hasIPAddressOnly()) {
+                            registerDevice(info);   // this also merges devices pre-registered by serial number
+                        }
+                        else {
+                            device = info;
+                        }
+                        printf("%s\n", info.toString().c_str());
+                    }
+                    break;
                 }
             }
+            repository.remove(*it);
+            deviceTypeQueries.erase(it);
+            return true;
         }
-        ++num_retries;
     }
+    return false;
+}
+
+
+/**
+ *  Send device type queries to all devices with incomplete device information that were not queried before.
+ *  The queries are sent without waiting; their replies are received by processDiscovery().
+ *  @return true if any query was sent
+ */
+bool SpeedwireDiscovery::completeDeviceInformation(void) {
+    if (command == NULL) {
+        return false;
+    }
+    bool result = false;
     for (auto& device : speedwireDevices) {
-        printf("%s\n", device.toString().c_str());
+        if (device.isComplete() == true || device.deviceIpAddress.length() == 0 ||
+            std::find(queriedDevices.begin(), queriedDevices.end(), device.deviceIpAddress) != queriedDevices.end()) {
+            continue;
+        }
+        queriedDevices.push_back(device.deviceIpAddress);
+        if (device.interfaceIpAddress.length() == 0 || device.interfaceIpAddress == "0.0.0.0") {
+            device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(device.deviceIpAddress);
+        }
+        // if the ip address and interface address is known, query the device; devices pre-registered by their
+        // ip address are queried by the broadcast address
+        if (device.interfaceIpAddress.length() != 0) {
+            SpeedwireDevice peer = device;
+            if (peer.deviceAddress.isComplete() == false) {
+                peer.deviceAddress = SpeedwireAddress::getBroadcastAddress();
+            }
+            SpeedwireCommandTokenIndex index = command->sendQueryRequest(peer, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF);
+            if (index >= 0) {
+                deviceTypeQueries.push_back(index);
+                result = true;
+            }
+        }
     }
-    return true;
+    return result;
 }
-
@@ -0,0 +1,254 @@
+#include <cmath>
+#include <limits>
+#include <LocalHost.hpp>
+#include <Logger.hpp>
+#include <SpeedwireData.hpp>
+#include <SpeedwireHeader.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwirePollScheduler.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwirePollScheduler");
+
+
+/**
+ * Constructor.
+ * @param query_engine Reference to the SpeedwireQueryEngine instance used to send queries.
+ * @param result_callback Callback receiving the results of all queries submitted by this scheduler.
+ */
+SpeedwirePollScheduler::SpeedwirePollScheduler(SpeedwireQueryEngine& query_engine, const SpeedwireQueryCallback& result_callback) :
+    engine(query_engine),
+    policy(),
+    callback(result_callback),
+    entries() {
+}
+
+
+/**
+ * Get the current tick count; this can be overridden for testing purposes.
+ * @return The tick count in milliseconds.
+ */
+uint64_t SpeedwirePollScheduler::getTickCountInMs(void) const {
+    return LocalHost::getTickCountInMs();
+}
+
+
+/**
+ * Add a poll entry. If there is already an entry for the same device, command and register range, its intervals
+ * are updated instead, such that the register range is queried only once. The entry is due immediately.
+ * @param peer The device to query.
+ * @param cmd The command identifier.
+ * @param first_register The first register id.
+ * @param last_register The last register id.
+ * @param interval_in_ms The target poll interval in milliseconds.
+ * @param min_interval_in_ms The lower bound of the adapted poll interval in milliseconds.
+ * @param max_interval_in_ms The upper bound of the adapted poll interval in milliseconds.
+ * @return The handle of the poll entry.
+ */
+SpeedwirePollHandle SpeedwirePollScheduler::add(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register,
+                                                const uint32_t interval_in_ms, const uint32_t min_interval_in_ms, const uint32_t max_interval_in_ms) {
+    const uint32_t min_interval = (min_interval_in_ms < interval_in_ms ? min_interval_in_ms : interval_in_ms);
+    const uint32_t max_interval = (max_interval_in_ms > interval_in_ms ? max_interval_in_ms : interval_in_ms);
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (entry.device.deviceAddress == peer.deviceAddress && entry.command == cmd &&
+            entry.firstRegister == first_register && entry.lastRegister == last_register) {
+            entry.targetInterval = interval_in_ms;
+            entry.minInterval = min_interval;
+            entry.maxInterval = max_interval;
+            entry.interval = interval_in_ms;
+            return (SpeedwirePollHandle)i;
+        }
+    }
+    Entry entry;
+    entry.device = peer;
+    entry.command = cmd;
+    entry.firstRegister = first_register;
+    entry.lastRegister = last_register;
+    entry.targetInterval = interval_in_ms;
+    entry.minInterval = min_interval;
+    entry.maxInterval = max_interval;
+    entry.interval = interval_in_ms;
+    entry.lastPollTime = 0;
+    entry.nextPollTime = getTickCountInMs();
+    entry.inFlight = false;
+    entry.numPolls = 0;
+    entry.numNanPolls = 0;
+    entries.push_back(entry);
+    return (SpeedwirePollHandle)(entries.size() - 1);
+}
+
+
+/**
+ * Submit the queries of all due entries to the query engine. Entries due within the burst window are included,
+ * such that entries with similar intervals are polled in the same burst. Entries with a query still in flight
+ * are skipped. The queries are sent by the next call to SpeedwireQueryEngine::send() or run().
+ * @return The number of submitted queries.
+ */
+size_t SpeedwirePollScheduler::poll(void) {
+    const uint64_t now = getTickCountInMs();
+    const uint64_t horizon = now + policy.burstWindowInMs;
+    size_t submitted = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (entry.inFlight == true || entry.nextPollTime > horizon) {
+            continue;
+        }
+        entry.inFlight = true;
+        entry.lastPollTime = now;
+        const SpeedwirePollHandle handle = (SpeedwirePollHandle)i;
+        engine.submit(entry.device, entry.command, entry.firstRegister, entry.lastRegister,
+                      [this, handle](const SpeedwireQueryResult& result) { complete(handle, result); });
+        ++submitted;
+    }
+    return submitted;
+}
+
+
+/**
+ * Get the tick count when the next entry is due.
+ * @return The tick count in milliseconds, or (uint64_t)-1 if there are no entries waiting to be polled.
+ */
+uint64_t SpeedwirePollScheduler::getNextPollTime(void) const {
+    uint64_t next = (uint64_t)-1;
+    for (const auto& entry : entries) {
+        if (entry.inFlight == false && entry.nextPollTime < next) {
+            next = entry.nextPollTime;
+        }
+    }
+    return next;
+}
+
+
+/**
+ * Completion callback of queries submitted by poll(); adapt the interval of the entry and forward the result.
+ * @param handle The handle of the poll entry.
+ * @param result The completion information of the query.
+ */
+void SpeedwirePollScheduler::complete(const SpeedwirePollHandle handle, const SpeedwireQueryResult& result) {
+    if (handle < entries.size()) {
+        Entry& entry = entries[handle];
+        entry.inFlight = false;
+        ++entry.numPolls;
+        if (result.status == SpeedwireQueryStatus::SUCCESS) {
+            adapt(entry, getValues(result.packet));
+        }
+        else {
+            const double stretched = entry.interval * policy.slowdownFactor;
+            entry.interval = (uint32_t)(stretched < entry.maxInterval ? stretched : entry.maxInterval);
+        }
+        // schedule relative to the burst time, so that entries polled together stay in phase
+        entry.nextPollTime = entry.lastPollTime + entry.interval;
+        logger.print(LogLevel::LOG_INFO_3, "entry %lu command 0x%08lx interval %lu ms", (unsigned long)handle, (uint32_t)entry.command, (unsigned long)entry.interval);
+    }
+    if (callback) {
+        callback(result);
+    }
+}
+
+
+/**
+ * Adapt the interval of the given entry to the values of the most recent reply.
+ * @param entry The poll entry.
+ * @param values The values of the most recent reply, NaN for NaN values.
+ */
+void SpeedwirePollScheduler::adapt(Entry& entry, const std::vector<double>& values) {
+    bool all_nan = (values.size() > 0);
+    bool changed = false;
+    bool volatile_values = false;
+    for (size_t i = 0; i < values.size(); ++i) {
+        const double value = values[i];
+        all_nan &= std::isnan(value);
+        if (i >= entry.values.size()) {
+            changed = true;
+            continue;
+        }
+        const double previous = entry.values[i];
+        if (std::isnan(value) || std::isnan(previous)) {
+            if (std::isnan(value) != std::isnan(previous)) {
+                changed = volatile_values = true;   // e.g. at dawn or dusk
+            }
+            continue;
+        }
+        if (value != previous) {
+            changed = true;
+            const double reference = (std::fabs(previous) > 1.0 ? std::fabs(previous) : 1.0);
+            if (std::fabs(value - previous) / reference > policy.volatilityThreshold) {
+                volatile_values = true;
+            }
+        }
+    }
+    const bool first_reply = (entry.values.size() != values.size());
+    entry.values = values;
+
+    double interval = entry.interval;
+    if (all_nan) {
+        ++entry.numNanPolls;
+        if (entry.numNanPolls >= policy.darknessPolls) {
+            interval = entry.maxInterval;
+        }
+        else {
+            interval *= policy.darknessFactor;
+        }
+    }
+    else {
+        const bool dark = (entry.numNanPolls >= policy.darknessPolls);
+        entry.numNanPolls = 0;
+        if (first_reply || dark) {
+            interval = entry.targetInterval;
+        }
+        else if (volatile_values) {
+            interval *= policy.speedupFactor;
+        }
+        else if (!changed) {
+            interval *= policy.slowdownFactor;
+        }
+        else {
+            interval = (interval + entry.targetInterval) / 2;
+        }
+    }
+    if (interval < entry.minInterval) interval = entry.minInterval;
+    if (interval > entry.maxInterval) interval = entry.maxInterval;
+    entry.interval = (uint32_t)interval;
+}
+
+
+/**
+ * Get the first value of each register of the given reply packet. String and timeline registers do not have
+ * numeric values and are skipped.
+ * @param packet The reply packet data.
+ * @return The values, NaN for NaN values.
+ */
+std::vector<double> SpeedwirePollScheduler::getValues(const std::vector<uint8_t>& packet) {
+    std::vector<double> values;
+    if (packet.size() == 0) {
+        return values;
+    }
+    SpeedwireHeader header(packet.data(), (unsigned long)packet.size());
+    SpeedwireInverterProtocol inverter(header);
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (const auto& raw_data : inverter.getRawDataElements()) {
+        if (raw_data.data_size < 4) {
+            continue;
+        }
+        const SpeedwireDataType type = (raw_data.type & SpeedwireDataType::TypeMask);
+        if (type == SpeedwireDataType::Unsigned32) {
+            SpeedwireRawDataUnsigned32 data(raw_data);
+            const uint32_t value = data.getValue(0);     // also covers the lower half of 64-bit energy values
+            values.push_back(data.isNanValue(value) ? nan : data.convertValueToDouble(value));
+        }
+        else if (type == SpeedwireDataType::Signed32) {
+            SpeedwireRawDataSigned32 data(raw_data);
+            const int32_t value = data.getValue(0);
+            values.push_back(data.isNanValue(value) ? nan : data.convertValueToDouble(value));
+        }
+        else if (type == SpeedwireDataType::Status32) {
+            SpeedwireRawDataStatus32 data(raw_data);
+            const size_t index = data.getSelectionIndex();
+            const uint32_t value = (index != (size_t)-1 ? data.getValue(index) : data.getValue(0));
+            values.push_back(data.isNanValue(value) ? nan : data.convertValueToDouble(value));
+        }
+    }
+    return values;
+}
@@ -0,0 +1,297 @@
+#include <LocalHost.hpp>
+#include <Logger.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireQueryEngine.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwireQueryEngine");
+
+
+/**
+ * Constructor.
+ * @param host Reference to the LocalHost instance.
+ * @param cmd Reference to the SpeedwireCommand instance used to send query requests and to check reply packets.
+ * @param max_in_flight_per_device Maximum number of queries in flight per device.
+ * @param timeout_in_ms Timeout of each query in milliseconds.
+ */
+SpeedwireQueryEngine::SpeedwireQueryEngine(LocalHost& host, SpeedwireCommand& cmd, const size_t max_in_flight_per_device, const int timeout_in_ms) :
+    InverterPacketReceiverBase(host),
+    command(cmd),
+    maxInFlightPerDevice(max_in_flight_per_device > 0 ? max_in_flight_per_device : 1),
+    timeoutInMs(timeout_in_ms),
+    nextId(1),
+    numPending(0),
+    numCompleted(0),
+    queries(),
+    tokens(),
+    devices(),
+    timers(256, 16, 0) {
+    command.getTokenRepository().addExpiryCallback(this, [this](const SpeedwireCommandToken& token) { tokenExpired(token); });
+}
+
+
+/**
+ * Destructor. Pending queries are dropped without calling their callbacks.
+ */
+SpeedwireQueryEngine::~SpeedwireQueryEngine(void) {
+    command.getTokenRepository().removeExpiryCallback(this);
+    for (const auto& entry : tokens) {
+        const SpeedwireQueryResult& result = queries[entry.second].result;
+        removeToken(result, (uint16_t)entry.first);
+    }
+}
+
+
+/**
+ * Get the current tick count; this can be overridden for testing purposes.
+ * @return The tick count in milliseconds.
+ */
+uint64_t SpeedwireQueryEngine::getTickCountInMs(void) const {
+    return LocalHost::getTickCountInMs();
+}
+
+
+/**
+ * Send a query request packet; this can be overridden for testing purposes.
+ * @param peer The device to send the query to.
+ * @param cmd The command identifier.
+ * @param first_register The first register id.
+ * @param last_register The last register id.
+ * @return The index of the command token, or -1 if the request could not be sent.
+ */
+SpeedwireCommandTokenIndex SpeedwireQueryEngine::sendRequest(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register) {
+    const SpeedwireCommand::SocketMap& socket_map = command.getSocketMap();
+    const SpeedwireCommand::SocketMap::const_iterator it = socket_map.find(peer.interfaceIpAddress);
+    if (it == socket_map.end() || it->second < 0) {
+        logger.print(LogLevel::LOG_ERROR, "no socket for interface %s", peer.interfaceIpAddress.c_str());
+        return -1;
+    }
+    return command.sendQueryRequest(peer, cmd, first_register, last_register);
+}
+
+
+/**
+ * Submit a query. The query is queued and sent by the next call to send() or run(), once the number of queries in
+ * flight for the device is below the limit. Queries to the same device are sent in submission order. The device
+ * address must be complete, i.e. broadcast queries are not supported.
+ * @param peer The device to send the query to.
+ * @param cmd The command identifier.
+ * @param first_register The first register id.
+ * @param last_register The last register id.
+ * @param callback The callback to be called upon completion, timeout or failure of the query.
+ * @return The query id.
+ */
+uint32_t SpeedwireQueryEngine::submit(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register, const SpeedwireQueryCallback& callback) {
+    const uint32_t id = nextId++;
+    Query& query = queries[id];
+    query.result.id = id;
+    query.result.device = peer;
+    query.result.command = cmd;
+    query.result.firstRegister = first_register;
+    query.result.lastRegister = last_register;
+    query.callback = callback;
+    query.packetId = 0;
+    query.sendTime = 0;
+    query.deadline = 0;
+
+    DeviceQueue& queue = devices[peer.deviceAddress.toKey()];
+    queue.pending.push_back(id);
+    ++numPending;
+    return id;
+}
+
+
+/**
+ * Send queued queries for all devices, as long as the number of queries in flight for each device is below the limit.
+ * Timed out queries are expired beforehand, so that they do not count against the limit.
+ * @return The number of query requests sent.
+ */
+size_t SpeedwireQueryEngine::send(void) {
+    expire();
+    size_t nsent = 0;
+    for (auto& entry : devices) {
+        DeviceQueue& queue = entry.second;
+        while (queue.inFlight < maxInFlightPerDevice && queue.pending.empty() == false) {
+            const uint32_t id = queue.pending.front();
+            queue.pending.pop_front();
+            --numPending;
+
+            Query& query = queries[id];
+            const SpeedwireQueryResult& result = query.result;
+            const uint64_t now = getTickCountInMs();
+            const SpeedwireCommandTokenIndex token_index = sendRequest(result.device, result.command, result.firstRegister, result.lastRegister);
+            if (token_index < 0) {
+                complete(id, SpeedwireQueryStatus::SEND_FAILURE, now);
+                continue;
+            }
+            const SpeedwireCommandToken& token = command.getTokenRepository().at(token_index);
+            query.packetId = token.packetid;
+            query.sendTime = now;
+            query.deadline = now + timeoutInMs;
+            tokens[toTokenKey(token.susyid, token.serialnumber, token.packetid)] = id;
+            timers.schedule(query.deadline, id);
+            ++queue.inFlight;
+            ++nsent;
+        }
+    }
+    return nsent;
+}
+
+
+/**
+ * Complete all queries in flight, where the timeout has elapsed. Token deadlines are processed beforehand, so that
+ * requests are retransmitted according to the retransmission policy of the token repository; queries are completed
+ * as soon as their token expires. The timeout of the engine is an upper bound for the total time including retransmissions.
+ * @return The number of timed out queries.
+ */
+size_t SpeedwireQueryEngine::expire(void) {
+    const size_t completed_before = numCompleted;
+    command.processTokenDeadlines();
+    const uint64_t now = getTickCountInMs();
+    size_t count = numCompleted - completed_before;
+    timers.advance(now, [this, now, &count](const uint32_t id) {
+        const auto it = queries.find(id);
+        if (it != queries.end()) {
+            removeToken(it->second.result, it->second.packetId);
+            complete(id, SpeedwireQueryStatus::TIMEOUT, now);
+            ++count;
+        }
+    });
+    return count;
+}
+
+
+/**
+ * Send all queued queries and receive reply packets until all queries are completed or the given time has elapsed.
+ * The poll timeout of the dispatcher is limited by the next query or token deadline. Any other packets received on the
+ * given sockets are passed on to their registered receivers.
+ * @param dispatcher The receive dispatcher; this instance must be registered as a receiver.
+ * @param sockets The sockets to receive replies from.
+ * @param max_wait_time_in_ms Maximum time to wait for replies; negative values are treated as 0.
+ * @return The number of queries completed during this call.
+ */
+int SpeedwireQueryEngine::run(SpeedwireReceiveDispatcher& dispatcher, const std::vector<SpeedwireSocket>& sockets, const int max_wait_time_in_ms) {
+    const uint64_t start_time = getTickCountInMs();
+    const uint64_t max_wait_time = (max_wait_time_in_ms > 0 ? (uint64_t)max_wait_time_in_ms : 0);
+    const size_t completed_before = numCompleted;
+    send();
+    while (isIdle() == false) {
+        const uint64_t now = getTickCountInMs();
+        const uint64_t elapsed = now - start_time;
+        if (elapsed >= max_wait_time) {
+            break;
+        }
+        uint64_t wait_time = max_wait_time - elapsed;
+        uint64_t next_deadline = timers.getNextDeadline([this](const uint32_t id) { return queries.find(id) != queries.end(); });
+        const uint64_t next_token_deadline = command.getTokenRepository().getNextDeadline();
+        if (next_token_deadline < next_deadline) {
+            next_deadline = next_token_deadline;
+        }
+        if (next_deadline != (uint64_t)-1) {
+            const uint64_t time_to_deadline = (next_deadline > now ? next_deadline - now : 0);
+            if (time_to_deadline < wait_time) wait_time = time_to_deadline;
+        }
+        if (dispatcher.dispatch(sockets, (int)wait_time) < 0) {
+            logger.print(LogLevel::LOG_ERROR, "dispatch failure");
+        }
+        send();
+    }
+    return (int)(numCompleted - completed_before);
+}
+
+
+/**
+ * Receive an inverter packet from the dispatcher and complete the corresponding query in flight, if any.
+ * Packets not belonging to any query in flight are ignored.
+ * @param packet Reference to a packet instance that was received from the socket.
+ * @param src Reference to a socket address with the ip address and port of the packet sender.
+ */
+void SpeedwireQueryEngine::receive(SpeedwireHeader& packet, struct sockaddr& src) {
+    if (tokens.empty() || packet.isValidData2Packet() == false) {
+        return;
+    }
+    const SpeedwireData2Packet data2_packet(packet);
+    if (data2_packet.isInverterProtocolID() == false) {
+        return;
+    }
+    const SpeedwireInverterProtocol inverter_packet(data2_packet);
+    const auto it = tokens.find(toTokenKey(inverter_packet.getSrcSusyID(), inverter_packet.getSrcSerialNumber(), inverter_packet.getPacketID()));
+    if (it == tokens.end()) {
+        return;
+    }
+    const uint32_t id = it->second;
+
+    // check the reply against its command token
+    SpeedwireCommandTokenRepository& token_repository = command.getTokenRepository();
+    const int token_index = command.findCommandToken(packet);
+    if (token_index < 0 || command.checkReply(packet, src, token_repository.at(token_index)) == false) {
+        return;
+    }
+    token_repository.remove(token_index);
+
+    // copy the reply packet and check the error code
+    Query& query = queries[id];
+    const uint8_t* const data = packet.getPacketPointer();
+    query.result.packet.assign(data, data + packet.getPacketSize());
+    query.result.errorCode = inverter_packet.getErrorCode();
+    if (query.result.errorCode == 0x0017) {
+        logger.print(LogLevel::LOG_ERROR, "lost connection - not authenticated (error code 0x0017)");
+        token_repository.needs_login = true;
+    }
+    complete(id, (query.result.errorCode == 0x0000 ? SpeedwireQueryStatus::SUCCESS : SpeedwireQueryStatus::ERROR_CODE), getTickCountInMs());
+}
+
+
+/**
+ * Internal implementation to complete a query and call its callback.
+ * @param id The query id.
+ * @param status The completion status.
+ * @param now The current tick count.
+ */
+void SpeedwireQueryEngine::complete(const uint32_t id, const SpeedwireQueryStatus status, const uint64_t now) {
+    const auto it = queries.find(id);
+    if (it == queries.end()) {
+        return;
+    }
+    Query query = std::move(it->second);
+    queries.erase(it);
+
+    // release the in-flight slot of the device
+    if (status != SpeedwireQueryStatus::SEND_FAILURE) {
+        const SpeedwireAddress& address = query.result.device.deviceAddress;
+        tokens.erase(toTokenKey(address.susyID, address.serialNumber, query.packetId));
+        --devices[address.toKey()].inFlight;
+        query.result.roundTripTime = (uint32_t)(now - query.sendTime);
+    }
+    query.result.status = status;
+    ++numCompleted;
+    if (query.callback) {
+        query.callback(query.result);
+    }
+}
+
+
+/**
+ * Internal implementation to complete the query of a command token that expired in the token repository.
+ * @param token The expired token.
+ */
+void SpeedwireQueryEngine::tokenExpired(const SpeedwireCommandToken& token) {
+    const auto it = tokens.find(toTokenKey(token.susyid, token.serialnumber, token.packetid));
+    if (it != tokens.end()) {
+        complete(it->second, SpeedwireQueryStatus::TIMEOUT, getTickCountInMs());
+    }
+}
+
+
+/**
+ * Internal implementation to remove the command token of a query in flight from the token repository.
+ * @param result The completion information of the query.
+ * @param packetid The packet id of the query request.
+ */
+void SpeedwireQueryEngine::removeToken(const SpeedwireQueryResult& result, const uint16_t packetid) {
+    SpeedwireCommandTokenRepository& token_repository = command.getTokenRepository();
+    const int token_index = token_repository.find(result.device.deviceAddress.susyID, result.device.deviceAddress.serialNumber, packetid);
+    if (token_index >= 0) {
+        token_repository.remove(token_index);
+    }
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <Logger.hpp>
+#include <SpeedwireQueryPlanner.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwireQueryPlanner");
+
+
+/**
+ * Constructor.
+ * @param max_reply_size Maximum size of a reply packet in bytes.
+ * @param max_gap_in_registers Maximum number of unrequested registers between two registers merged into the same range.
+ */
+SpeedwireQueryPlanner::SpeedwireQueryPlanner(const size_t max_reply_size, const uint32_t max_gap_in_registers) :
+    maxReplySize(max_reply_size),
+    maxGap(max_gap_in_registers),
+    cache() {
+}
+
+
+/**
+ * Get the estimated size of a register record in a reply packet. Each record consists of a register id word, a timestamp
+ * and the data values.
+ * @param command The command identifier.
+ * @param type The data type of the register.
+ * @return The estimated record size in bytes.
+ */
+size_t SpeedwireQueryPlanner::getRecordSize(const Command command, const SpeedwireDataType type) {
+    if ((command & Command::ID_MASK) == (Command::ENERGY_QUERY & Command::ID_MASK)) {
+        return 8 + 8;       // single 64-bit counter value
+    }
+    const SpeedwireDataType masked_type = (type & SpeedwireDataType::TypeMask);
+    if (masked_type == SpeedwireDataType::String32 || masked_type == SpeedwireDataType::Status32) {
+        return 8 + 32;      // 32 bytes of string data or 8 status values
+    }
+    return 8 + 20;          // 4 values and a trailing word
+}
+
+
+/**
+ * Get the estimated size of the records of all known registers within the given register range.
+ * @param command The command identifier.
+ * @param first_register The first register id of the gap.
+ * @param last_register The last register id of the gap.
+ * @return The estimated size in bytes.
+ */
+size_t SpeedwireQueryPlanner::getGapSize(const Command command, const uint32_t first_register, const uint32_t last_register) const {
+    size_t size = 0;
+    const SpeedwireDataMap& map = SpeedwireDataMap::getGlobalMap();
+    for (auto it = map.lower_bound(first_register); it != map.end() && it->first <= last_register; ++it) {
+        if (it->second.command == command) {
+            size += getRecordSize(command, it->second.type);
+        }
+    }
+    return size;
+}
+
+
+/**
+ * Get the query plan for the given elements. The plan is created on first use and cached; the order of the elements
+ * and duplicate elements do not matter.
+ * @param elements The requested elements.
+ * @return The query plan; it remains valid until clear() is called.
+ */
+const SpeedwireQueryPlan& SpeedwireQueryPlanner::getPlan(const std::vector<SpeedwireData>& elements) {
+    std::vector<uint64_t> key;
+    key.reserve(elements.size());
+    for (const auto& element : elements) {
+        key.push_back(((uint64_t)element.command << 32) | element.toKey());
+    }
+    std::sort(key.begin(), key.end());
+    key.erase(std::unique(key.begin(), key.end()), key.end());
+
+    std::map<std::vector<uint64_t>, SpeedwireQueryPlan>::iterator it = cache.find(key);
+    if (it == cache.end()) {
+        it = cache.insert(std::make_pair(key, createPlan(elements))).first;
+    }
+    return it->second;
+}
+
+
+/**
+ * Create a query plan for the given elements.
+ * @param elements The requested elements.
+ * @return The query plan, ordered by command and register id.
+ */
+SpeedwireQueryPlan SpeedwireQueryPlanner::createPlan(std::vector<SpeedwireData> elements) const {
+    std::sort(elements.begin(), elements.end(), [](const SpeedwireData& a, const SpeedwireData& b) {
+        return (a.command != b.command ? a.command < b.command : a.toKey() < b.toKey());
+    });
+
+    SpeedwireQueryPlan plan;
+    for (const auto& element : elements) {
+        const size_t record_size = getRecordSize(element.command, element.type);
+        const uint32_t last_register = element.id | 0xff;
+        if (plan.size() > 0 && plan.back().command == element.command) {
+            SpeedwireQueryRange& range = plan.back();
+            if (element.id == (range.lastRegister & 0xffffff00)) {
+                // same register, i.e. another connector or a duplicate
+                if (range.elements.back().toKey() != element.toKey()) {
+                    range.replySize += record_size;
+                    range.elements.push_back(element);
+                }
+                continue;
+            }
+            const uint32_t gap = ((element.id - (range.lastRegister & 0xffffff00)) >> 8) - 1;
+            if (gap <= maxGap) {
+                const size_t reply_size = range.replySize + getGapSize(element.command, range.lastRegister + 1, element.id - 1) + record_size;
+                if (reply_size <= maxReplySize) {
+                    range.lastRegister = last_register;
+                    range.replySize = reply_size;
+                    range.elements.push_back(element);
+                    continue;
+                }
+            }
+        }
+        SpeedwireQueryRange range;
+        range.command = element.command;
+        range.firstRegister = element.id;
+        range.lastRegister = last_register;
+        range.replySize = reply_header_size + record_size;
+        range.elements.push_back(element);
+        plan.push_back(range);
+    }
+    for (const auto& range : plan) {
+        logger.print(LogLevel::LOG_INFO_2, "command 0x%08lx registers 0x%08lx-0x%08lx elements %lu reply size %lu",
+                     (uint32_t)range.command, range.firstRegister, range.lastRegister, (unsigned long)range.elements.size(), (unsigned long)range.replySize);
+    }
+    return plan;
+}
+
+
+/**
+ * Submit the queries of the plan for the given elements to the query engine.
+ * @param engine The query engine.
+ * @param peer The device to query.
+ * @param elements The requested elements.
+ * @param callback The completion callback of each query.
+ * @return The number of submitted queries.
+ */
+size_t SpeedwireQueryPlanner::submit(SpeedwireQueryEngine& engine, const SpeedwireDevice& peer, const std::vector<SpeedwireData>& elements, const SpeedwireQueryCallback& callback) {
+    const SpeedwireQueryPlan& plan = getPlan(elements);
+    for (const auto& range : plan) {
+        engine.submit(peer, range.command, range.firstRegister, range.lastRegister, callback);
+    }
+    return plan.size();
+}
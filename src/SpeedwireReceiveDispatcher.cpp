@@ -87,89 +87,110 @@ int  SpeedwireReceiveDispatcher::dispatch(const std::vector<SpeedwireSocket>& so
                 nbytes = socket.recvfrom(udp_packet, sizeof(udp_packet), AddressConversion::toSockAddrIn6(src));
             }
 
-            // check if it is a speedwire discovery packet
+            // check the packet and pass it to the relevant registered packet consumers
             SpeedwireHeader speedwire_packet(udp_packet, nbytes);
-            if (speedwire_packet.isValidDiscoveryPacket()) {
-                logger.print(LogLevel::LOG_INFO_2, "received discovery packet  time %lu\n", (uint32_t)LocalHost::getUnixEpochTimeInMs());
-                for (auto& receiver : receivers) {
-                    if (receiver->protocolID == 0x0000) {
-                        receiver->receive(speedwire_packet, src);
-                    }
-                }
+            const int result = dispatch(speedwire_packet, src);
+            if (result < 0) {
+                return -1;
             }
-            // check if it is an sma data2 speedwire packet
-            else if (speedwire_packet.isValidData2Packet()) {
-
-                SpeedwireData2Packet data2_packet(speedwire_packet);
-                uint16_t length     = data2_packet.getTagLength();
-                uint16_t protocolID = data2_packet.getProtocolID();
-
-                bool valid_emeter_packet = false;
-                bool valid_inverter_packet = false;
-
-                // check if it is an sma emeter packet
-                if (SpeedwireData2Packet::isEmeterProtocolID(protocolID) ||
-                    SpeedwireData2Packet::isExtendedEmeterProtocolID(protocolID)) {
-                    SpeedwireEmeterProtocol emeter(speedwire_packet);
-                    uint16_t susyid = emeter.getSusyID();
-                    uint32_t serial = emeter.getSerialNumber();
-                    uint32_t time   = emeter.getTime();
-                    logger.print(LogLevel::LOG_INFO_2, "received emeter packet  time %lu\n", time);
-                    valid_emeter_packet = true;
-                    ++npackets;
-                }
-                // check if it is an sma inverter packet
-                else if (SpeedwireData2Packet::isInverterProtocolID(protocolID)) {
-                    uint8_t longwords = data2_packet.getLongWords();
-
-                    // a few quick sanity checks
-                    if ((length + (size_t)20) > sizeof(udp_packet)) {    // packet length - starting to count from the byte following protocolID, # of long words and control byte, i.e. with byte #20
-                        logger.print(LogLevel::LOG_ERROR, "length field %u and buff_size %u mismatch\n", length, (unsigned)sizeof(udp_packet));
-                        return -1;
-                    }
-                    if (length < (8 + 8 + 6)) {                         // up to and including packetID
-                        logger.print(LogLevel::LOG_ERROR, "length field %u too small to hold inverter packet (8 + 8 + 6)\n", length);
-                        return -1;
-                    }
-                    if ((longwords != (length / sizeof(uint32_t)))) {
-                        logger.print(LogLevel::LOG_ERROR, "length field %u and long words %u mismatch\n", length, longwords);
-                        return -1;
-                    }
-
-                    logger.print(LogLevel::LOG_INFO_2, "received inverter packet  time %lu\n", (uint32_t)LocalHost::getUnixEpochTimeInMs());
-                    valid_inverter_packet = true;
-                    ++npackets;
-                }
-                // check if it is an sma 6075 packet
-                else if (SpeedwireData2Packet::isEncryptionProtocolID(protocolID)) {
-                    SpeedwireEncryptionProtocol encryption(speedwire_packet);
-                    logger.print(LogLevel::LOG_INFO_2, "received encryption packet  time %lu\n", (uint32_t)LocalHost::getUnixEpochTimeInMs());
-                    //logger.print(LogLevel::LOG_INFO_2, "%s\n", encryption.toString().c_str());
-                    valid_inverter_packet = true;
-                    ++npackets;
-                }
-                else {
-                    logger.print(LogLevel::LOG_WARNING, "received unknown protocol 0x%04x time %lu\n", protocolID, (uint32_t)LocalHost::getUnixEpochTimeInMs());
-                }
+            npackets += result;
+        }
+    }
+    return npackets;
+}
+
+
+/**
+ * Dispatch method for a single packet - checks the validity of the given packet and dispatches it to its corresponding
+ * registered receivers. This is used by dispatch() for each received packet; it can also be used by other receive loops,
+ * like SpeedwireCommand::receiveResponse(), to pass on packets they are not waiting for.
+ * @param speedwire_packet Reference to the received packet
+ * @param src Reference to a socket address with the ip address and port of the packet sender
+ * @return Returns 1 for a valid emeter, inverter or encryption packet, 0 for any other packet, or -1 if an inverter packet failed the sanity checks.
+ */
+int  SpeedwireReceiveDispatcher::dispatch(SpeedwireHeader& speedwire_packet, struct sockaddr& src) {
+    int npackets = 0;
 
-                // pass it to the relevant registered packet consumers
-                for (auto& receiver : receivers) {
-                    switch (receiver->protocolID) {
-                    case 0x0000:
-                        receiver->receive(speedwire_packet, src);
-                        break;
-                    case SpeedwireData2Packet::sma_emeter_protocol_id:
-                        if (valid_emeter_packet == true) {
-                            receiver->receive(speedwire_packet, src);
-                        }
-                        break;
-                    case SpeedwireData2Packet::sma_inverter_protocol_id:
-                        if (valid_inverter_packet == true) {
-                            receiver->receive(speedwire_packet, src);
-                        }
-                        break;
-                    }
+    // check if it is a speedwire discovery packet
+    if (speedwire_packet.isValidDiscoveryPacket()) {
+        logger.print(LogLevel::LOG_INFO_2, "received discovery packet  time %lu\n", (uint32_t)LocalHost::getUnixEpochTimeInMs());
+        for (auto& receiver : receivers) {
+            if (receiver->protocolID == 0x0000) {
+                receiver->receive(speedwire_packet, src);
+            }
+        }
+    }
+    // check if it is an sma data2 speedwire packet
+    else if (speedwire_packet.isValidData2Packet()) {
+
+        SpeedwireData2Packet data2_packet(speedwire_packet);
+        uint16_t length     = data2_packet.getTagLength();
+        uint16_t protocolID = data2_packet.getProtocolID();
+
+        bool valid_emeter_packet = false;
+        bool valid_inverter_packet = false;
+
+        // check if it is an sma emeter packet
+        if (SpeedwireData2Packet::isEmeterProtocolID(protocolID) ||
+            SpeedwireData2Packet::isExtendedEmeterProtocolID(protocolID)) {
+            SpeedwireEmeterProtocol emeter(speedwire_packet);
+            uint16_t susyid = emeter.getSusyID();
+            uint32_t serial = emeter.getSerialNumber();
+            uint32_t time   = emeter.getTime();
+            logger.print(LogLevel::LOG_INFO_2, "received emeter packet  time %lu\n", time);
+            valid_emeter_packet = true;
+            ++npackets;
+        }
+        // check if it is an sma inverter packet
+        else if (SpeedwireData2Packet::isInverterProtocolID(protocolID)) {
+            uint8_t longwords = data2_packet.getLongWords();
+
+            // a few quick sanity checks
+            if ((length + (size_t)20) > speedwire_packet.getPacketSize()) {    // packet length - starting to count from the byte following protocolID, # of long words and control byte, i.e. with byte #20
+                logger.print(LogLevel::LOG_ERROR, "length field %u and buff_size %u mismatch\n", length, (unsigned)speedwire_packet.getPacketSize());
+                return -1;
+            }
+            if (length < (8 + 8 + 6)) {                         // up to and including packetID
+                logger.print(LogLevel::LOG_ERROR, "length field %u too small to hold inverter packet (8 + 8 + 6)\n", length);
+                return -1;
+            }
+            if ((longwords != (length / sizeof(uint32_t)))) {
+                logger.print(LogLevel::LOG_ERROR, "length field %u and long words %u mismatch\n", length, longwords);
+                return -1;
+            }
+
+            logger.print(LogLevel::LOG_INFO_2, "received inverter packet  time %lu\n", (uint32_t)LocalHost::getUnixEpochTimeInMs());
+            valid_inverter_packet = true;
+            ++npackets;
+        }
+        // check if it is an sma 6075 packet
+        else if (SpeedwireData2Packet::isEncryptionProtocolID(protocolID)) {
+            SpeedwireEncryptionProtocol encryption(speedwire_packet);
+            logger.print(LogLevel::LOG_INFO_2, "received encryption packet  time %lu\n", (uint32_t)LocalHost::getUnixEpochTimeInMs());
+            //logger.print(LogLevel::LOG_INFO_2, "%s\n", encryption.toString().c_str());
+            valid_inverter_packet = true;
+            ++npackets;
+        }
+        else {
+            logger.print(LogLevel::LOG_WARNING, "received unknown protocol 0x%04x time %lu\n", protocolID, (uint32_t)LocalHost::getUnixEpochTimeInMs());
+        }
+
+        // pass it to the relevant registered packet consumers
+        for (auto& receiver : receivers) {
+            switch (receiver->protocolID) {
+            case 0x0000:
+                receiver->receive(speedwire_packet, src);
+                break;
+            case SpeedwireData2Packet::sma_emeter_protocol_id:
+                if (valid_emeter_packet == true) {
+                    receiver->receive(speedwire_packet, src);
+                }
+                break;
+            case SpeedwireData2Packet::sma_inverter_protocol_id:
+                if (valid_inverter_packet == true) {
+                    receiver->receive(speedwire_packet, src);
                 }
+                break;
             }
         }
     }
@@ -1,7 +1,12 @@
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <chrono>
 #include <cstring>
 #include <stdio.h>
+#include <thread>
 #include <vector>
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
 #include <SpeedwireSocket.hpp>
 #include <AddressConversion.hpp>
 using namespace libspeedwire;
@@ -621,3 +626,117 @@ int SpeedwireSocket::sendto(const void* const buff, const unsigned long size, co
     return nbytes;
 }
 
+
+/**
+ *  Send a batch of udp packets. Packets are sent in bursts of the given number of packets, each burst is handed
+ *  over to the kernel by a single sendmmsg() system call if available. Bursts are separated by the given gap, such
+ *  that the small network interfaces of inverters are not overrun by a large batch, e.g. during a subnet scan.
+ *  A failing packet does not abort the batch; the remaining packets are still sent.
+ *  @param packets The packets to send.
+ *  @param burst_size The maximum number of packets per burst, or 0 to send all packets in a single burst.
+ *  @param burst_gap_in_us The gap between two bursts in microseconds.
+ *  @return The number of packets sent.
+ */
+int SpeedwireSocket::sendto(const std::vector<SpeedwireSocketPacket>& packets, const size_t burst_size, const uint32_t burst_gap_in_us) const {
+    const size_t burst = (burst_size > 0 ? burst_size : packets.size());
+    int npackets = 0;
+    for (size_t first = 0; first < packets.size(); first += burst) {
+        if (first > 0 && burst_gap_in_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(burst_gap_in_us));
+        }
+        const size_t num_packets = (packets.size() - first < burst ? packets.size() - first : burst);
+        npackets += sendBurst(&packets[first], num_packets);
+    }
+    return npackets;
+}
+
+
+/**
+ *  Send a burst of udp packets. Multicast destinations and sockets without a dedicated interface address require
+ *  interface configuration before each packet and are sent one by one.
+ *  @param packets Pointer to the first packet of the burst.
+ *  @param num_packets The number of packets of the burst.
+ *  @return The number of packets sent.
+ */
+int SpeedwireSocket::sendBurst(const SpeedwireSocketPacket* const packets, const size_t num_packets) const {
+    bool per_packet = true;
+#ifdef __linux__
+    per_packet = false;
+    for (size_t i = 0; i < num_packets; ++i) {
+        if (packets[i].isMulticast() || (packets[i].dest.addr.sa_family == AF_INET && socket_interface_v4.s_addr == 0)) {
+            per_packet = true;
+            break;
+        }
+    }
+    if (per_packet == false) {
+        std::vector<struct mmsghdr> msgs(num_packets);
+        std::vector<struct iovec>   iovs(num_packets);
+        memset(msgs.data(), 0, num_packets * sizeof(struct mmsghdr));
+        for (size_t i = 0; i < num_packets; ++i) {
+            iovs[i].iov_base = (void*)packets[i].buff;
+            iovs[i].iov_len  = packets[i].size;
+            msgs[i].msg_hdr.msg_name    = (void*)&packets[i].dest;
+            msgs[i].msg_hdr.msg_namelen = (packets[i].dest.addr.sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+            msgs[i].msg_hdr.msg_iov     = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+        }
+        int npackets = 0;
+        size_t next = 0;
+        while (next < num_packets) {
+            int nsent = ::sendmmsg(socket_fd, &msgs[next], (unsigned int)(num_packets - next), 0);
+            if (nsent < 0) {
+                perror("sendmmsg failure");
+                ++next;     // skip the failing packet
+                continue;
+            }
+            npackets += nsent;
+            next += nsent;
+        }
+        return npackets;
+    }
+#endif
+    int npackets = 0;
+    for (size_t i = 0; i < num_packets; ++i) {
+        if (sendto(packets[i].buff, packets[i].size, packets[i].dest.addr) >= 0) {
+            ++npackets;
+        }
+    }
+    return npackets;
+}
+
+
+/**
+ *  Constructor for a packet to an ipv4 destination.
+ */
+SpeedwireSocketPacket::SpeedwireSocketPacket(const void* const _buff, const unsigned long _size, const struct sockaddr_in& _dest) :
+    buff(_buff),
+    size(_size) {
+    memset(&dest, 0, sizeof(dest));
+    dest.addr4 = _dest;
+}
+
+
+/**
+ *  Constructor for a packet to an ipv6 destination.
+ */
+SpeedwireSocketPacket::SpeedwireSocketPacket(const void* const _buff, const unsigned long _size, const struct sockaddr_in6& _dest) :
+    buff(_buff),
+    size(_size) {
+    memset(&dest, 0, sizeof(dest));
+    dest.addr6 = _dest;
+}
+
+
+/**
+ *  Check if the destination of the packet is a multicast address.
+ */
+bool SpeedwireSocketPacket::isMulticast(void) const {
+    if (dest.addr.sa_family == AF_INET) {
+        return IN_MULTICAST(ntohl(dest.addr4.sin_addr.s_addr));       // 224.0.0.0/4
+    }
+    if (dest.addr.sa_family == AF_INET6) {
+        return IN6_IS_ADDR_MULTICAST(&dest.addr6.sin6_addr);        // ff00::/8
+    }
+    return false;
+}
+
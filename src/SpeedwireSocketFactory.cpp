@@ -1,3 +1,4 @@
+#include <mutex>
 #include <SpeedwireSocketFactory.hpp>
 using namespace libspeedwire;
 
@@ -5,6 +6,9 @@ using namespace libspeedwire;
 //! The static instance variable
 SpeedwireSocketFactory* SpeedwireSocketFactory::instance = NULL;
 
+//! Mutex protecting the creation of the static instance
+static std::mutex instance_mutex;
+
 
 /**
  * Singleton get instance method using the default strategy for obtaining sockets from the operating system.
@@ -29,10 +33,12 @@ SpeedwireSocketFactory* SpeedwireSocketFactory::getInstance(const LocalHost& loc
 
 /**
  * Singleton get instance method using the given strategy for obtaining sockets from the operating system.
+ * This method is thread-safe; the strategy of the first call is used.
  * @param localhost Reference to a LocalHost instance.
  * @param strategy The strategy to use for obtaining sockets from the OS.
  */
 SpeedwireSocketFactory* SpeedwireSocketFactory::getInstance(const LocalHost& localhost, const SocketStrategy strategy) {
+    std::lock_guard<std::mutex> lock(instance_mutex);
     if (instance == NULL) {
         instance = new SpeedwireSocketFactory(localhost, strategy);
     }
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <AveragingProcessor.hpp>
+
+using namespace libspeedwire;
+
+// obis consumer recording all consumed values
+class RecordingObisConsumer : public ObisConsumer {
+public:
+    std::vector<TimestampDoublePair> values;
+    int end_of_data_count;
+
+    RecordingObisConsumer(void) : end_of_data_count(0) {}
+    virtual void consume(const SpeedwireDevice& /*device*/, ObisData& element) {
+        values.push_back(element.measurementValues.getNewestElement());
+        ASSERT_EQ(element.measurementValues.getNumberOfElements(), 1);
+    }
+    virtual void endOfObisData(const SpeedwireDevice& /*device*/, const uint32_t /*timestamp*/) { ++end_of_data_count; }
+};
+
+// test averaging of obis values over exactly one averaging window
+TEST(AveragingProcessorTest, ObisAveraging) {
+    AveragingProcessor processor(5000, 0);
+    RecordingObisConsumer consumer;
+    processor.addConsumer(consumer);
+
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x15d, 1234567);
+    ObisData element = ObisData::PositiveActivePowerTotal;
+    element.measurementValues.setMaximumNumberOfElements(100);
+
+    // emeter packets are received once per second; values are 0, 1, 2, ...
+    for (uint32_t i = 0; i <= 10; ++i) {
+        element.measurementValues.addMeasurement((double)i, 1000000 + i * 1000);
+        processor.consume(device, element);
+        processor.endOfObisData(device, 1000000 + i * 1000);
+    }
+    ASSERT_EQ(consumer.values.size(), 2);
+    ASSERT_EQ(consumer.end_of_data_count, 2);
+    ASSERT_EQ(consumer.values[0].time, 1005000);
+    ASSERT_EQ(consumer.values[0].value, (0.0 + 1.0 + 2.0 + 3.0 + 4.0) / 5);
+    ASSERT_EQ(consumer.values[1].time, 1010000);
+    ASSERT_EQ(consumer.values[1].value, (5.0 + 6.0 + 7.0 + 8.0 + 9.0) / 5);
+
+    AggregatedValue aggregate;
+    ASSERT_TRUE(processor.getLastAggregate(device, element, aggregate));
+    ASSERT_EQ(aggregate.count, 5);
+    ASSERT_EQ(aggregate.min, 5.0);
+    ASSERT_EQ(aggregate.max, 9.0);
+    ASSERT_EQ(aggregate.time, 1010000);
+    ASSERT_FALSE(processor.getLastAggregate(device, ObisData::NegativeActivePowerTotal, aggregate));
+}
+
+// test pass-through without averaging
+TEST(AveragingProcessorTest, NoAveraging) {
+    AveragingProcessor processor(0, 0);
+    RecordingObisConsumer consumer;
+    processor.addConsumer(consumer);
+
+    SpeedwireDevice device;
+    ObisData element = ObisData::PositiveActivePowerTotal;
+    element.measurementValues.setMaximumNumberOfElements(1);
+    for (uint32_t i = 0; i < 3; ++i) {
+        element.measurementValues.addMeasurement((double)i, i * 1000);
+        processor.consume(device, element);
+    }
+    ASSERT_EQ(consumer.values.size(), 3);
+    ASSERT_EQ(consumer.values[2].value, 2.0);
+}
+
+// test several concurrent output intervals, each routed to its own consumer
+TEST(AveragingProcessorTest, MultiRate) {
+    AveragingProcessor processor(1000, 0);
+    const size_t interval_1min  = processor.addInterval(60000, 0);
+    const size_t interval_15min = processor.addInterval(900000, 0);
+    ASSERT_EQ(processor.getNumberOfIntervals(), 3);
+
+    RecordingObisConsumer consumer_1s, consumer_1min, consumer_15min;
+    processor.addConsumer(consumer_1s);
+    processor.addConsumer(consumer_1min, interval_1min);
+    processor.addConsumer(consumer_15min, interval_15min);
+
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x15d, 1234567);
+    ObisData element = ObisData::PositiveActivePowerTotal;
+    element.measurementValues.setMaximumNumberOfElements(10);
+
+    // one emeter packet per second for 30 minutes
+    double sum_15min = 0.0;
+    for (uint32_t i = 0; i <= 1800; ++i) {
+        element.measurementValues.addMeasurement((double)(i % 100), i * 1000);
+        processor.consume(device, element);
+        processor.endOfObisData(device, i * 1000);
+        if (i < 900) sum_15min += (double)(i % 100);
+    }
+    ASSERT_EQ(consumer_1s.values.size(), 1800);
+    ASSERT_EQ(consumer_1min.values.size(), 30);
+    ASSERT_EQ(consumer_15min.values.size(), 2);
+    ASSERT_EQ(consumer_1s.end_of_data_count, 1800);
+    ASSERT_EQ(consumer_1min.end_of_data_count, 30);
+    ASSERT_EQ(consumer_15min.end_of_data_count, 2);
+    ASSERT_EQ(consumer_15min.values[0].time, 900000);
+    ASSERT_EQ(consumer_15min.values[0].value, sum_15min / 900);
+
+    AggregatedValue aggregate;
+    ASSERT_TRUE(processor.getLastAggregate(device, element, aggregate, interval_1min));
+    ASSERT_EQ(aggregate.count, 60);
+    ASSERT_FALSE(processor.getLastAggregate(device, element, aggregate, 3));
+}
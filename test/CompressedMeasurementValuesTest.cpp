@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <CompressedMeasurementValues.hpp>
+
+using namespace libspeedwire;
+
+// test bit stream write and read operations
+TEST(CompressedMeasurementValuesTest, BitStream) {
+    BitStream stream;
+    stream.write(0x1, 1);
+    stream.write(0x5, 3);
+    stream.write(0x123456789abcdef0ull, 64);
+    stream.write(0x7f, 7);
+    ASSERT_EQ(stream.num_bits, 75);
+    ASSERT_EQ(stream.bytes.size(), 10);
+
+    size_t pos = 0;
+    ASSERT_EQ(stream.read(pos, 1), 0x1);
+    ASSERT_EQ(stream.read(pos, 3), 0x5);
+    ASSERT_EQ(stream.read(pos, 64), 0x123456789abcdef0ull);
+    ASSERT_EQ(stream.read(pos, 7), 0x7f);
+    ASSERT_EQ(pos, 75);
+}
+
+// test lossless round trip of a single block, including irregular timestamps and a timestamp wrap-around
+TEST(CompressedMeasurementValuesTest, BlockRoundTrip) {
+    std::vector<TimestampDoublePair> input;
+    uint32_t time = 0xffff0000;
+    std::srand(1);
+    for (size_t i = 0; i < 1000; ++i) {
+        const double value = (i % 7 == 0 ? 1234.5 : (double)std::rand() / 7.0);
+        input.push_back(TimestampDoublePair(value, time));
+        time += (i % 100 == 0 ? 100000 : 1000 + (std::rand() % 50) - 25);
+    }
+    CompressedMeasurementBlock block;
+    for (const auto& pair : input) {
+        block.addMeasurement(pair.value, pair.time);
+    }
+    ASSERT_EQ(block.count, input.size());
+    ASSERT_EQ(block.first_time, input.front().time);
+    ASSERT_EQ(block.last_time, input.back().time);
+
+    std::vector<TimestampDoublePair> output;
+    ASSERT_EQ(block.decode(output), input.size());
+    ASSERT_EQ(output.size(), input.size());
+    for (size_t i = 0; i < input.size(); ++i) {
+        ASSERT_EQ(output[i].time, input[i].time);
+        ASSERT_EQ(output[i].value, input[i].value);
+    }
+}
+
+// test the block store with retention limit, seek and compression ratio
+TEST(CompressedMeasurementValuesTest, Store) {
+    CompressedMeasurementValues store(100, 10);
+    ASSERT_EQ(store.findBlockIndex(0), (size_t)-1);
+
+    // slowly varying 1 Hz power values in W with 0.1 W resolution
+    for (uint32_t i = 0; i < 1500; ++i) {
+        const double value = (double)(1000 + (i / 60) * 5) / 10.0;
+        store.addMeasurement(value, 1000000 + i * 1000);
+    }
+    ASSERT_EQ(store.getNumberOfBlocks(), 10);
+    ASSERT_EQ(store.getNumberOfElements(), 1000);
+    ASSERT_EQ(store.getBlock(0).first_time, 1000000 + 500 * 1000);
+    ASSERT_EQ(store.findBlockIndex(1000000 + 1050 * 1000), 5);
+
+    // 16 bytes per uncompressed sample
+    const size_t uncompressed_size = store.getNumberOfElements() * sizeof(TimestampDoublePair);
+    ASSERT_LT(store.getCompressedSize() * 10, uncompressed_size);
+
+    std::vector<TimestampDoublePair> output;
+    ASSERT_EQ(store.decode(1000000 + 1050 * 1000, 1000000 + 1249 * 1000, output), 200);
+    ASSERT_EQ(output.front().time, 1000000 + 1050 * 1000);
+    ASSERT_EQ(output.back().time, 1000000 + 1249 * 1000);
+    ASSERT_EQ(output.back().value, (double)(1000 + (1249 / 60) * 5) / 10.0);
+
+    // append from a ring buffer; only newer measurements are added
+    MeasurementValues mv(4);
+    mv.addMeasurement(1.0, 1000000 + 1498 * 1000);
+    mv.addMeasurement(2.0, 1000000 + 1499 * 1000);
+    mv.addMeasurement(3.0, 1000000 + 1500 * 1000);
+    ASSERT_EQ(store.addMeasurements(mv), 1);
+}
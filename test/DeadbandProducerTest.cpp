@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <DeadbandProducer.hpp>
+
+using namespace libspeedwire;
+
+// producer recording all produced values
+class RecordingValueProducer : public Producer {
+public:
+    std::vector<double> values;
+    virtual void flush(void) {}
+    virtual void produce(const SpeedwireDevice& /*device*/, const MeasurementType& /*type*/, const Wire /*wire*/, const double value, const uint32_t /*time_in_ms*/) {
+        values.push_back(value);
+    }
+};
+
+// deadband producer with a manually controlled tick count
+class TestDeadbandProducer : public DeadbandProducer {
+public:
+    uint64_t tick;
+    TestDeadbandProducer(Producer& producer, const unsigned long heartbeat) : DeadbandProducer(producer, heartbeat), tick(0) {}
+protected:
+    virtual uint64_t getTickCountInMs(void) const { return tick; }
+};
+
+// test absolute, relative and change-only deadbands
+TEST(DeadbandProducerTest, Deadband) {
+    RecordingValueProducer recorder;
+    TestDeadbandProducer producer(recorder, 0);
+    producer.setDeadband(Quantity::POWER, 10.0);
+    producer.setDeadband(Quantity::VOLTAGE, 0.0, 0.01);
+    producer.setDeadband(Quantity::STATUS, 0.0);
+    producer.setDeadband(MeasurementType::EmeterSignedActivePower(), 100.0);
+    SpeedwireDevice device1, device2;
+    device1.deviceAddress = SpeedwireAddress(0x15d, 1);
+    device2.deviceAddress = SpeedwireAddress(0x15d, 2);
+
+    const MeasurementType power = MeasurementType::InverterPower();
+    producer.produce(device1, power, Wire::L1, 1000.0);     // first value of channel
+    producer.produce(device1, power, Wire::L1, 1005.0);     // suppressed
+    producer.produce(device1, power, Wire::L2, 1005.0);     // first value of channel
+    producer.produce(device2, power, Wire::L1, 1005.0);     // first value of channel
+    producer.produce(device1, power, Wire::L1, 1011.0);     // outside
+    producer.produce(device1, power, Wire::L1, 1001.0);     // suppressed
+    ASSERT_EQ(recorder.values.size(), 4);
+    ASSERT_EQ(recorder.values[3], 1011.0);
+
+    // measurement type configuration takes precedence
+    const MeasurementType signed_power = MeasurementType::EmeterSignedActivePower();
+    producer.produce(device1, signed_power, Wire::TOTAL, 0.0);
+    producer.produce(device1, signed_power, Wire::TOTAL, 50.0);
+    ASSERT_EQ(recorder.values.size(), 5);
+
+    // relative deadband
+    const MeasurementType voltage = MeasurementType::InverterVoltage();
+    producer.produce(device1, voltage, Wire::L1, 230.0);
+    producer.produce(device1, voltage, Wire::L1, 232.0);
+    producer.produce(device1, voltage, Wire::L1, 233.0);
+    ASSERT_EQ(recorder.values.size(), 7);
+
+    // change-only
+    const MeasurementType status = MeasurementType::InverterStatus();
+    producer.produce(device1, status, Wire::RELAY_ON, 1.0);
+    producer.produce(device1, status, Wire::RELAY_ON, 1.0);
+    producer.produce(device1, status, Wire::RELAY_ON, 0.0);
+    ASSERT_EQ(recorder.values.size(), 9);
+
+    // no configuration
+    const MeasurementType energy = MeasurementType::InverterEnergy();
+    producer.produce(device1, energy, Wire::TOTAL, 1.0);
+    producer.produce(device1, energy, Wire::TOTAL, 1.0);
+    ASSERT_EQ(recorder.values.size(), 11);
+    ASSERT_EQ(producer.getNumberOfPassedValues(), 11);
+    ASSERT_EQ(producer.getNumberOfSuppressedValues(), 5);
+}
+
+// test heartbeat emission
+TEST(DeadbandProducerTest, Heartbeat) {
+    RecordingValueProducer recorder;
+    TestDeadbandProducer producer(recorder, 60);
+    producer.setDeadband(Quantity::STATUS, 0.0);
+    SpeedwireDevice device;
+    const MeasurementType status = MeasurementType::InverterStatus();
+
+    for (uint64_t i = 0; i <= 180; ++i) {
+        producer.tick = i * 1000;
+        producer.produce(device, status, Wire::DEVICE_OK, 307.0);
+    }
+    ASSERT_EQ(recorder.values.size(), 4);
+}
+
+// test deadband filtering of frames
+TEST(DeadbandProducerTest, Frame) {
+    RecordingValueProducer recorder;
+    TestDeadbandProducer producer(recorder, 0);
+    producer.setDeadband(Quantity::POWER, 10.0);
+    ProducerSeriesTable table;
+    ProducerFrame frame;
+    SpeedwireDevice device;
+    const uint32_t power = table.getSeriesId(device, MeasurementType::InverterPower(), Wire::L1);
+    const uint32_t energy = table.getSeriesId(device, MeasurementType::InverterEnergy(), Wire::TOTAL);
+
+    frame.add(power, 100.0, 1);
+    frame.add(energy, 5.0, 1);
+    producer.produce(frame, table);
+    frame.clear();
+    frame.add(power, 105.0, 2);
+    frame.add(energy, 5.0, 2);
+    producer.produce(frame, table);
+    ASSERT_EQ(recorder.values.size(), 3);
+    ASSERT_EQ(recorder.values[2], 5.0);
+    ASSERT_EQ(producer.getNumberOfSuppressedValues(), 1);
+}
@@ -0,0 +1,217 @@
+#include <gtest/gtest.h>
+#include <DerivedValueGraph.hpp>
+#include <CalculatedValueProcessor.hpp>
+
+using namespace libspeedwire;
+
+// producer recording all produced values
+class RecordingProducer : public Producer {
+public:
+    std::vector<std::pair<uint32_t, TimestampDoublePair> > values;  // serial number and value
+    int flush_count;
+
+    RecordingProducer(void) : flush_count(0) {}
+    virtual void flush(void) { ++flush_count; }
+    virtual void produce(const SpeedwireDevice& device, const MeasurementType& /*type*/, const Wire /*wire*/, const double value, const uint32_t time_in_ms) {
+        values.push_back(std::make_pair(device.deviceAddress.serialNumber, TimestampDoublePair(value, time_in_ms)));
+    }
+};
+
+// formula adding up all inputs
+static bool sum(DerivedValueNode& node, const SpeedwireDevice& /*device*/, const uint32_t time) {
+    double total = 0.0;
+    for (size_t i = 0; i < node.inputs.size(); ++i) {
+        if (node.hasInput(i)) {
+            total += node.input(i).measurementValues.getNewestElement().value;
+        }
+    }
+    node.setResult(total, time);
+    return true;
+}
+
+static ObisDataMap createObisMap(void) {
+    ObisDataMap map;
+    map.add(ObisData::PositiveActivePowerTotal);
+    map.add(ObisData::NegativeActivePowerTotal);
+    for (auto& entry : map) {
+        entry.second.measurementValues.setMaximumNumberOfElements(10);
+    }
+    return map;
+}
+
+// test change-only evaluation of a chain of derived values
+TEST(DerivedValueGraphTest, Evaluation) {
+    ObisDataMap obis_map = createObisMap();
+    SpeedwireDataMap speedwire_map;
+    DerivedValueGraph graph(obis_map, speedwire_map);
+    RecordingProducer producer;
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x15d, 1234567);
+
+    graph.add(ObisData::SignedActivePowerTotal, 0, { DerivedValueRef::obis(ObisData::PositiveActivePowerTotal), DerivedValueRef::obis(ObisData::NegativeActivePowerTotal) }, sum);
+    graph.add(SpeedwireData::HouseholdPowerTotal, 0, { DerivedValueRef::derived(ObisData::SignedActivePowerTotal) }, sum).serialNumber = 0xcafebabe;
+    graph.add(SpeedwireData::InverterPowerDCTotal, 0, { DerivedValueRef::speedwire(SpeedwireData::InverterPowerMPP1) }, sum);
+    graph.add(SpeedwireData::InverterPowerLoss, 1, { DerivedValueRef::obis(ObisData::PositiveActivePowerTotal) }, sum);
+    ASSERT_EQ(graph.size(), 4);
+
+    // no input values yet
+    ASSERT_EQ(graph.evaluate(device, 0, 1000, producer), 0);
+    ASSERT_TRUE(graph.getNode(0).enabled);
+    ASSERT_TRUE(graph.getNode(1).enabled);
+    ASSERT_FALSE(graph.getNode(2).enabled);
+    ASSERT_TRUE(graph.getNode(3).enabled);
+
+    obis_map[ObisData::PositiveActivePowerTotal.toKey()].measurementValues.addMeasurement(100.0, 1000);
+    obis_map[ObisData::NegativeActivePowerTotal.toKey()].measurementValues.addMeasurement(20.0, 1000);
+    ASSERT_EQ(graph.evaluate(device, 0, 1000, producer), 2);
+    ASSERT_EQ(producer.values.size(), 2);
+    ASSERT_EQ(producer.values[0].first, 1234567);
+    ASSERT_EQ(producer.values[0].second.value, 120.0);
+    ASSERT_EQ(producer.values[1].first, 0xcafebabe);
+    ASSERT_EQ(producer.values[1].second.value, 120.0);
+    ASSERT_TRUE(graph.getNode(0).updated);
+
+    // unchanged inputs are not evaluated again
+    ASSERT_EQ(graph.evaluate(device, 0, 1000, producer), 0);
+    ASSERT_FALSE(graph.getNode(0).updated);
+
+    // a single changed input triggers evaluation of all dependent nodes
+    obis_map[ObisData::NegativeActivePowerTotal.toKey()].measurementValues.addMeasurement(30.0, 2000);
+    ASSERT_EQ(graph.evaluate(device, 0, 2000, producer), 2);
+    ASSERT_EQ(producer.values[3].second.value, 130.0);
+    ASSERT_EQ(producer.values[3].second.time, 2000);
+
+    // nodes of other triggers are evaluated separately
+    ASSERT_EQ(graph.evaluate(device, 1, 2000, producer), 1);
+    ASSERT_EQ(producer.values[4].second.value, 100.0);
+}
+
+// test resolution of mapped outputs, optional inputs and newly added map entries
+TEST(DerivedValueGraphTest, Resolution) {
+    ObisDataMap obis_map = createObisMap();
+    SpeedwireDataMap speedwire_map;
+    DerivedValueGraph graph(obis_map, speedwire_map);
+    RecordingProducer producer;
+    SpeedwireDevice device;
+
+    graph.add(ObisData::SignedActivePowerTotal, 0, { DerivedValueRef::obis(ObisData::PositiveActivePowerTotal) }, sum).mapped = true;
+    graph.add(SpeedwireData::InverterPowerDCTotal, 0, { DerivedValueRef::obis(ObisData::PositiveActivePowerTotal), DerivedValueRef::speedwire(SpeedwireData::InverterPowerMPP1, true) }, sum);
+    obis_map[ObisData::PositiveActivePowerTotal.toKey()].measurementValues.addMeasurement(100.0, 1000);
+    ASSERT_EQ(graph.evaluate(device, 0, 1000, producer), 1);
+    ASSERT_FALSE(graph.getNode(0).enabled);
+    ASSERT_TRUE(graph.getNode(1).enabled);
+    ASSERT_EQ(producer.values[0].second.value, 100.0);
+
+    // adding map entries resolves the graph again
+    obis_map.add(ObisData::SignedActivePowerTotal);
+    obis_map[ObisData::SignedActivePowerTotal.toKey()].measurementValues.setMaximumNumberOfElements(10);
+    speedwire_map.add(SpeedwireData::InverterPowerMPP1);
+    speedwire_map[SpeedwireData::InverterPowerMPP1.toKey()].measurementValues.setMaximumNumberOfElements(10);
+    speedwire_map[SpeedwireData::InverterPowerMPP1.toKey()].measurementValues.addMeasurement(50.0, 1);
+    ASSERT_EQ(graph.evaluate(device, 0, 1000, producer), 2);
+    ASSERT_TRUE(graph.getNode(0).enabled);
+    ASSERT_EQ(obis_map[ObisData::SignedActivePowerTotal.toKey()].measurementValues.getNewestElement().value, 100.0);
+    ASSERT_EQ(producer.values[2].second.value, 150.0);
+}
+
+// test change detection for several devices updating the same inputs within the same second
+TEST(DerivedValueGraphTest, MultipleDevices) {
+    ObisDataMap obis_map;
+    SpeedwireDataMap speedwire_map;
+    speedwire_map.add(SpeedwireData::InverterPowerMPP1);
+    speedwire_map[SpeedwireData::InverterPowerMPP1.toKey()].measurementValues.setMaximumNumberOfElements(10);
+    DerivedValueGraph graph(obis_map, speedwire_map);
+    RecordingProducer producer;
+    SpeedwireDevice inverter1, inverter2;
+    inverter1.deviceAddress = SpeedwireAddress(0x178, 3000000001u);
+    inverter2.deviceAddress = SpeedwireAddress(0x178, 3000000002u);
+    graph.add(SpeedwireData::InverterPowerDCTotal, 0, { DerivedValueRef::speedwire(SpeedwireData::InverterPowerMPP1) }, sum);
+
+    MeasurementValues& mpp1 = speedwire_map[SpeedwireData::InverterPowerMPP1.toKey()].measurementValues;
+    mpp1.addMeasurement(100.0, 1000);
+    ASSERT_EQ(graph.evaluate(inverter1, 0, 1000, producer), 1);
+    mpp1.addMeasurement(200.0, 1000);
+    ASSERT_EQ(graph.evaluate(inverter2, 0, 1000, producer), 1);
+    ASSERT_EQ(producer.values.size(), 2);
+    ASSERT_EQ(producer.values[1].first, 3000000002u);
+    ASSERT_EQ(producer.values[1].second.value, 200.0);
+
+    // unchanged inputs are not evaluated again for either device
+    ASSERT_EQ(graph.evaluate(inverter1, 0, 1000, producer), 0);
+    ASSERT_EQ(graph.evaluate(inverter2, 0, 1000, producer), 0);
+
+    // removing a map entry resolves the graph again, even if another entry is added in its place
+    speedwire_map.remove(SpeedwireData::InverterPowerMPP1);
+    speedwire_map.add(SpeedwireData::InverterPowerMPP2);
+    ASSERT_EQ(graph.evaluate(inverter1, 0, 2000, producer), 0);
+    ASSERT_FALSE(graph.getNode(0).enabled);
+}
+
+// test signed power calculation of the calculated value processor
+TEST(DerivedValueGraphTest, CalculatedValueProcessor) {
+    ObisDataMap obis_map = createObisMap();
+    obis_map.add(ObisData::SignedActivePowerTotal);
+    obis_map[ObisData::SignedActivePowerTotal.toKey()].measurementValues.setMaximumNumberOfElements(10);
+    SpeedwireDataMap speedwire_map;
+    RecordingProducer producer;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, producer);
+    SpeedwireDevice device;
+
+    for (uint32_t i = 1; i <= 3; ++i) {
+        obis_map[ObisData::PositiveActivePowerTotal.toKey()].measurementValues.addMeasurement(100.0 * i, 1000 * i);
+        obis_map[ObisData::NegativeActivePowerTotal.toKey()].measurementValues.addMeasurement(10.0 * i, 1000 * i);
+    }
+    processor.endOfObisData(device, 3000);
+    ASSERT_EQ(producer.flush_count, 1);
+    ASSERT_GE(producer.values.size(), 1);
+    ASSERT_EQ(producer.values[0].second.value, (90.0 + 180.0 + 270.0) / 3);
+    ASSERT_EQ(producer.values[0].second.time, 3000);
+    ASSERT_EQ(obis_map[ObisData::SignedActivePowerTotal.toKey()].measurementValues.getNumberOfElements(), 3);
+}
+
+// test incremental signed power calculation across ring buffer wrap-around
+TEST(DerivedValueGraphTest, SignedPowerIncremental) {
+    ObisDataMap obis_map = createObisMap();
+    obis_map.add(ObisData::SignedActivePowerTotal);
+    obis_map[ObisData::SignedActivePowerTotal.toKey()].measurementValues.setMaximumNumberOfElements(10);
+    SpeedwireDataMap speedwire_map;
+    RecordingProducer producer;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, producer);
+    SpeedwireDevice device;
+    MeasurementValues& pos = obis_map[ObisData::PositiveActivePowerTotal.toKey()].measurementValues;
+    MeasurementValues& neg = obis_map[ObisData::NegativeActivePowerTotal.toKey()].measurementValues;
+    const MeasurementValues& sig = obis_map[ObisData::SignedActivePowerTotal.toKey()].measurementValues;
+
+    // signed power holds the differences of all matching pairs received so far, up to its own capacity
+    std::vector<TimestampDoublePair> expected;
+    for (uint32_t i = 1; i <= 25; ++i) {
+        pos.addMeasurement(100.0 * i, 1000 * i);
+        neg.addMeasurement(10.0 * i, (i == 7 ? 1000 * i + 1 : 1000 * i));   // timestamp mismatch for i == 7
+        if (i != 7) {
+            expected.push_back(TimestampDoublePair(90.0 * i, 1000 * i));
+        }
+        if (i % 3 == 0) {
+            pos.addMeasurement(1.0 * i, 1000 * i + 500);
+            neg.addMeasurement(2.0 * i, 1000 * i + 500);
+            expected.push_back(TimestampDoublePair(-1.0 * i, 1000 * i + 500));
+        }
+        processor.endOfObisData(device, 1000 * i);
+
+        const size_t n = (expected.size() < 10 ? expected.size() : 10);
+        ASSERT_EQ(sig.getNumberOfElements(), n);
+        for (size_t j = 0; j < n; ++j) {
+            ASSERT_EQ(sig[j].time, expected[expected.size() - n + j].time);
+            ASSERT_EQ(sig[j].value, expected[expected.size() - n + j].value);
+        }
+    }
+
+    // signed power is recalculated if it is out of sync
+    obis_map[ObisData::SignedActivePowerTotal.toKey()].measurementValues.addMeasurement(0.0, 999999);
+    pos.addMeasurement(100.0, 26000);
+    neg.addMeasurement(10.0, 26000);
+    processor.endOfObisData(device, 26000);
+    ASSERT_EQ(sig.getNumberOfElements(), 10);
+    ASSERT_EQ(sig.getNewestElement().value, 90.0);
+    ASSERT_EQ(sig.getNewestElement().time, 26000);
+    ASSERT_EQ(sig.getOldestElement().time, pos.getOldestElement().time);
+}
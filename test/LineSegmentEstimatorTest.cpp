@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <MeasurementValues.hpp>
 #include <LineSegmentEstimator.hpp>
+#include <LocalHost.hpp>
 
 using namespace libspeedwire;
 
@@ -80,4 +81,75 @@ TEST(LineSegmentEstimatorTest, approximateSlopeFunctions3) {
     std::vector<size_t> steps;
     LineSegmentEstimator::findChangePointsOfLinearRegressionValues(mv, steps);
 }
-#endif
\ No newline at end of file
+#endif
+#if 1
+// test pelt change point detection on a noisy step function
+TEST(LineSegmentEstimatorTest, peltStepFunction) {
+    const double noise = 50.0;
+    MeasurementValues mv(90);
+    std::srand(1);
+    for (size_t i = 0; i < mv.getMaximumNumberOfElements(); ++i) {
+        double level = (i < 30 ? 300.0 : (i < 60 ? 900.0 : 500.0));
+        double value = level + noise * (((double)std::rand() - (RAND_MAX / 2)) / RAND_MAX);
+        mv.addMeasurement(value, (uint32_t)(i * 1000));
+    }
+    std::vector<size_t> steps;
+    ASSERT_EQ(LineSegmentEstimator::findChangePointsOfMeanValuesPELT(mv, LineSegmentEstimator::estimatePenaltyPELT(mv), steps), 2);
+    ASSERT_EQ(steps[0], 29);
+    ASSERT_EQ(steps[1], 59);
+
+    std::vector<MeasurementValueInterval> intervals;
+    ASSERT_EQ(LineSegmentEstimator::findPiecewiseConstantIntervals(mv, intervals, SegmentationMethod::PELT), 3);
+    ASSERT_EQ(intervals[0].start_index, 0);
+    ASSERT_EQ(intervals[0].end_index, 29);
+    ASSERT_EQ(intervals[2].start_index, 60);
+    ASSERT_EQ(intervals[2].end_index, 89);
+    ASSERT_NEAR(intervals[1].mean_value, 900.0, noise);
+
+    // a constant signal has no change points
+    MeasurementValues constant(20);
+    for (size_t i = 0; i < constant.getMaximumNumberOfElements(); ++i) {
+        constant.addMeasurement(100.0, (uint32_t)(i * 1000));
+    }
+    intervals.clear();
+    ASSERT_EQ(LineSegmentEstimator::findPiecewiseConstantIntervals(constant, intervals, SegmentationMethod::PELT, 1.0), 1);
+}
+#endif
+
+#if 1
+// benchmark pelt change point detection on long synthetic step and ramp signals
+TEST(LineSegmentEstimatorTest, DISABLED_peltBenchmark) {
+    const size_t num_values = 20000;
+    const double noise = 100.0;
+    MeasurementValues step(num_values);
+    MeasurementValues ramp(num_values);
+    std::srand(1);
+    for (size_t i = 0; i < num_values; ++i) {
+        double step_value = ((i / 500) % 2 == 0 ? 300.0 : 1500.0) + noise * (((double)std::rand() - (RAND_MAX / 2)) / RAND_MAX);
+        double ramp_value = (double)(i % 1000) + noise * (((double)std::rand() - (RAND_MAX / 2)) / RAND_MAX);
+        step.addMeasurement(step_value, (uint32_t)(i * 1000));
+        ramp.addMeasurement(ramp_value, (uint32_t)(i * 1000));
+    }
+
+    uint64_t start_time = LocalHost::getTickCountInMs();
+    std::vector<MeasurementValueInterval> step_intervals;
+    LineSegmentEstimator::findPiecewiseConstantIntervals(step, step_intervals, SegmentationMethod::PELT);
+    uint64_t step_time = LocalHost::getTickCountInMs() - start_time;
+    printf("pelt step signal: %u values => %u intervals in %u ms\n", (unsigned)num_values, (unsigned)step_intervals.size(), (unsigned)step_time);
+    ASSERT_EQ(step_intervals.size(), num_values / 500);
+
+    start_time = LocalHost::getTickCountInMs();
+    std::vector<MeasurementValueInterval> ramp_intervals;
+    LineSegmentEstimator::findPiecewiseConstantIntervals(ramp, ramp_intervals, SegmentationMethod::PELT);
+    uint64_t ramp_time = LocalHost::getTickCountInMs() - start_time;
+    printf("pelt ramp signal: %u values => %u intervals in %u ms\n", (unsigned)num_values, (unsigned)ramp_intervals.size(), (unsigned)ramp_time);
+    ASSERT_GE(ramp_intervals.size(), num_values / 1000);
+    ASSERT_LT(ramp_intervals.size(), num_values / 10);
+
+    start_time = LocalHost::getTickCountInMs();
+    std::vector<MeasurementValueInterval> tv_intervals;
+    LineSegmentEstimator::findPiecewiseConstantIntervals(step, tv_intervals, SegmentationMethod::TOTAL_VARIATION);
+    uint64_t tv_time = LocalHost::getTickCountInMs() - start_time;
+    printf("total variation step signal: %u values => %u intervals in %u ms\n", (unsigned)num_values, (unsigned)tv_intervals.size(), (unsigned)tv_time);
+}
+#endif
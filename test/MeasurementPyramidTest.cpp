@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <MeasurementPyramid.hpp>
+#include <Measurement.hpp>
+
+using namespace libspeedwire;
+
+// test aggregation of a single level
+TEST(MeasurementPyramidTest, AggregationLevel) {
+    MeasurementAggregationLevel level(1000, 4);
+    ASSERT_EQ(level.getNumberOfElements(), 0);
+    ASSERT_FALSE(level.covers(0));
+
+    // 10 values per bucket, values 0 .. 59 over 6 seconds
+    for (uint32_t i = 0; i < 60; ++i) {
+        level.addMeasurement((double)i, 10000 + i * 100);
+    }
+    // 5 buckets closed, but only 4 are retained; the 6th bucket is still open
+    ASSERT_EQ(level.getNumberOfElements(), 4);
+    ASSERT_EQ(level.getOldestTime(), 11000);
+    ASSERT_EQ(level.current.time, 15000);
+    ASSERT_EQ(level.current.count, 10);
+    ASSERT_EQ(level.at(0).count, 10);
+    ASSERT_DOUBLE_EQ(level.at(0).min, 10.0);
+    ASSERT_DOUBLE_EQ(level.at(0).max, 19.0);
+    ASSERT_DOUBLE_EQ(level.at(0).getMean(), 14.5);
+    ASSERT_TRUE(level.covers(11000));
+    ASSERT_FALSE(level.covers(10999));
+
+    AggregatedValue result;
+    level.aggregate(12000, 13999, result);
+    ASSERT_EQ(result.count, 20);
+    ASSERT_DOUBLE_EQ(result.min, 20.0);
+    ASSERT_DOUBLE_EQ(result.max, 39.0);
+    ASSERT_DOUBLE_EQ(result.getMean(), 29.5);
+
+    // the open bucket is included in the aggregate
+    AggregatedValue result2;
+    level.aggregate(14000, 20000, result2);
+    ASSERT_EQ(result2.count, 20);
+    ASSERT_DOUBLE_EQ(result2.max, 59.0);
+}
+
+// test level selection and range queries on the pyramid
+TEST(MeasurementPyramidTest, RangeQueries) {
+    MeasurementPyramid pyramid;
+    ASSERT_FALSE(pyramid.isEnabled());
+    ASSERT_EQ(pyramid.findAdequateLevel(0, 1000), (size_t)-1);
+    ASSERT_EQ(pyramid.aggregate(0, 1000).count, 0);
+
+    pyramid.addDefaultLevels(1000);
+    ASSERT_TRUE(pyramid.isEnabled());
+    ASSERT_EQ(pyramid.getNumberOfLevels(), 4);
+
+    // one value every 100 ms for one hour, starting at a 15 minute boundary
+    const uint32_t start = 900000 * 10;
+    for (uint32_t i = 0; i < 36000; ++i) {
+        pyramid.addMeasurement(1.0, start + i * 100);
+    }
+    ASSERT_EQ(pyramid.getLevel(0).getNumberOfElements(), 600);
+    ASSERT_EQ(pyramid.getLevel(3).getNumberOfElements(), 3);
+
+    // the last 5 seconds are answered from the 1 s level
+    ASSERT_EQ(pyramid.findAdequateLevel(start + 3595000, start + 3599999), 0);
+    // the last 5 minutes are answered from the 1 min level
+    ASSERT_EQ(pyramid.findAdequateLevel(start + 3300000, start + 3599999), 2);
+    // the whole hour is answered from the 15 min level
+    ASSERT_EQ(pyramid.findAdequateLevel(start, start + 3599999), 3);
+
+    AggregatedValue hour = pyramid.aggregate(start, start + 3599999);
+    ASSERT_EQ(hour.count, 36000);
+    ASSERT_DOUBLE_EQ(hour.getMean(), 1.0);
+    AggregatedValue minutes = pyramid.aggregate(start + 3300000, start + 3599999);
+    ASSERT_EQ(minutes.count, 3000);
+}
+
+// test range queries not aligned to the buckets of the coarsest levels
+TEST(MeasurementPyramidTest, UnalignedRangeQueries) {
+    MeasurementPyramid pyramid;
+    pyramid.addDefaultLevels(1000);
+
+    // value i every 100 ms for one hour, starting at a 15 minute boundary
+    const uint32_t start = 900000 * 10;
+    for (uint32_t i = 0; i < 36000; ++i) {
+        pyramid.addMeasurement((double)i, start + i * 100);
+    }
+
+    // a range shorter than two 15 min buckets does not contain a whole 15 min bucket
+    ASSERT_EQ(pyramid.findAdequateLevel(start + 60000, start + 1019999), 2);
+
+    // 31 minutes from minute 1 to minute 32: 15 min buckets inside, edges from the 1 min level
+    ASSERT_EQ(pyramid.findAdequateLevel(start + 60000, start + 1919999), 3);
+    AggregatedValue minutes = pyramid.aggregate(start + 60000, start + 1919999);
+    ASSERT_EQ(minutes.count, 18600);
+    ASSERT_DOUBLE_EQ(minutes.min, 600.0);
+    ASSERT_DOUBLE_EQ(minutes.max, 19199.0);
+    ASSERT_DOUBLE_EQ(minutes.getMean(), (600.0 + 19199.0) / 2.0);
+
+    // edges down to the 10 s level
+    AggregatedValue seconds = pyramid.aggregate(start + 30000, start + 1949999);
+    ASSERT_EQ(seconds.count, 19200);
+    ASSERT_DOUBLE_EQ(seconds.min, 300.0);
+    ASSERT_DOUBLE_EQ(seconds.max, 19499.0);
+}
+
+// test the pyramid attached to a measurement
+TEST(MeasurementPyramidTest, Measurement) {
+    Measurement m(MeasurementType::EmeterPositiveActivePower(), Wire::TOTAL);
+    m.measurementValues.setMaximumNumberOfElements(4);
+    m.addMeasurement((uint32_t)100, 1000);
+    ASSERT_EQ(m.measurementPyramid.getNumberOfLevels(), 0);
+
+    m.measurementPyramid.addDefaultLevels(1000);
+    m.addMeasurement((uint32_t)100, 1000);
+    m.addMeasurement((uint32_t)300, 1500);
+    AggregatedValue result = m.measurementPyramid.aggregate(1000, 1999);
+    ASSERT_EQ(result.count, 2);
+    ASSERT_DOUBLE_EQ(result.getMean(), 20.0);
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <MeasurementType.hpp>
+#include <ObisData.hpp>
+#include <SpeedwireData.hpp>
+
+using namespace libspeedwire;
+
+// test interning of measurement types and descriptors
+TEST(MeasurementTypeRegistryTest, Intern) {
+    MeasurementTypeRegistry& registry = MeasurementTypeRegistry::getInstance();
+
+    // equal measurement types are interned to the same instance
+    const MeasurementType& type1 = registry.intern(MeasurementType::EmeterPositiveActivePower());
+    const MeasurementType& type2 = registry.intern(MeasurementType::EmeterPositiveActivePower());
+    const MeasurementType& type3 = registry.intern(MeasurementType::EmeterNegativeActivePower());
+    ASSERT_EQ(&type1, &type2);
+    ASSERT_NE(&type1, &type3);
+
+    // equal pairs of measurement type and wire are interned to the same descriptor
+    const MeasurementDescriptor& desc1 = registry.intern(MeasurementType::EmeterPositiveActivePower(), Wire::L1);
+    const MeasurementDescriptor& desc2 = registry.intern(MeasurementType::EmeterPositiveActivePower(), Wire::L1);
+    const MeasurementDescriptor& desc3 = registry.intern(MeasurementType::EmeterPositiveActivePower(), Wire::L2);
+    ASSERT_EQ(&desc1, &desc2);
+    ASSERT_NE(&desc1, &desc3);
+    ASSERT_EQ(&desc1.measurementType, &type1);
+    ASSERT_EQ(desc1.fullName, MeasurementType::EmeterPositiveActivePower().getFullName(Wire::L1));
+    ASSERT_LT(desc1.id, registry.getNumberOfDescriptors());
+    ASSERT_EQ(&registry.getDescriptor(desc1.id), &desc1);
+    ASSERT_NE(desc1.id, desc3.id);
+
+    // measurement types differing only in their name or instantaneous flag are interned to different instances
+    MeasurementType renamed = MeasurementType::EmeterPositiveActivePower();
+    renamed.name = "renamed_active_power";
+    MeasurementType non_instantaneous = MeasurementType::EmeterPositiveActivePower();
+    non_instantaneous.instaneous = !non_instantaneous.instaneous;
+    const MeasurementType& type4 = registry.intern(renamed);
+    const MeasurementType& type5 = registry.intern(non_instantaneous);
+    ASSERT_NE(&type1, &type4);
+    ASSERT_NE(&type1, &type5);
+    ASSERT_EQ(type4.name, "renamed_active_power");
+    ASSERT_EQ(type5.instaneous, non_instantaneous.instaneous);
+}
+
+// test that measurements share their descriptors
+TEST(MeasurementTypeRegistryTest, Measurement) {
+    const ObisData copy(ObisData::PositiveActivePowerL1);
+    ASSERT_EQ(copy.descriptor, ObisData::PositiveActivePowerL1.descriptor);
+    ASSERT_EQ(copy.getDescription(), copy.getMeasurementType().getFullName(copy.wire));
+    ASSERT_EQ(copy.getMeasurementType().divisor, MeasurementType::EmeterPositiveActivePower().divisor);
+
+    const Measurement measurement(MeasurementType::EmeterPositiveActivePower(), Wire::L1);
+    ASSERT_EQ(measurement.descriptor, ObisData::PositiveActivePowerL1.descriptor);
+
+    const SpeedwireData speedwire_copy(SpeedwireData::InverterPowerMPP1);
+    ASSERT_EQ(speedwire_copy.descriptor, SpeedwireData::InverterPowerMPP1.descriptor);
+    ASSERT_EQ(speedwire_copy.getDescription(), SpeedwireData::InverterPowerMPP1.getDescription());
+}
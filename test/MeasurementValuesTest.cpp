@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <MeasurementValues.hpp>
+#include <Measurement.hpp>
 #include <LineSegmentEstimator.hpp>
 
 using namespace libspeedwire;
@@ -481,3 +482,87 @@ TEST(MeasurementValuesTest, Capacity3_estimateLinearRegressionDown) {
     ASSERT_EQ(variance, 1.0);
     EXPECT_DOUBLE_EQ(slope, -1.0);
 }
+
+// test findLowerIndex and findClosestIndex against a linear search, using jittered timestamps and a wrapped ring buffer
+TEST(MeasurementValuesTest, InterpolationSearch) {
+    MeasurementValues mv(100);
+    std::srand(1);
+    uint32_t time = 0xffff0000;     // timestamps wrap around during the test
+    for (size_t i = 0; i < 150; ++i) {
+        mv.addMeasurement((double)i, time);
+        time += 1000 + (std::rand() % 200) - 100 + (i == 120 ? 20000 : 0);
+    }
+    ASSERT_EQ(mv.findLowerIndex(mv.getOldestElement().time - 1), (size_t)-1);
+    for (uint32_t t = mv.getOldestElement().time - 2000; t != mv.getNewestElement().time + 2000; t += 7) {
+        size_t expected_lower = (size_t)-1;
+        size_t expected_closest = 0;
+        for (size_t i = 0; i < mv.getNumberOfElements(); ++i) {
+            if (SpeedwireTime::calculateTimeDifference(mv.at(i).time, t) <= 0) {
+                expected_lower = i;
+            }
+            if (SpeedwireTime::calculateAbsTimeDifference(mv.at(i).time, t) <= SpeedwireTime::calculateAbsTimeDifference(mv.at(expected_closest).time, t)) {
+                expected_closest = i;
+            }
+        }
+        ASSERT_EQ(mv.findLowerIndex(t), expected_lower);
+        ASSERT_EQ(mv.findClosestIndex(t), expected_closest);
+    }
+}
+
+// test time range queries
+TEST(MeasurementValuesTest, RangeQueries) {
+    MeasurementValues mv(10);
+    MeasurementValues::Span first, second;
+    ASSERT_EQ(mv.findRange(0, 100000, first, second), 0);
+    ASSERT_EQ(mv.aggregate(0, 100000).count, 0);
+
+    for (uint32_t i = 0; i < 14; ++i) {
+        mv.addMeasurement((double)i, i * 1000);     // ring buffer holds times 4000 ... 13000 and wraps after 9000
+    }
+    ASSERT_EQ(mv.findRange(0, 3999, first, second), 0);
+    ASSERT_EQ(mv.findRange(14000, 20000, first, second), 0);
+
+    ASSERT_EQ(mv.findRange(5000, 8000, first, second), 4);
+    ASSERT_EQ(first.size, 4);
+    ASSERT_EQ(second.size, 0);
+    ASSERT_EQ(first.data[0].time, 5000);
+
+    ASSERT_EQ(mv.findRange(4500, 12500, first, second), 8);
+    ASSERT_EQ(first.size, 5);
+    ASSERT_EQ(second.size, 3);
+    ASSERT_EQ(first.data[0].time, 5000);
+    ASSERT_EQ(second.data[2].time, 12000);
+
+    ASSERT_EQ(mv.findRange(0, 100000, first, second), 10);
+
+    const AggregatedValue aggregate = mv.aggregate(6000, 11000);
+    ASSERT_EQ(aggregate.count, 6);
+    ASSERT_EQ(aggregate.min, 6.0);
+    ASSERT_EQ(aggregate.max, 11.0);
+    ASSERT_EQ(aggregate.getMean(), 8.5);
+}
+
+// test bulk append of raw measurement values
+TEST(MeasurementValuesTest, AddMeasurements) {
+    Measurement m(MeasurementType::EmeterPositiveActivePower(), Wire::TOTAL);
+    m.measurementValues.setMaximumNumberOfElements(8);
+    m.measurementPyramid.addLevel(10000, 4);
+
+    std::vector<uint32_t> raw_values, times;
+    for (uint32_t i = 0; i < 12; ++i) {
+        raw_values.push_back(i * 10);
+        times.push_back(i * 1000);
+    }
+    m.addMeasurements(raw_values.data(), times.data(), raw_values.size());
+    ASSERT_EQ(m.measurementValues.getNumberOfElements(), 8);
+    ASSERT_EQ(m.measurementValues.getOldestElement().time, 4000);
+    ASSERT_EQ(m.measurementValues.getNewestElement().time, 11000);
+    ASSERT_TRUE(approximatelyEqual(m.measurementValues.getNewestElement().value, 110.0 / m.getMeasurementType().divisor));
+    ASSERT_EQ(m.measurementPyramid.getLevel(0).getNumberOfElements(), 1);
+    ASSERT_EQ(m.measurementPyramid.getLevel(0).current.count, 2);
+
+    std::vector<double> values(3, 1.5);
+    m.addMeasurementValues(values.data(), times.data(), values.size());
+    ASSERT_EQ(m.measurementValues.getNewestElement().value, 1.5);
+    ASSERT_EQ(m.measurementValues.at(4).time, 11000);
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <ObisSnapshot.hpp>
+
+using namespace libspeedwire;
+
+// test publication of latest values and tails
+TEST(ObisSnapshotTest, LatestAndTail) {
+    ObisDataMap obis_map;
+    obis_map.add(ObisData::PositiveActivePowerTotal);
+    obis_map.add(ObisData::NegativeActivePowerTotal);
+    ObisSnapshot snapshot(obis_map, 4);
+
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x15d, 1234567);
+
+    ObisSnapshotValue value;
+    const uint32_t key = ObisData::PositiveActivePowerTotal.toKey();
+    ASSERT_FALSE(snapshot.getLatest(key, value));
+    ASSERT_FALSE(snapshot.getLatest(ObisData::Frequency.toKey(), value));
+
+    ObisData element = ObisData::PositiveActivePowerTotal;
+    for (uint32_t i = 1; i <= 6; ++i) {
+        element.measurementValues.addMeasurement(i * 10.0, i * 1000);
+        snapshot.consume(device, element);
+    }
+    ASSERT_TRUE(snapshot.getLatest(key, value));
+    ASSERT_EQ(value.key, key);
+    ASSERT_EQ(value.serialNumber, 1234567);
+    ASSERT_EQ(value.value, 60.0);
+    ASSERT_EQ(value.time, 6000);
+    ASSERT_EQ(value.count, 6);
+
+    std::vector<ObisSnapshotValue> values;
+    ASSERT_EQ(snapshot.getSnapshot(values), 1);
+
+    std::vector<TimestampDoublePair> tail;
+    ASSERT_EQ(snapshot.getTail(key, 10, tail), 4);
+    ASSERT_EQ(tail.front().time, 3000);
+    ASSERT_EQ(tail.back().time, 6000);
+    ASSERT_EQ(snapshot.getTail(key, 2, tail), 2);
+    ASSERT_EQ(tail.front().time, 5000);
+}
+
+// test consistency of snapshots taken by a reader thread while the writer is publishing
+TEST(ObisSnapshotTest, ConcurrentReader) {
+    ObisDataMap obis_map;
+    obis_map.add(ObisData::PositiveActivePowerTotal);
+    ObisSnapshot snapshot(obis_map, 8);
+    const uint32_t key = ObisData::PositiveActivePowerTotal.toKey();
+
+    std::atomic<bool> done(false);
+    std::atomic<int> errors(0);
+    std::thread reader([&]() {
+        std::vector<TimestampDoublePair> tail;
+        ObisSnapshotValue value;
+        while (!done.load()) {
+            if (snapshot.getLatest(key, value) && value.value != (double)value.time) {
+                ++errors;
+            }
+            snapshot.getTail(key, 8, tail);
+            for (size_t i = 1; i < tail.size(); ++i) {
+                if (tail[i].time != tail[i - 1].time + 1 || tail[i].value != (double)tail[i].time) {
+                    ++errors;
+                }
+            }
+        }
+    });
+
+    SpeedwireDevice device;
+    ObisData element = ObisData::PositiveActivePowerTotal;
+    for (uint32_t i = 0; i < 200000; ++i) {
+        element.measurementValues.addMeasurement((double)i, i);
+        snapshot.consume(device, element);
+    }
+    done.store(true);
+    reader.join();
+    ASSERT_EQ(errors.load(), 0);
+}
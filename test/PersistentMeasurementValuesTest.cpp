@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstddef>
+#include <PersistentMeasurementValues.hpp>
+
+using namespace libspeedwire;
+
+static const char* test_file = "PersistentMeasurementValuesTest.bin";
+
+// test adding, wrap-around and warm restart from the file
+TEST(PersistentMeasurementValuesTest, ReopenAndRestore) {
+    std::remove(test_file);
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 8));
+        ASSERT_TRUE(pmv.isOpen());
+        ASSERT_EQ(pmv.getNumberOfElements(), 0);
+        ASSERT_EQ(pmv.getMaximumNumberOfElements(), 8);
+        for (uint32_t i = 0; i < 5; ++i) {
+            pmv.addMeasurement(i * 1.5, 1000 + i);
+        }
+        ASSERT_EQ(pmv.getNumberOfElements(), 5);
+        ASSERT_EQ(pmv.at(0).time, 1000);
+        ASSERT_EQ(pmv.at(4).value, 4 * 1.5);
+    }
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 8));
+        ASSERT_EQ(pmv.getNumberOfElements(), 5);
+        for (uint32_t i = 5; i < 20; ++i) {
+            pmv.addMeasurement(i * 1.5, 1000 + i);
+        }
+        ASSERT_EQ(pmv.getNumberOfElements(), 8);
+        ASSERT_EQ(pmv.at(0).time, 1012);
+        ASSERT_EQ(pmv.at(7).time, 1019);
+        ASSERT_EQ(pmv.at(8).time, 0);
+        ASSERT_TRUE(pmv.flush());
+
+        MeasurementValues mv(4);
+        ASSERT_EQ(pmv.restore(mv), 4);
+        ASSERT_EQ(mv.getNumberOfElements(), 4);
+        ASSERT_EQ(mv.getOldestElement().time, 1016);
+        ASSERT_EQ(mv.getNewestElement().value, 19 * 1.5);
+    }
+    {
+        // a different capacity re-initializes the file
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 16));
+        ASSERT_EQ(pmv.getNumberOfElements(), 0);
+    }
+    std::remove(test_file);
+}
+
+// test recovery of a record written just before a crash, without the write count update
+TEST(PersistentMeasurementValuesTest, CrashRecovery) {
+    std::remove(test_file);
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 4));
+        pmv.addMeasurement(1.0, 1);
+        pmv.addMeasurement(2.0, 2);
+    }
+    {
+        // simulate a crash: the record is complete, but the header still holds the previous write count
+        FILE* file = fopen(test_file, "r+b");
+        ASSERT_NE(file, (FILE*)NULL);
+        PersistentMeasurementValues::Record record;
+        record.value = 3.0;
+        record.time = 3;
+        record.sequence = 3;
+        fseek(file, (long)(sizeof(PersistentMeasurementValues::Header) + 2 * sizeof(record)), SEEK_SET);
+        fwrite(&record, sizeof(record), 1, file);
+        fclose(file);
+    }
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 4));
+        ASSERT_EQ(pmv.getNumberOfElements(), 3);
+        ASSERT_EQ(pmv.at(2).value, 3.0);
+    }
+    std::remove(test_file);
+}
+
+// test read-only access; the file is neither created, nor resized, nor recovered
+TEST(PersistentMeasurementValuesTest, ReadOnly) {
+    std::remove(test_file);
+    PersistentMeasurementValues reader;
+    ASSERT_FALSE(reader.openReadOnly(test_file));
+    ASSERT_FALSE(reader.isOpen());
+    {
+        FILE* file = fopen(test_file, "rb");
+        ASSERT_EQ(file, (FILE*)NULL);
+    }
+    PersistentMeasurementValues writer;
+    ASSERT_TRUE(writer.open(test_file, 4));
+    ASSERT_TRUE(reader.openReadOnly(test_file));
+    ASSERT_TRUE(reader.isReadOnly());
+    ASSERT_EQ(reader.getMaximumNumberOfElements(), 4);
+    ASSERT_EQ(reader.getNumberOfElements(), 0);
+
+    // the reader sees the records added by the writer through the shared mapping
+    for (uint32_t i = 0; i < 6; ++i) {
+        writer.addMeasurement(i * 2.0, 100 + i);
+    }
+    ASSERT_EQ(reader.getNumberOfElements(), 4);
+    ASSERT_EQ(reader.at(0).time, 102);
+    ASSERT_EQ(reader.at(3).value, 10.0);
+
+    // measurements added to the reader are ignored
+    reader.addMeasurement(1.0, 1);
+    ASSERT_EQ(writer.getNumberOfElements(), 4);
+    ASSERT_EQ(writer.at(3).time, 105);
+    reader.close();
+    writer.close();
+    std::remove(test_file);
+}
+
+// test that a record being overwritten is not returned, and the wrap-around of the lower 32-bit write count
+TEST(PersistentMeasurementValuesTest, OverwrittenRecord) {
+    std::remove(test_file);
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 4));
+    }
+    {
+        // set the write count just below the wrap-around of its lower 32-bit
+        FILE* file = fopen(test_file, "r+b");
+        ASSERT_NE(file, (FILE*)NULL);
+        const uint32_t low = 0xfffffffe;
+        fseek(file, (long)offsetof(PersistentMeasurementValues::Header, write_count_low), SEEK_SET);
+        fwrite(&low, sizeof(low), 1, file);
+        fclose(file);
+    }
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 4));
+        for (uint32_t i = 0; i < 3; ++i) {
+            pmv.addMeasurement(i + 1.0, i + 1);
+        }
+        ASSERT_EQ(pmv.getNumberOfElements(), 4);
+
+        // the oldest record has never been written, it carries the sequence number of a record being written
+        ASSERT_EQ(pmv.at(0).time, 0);
+        ASSERT_EQ(pmv.at(1).time, 1);
+        ASSERT_EQ(pmv.at(2).time, 2);
+        ASSERT_EQ(pmv.at(3).time, 3);
+    }
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.openReadOnly(test_file));
+        ASSERT_EQ(pmv.getNumberOfElements(), 4);
+        ASSERT_EQ(pmv.at(3).value, 3.0);
+    }
+    std::remove(test_file);
+}
+
+// test that a read-only reader does not spin forever on a write count locked by a crashed writer
+TEST(PersistentMeasurementValuesTest, LockedWriteCount) {
+    std::remove(test_file);
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 4));
+        pmv.addMeasurement(1.0, 1);
+    }
+    {
+        // simulate a crash while updating the upper 32-bit of the write count: the sequence lock stays odd
+        FILE* file = fopen(test_file, "r+b");
+        ASSERT_NE(file, (FILE*)NULL);
+        const uint32_t sequence = 1;
+        fseek(file, (long)offsetof(PersistentMeasurementValues::Header, write_lock), SEEK_SET);
+        fwrite(&sequence, sizeof(sequence), 1, file);
+        fclose(file);
+    }
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_FALSE(pmv.openReadOnly(test_file));
+        ASSERT_FALSE(pmv.isOpen());
+    }
+    {
+        // the writer repairs the lock when it reopens the file
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.open(test_file, 4));
+        ASSERT_EQ(pmv.getNumberOfElements(), 1);
+    }
+    {
+        PersistentMeasurementValues pmv;
+        ASSERT_TRUE(pmv.openReadOnly(test_file));
+        ASSERT_EQ(pmv.at(0).value, 1.0);
+    }
+    std::remove(test_file);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <Producer.hpp>
+#include <CalculatedValueProcessor.hpp>
+
+using namespace libspeedwire;
+
+// producer recording all frames and values
+class RecordingFrameProducer : public Producer {
+public:
+    std::vector<size_t> frame_sizes;
+    std::vector<std::string> names;
+    int value_count;
+
+    RecordingFrameProducer(void) : value_count(0) {}
+    virtual void flush(void) {}
+    virtual void produce(const SpeedwireDevice& /*device*/, const MeasurementType& /*type*/, const Wire /*wire*/, const double /*value*/, const uint32_t /*time_in_ms*/) {
+        ++value_count;
+    }
+    virtual void produce(const ProducerFrame& frame, const ProducerSeriesTable& table) {
+        frame_sizes.push_back(frame.size());
+        for (const auto& sample : frame.samples) {
+            names.push_back(table[sample.series].getName());
+        }
+    }
+};
+
+// producer implementing the per value interface only
+class RecordingValueOnlyProducer : public Producer {
+public:
+    std::vector<std::pair<uint32_t, double> > values;
+    virtual void flush(void) {}
+    virtual void produce(const SpeedwireDevice& device, const MeasurementType& /*type*/, const Wire /*wire*/, const double value, const uint32_t /*time_in_ms*/) {
+        values.push_back(std::make_pair(device.deviceAddress.serialNumber, value));
+    }
+};
+
+// test stable series ids
+TEST(ProducerTest, SeriesTable) {
+    ProducerSeriesTable table;
+    SpeedwireDevice device1, device2;
+    device1.deviceAddress = SpeedwireAddress(0x15d, 1);
+    device2.deviceAddress = SpeedwireAddress(0x15d, 2);
+    ASSERT_EQ(table.getSeriesId(device1, MeasurementType::InverterPower(), Wire::L1), 0);
+    ASSERT_EQ(table.getSeriesId(device1, MeasurementType::InverterPower(), Wire::L2), 1);
+    ASSERT_EQ(table.getSeriesId(device2, MeasurementType::InverterPower(), Wire::L1), 2);
+    ASSERT_EQ(table.getSeriesId(device1, MeasurementType::InverterVoltage(), Wire::L1), 3);
+    ASSERT_EQ(table.getSeriesId(device1, MeasurementType::InverterPower(), Wire::L2), 1);
+    ASSERT_EQ(table.size(), 4);
+    ASSERT_EQ(table[2].device.deviceAddress.serialNumber, 2);
+    ASSERT_EQ(table[3].getName(), MeasurementType::InverterVoltage().getFullName(Wire::L1));
+}
+
+// test the default frame implementation calling the per value interface
+TEST(ProducerTest, DefaultFrameProduce) {
+    ProducerSeriesTable table;
+    ProducerFrame frame;
+    SpeedwireDevice device1, device2;
+    device1.deviceAddress = SpeedwireAddress(0x15d, 1);
+    device2.deviceAddress = SpeedwireAddress(0x15d, 2);
+    frame.add(table.getSeriesId(device1, MeasurementType::InverterPower(), Wire::L1), 1.0, 1000);
+    frame.add(table.getSeriesId(device2, MeasurementType::InverterPower(), Wire::L1), 2.0, 1000);
+    RecordingValueOnlyProducer producer;
+    Producer& base = producer;
+    base.produce(frame, table);
+    ASSERT_EQ(producer.values.size(), 2);
+    ASSERT_EQ(producer.values[0].first, 1);
+    ASSERT_EQ(producer.values[1].first, 2);
+    ASSERT_EQ(producer.values[1].second, 2.0);
+    frame.clear();
+    ASSERT_EQ(frame.size(), 0);
+}
+
+// test that the calculated value processor hands over a single frame per packet
+TEST(ProducerTest, CalculatedValueProcessorFrames) {
+    ObisDataMap obis_map;
+    obis_map.add(ObisData::PositiveActivePowerTotal);
+    obis_map.add(ObisData::NegativeActivePowerTotal);
+    for (auto& entry : obis_map) {
+        entry.second.measurementValues.setMaximumNumberOfElements(10);
+    }
+    SpeedwireDataMap speedwire_map;
+    RecordingFrameProducer producer;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, producer);
+    SpeedwireDevice device;
+
+    for (uint32_t i = 1; i <= 2; ++i) {
+        for (auto& entry : obis_map) {
+            entry.second.measurementValues.addMeasurement(100.0 * i, 1000 * i);
+            processor.consume(device, entry.second);
+        }
+        processor.endOfObisData(device, 1000 * i);
+    }
+    ASSERT_EQ(producer.value_count, 0);
+    ASSERT_EQ(producer.frame_sizes.size(), 2);
+    ASSERT_EQ(producer.frame_sizes[0], 2);
+    ASSERT_EQ(producer.names[0], ObisData::PositiveActivePowerTotal.getDescription());
+
+    // frames are not passed on if they are empty
+    processor.endOfObisData(device, 3000);
+    ASSERT_EQ(producer.frame_sizes.size(), 2);
+}
@@ -473,3 +473,32 @@ TEST(RingBufferTest, RemoveElements) {
     ASSERT_EQ(rb2.getNumberOfElements(), 1);
     ASSERT_EQ(rb3.getNumberOfElements(), 2);
 }
+
+// test bulk append against appending single elements, for all combinations of fill level and array size
+TEST(RingBufferTest, AddNewElements) {
+    std::vector<int> values;
+    for (int i = 0; i < 20; ++i) {
+        values.push_back(100 + i);
+    }
+    for (size_t capacity = 0; capacity <= 7; ++capacity) {
+        for (size_t prefill = 0; prefill <= 9; ++prefill) {
+            for (size_t n = 0; n <= 11; ++n) {
+                RingBuffer<int> expected(capacity), actual(capacity);
+                for (size_t i = 0; i < prefill; ++i) {
+                    expected.addNewElement((int)i);
+                    actual.addNewElement((int)i);
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    expected.addNewElement(values[i]);
+                }
+                actual.addNewElements(values.data(), n);
+                ASSERT_EQ(actual.getNumberOfElements(), expected.getNumberOfElements());
+                ASSERT_EQ(actual.getWritePointer(), expected.getWritePointer());
+                for (size_t i = 0; i < expected.getNumberOfElements(); ++i) {
+                    ASSERT_EQ(actual.at(i), expected.at(i));
+                    ASSERT_EQ(actual[i], expected[i]);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+#include <SpeedwireAddressTable.hpp>
+
+using namespace libspeedwire;
+
+// test insertion, lookup and rehashing
+TEST(SpeedwireAddressTableTest, InsertAndFind) {
+    SpeedwireAddressTable table;
+    ASSERT_EQ(table.size(), 0);
+    ASSERT_EQ(table.find(SpeedwireAddress(0x15d, 1234567)), -1);
+
+    for (int i = 0; i < 1000; ++i) {
+        table.insert(SpeedwireAddress((uint16_t)(0x100 + (i & 7)), (uint32_t)(3000000000u + i * 1000)), i);
+    }
+    ASSERT_EQ(table.size(), 1000);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(table.find(SpeedwireAddress((uint16_t)(0x100 + (i & 7)), (uint32_t)(3000000000u + i * 1000))), i);
+    }
+    // same serial number, different susy id
+    ASSERT_EQ(table.find(SpeedwireAddress(0x200, 3000000000u)), -1);
+
+    // replace an existing mapping
+    table.insert(SpeedwireAddress(0x100, 3000000000u), 4711);
+    ASSERT_EQ(table.size(), 1000);
+    ASSERT_EQ(table.find(SpeedwireAddress(0x100, 3000000000u)), 4711);
+
+    table.clear();
+    ASSERT_EQ(table.size(), 0);
+    ASSERT_EQ(table.find(SpeedwireAddress(0x100, 3000000000u)), -1);
+}
@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#define poll(a, b, c) WSAPoll((a), (b), (c))
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include <string.h>
+#include <thread>
+#include <AddressConversion.hpp>
+#include <SpeedwireAuthentication.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+
+using namespace libspeedwire;
+
+// authentication with a manually controlled tick count, exposing the session cache update
+class TestAuthentication : public SpeedwireAuthentication {
+public:
+    using SpeedwireAuthentication::LoginRequest;
+    uint64_t tick;
+
+    TestAuthentication(LocalHost& host, const std::vector<SpeedwireDevice>& devices) : SpeedwireAuthentication(host, devices), tick(1000) {}
+
+    void loginResult(const std::string& if_address, const SpeedwireAddress& dst, const bool success, const std::vector<SpeedwireAddress>& responders = std::vector<SpeedwireAddress>()) {
+        std::vector<LoginRequest> requests;
+        addLoginRequest(requests, if_address, dst, SpeedwireAddress::getLocalAddress());
+        requests[0].responders = responders;
+        requests[0].done = true;
+        requests[0].success = success;
+        updateSessions(requests[0]);
+    }
+
+    // send concurrent unicast login requests to the given devices and wait for the responses
+    std::vector<LoginRequest> loginDevices(const std::vector<SpeedwireDevice>& peers, const int timeout_in_ms) {
+        std::vector<LoginRequest> requests;
+        for (const auto& peer : peers) {
+            addLoginRequest(requests, peer.interfaceIpAddress, peer.deviceAddress, SpeedwireAddress::getLocalAddress());
+        }
+        login(requests, CredentialsMap().get(UserName::USER), timeout_in_ms);
+        return requests;
+    }
+
+    // register a broadcast login request as if it was sent on the given interface, without sending it to the multicast group
+    std::vector<LoginRequest> addBroadcastLoginRequest(const std::string& if_address, const uint16_t packet_id) {
+        std::vector<LoginRequest> requests;
+        const SpeedwireAddress& broadcast = SpeedwireAddress::getBroadcastAddress();
+        addLoginRequest(requests, if_address, broadcast, SpeedwireAddress::getLocalAddress());
+        requests[0].socket_index = socket_map[if_address];
+        requests[0].token_index = token_repository.add(broadcast.susyID, broadcast.serialNumber, packet_id, if_address, Command::LOGIN, if_address);
+        requests[0].token = token_repository.at(requests[0].token_index);
+        return requests;
+    }
+
+    // wait for the responses to the given login requests
+    bool receive(std::vector<LoginRequest>& requests, const int timeout_in_ms) { return receiveLoginResponses(requests, timeout_in_ms); }
+
+    // get the address of the socket used for the given interface
+    struct sockaddr_in getSocketAddress(const std::string& if_address) const {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        memset(&addr, 0, sizeof(addr));
+        getsockname(sockets[socket_map.at(if_address)].getSocketFd(), (struct sockaddr*)&addr, &addr_len);
+        return addr;
+    }
+
+protected:
+    virtual uint64_t getTickCountInMs(void) const { return tick; }
+};
+
+static SpeedwireDevice device(const uint32_t serial, const std::string& ip, const SpeedwireDeviceClass device_class) {
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x0178, serial);
+    device.deviceIpAddress = ip;
+    device.interfaceIpAddress = "192.168.1.1";
+    device.deviceClass = toString(device_class);
+    return device;
+}
+
+// test session tracking, expiry and proactive re-authentication
+TEST(SpeedwireAuthenticationTest, SessionCache) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(device(3000000000u, "192.168.1.10", SpeedwireDeviceClass::PV_INVERTER));
+    devices.push_back(device(3000000001u, "192.168.1.11", SpeedwireDeviceClass::BATTERY_INVERTER));
+    devices.push_back(device(3000000002u, "192.168.1.12", SpeedwireDeviceClass::EMETER));
+    TestAuthentication authentication(localhost, devices);
+    authentication.setSessionTimeout(10000);
+    authentication.setReloginMargin(1000);
+
+    // initially, all inverters need a login; emeters never do
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 2);
+    ASSERT_FALSE(authentication.isLoggedIn(devices[0]));
+
+    // a broadcast login starts sessions only with the devices that responded to it
+    std::vector<SpeedwireAddress> responders;
+    responders.push_back(devices[0].deviceAddress);
+    authentication.loginResult("192.168.1.1", SpeedwireAddress::getBroadcastAddress(), true, responders);
+    ASSERT_TRUE(authentication.isLoggedIn(devices[0]));
+    ASSERT_FALSE(authentication.isLoggedIn(devices[1]));
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 1);
+    ASSERT_EQ(authentication.getExpiringSessions()[0].deviceAddress, devices[1].deviceAddress);
+    responders.push_back(devices[1].deviceAddress);
+    responders.push_back(devices[2].deviceAddress);
+    authentication.loginResult("192.168.1.1", SpeedwireAddress::getBroadcastAddress(), true, responders);
+    ASSERT_TRUE(authentication.isLoggedIn(devices[0]));
+    ASSERT_TRUE(authentication.isLoggedIn(devices[1]));
+    ASSERT_FALSE(authentication.isLoggedIn(devices[2]));
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 0);
+
+    // sessions are refreshed within the relogin margin, before they lapse
+    authentication.tick += 8999;
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 0);
+    authentication.tick += 1;
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 2);
+    ASSERT_TRUE(authentication.isLoggedIn(devices[0]));
+    authentication.loginResult("192.168.1.1", devices[0].deviceAddress, true);
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 1);
+    ASSERT_EQ(authentication.getExpiringSessions()[0].deviceAddress, devices[1].deviceAddress);
+    authentication.tick += 1000;
+    ASSERT_TRUE(authentication.isLoggedIn(devices[0]));
+    ASSERT_FALSE(authentication.isLoggedIn(devices[1]));
+
+    // failed unicast logins end the session
+    authentication.loginResult("192.168.1.1", devices[0].deviceAddress, false);
+    ASSERT_FALSE(authentication.isLoggedIn(devices[0]));
+
+    // error code 0x0017 requires a login of all devices
+    authentication.loginResult("192.168.1.1", SpeedwireAddress::getBroadcastAddress(), true, responders);
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 0);
+    authentication.getTokenRepository().needs_login = true;
+    ASSERT_EQ(authentication.getExpiringSessions().size(), 2);
+    authentication.invalidateSessions();
+    ASSERT_FALSE(authentication.isLoggedIn(devices[1]));
+}
+
+// loopback socket bound to the speedwire port, acting as one or more devices
+class LoopbackDevices {
+public:
+    int fd;
+
+    LoopbackDevices(void) {
+        fd = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        uint32_t reuseaddr = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuseaddr, sizeof(reuseaddr));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+        addr.sin_addr = AddressConversion::toInAddress("127.0.0.1");
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close();
+        }
+    }
+    ~LoopbackDevices(void) { close(); }
+
+    void close(void) {
+        if (fd >= 0) {
+#ifdef _WIN32
+            closesocket(fd);
+#else
+            ::close(fd);
+#endif
+            fd = -1;
+        }
+    }
+
+    // receive a login request; return the destination serial number and packet id and the address of the sender
+    bool receiveRequest(uint32_t& dst_serial, uint16_t& packet_id, struct sockaddr_in& src) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 2000) != 1) {
+            return false;
+        }
+        unsigned char buffer[1024];
+        socklen_t src_len = sizeof(src);
+        const int nbytes = (int)recvfrom(fd, (char*)buffer, sizeof(buffer), 0, (struct sockaddr*)&src, &src_len);
+        SpeedwireHeader header(buffer, nbytes);
+        if (nbytes <= 0 || !header.isValidData2Packet()) {
+            return false;
+        }
+        const SpeedwireInverterProtocol inverter(header);
+        dst_serial = inverter.getDstSerialNumber();
+        packet_id = inverter.getPacketID();
+        return true;
+    }
+
+    // send a login response with the given error code from the given device
+    bool sendResponse(const uint32_t serial, const uint16_t packet_id, const uint16_t error_code, const struct sockaddr_in& dest) {
+        unsigned char buffer[24 + 8 + 8 + 6 + 4 + 4 + 4];
+        memset(buffer, 0, sizeof(buffer));
+        SpeedwireHeader header(buffer, sizeof(buffer));
+        header.setDefaultHeader(1, sizeof(buffer) - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
+        SpeedwireData2Packet data2_packet(header);
+        data2_packet.setControl(0xa0);
+        SpeedwireInverterProtocol inverter(header);
+        inverter.setDstSusyID(SpeedwireAddress::getLocalAddress().susyID);
+        inverter.setDstSerialNumber(SpeedwireAddress::getLocalAddress().serialNumber);
+        inverter.setSrcSusyID(0x0178);
+        inverter.setSrcSerialNumber(serial);
+        inverter.setErrorCode(error_code);
+        inverter.setPacketID(packet_id | 0x8000);
+        inverter.setCommandID(Command::LOGIN | Command::QUERY_RESPONSE);
+        return (sendto(fd, (const char*)buffer, sizeof(buffer), 0, (const struct sockaddr*)&dest, sizeof(dest)) == (int)sizeof(buffer));
+    }
+};
+
+static SpeedwireDevice loopbackDevice(const uint32_t serial) {
+    SpeedwireDevice peer = device(serial, "127.0.0.1", SpeedwireDeviceClass::PV_INVERTER);
+    peer.interfaceIpAddress = "127.0.0.1";
+    return peer;
+}
+
+// test that concurrent unicast login requests are matched with their responses, even if they arrive out of order
+TEST(SpeedwireAuthenticationTest, ConcurrentLogin) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(loopbackDevice(3000000010u));
+    devices.push_back(loopbackDevice(3000000011u));
+    TestAuthentication authentication(localhost, devices);
+    ASSERT_GE(authentication.getSocketMap().at("127.0.0.1"), 0);
+    LoopbackDevices peers;
+    ASSERT_GE(peers.fd, 0);
+
+    // the devices receive both requests before responding in reverse order; the second device rejects the password
+    std::thread responder([&peers]() {
+        uint32_t serial[2] = { 0, 0 };
+        uint16_t packet_id[2] = { 0, 0 };
+        struct sockaddr_in src[2];
+        for (int i = 0; i < 2; ++i) {
+            if (!peers.receiveRequest(serial[i], packet_id[i], src[i])) {
+                return;
+            }
+        }
+        for (int i = 1; i >= 0; --i) {
+            peers.sendResponse(serial[i], packet_id[i], (serial[i] == 3000000011u ? 0x0100 : 0x0000), src[i]);
+        }
+    });
+    const std::vector<TestAuthentication::LoginRequest> requests = authentication.loginDevices(devices, 2000);
+    responder.join();
+
+    ASSERT_EQ(requests.size(), 2);
+    ASSERT_TRUE(requests[0].done);
+    ASSERT_TRUE(requests[0].success);
+    ASSERT_TRUE(requests[1].done);
+    ASSERT_FALSE(requests[1].success);
+    ASSERT_TRUE(authentication.isLoggedIn(devices[0]));
+    ASSERT_FALSE(authentication.isLoggedIn(devices[1]));
+    ASSERT_EQ(authentication.getTokenRepository().size(), 0);
+}
+
+// test that broadcast login requests collect the responses of several devices, and finish once all known devices responded
+TEST(SpeedwireAuthenticationTest, BroadcastLogin) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(loopbackDevice(3000000020u));
+    devices.push_back(loopbackDevice(3000000021u));
+    TestAuthentication authentication(localhost, devices);
+    LoopbackDevices peers;
+    ASSERT_GE(peers.fd, 0);
+    const struct sockaddr_in dest = authentication.getSocketAddress("127.0.0.1");
+
+    // both known devices respond; the request finishes without waiting for the timeout
+    const uint16_t packet_id = SpeedwireCommand::getIncrementedPacketID();
+    std::vector<TestAuthentication::LoginRequest> requests = authentication.addBroadcastLoginRequest("127.0.0.1", packet_id);
+    ASSERT_TRUE(peers.sendResponse(3000000020u, packet_id, 0x0000, dest));
+    ASSERT_TRUE(peers.sendResponse(3000000021u, packet_id, 0x0000, dest));
+    uint64_t start = LocalHost::getTickCountInMs();
+    ASSERT_TRUE(authentication.receive(requests, 5000));
+    ASSERT_LT(LocalHost::getTickCountInMs() - start, 2500);
+    ASSERT_EQ(requests[0].responders.size(), 2);
+    ASSERT_TRUE(authentication.isLoggedIn(devices[0]));
+    ASSERT_TRUE(authentication.isLoggedIn(devices[1]));
+    ASSERT_EQ(authentication.getTokenRepository().size(), 0);
+
+    // a known device is missing; responses are collected until the timeout
+    authentication.invalidateSessions();
+    devices.push_back(loopbackDevice(3000000022u));
+    const uint16_t packet_id2 = SpeedwireCommand::getIncrementedPacketID();
+    requests = authentication.addBroadcastLoginRequest("127.0.0.1", packet_id2);
+    ASSERT_TRUE(peers.sendResponse(3000000021u, packet_id2, 0x0000, dest));
+    ASSERT_TRUE(peers.sendResponse(3000000020u, packet_id2, 0x0000, dest));
+    start = LocalHost::getTickCountInMs();
+    ASSERT_TRUE(authentication.receive(requests, 300));
+    ASSERT_GE(LocalHost::getTickCountInMs() - start, 300);
+    ASSERT_EQ(requests[0].responders.size(), 2);
+    ASSERT_TRUE(authentication.isLoggedIn(devices[0]));
+    ASSERT_TRUE(authentication.isLoggedIn(devices[1]));
+    ASSERT_FALSE(authentication.isLoggedIn(devices[2]));
+}
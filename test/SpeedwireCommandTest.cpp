@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#define poll(a, b, c) WSAPoll((a), (b), (c))
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <AddressConversion.hpp>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireReceiveDispatcher.hpp>
+#include <SpeedwireSocket.hpp>
+
+using namespace libspeedwire;
+
+// test that packet ids obtained concurrently from several threads are unique and have bit 15 set
+TEST(SpeedwireCommandTest, ConcurrentPacketIDs) {
+    const size_t num_threads = 4;
+    const size_t num_ids = 4000;
+    std::vector<std::vector<uint16_t> > ids(num_threads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.push_back(std::thread([&ids, i, num_ids]() {
+            for (size_t j = 0; j < num_ids; ++j) {
+                ids[i].push_back(SpeedwireCommand::getIncrementedPacketID());
+            }
+        }));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::vector<bool> seen(0x10000, false);
+    for (const auto& thread_ids : ids) {
+        for (const uint16_t id : thread_ids) {
+            ASSERT_NE(id & 0x8000, 0);
+            ASSERT_FALSE(seen[id]);
+            seen[id] = true;
+        }
+    }
+}
+
+// request the local address from several threads started together, such that they race for its initialization;
+// exit with code 0 if all threads got the same, complete address
+static void requestLocalAddressConcurrently(void) {
+    std::vector<const SpeedwireAddress*> addresses(8, NULL);
+    std::atomic<size_t> ready(0);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        threads.push_back(std::thread([&addresses, &ready, i]() {
+            ++ready;
+            while (ready.load() < addresses.size()) {}     // barrier
+            addresses[i] = &SpeedwireAddress::getLocalAddress();
+        }));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto address : addresses) {
+        if (address != addresses[0] || !address->isComplete()) {
+            exit(1);
+        }
+    }
+    exit(0);
+}
+
+// test that the local address is initialized once, even if it is requested concurrently; the test runs in a
+// freshly started process, as the local address of this process has been initialized by other tests already
+TEST(SpeedwireCommandDeathTest, ConcurrentLocalAddress) {
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_EXIT(requestLocalAddressConcurrently(), ::testing::ExitedWithCode(0), "");
+}
+
+// get the address of the given socket, as chosen by the os
+static struct sockaddr_in getSocketAddress(const SpeedwireSocket& socket) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    getsockname(socket.getSocketFd(), (struct sockaddr*)&addr, &addr_len);
+    return addr;
+}
+
+// check if the given socket has a packet waiting
+static bool hasPendingPacket(const SpeedwireSocket& socket) {
+    struct pollfd pfd;
+    pfd.fd = socket.getSocketFd();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 1;
+}
+
+// test that token deadlines are processed while unrelated packets keep arriving
+TEST(SpeedwireCommandTest, DeadlinesWhileReceiving) {
+    LocalHost& localhost = LocalHost::getInstance();
+    SpeedwireSocket receiver(localhost);
+    SpeedwireSocket sender(localhost);
+    ASSERT_GE(receiver.openSocket("127.0.0.1", false), 0);
+    ASSERT_GE(sender.openSocket("127.0.0.1", false), 0);
+    const struct sockaddr_in dest = getSocketAddress(receiver);
+
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(localhost, devices);
+    SpeedwireRetransmissionPolicy policy;
+    policy.timeoutInMs = 1;
+    policy.maxRetransmissions = 0;
+    policy.backoffFactor = 2.0;
+    policy.jitter = 0.0;
+    command.getTokenRepository().setRetransmissionPolicy(policy);
+    const SpeedwireCommandTokenIndex token_index = command.getTokenRepository().add(0x0178, 3000000000u, 0x8001, "127.0.0.1", Command::AC_QUERY);
+
+    // queue unrelated packets and let the token deadline pass
+    uint8_t data[4] = { 0, 1, 2, 3 };
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_EQ(sender.sendto(data, sizeof(data), dest), (int)sizeof(data));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_TRUE(hasPendingPacket(receiver));
+
+    // the token expires before the queued packets are drained
+    uint8_t buffer[1024];
+    ASSERT_EQ(command.receiveResponse(token_index, receiver, buffer, sizeof(buffer), 1000), 0);
+    ASSERT_FALSE(command.getTokenRepository().isValid(token_index));
+    ASSERT_TRUE(hasPendingPacket(receiver));
+    receiver.closeSocket();
+    sender.closeSocket();
+}
+
+// inverter packet receiver counting the packets passed on by the command instance
+class ForwardedInverterReceiver : public InverterPacketReceiverBase {
+public:
+    int count;
+    uint16_t packet_id;
+    ForwardedInverterReceiver(LocalHost& host) : InverterPacketReceiverBase(host), count(0), packet_id(0) {}
+    virtual void receive(SpeedwireHeader& packet, struct sockaddr& /*src*/) {
+        ++count;
+        packet_id = SpeedwireInverterProtocol(packet).getPacketID();
+    }
+};
+
+// assemble an inverter reply packet without data elements
+static void setInverterReply(SpeedwireHeader& header, const uint32_t serial, const uint16_t packet_id) {
+    memset(header.getPacketPointer(), 0, header.getPacketSize());
+    header.setDefaultHeader(1, header.getPacketSize() - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
+    SpeedwireData2Packet data2_packet(header);
+    data2_packet.setControl(0xa0);
+    SpeedwireInverterProtocol inverter(header);
+    inverter.setDstSusyID(SpeedwireAddress::getLocalAddress().susyID);
+    inverter.setDstSerialNumber(SpeedwireAddress::getLocalAddress().serialNumber);
+    inverter.setSrcSusyID(0x0178);
+    inverter.setSrcSerialNumber(serial);
+    inverter.setPacketID(packet_id);
+    inverter.setCommandID(Command::AC_QUERY | Command::QUERY_RESPONSE);
+}
+
+// test that a packet arriving together with the reply is passed on to the receive dispatcher
+TEST(SpeedwireCommandTest, ForwardUnrelatedPackets) {
+    LocalHost& localhost = LocalHost::getInstance();
+    SpeedwireSocket receiver(localhost);
+    ASSERT_GE(receiver.openSocket("127.0.0.1", false), 0);
+    const struct sockaddr_in dest = getSocketAddress(receiver);
+
+    // replies are only accepted from the speedwire port
+    int sender = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    ASSERT_GE(sender, 0);
+    uint32_t reuseaddr = 1;
+    setsockopt(sender, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuseaddr, sizeof(reuseaddr));
+    struct sockaddr_in sender_addr;
+    memset(&sender_addr, 0, sizeof(sender_addr));
+    sender_addr.sin_family = AF_INET;
+    sender_addr.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+    sender_addr.sin_addr = AddressConversion::toInAddress("127.0.0.1");
+    ASSERT_EQ(bind(sender, (struct sockaddr*)&sender_addr, sizeof(sender_addr)), 0);
+
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(localhost, devices);
+    SpeedwireReceiveDispatcher dispatcher(localhost);
+    ForwardedInverterReceiver inverter_receiver(localhost);
+    dispatcher.registerReceiver(inverter_receiver);
+    command.setReceiveDispatcher(&dispatcher);
+    const SpeedwireCommandTokenIndex token_index = command.getTokenRepository().add(0x0178, 3000000000u, 0x8001, "127.0.0.1", Command::AC_QUERY);
+
+    // an unrelated reply to another request arrives before the reply
+    unsigned char unrelated_buffer[24 + 8 + 8 + 6 + 4 + 4 + 4];
+    SpeedwireHeader unrelated(unrelated_buffer, sizeof(unrelated_buffer));
+    setInverterReply(unrelated, 3000000001u, 0x8002);
+    ASSERT_EQ(sendto(sender, (const char*)unrelated_buffer, sizeof(unrelated_buffer), 0, (const struct sockaddr*)&dest, sizeof(dest)), (int)sizeof(unrelated_buffer));
+    unsigned char reply_buffer[24 + 8 + 8 + 6 + 4 + 4 + 4];
+    SpeedwireHeader reply(reply_buffer, sizeof(reply_buffer));
+    setInverterReply(reply, 3000000000u, 0x8001);
+    ASSERT_EQ(sendto(sender, (const char*)reply_buffer, sizeof(reply_buffer), 0, (const struct sockaddr*)&dest, sizeof(dest)), (int)sizeof(reply_buffer));
+
+    // the reply is returned and the unrelated packet reaches its receiver
+    uint8_t buffer[1024];
+    ASSERT_EQ(command.receiveResponse(token_index, receiver, buffer, sizeof(buffer), 1000), (int32_t)sizeof(reply_buffer));
+    ASSERT_FALSE(command.getTokenRepository().isValid(token_index));
+    ASSERT_EQ(inverter_receiver.count, 1);
+    ASSERT_EQ(inverter_receiver.packet_id, 0x8002);
+    receiver.closeSocket();
+#ifdef _WIN32
+    closesocket(sender);
+#else
+    close(sender);
+#endif
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <SpeedwireCommand.hpp>
+
+using namespace libspeedwire;
+
+// test stable handles, lookup and removal
+TEST(SpeedwireCommandTokenRepositoryTest, Handles) {
+    SpeedwireCommandTokenRepository repository;
+
+    std::vector<SpeedwireCommandTokenIndex> handles;
+    for (uint16_t i = 0; i < 100; ++i) {
+        handles.push_back(repository.add(0x0178, 3000000000u + (i % 7), 0x8000 | i, "192.168.1.10", Command::AC_QUERY));
+        ASSERT_GE(handles.back(), 0);
+    }
+    ASSERT_EQ(repository.size(), 100);
+
+    // remove every other token; all other handles remain valid
+    for (size_t i = 0; i < handles.size(); i += 2) {
+        repository.remove(handles[i]);
+    }
+    ASSERT_EQ(repository.size(), 50);
+    for (uint16_t i = 0; i < 100; ++i) {
+        const int index = repository.find(0x0178, 3000000000u + (i % 7), i);    // reply packet ids may have bit 15 cleared
+        if ((i & 1) == 0) {
+            ASSERT_EQ(index, -1);
+            ASSERT_FALSE(repository.isValid(handles[i]));
+        }
+        else {
+            ASSERT_EQ(index, handles[i]);
+            ASSERT_TRUE(repository.isValid(handles[i]));
+            ASSERT_EQ(repository.at(index).packetid, 0x8000 | i);
+            ASSERT_EQ(repository.at(index).serialnumber, 3000000000u + (i % 7));
+        }
+    }
+
+    // removing a token twice is harmless, even if its slot is reused meanwhile
+    const SpeedwireCommandTokenIndex reused = repository.add(0x0178, 3000000000u, 0x9000, "192.168.1.10", Command::DC_QUERY);
+    repository.remove(handles[0]);
+    ASSERT_EQ(repository.size(), 51);
+    ASSERT_TRUE(repository.isValid(reused));
+    ASSERT_EQ(repository.find(0x0178, 3000000000u, 0x9000), reused);
+
+    // a token with the same key replaces the existing token
+    const SpeedwireCommandTokenIndex replaced = repository.add(0x0178, 3000000000u, 0x9000, "192.168.1.10", Command::ENERGY_QUERY);
+    ASSERT_EQ(repository.size(), 51);
+    ASSERT_FALSE(repository.isValid(reused));
+    ASSERT_EQ(repository.at(repository.find(0x0178, 3000000000u, 0x9000)).command, Command::ENERGY_QUERY);
+    ASSERT_EQ(repository.find(0x0178, 3000000000u, 0x9000), replaced);
+
+    repository.clear();
+    ASSERT_EQ(repository.size(), 0);
+    ASSERT_EQ(repository.find(0x0178, 3000000001u, 1), -1);
+}
+
+// test expiry of tokens in creation order
+TEST(SpeedwireCommandTokenRepositoryTest, Expire) {
+    SpeedwireCommandTokenRepository repository;
+    for (uint16_t i = 0; i < 10; ++i) {
+        repository.add(0x0178, 3000000000u, 0x8000 | i, "192.168.1.10", Command::AC_QUERY);
+    }
+    ASSERT_EQ(repository.expire(60000), 0);
+    ASSERT_EQ(repository.size(), 10);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(repository.expire(0), 10);
+    ASSERT_EQ(repository.size(), 0);
+    ASSERT_EQ(repository.find(0x0178, 3000000000u, 0x8001), -1);
+}
+
+// test retransmission with exponential backoff and expiry through callbacks
+TEST(SpeedwireCommandTokenRepositoryTest, Retransmission) {
+    SpeedwireCommandTokenRepository repository;
+    SpeedwireRetransmissionPolicy policy;
+    policy.timeoutInMs = 100;
+    policy.maxRetransmissions = 2;
+    policy.backoffFactor = 2.0;
+    policy.jitter = 0.0;
+    repository.setRetransmissionPolicy(policy);
+
+    std::vector<uint16_t> retransmitted;
+    std::vector<uint16_t> expired;
+    repository.setRetransmitCallback([&retransmitted](const SpeedwireCommandToken& token) { retransmitted.push_back(token.packetid); return true; });
+    repository.addExpiryCallback(&expired, [&expired](const SpeedwireCommandToken& token) { expired.push_back(token.packetid); });
+
+    const uint8_t request[4] = { 1, 2, 3, 4 };
+    const SpeedwireCommandTokenIndex index1 = repository.add(0x0178, 3000000000u, 0x8001, "192.168.1.10", Command::AC_QUERY, "192.168.1.1", request, sizeof(request));
+    const SpeedwireCommandTokenIndex index2 = repository.add(0x0178, 3000000000u, 0x8002, "192.168.1.10", Command::DC_QUERY, "192.168.1.1", request, sizeof(request));
+    const uint64_t start = repository.at(index1).create_tick;
+    ASSERT_EQ(repository.at(index1).request.size(), sizeof(request));
+    ASSERT_EQ(repository.at(index1).deadline, start + 100);
+    ASSERT_LE(repository.getNextDeadline(), start + 100);
+
+    // the second token receives its reply before its deadline
+    repository.remove(index2);
+
+    // retransmissions after 100 ms, then after further 200 ms; expiry after further 400 ms
+    ASSERT_EQ(repository.advance(start + 99), 0);
+    ASSERT_EQ(retransmitted.size(), 0);
+    ASSERT_EQ(repository.advance(start + 150), 0);
+    ASSERT_EQ(retransmitted.size(), 1);
+    ASSERT_EQ(repository.at(index1).retransmissions, 1);
+    ASSERT_EQ(repository.at(index1).deadline, start + 150 + 200);
+    ASSERT_EQ(repository.advance(start + 349), 0);
+    ASSERT_EQ(repository.advance(start + 350), 0);
+    ASSERT_EQ(retransmitted.size(), 2);
+    ASSERT_EQ(repository.at(index1).deadline, start + 350 + 400);
+    ASSERT_EQ(repository.advance(start + 749), 0);
+    ASSERT_TRUE(repository.isValid(index1));
+    ASSERT_EQ(repository.advance(start + 750), 1);
+    ASSERT_FALSE(repository.isValid(index1));
+    ASSERT_EQ(retransmitted.size(), 2);
+    ASSERT_EQ(expired.size(), 1);
+    ASSERT_EQ(expired[0], 0x8001);
+    ASSERT_EQ(repository.size(), 0);
+    ASSERT_EQ(repository.getNextDeadline(), (uint64_t)-1);
+
+    // failed retransmissions expire the token at once; jitter varies the intervals within bounds
+    policy.jitter = 0.25;
+    repository.setRetransmissionPolicy(policy);
+    const SpeedwireCommandTokenIndex index3 = repository.add(0x0178, 3000000000u, 0x8003, "192.168.1.10", Command::AC_QUERY, "192.168.1.1", request, sizeof(request));
+    ASSERT_EQ(repository.at(index3).deadline, repository.at(index3).create_tick + 100);
+    ASSERT_EQ(repository.advance(start + 800), 0);
+    ASSERT_EQ(repository.at(index3).retransmissions, 1);
+    ASSERT_GE(repository.at(index3).deadline, start + 800 + 150);
+    ASSERT_LE(repository.at(index3).deadline, start + 800 + 250);
+    repository.setRetransmitCallback([](const SpeedwireCommandToken& /*token*/) { return false; });
+    ASSERT_EQ(repository.advance(start + 1100), 1);
+    ASSERT_EQ(expired.size(), 2);
+    ASSERT_EQ(expired[1], 0x8003);
+}
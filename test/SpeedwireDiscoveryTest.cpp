@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <SpeedwireByteEncoding.hpp>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireDiscovery.hpp>
+#include <SpeedwireDiscoveryProtocol.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+
+using namespace libspeedwire;
+
+// discovery with a manually controlled tick count and a command instance without sockets
+class TestDiscovery : public SpeedwireDiscovery {
+public:
+    uint64_t tick;
+
+    TestDiscovery(LocalHost& host) : SpeedwireDiscovery(host), tick(1000) {
+        interfaceDevices.reset(new std::vector<SpeedwireDevice>());
+        command.reset(new SpeedwireCommand(localhost, *interfaceDevices));
+    }
+
+    void start(const bool full_scan) { reset(full_scan); }
+    bool isComplete(void) const { return checkCompletion(tick); }
+    bool receive(const SpeedwireHeader& packet, const std::string& peer_ip_address) { return processDiscoveryPacket(packet, peer_ip_address, "192.168.1.1"); }
+
+    // register a device type query as if it was sent to the given peer by completeDeviceInformation()
+    uint16_t addDeviceTypeQuery(const std::string& peer_ip_address) {
+        for (auto& device : speedwireDevices) {
+            if (device.deviceIpAddress == peer_ip_address) {
+                device.interfaceIpAddress = "192.168.1.1";
+            }
+        }
+        const uint16_t packet_id = SpeedwireCommand::getIncrementedPacketID();
+        const SpeedwireAddress& broadcast = SpeedwireAddress::getBroadcastAddress();
+        deviceTypeQueries.push_back(command->getTokenRepository().add(broadcast.susyID, broadcast.serialNumber, packet_id, peer_ip_address, Command::DEVICE_QUERY));
+        queriedDevices.push_back(peer_ip_address);
+        return packet_id;
+    }
+
+protected:
+    virtual uint64_t getTickCountInMs(void) const { return tick; }
+};
+
+// assemble an inverter reply packet with the given number of 40 byte data elements
+static void setReply(SpeedwireHeader& header, const uint32_t serial, const uint16_t packet_id, const Command cmd, const uint32_t num_elements) {
+    memset(header.getPacketPointer(), 0, header.getPacketSize());
+    header.setDefaultHeader(1, header.getPacketSize() - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
+    SpeedwireData2Packet data2_packet(header);
+    data2_packet.setControl(0xa0);
+    SpeedwireInverterProtocol inverter(header);
+    inverter.setDstSusyID(SpeedwireAddress::getLocalAddress().susyID);
+    inverter.setDstSerialNumber(SpeedwireAddress::getLocalAddress().serialNumber);
+    inverter.setSrcSusyID(0x0178);
+    inverter.setSrcSerialNumber(serial);
+    inverter.setPacketID(packet_id);
+    inverter.setCommandID(cmd);
+    inverter.setFirstRegisterID(num_elements > 1 ? 1 : 0);
+    inverter.setLastRegisterID(num_elements > 1 ? num_elements : 0);
+}
+
+// test early completion once all pre-registered devices are seen, either by discovery or by device type replies
+TEST(SpeedwireDiscoveryTest, EarlyCompletion) {
+    LocalHost& localhost = LocalHost::getInstance();
+    TestDiscovery discovery(localhost);
+    discovery.preRegisterDevice("192.168.1.10");
+    discovery.preRegisterDevice("192.168.1.11");
+    discovery.start(false);
+    ASSERT_FALSE(discovery.isComplete());
+
+    // the first device replies to the unicast discovery request
+    unsigned char discovery_buffer[24 + 8 + 8 + 6 + 4 + 4 + 4 + 40];
+    SpeedwireHeader discovery_reply(discovery_buffer, sizeof(discovery_buffer));
+    setReply(discovery_reply, 3000000000u, 0x8001, (Command)0x00000201, 1);
+    ASSERT_TRUE(SpeedwireDiscoveryProtocol(discovery_reply).isUnicastResponsePacket());
+    ASSERT_TRUE(discovery.receive(discovery_reply, "192.168.1.10"));
+    ASSERT_EQ(discovery.getNumberOfPreRegisteredIPDevices(), 1);
+    ASSERT_FALSE(discovery.isComplete());
+
+    // the second device replies to the device type query sent to its broadcast address
+    const uint16_t packet_id = discovery.addDeviceTypeQuery("192.168.1.11");
+    unsigned char type_buffer[24 + 8 + 8 + 6 + 4 + 4 + 4 + 2 * 40];
+    SpeedwireHeader type_reply(type_buffer, sizeof(type_buffer));
+    setReply(type_reply, 3000000001u, packet_id, Command::DEVICE_QUERY | Command::QUERY_RESPONSE, 2);
+    SpeedwireInverterProtocol inverter(type_reply);
+    inverter.setDataUint32(0, 0x08821f01);          // Status32 device class register
+    inverter.setDataUint32(8, 0x01000000 | (uint32_t)SpeedwireDeviceClass::PV_INVERTER);
+    inverter.setDataUint32(12, 0x00fffffe);
+    inverter.setDataUint32(40, 0x08822001);         // Status32 device type register
+    inverter.setDataUint32(48, 0x01002481);
+    inverter.setDataUint32(52, 0x00fffffe);
+    ASSERT_FALSE(discovery.receive(type_reply, "192.168.1.12"));     // wrong peer
+    ASSERT_TRUE(discovery.receive(type_reply, "192.168.1.11"));
+    ASSERT_EQ(discovery.getNumberOfPreRegisteredIPDevices(), 0);
+    ASSERT_EQ(discovery.getNumberOfFullyRegisteredDevices(), 2);
+    ASSERT_EQ(discovery.getDevices()[1].deviceAddress.serialNumber, 3000000001u);
+    ASSERT_EQ(discovery.getDevices()[1].deviceClass, toString(SpeedwireDeviceClass::PV_INVERTER));
+    ASSERT_TRUE(discovery.isComplete());
+
+    // full scans do not complete early
+    discovery.start(true);
+    ASSERT_FALSE(discovery.isComplete());
+}
+
+// test that a discovery instance can be moved together with its command instance and the queries in flight
+TEST(SpeedwireDiscoveryTest, Move) {
+    LocalHost& localhost = LocalHost::getInstance();
+    TestDiscovery discovery(localhost);
+    discovery.preRegisterDevice("192.168.1.11");
+    discovery.start(false);
+    const uint16_t packet_id = discovery.addDeviceTypeQuery("192.168.1.11");
+
+    TestDiscovery moved(std::move(discovery));
+    ASSERT_FALSE(moved.isComplete());
+    unsigned char type_buffer[24 + 8 + 8 + 6 + 4 + 4 + 4 + 2 * 40];
+    SpeedwireHeader type_reply(type_buffer, sizeof(type_buffer));
+    setReply(type_reply, 3000000001u, packet_id, Command::DEVICE_QUERY | Command::QUERY_RESPONSE, 2);
+    SpeedwireInverterProtocol inverter(type_reply);
+    inverter.setDataUint32(0, 0x08821f01);          // Status32 device class register
+    inverter.setDataUint32(8, 0x01000000 | (uint32_t)SpeedwireDeviceClass::PV_INVERTER);
+    inverter.setDataUint32(12, 0x00fffffe);
+    inverter.setDataUint32(40, 0x08822001);         // Status32 device type register
+    inverter.setDataUint32(48, 0x01002481);
+    inverter.setDataUint32(52, 0x00fffffe);
+    ASSERT_TRUE(moved.receive(type_reply, "192.168.1.11"));
+    ASSERT_EQ(moved.getNumberOfFullyRegisteredDevices(), 1);
+    ASSERT_TRUE(moved.isComplete());
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <AddressConversion.hpp>
+#include <SpeedwireByteEncoding.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwirePollScheduler.hpp>
+
+using namespace libspeedwire;
+
+// query engine with a manually controlled tick count, recording query requests instead of sending them
+class PollTestQueryEngine : public SpeedwireQueryEngine {
+public:
+    uint64_t tick;
+    std::vector<SpeedwireCommandToken> requests;
+
+    PollTestQueryEngine(LocalHost& host, SpeedwireCommand& command) : SpeedwireQueryEngine(host, command, 4, 1000), tick(1000) {}
+
+protected:
+    virtual uint64_t getTickCountInMs(void) const { return tick; }
+
+    virtual SpeedwireCommandTokenIndex sendRequest(const SpeedwireDevice& peer, const Command cmd, const uint32_t /*first_register*/, const uint32_t /*last_register*/) {
+        const uint16_t packet_id = SpeedwireCommand::getIncrementedPacketID();
+        const SpeedwireCommandTokenIndex index = command.getTokenRepository().add(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id, peer.deviceIpAddress, cmd);
+        requests.push_back(command.getTokenRepository().at(index));
+        return index;
+    }
+};
+
+// poll scheduler sharing the tick count of the query engine
+class TestPollScheduler : public SpeedwirePollScheduler {
+public:
+    const PollTestQueryEngine& clock;
+
+    TestPollScheduler(PollTestQueryEngine& engine, const SpeedwireQueryCallback& callback) : SpeedwirePollScheduler(engine, callback), clock(engine) {}
+
+protected:
+    virtual uint64_t getTickCountInMs(void) const { return clock.tick; }
+};
+
+// assemble a reply packet with a single Signed32 register for the given request
+static void reply(SpeedwireQueryEngine& engine, const SpeedwireCommandToken& request, const uint32_t value) {
+    unsigned char buffer[24 + 8 + 8 + 6 + 4 + 4 + 4 + 16];
+    memset(buffer, 0, sizeof(buffer));
+    SpeedwireHeader header(buffer, sizeof(buffer));
+    header.setDefaultHeader(1, sizeof(buffer) - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
+    SpeedwireData2Packet data2_packet(header);
+    data2_packet.setControl(0xa0);
+    SpeedwireInverterProtocol inverter(header);
+    inverter.setDstSusyID(SpeedwireAddress::getLocalAddress().susyID);
+    inverter.setDstSerialNumber(SpeedwireAddress::getLocalAddress().serialNumber);
+    inverter.setSrcSusyID(request.susyid);
+    inverter.setSrcSerialNumber(request.serialnumber);
+    inverter.setPacketID(request.packetid);
+    inverter.setCommandID((Command)((uint32_t)request.command | 1));
+    inverter.setFirstRegisterID(0);
+    inverter.setLastRegisterID(0);
+    inverter.setDataUint32(0, 0x40263f01);      // Signed32 register 0x00263f, connector 0x01
+    inverter.setDataUint32(4, 0x60000000);      // timestamp
+    inverter.setDataUint32(8, value);
+
+    struct sockaddr src;
+    memset(&src, 0, sizeof(src));
+    struct sockaddr_in& src4 = AddressConversion::toSockAddrIn(src);
+    src4.sin_family = AF_INET;
+    src4.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+    src4.sin_addr = AddressConversion::toInAddress(request.peer_ip_address);
+    engine.receive(header, src);
+}
+
+static SpeedwireDevice device(const uint32_t serial, const std::string& ip) {
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x0178, serial);
+    device.deviceIpAddress = ip;
+    device.interfaceIpAddress = "192.168.1.1";
+    return device;
+}
+
+// test burst coalescing and interval adaptation
+TEST(SpeedwirePollSchedulerTest, Adaptation) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(localhost, devices);
+    PollTestQueryEngine engine(localhost, command);
+
+    std::vector<SpeedwireQueryResult> results;
+    TestPollScheduler scheduler(engine, [&results](const SpeedwireQueryResult& result) { results.push_back(result); });
+    const SpeedwireDevice peer = device(3000000000u, "192.168.1.10");
+    const SpeedwirePollHandle ac = scheduler.add(peer, Command::AC_QUERY, 0x00464000, 0x004642FF, 1000, 500, 8000);
+    const SpeedwirePollHandle energy = scheduler.add(peer, Command::ENERGY_QUERY, 0x00260100, 0x002622FF, 1100, 1100, 60000);
+    ASSERT_EQ(scheduler.add(peer, Command::AC_QUERY, 0x00464000, 0x004642FF, 1000, 500, 8000), ac);
+    ASSERT_EQ(scheduler.size(), 2);
+
+    // both entries are polled in the first burst; the first reply sets the target interval
+    ASSERT_EQ(scheduler.poll(), 2);
+    ASSERT_EQ(scheduler.poll(), 0);
+    ASSERT_EQ(engine.send(), 2);
+    reply(engine, engine.requests[0], 1000);
+    reply(engine, engine.requests[1], 5000);
+    ASSERT_EQ(results.size(), 2);
+    ASSERT_EQ(scheduler.getInterval(ac), 1000);
+    ASSERT_EQ(scheduler.getNextPollTime(), 2000);
+
+    // the energy entry is due within the burst window and is polled together with the ac entry
+    engine.tick = 2000;
+    ASSERT_EQ(scheduler.poll(), 2);
+    ASSERT_EQ(engine.send(), 2);
+    reply(engine, engine.requests[2], 2000);    // volatile value => speed up
+    reply(engine, engine.requests[3], 5000);    // unchanged value => slow down
+    ASSERT_EQ(scheduler.getInterval(ac), 500);
+    ASSERT_EQ(scheduler.getInterval(energy), 1650);
+    ASSERT_EQ(scheduler.getNextPollTime(), 2500);
+
+    // slightly changing values converge back towards the target interval
+    engine.tick = 2500;
+    ASSERT_EQ(scheduler.poll(), 1);
+    ASSERT_EQ(engine.send(), 1);
+    reply(engine, engine.requests[4], 2010);
+    ASSERT_EQ(scheduler.getInterval(ac), 750);
+
+    // NaN values, e.g. at night, stretch the interval; timeouts stretch the interval by the slowdown factor
+    engine.tick = 3650;
+    ASSERT_EQ(scheduler.poll(), 2);
+    ASSERT_EQ(engine.send(), 2);
+    reply(engine, engine.requests[5], SpeedwireRawDataSigned32::nan);
+    ASSERT_EQ(scheduler.getInterval(ac), 3000);
+    engine.tick += 1000;
+    ASSERT_EQ(engine.expire(), 1);
+    ASSERT_EQ(results.back().status, SpeedwireQueryStatus::TIMEOUT);
+    ASSERT_EQ(scheduler.getInterval(energy), 2475);
+    ASSERT_EQ(scheduler.getNextPollTime(), 6125);
+
+    // intervals are limited by their upper bound
+    engine.tick = 6650;
+    ASSERT_EQ(scheduler.poll(), 2);
+    ASSERT_EQ(engine.send(), 2);
+    reply(engine, engine.requests[7], SpeedwireRawDataSigned32::nan);
+    reply(engine, engine.requests[8], 5000);
+    ASSERT_EQ(scheduler.getInterval(ac), 8000);
+    ASSERT_EQ(scheduler.getInterval(energy), 3712);
+    ASSERT_EQ(results.size(), 9);
+}
+
+// test that entries staying dark are polled at their maximum interval and recover their target interval at dawn
+TEST(SpeedwirePollSchedulerTest, Darkness) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(localhost, devices);
+    PollTestQueryEngine engine(localhost, command);
+
+    TestPollScheduler scheduler(engine, [](const SpeedwireQueryResult& /*result*/) {});
+    SpeedwirePollPolicy policy;
+    policy.darknessFactor = 2.0;
+    policy.darknessPolls = 3;
+    policy.speedupFactor = 0.75;
+    scheduler.setPolicy(policy);
+    const SpeedwirePollHandle ac = scheduler.add(device(3000000000u, "192.168.1.10"), Command::AC_QUERY, 0x00464000, 0x004642FF, 1000, 500, 60000);
+
+    const uint32_t nan = (uint32_t)SpeedwireRawDataSigned32::nan;
+    const uint32_t replies[] = { 1000, nan, nan, nan, nan, 1000 };
+    const uint32_t intervals[] = { 1000, 2000, 4000, 60000, 60000, 1000 };
+    for (size_t i = 0; i < sizeof(replies) / sizeof(replies[0]); ++i) {
+        engine.tick = scheduler.getNextPollTime();
+        ASSERT_EQ(scheduler.poll(), 1);
+        ASSERT_EQ(engine.send(), 1);
+        reply(engine, engine.requests.back(), replies[i]);
+        ASSERT_EQ(scheduler.getInterval(ac), intervals[i]);
+    }
+
+    // after a single dark poll, values returning are treated as volatile values instead
+    engine.tick = scheduler.getNextPollTime();
+    ASSERT_EQ(scheduler.poll(), 1);
+    ASSERT_EQ(engine.send(), 1);
+    reply(engine, engine.requests.back(), SpeedwireRawDataSigned32::nan);
+    ASSERT_EQ(scheduler.getInterval(ac), 2000);
+    engine.tick = scheduler.getNextPollTime();
+    ASSERT_EQ(scheduler.poll(), 1);
+    ASSERT_EQ(engine.send(), 1);
+    reply(engine, engine.requests.back(), 1000);
+    ASSERT_EQ(scheduler.getInterval(ac), 1500);
+}
@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <AddressConversion.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireQueryEngine.hpp>
+
+using namespace libspeedwire;
+
+// query engine with a manually controlled tick count, recording query requests instead of sending them
+class TestQueryEngine : public SpeedwireQueryEngine {
+public:
+    uint64_t tick;
+    bool     fail;
+    std::vector<SpeedwireCommandToken> requests;
+
+    TestQueryEngine(LocalHost& host, SpeedwireCommand& command, const size_t max_in_flight, const int timeout) :
+        SpeedwireQueryEngine(host, command, max_in_flight, timeout), tick(1000), fail(false) {}
+
+protected:
+    virtual uint64_t getTickCountInMs(void) const { return tick; }
+
+    virtual SpeedwireCommandTokenIndex sendRequest(const SpeedwireDevice& peer, const Command cmd, const uint32_t /*first_register*/, const uint32_t /*last_register*/) {
+        if (fail) {
+            return -1;
+        }
+        const uint16_t packet_id = SpeedwireCommand::getIncrementedPacketID();
+        const SpeedwireCommandTokenIndex index = command.getTokenRepository().add(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id, peer.deviceIpAddress, cmd);
+        requests.push_back(command.getTokenRepository().at(index));
+        return index;
+    }
+};
+
+// assemble a reply packet for the given request
+static void reply(SpeedwireQueryEngine& engine, const SpeedwireCommandToken& request, const uint16_t error_code) {
+    unsigned char buffer[24 + 8 + 8 + 6 + 4 + 4 + 4];
+    memset(buffer, 0, sizeof(buffer));
+    SpeedwireHeader header(buffer, sizeof(buffer));
+    header.setDefaultHeader(1, sizeof(buffer) - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
+    SpeedwireData2Packet data2_packet(header);
+    data2_packet.setControl(0xa0);
+    SpeedwireInverterProtocol inverter(header);
+    inverter.setDstSusyID(SpeedwireAddress::getLocalAddress().susyID);
+    inverter.setDstSerialNumber(SpeedwireAddress::getLocalAddress().serialNumber);
+    inverter.setSrcSusyID(request.susyid);
+    inverter.setSrcSerialNumber(request.serialnumber);
+    inverter.setErrorCode(error_code);
+    inverter.setPacketID(request.packetid);
+    inverter.setCommandID((Command)((uint32_t)request.command | 1));
+
+    struct sockaddr src;
+    memset(&src, 0, sizeof(src));
+    struct sockaddr_in& src4 = AddressConversion::toSockAddrIn(src);
+    src4.sin_family = AF_INET;
+    src4.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+    src4.sin_addr = AddressConversion::toInAddress(request.peer_ip_address);
+    engine.receive(header, src);
+}
+
+static SpeedwireDevice device(const uint32_t serial, const std::string& ip) {
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x0178, serial);
+    device.deviceIpAddress = ip;
+    device.interfaceIpAddress = "192.168.1.1";
+    return device;
+}
+
+// test pipelining across devices, per device in-flight limits and reply matching
+TEST(SpeedwireQueryEngineTest, Pipelining) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(localhost, devices);
+    TestQueryEngine engine(localhost, command, 1, 1000);
+
+    std::vector<SpeedwireQueryResult> results;
+    const SpeedwireQueryCallback callback = [&results](const SpeedwireQueryResult& result) { results.push_back(result); };
+    for (uint32_t i = 0; i < 3; ++i) {
+        const SpeedwireDevice peer = device(3000000000u + i, "192.168.1." + std::to_string(10 + i));
+        engine.submit(peer, Command::AC_QUERY, 0x00464000, 0x004642FF, callback);
+        engine.submit(peer, Command::DC_QUERY, 0x00251E00, 0x00251EFF, callback);
+    }
+    ASSERT_EQ(engine.getNumberOfPendingQueries(), 6);
+
+    // one query per device is sent at once
+    ASSERT_EQ(engine.send(), 3);
+    ASSERT_EQ(engine.getNumberOfQueriesInFlight(), 3);
+    ASSERT_EQ(command.getTokenRepository().size(), 3);
+    ASSERT_EQ(engine.send(), 0);
+
+    // replies are matched in any order; unrelated replies are ignored
+    SpeedwireCommandToken unrelated = engine.requests[1];
+    unrelated.packetid = (uint16_t)(unrelated.packetid + 100);
+    reply(engine, unrelated, 0);
+    ASSERT_EQ(results.size(), 0);
+    engine.tick += 20;
+    reply(engine, engine.requests[2], 0);
+    reply(engine, engine.requests[0], 0);
+    ASSERT_EQ(results.size(), 2);
+    ASSERT_EQ(results[0].device.deviceAddress.serialNumber, 3000000002u);
+    ASSERT_EQ(results[0].status, SpeedwireQueryStatus::SUCCESS);
+    ASSERT_EQ(results[0].roundTripTime, 20);
+    ASSERT_EQ(results[0].packet.size(), 58);
+    ASSERT_EQ(results[1].device.deviceAddress.serialNumber, 3000000000u);
+    ASSERT_EQ(command.getTokenRepository().size(), 1);
+
+    // the second query of the completed devices is sent next
+    ASSERT_EQ(engine.send(), 2);
+    ASSERT_EQ(engine.requests[3].command, Command::DC_QUERY);
+    reply(engine, engine.requests[1], 0);
+    reply(engine, engine.requests[3], 0x0017);
+    reply(engine, engine.requests[4], 0);
+    ASSERT_EQ(results.size(), 5);
+    ASSERT_EQ(results[3].status, SpeedwireQueryStatus::ERROR_CODE);
+    ASSERT_EQ(results[3].errorCode, 0x0017);
+    ASSERT_TRUE(command.getTokenRepository().needs_login);
+    ASSERT_EQ(engine.send(), 1);
+    reply(engine, engine.requests[5], 0);
+    ASSERT_EQ(results.size(), 6);
+    ASSERT_TRUE(engine.isIdle());
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+}
+
+// test timeouts and send failures
+TEST(SpeedwireQueryEngineTest, Timeout) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(localhost, devices);
+    TestQueryEngine engine(localhost, command, 2, 500);
+
+    std::vector<SpeedwireQueryResult> results;
+    const SpeedwireQueryCallback callback = [&results](const SpeedwireQueryResult& result) { results.push_back(result); };
+    const SpeedwireDevice peer = device(3000000000u, "192.168.1.10");
+    engine.submit(peer, Command::AC_QUERY, 0x00464000, 0x004642FF, callback);
+    engine.submit(peer, Command::DC_QUERY, 0x00251E00, 0x00251EFF, callback);
+    engine.submit(peer, Command::ENERGY_QUERY, 0x00260100, 0x002622FF, callback);
+    ASSERT_EQ(engine.send(), 2);
+
+    // the first query is answered, the second one times out
+    engine.tick += 100;
+    reply(engine, engine.requests[0], 0);
+    ASSERT_EQ(engine.send(), 1);
+    engine.tick += 399;
+    ASSERT_EQ(engine.expire(), 0);
+    engine.tick += 1;
+    ASSERT_EQ(engine.expire(), 1);
+    ASSERT_EQ(results.size(), 2);
+    ASSERT_EQ(results[1].status, SpeedwireQueryStatus::TIMEOUT);
+    ASSERT_EQ(results[1].command, Command::DC_QUERY);
+    ASSERT_EQ(results[1].roundTripTime, 500);
+    ASSERT_EQ(command.getTokenRepository().size(), 1);
+
+    // a late reply to the timed out query is ignored
+    reply(engine, engine.requests[1], 0);
+    ASSERT_EQ(results.size(), 2);
+
+    // the third query times out as well
+    engine.tick += 100;
+    ASSERT_EQ(engine.expire(), 1);
+    ASSERT_TRUE(engine.isIdle());
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+
+    // send failures complete immediately
+    engine.fail = true;
+    engine.submit(peer, Command::AC_QUERY, 0x00464000, 0x004642FF, callback);
+    ASSERT_EQ(engine.send(), 0);
+    ASSERT_EQ(results.size(), 4);
+    ASSERT_EQ(results[3].status, SpeedwireQueryStatus::SEND_FAILURE);
+    ASSERT_TRUE(engine.isIdle());
+}
+
+// test several engines sharing the token repository of a command instance
+TEST(SpeedwireQueryEngineTest, SharedRepository) {
+    LocalHost& localhost = LocalHost::getInstance();
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(localhost, devices);
+    SpeedwireRetransmissionPolicy policy;
+    policy.timeoutInMs = 100;
+    policy.maxRetransmissions = 0;
+    policy.backoffFactor = 2.0;
+    policy.jitter = 0.0;
+    command.getTokenRepository().setRetransmissionPolicy(policy);
+
+    std::vector<SpeedwireQueryResult> results;
+    const SpeedwireQueryCallback callback = [&results](const SpeedwireQueryResult& result) { results.push_back(result); };
+    TestQueryEngine engine1(localhost, command, 1, 1000);
+    {
+        // the second engine is destroyed first; this must not remove the expiry callback of the first engine
+        TestQueryEngine engine2(localhost, command, 1, 1000);
+        engine2.submit(device(3000000001u, "192.168.1.11"), Command::AC_QUERY, 0x00464000, 0x004642FF, callback);
+        ASSERT_EQ(engine2.send(), 1);
+    }
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+    engine1.submit(device(3000000000u, "192.168.1.10"), Command::AC_QUERY, 0x00464000, 0x004642FF, callback);
+    ASSERT_EQ(engine1.send(), 1);
+
+    // the token expires in the repository and completes the query of the first engine
+    ASSERT_EQ(command.getTokenRepository().advance(LocalHost::getTickCountInMs() + 1000), 1);
+    ASSERT_EQ(results.size(), 1);
+    ASSERT_EQ(results[0].status, SpeedwireQueryStatus::TIMEOUT);
+    ASSERT_TRUE(engine1.isIdle());
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <SpeedwireQueryPlanner.hpp>
+
+using namespace libspeedwire;
+
+// test register range coalescing and plan caching
+TEST(SpeedwireQueryPlannerTest, Coalescing) {
+    SpeedwireQueryPlanner planner;
+    const std::vector<SpeedwireData> elements = {
+        SpeedwireData::InverterCurrentL1, SpeedwireData::InverterPowerL1, SpeedwireData::InverterVoltageL1, SpeedwireData::InverterPowerL2,
+        SpeedwireData::InverterPowerL3, SpeedwireData::InverterPowerMPP1, SpeedwireData::InverterPowerMPP2, SpeedwireData::InverterPowerL1,
+        SpeedwireData::InverterEnergyTotal, SpeedwireData::InverterEnergyDaily
+    };
+    const SpeedwireQueryPlan& plan = planner.getPlan(elements);
+    ASSERT_EQ(plan.size(), 3);
+
+    // ac registers 0x4640 ... 0x4653 are merged; the 11 known registers in between, including battery registers, count towards the reply size
+    const SpeedwireQueryRange& ac = plan[0];
+    ASSERT_EQ(ac.command, Command::AC_QUERY);
+    ASSERT_EQ(ac.firstRegister, 0x00464000);
+    ASSERT_EQ(ac.lastRegister, 0x004653FF);
+    ASSERT_EQ(ac.elements.size(), 5);
+    ASSERT_EQ(ac.replySize, SpeedwireQueryPlanner::reply_header_size + 16 * 28);
+
+    // both mpp connectors share a single register
+    const SpeedwireQueryRange& dc = plan[1];
+    ASSERT_EQ(dc.command, Command::DC_QUERY);
+    ASSERT_EQ(dc.firstRegister, 0x00251E00);
+    ASSERT_EQ(dc.lastRegister, 0x00251EFF);
+    ASSERT_EQ(dc.elements.size(), 2);
+
+    const SpeedwireQueryRange& energy = plan[2];
+    ASSERT_EQ(energy.command, Command::ENERGY_QUERY);
+    ASSERT_EQ(energy.firstRegister, 0x00260100);
+    ASSERT_EQ(energy.lastRegister, 0x002622FF);
+
+    // plans are cached independently of element order
+    std::vector<SpeedwireData> reversed(elements.rbegin(), elements.rend());
+    ASSERT_EQ(&planner.getPlan(reversed), &plan);
+    ASSERT_EQ(planner.getNumberOfCachedPlans(), 1);
+
+    // ranges are split if the reply would not fit into a packet or if the gap is too large
+    SpeedwireQueryPlanner small_planner(SpeedwireQueryPlanner::reply_header_size + 3 * 28);
+    const SpeedwireQueryPlan& small_plan = small_planner.getPlan(elements);
+    ASSERT_EQ(small_plan.size(), 5);
+    ASSERT_EQ(small_plan[0].firstRegister, 0x00464000);
+    ASSERT_EQ(small_plan[0].lastRegister, 0x004642FF);
+    ASSERT_EQ(small_plan[1].firstRegister, 0x00464800);
+    ASSERT_EQ(small_plan[2].firstRegister, 0x00465300);
+
+    SpeedwireQueryPlanner adjacent_planner(SpeedwireQueryPlanner::max_udp_payload_size, 0);
+    const SpeedwireQueryPlan& adjacent_plan = adjacent_planner.getPlan(elements);
+    ASSERT_EQ(adjacent_plan.size(), 6);
+    ASSERT_EQ(adjacent_plan[0].lastRegister, 0x004642FF);
+    ASSERT_EQ(adjacent_plan[4].lastRegister, 0x002601FF);
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <AddressConversion.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireReceiveDispatcher.hpp>
+
+using namespace libspeedwire;
+
+// inverter packet receiver counting the received packets
+class CountingInverterReceiver : public InverterPacketReceiverBase {
+public:
+    int count;
+    CountingInverterReceiver(LocalHost& host) : InverterPacketReceiverBase(host), count(0) {}
+    virtual void receive(SpeedwireHeader& /*packet*/, struct sockaddr& /*src*/) { ++count; }
+};
+
+// emeter packet receiver counting the received packets
+class CountingEmeterReceiver : public EmeterPacketReceiverBase {
+public:
+    int count;
+    CountingEmeterReceiver(LocalHost& host) : EmeterPacketReceiverBase(host), count(0) {}
+    virtual void receive(SpeedwireHeader& /*packet*/, struct sockaddr& /*src*/) { ++count; }
+};
+
+// test dispatching of single packets, as used by receive loops passing on unrelated packets
+TEST(SpeedwireReceiveDispatcherTest, DispatchPacket) {
+    LocalHost& localhost = LocalHost::getInstance();
+    SpeedwireReceiveDispatcher dispatcher(localhost);
+    CountingInverterReceiver inverter_receiver(localhost);
+    CountingEmeterReceiver emeter_receiver(localhost);
+    dispatcher.registerReceiver(inverter_receiver);
+    dispatcher.registerReceiver(emeter_receiver);
+
+    struct sockaddr src;
+    memset(&src, 0, sizeof(src));
+    struct sockaddr_in& src4 = AddressConversion::toSockAddrIn(src);
+    src4.sin_family = AF_INET;
+    src4.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+    src4.sin_addr = AddressConversion::toInAddress("192.168.1.10");
+
+    // inverter packets are passed to inverter receivers only
+    unsigned char buffer[24 + 8 + 8 + 6 + 4 + 4 + 4];
+    memset(buffer, 0, sizeof(buffer));
+    SpeedwireHeader header(buffer, sizeof(buffer));
+    header.setDefaultHeader(1, sizeof(buffer) - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
+    SpeedwireData2Packet data2_packet(header);
+    data2_packet.setControl(0xa0);
+    ASSERT_EQ(dispatcher.dispatch(header, src), 1);
+    ASSERT_EQ(inverter_receiver.count, 1);
+    ASSERT_EQ(emeter_receiver.count, 0);
+
+    // truncated packets are ignored
+    SpeedwireHeader truncated(buffer, sizeof(buffer) - 8);
+    ASSERT_EQ(dispatcher.dispatch(truncated, src), 0);
+    ASSERT_EQ(inverter_receiver.count, 1);
+
+    // other packets are ignored
+    unsigned char garbage[32];
+    memset(garbage, 0x55, sizeof(garbage));
+    SpeedwireHeader garbage_header(garbage, sizeof(garbage));
+    ASSERT_EQ(dispatcher.dispatch(garbage_header, src), 0);
+    ASSERT_EQ(inverter_receiver.count, 1);
+    ASSERT_EQ(emeter_receiver.count, 0);
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#define poll(a, b, c) WSAPoll((a), (b), (c))
+#else
+#include <poll.h>
+#endif
+#include <string.h>
+#include <AddressConversion.hpp>
+#include <SpeedwireSocket.hpp>
+
+using namespace libspeedwire;
+
+// test batched sending of unicast packets across the loopback interface
+TEST(SpeedwireSocketTest, BatchedSend) {
+    LocalHost& localhost = LocalHost::getInstance();
+    SpeedwireSocket receiver(localhost);
+    SpeedwireSocket sender(localhost);
+    ASSERT_GE(receiver.openSocket("127.0.0.1", false), 0);
+    ASSERT_GE(sender.openSocket("127.0.0.1", false), 0);
+
+    // determine the port the os has chosen for the receiver
+    struct sockaddr_in dest;
+    socklen_t dest_len = sizeof(dest);
+    memset(&dest, 0, sizeof(dest));
+    ASSERT_EQ(getsockname(receiver.getSocketFd(), (struct sockaddr*)&dest, &dest_len), 0);
+
+    // send 5 packets in bursts of 2 packets
+    uint8_t data[5][4];
+    std::vector<SpeedwireSocketPacket> packets;
+    for (uint8_t i = 0; i < 5; ++i) {
+        memset(data[i], i, sizeof(data[i]));
+        packets.push_back(SpeedwireSocketPacket(data[i], sizeof(data[i]) - (i & 1), dest));
+    }
+    ASSERT_FALSE(packets[0].isMulticast());
+    ASSERT_TRUE(SpeedwireSocketPacket(data[0], sizeof(data[0]), sender.getSpeedwireMulticastIn4Address()).isMulticast());
+    struct sockaddr_in group = dest;
+    group.sin_addr = AddressConversion::toInAddress("224.0.0.251");
+    ASSERT_TRUE(SpeedwireSocketPacket(data[0], sizeof(data[0]), group).isMulticast());
+    group.sin_addr = AddressConversion::toInAddress("239.255.255.250");
+    ASSERT_TRUE(SpeedwireSocketPacket(data[0], sizeof(data[0]), group).isMulticast());
+    group.sin_addr = AddressConversion::toInAddress("240.0.0.1");
+    ASSERT_FALSE(SpeedwireSocketPacket(data[0], sizeof(data[0]), group).isMulticast());
+    ASSERT_EQ(sender.sendto(packets, 2, 100), 5);
+
+    // receive all packets in order
+    for (uint8_t i = 0; i < 5; ++i) {
+        struct pollfd pfd;
+        pfd.fd = receiver.getSocketFd();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+        uint8_t buffer[16];
+        struct sockaddr_in src;
+        ASSERT_EQ(receiver.recvfrom(buffer, sizeof(buffer), src), (int)(sizeof(data[i]) - (i & 1)));
+        ASSERT_EQ(buffer[0], i);
+    }
+    receiver.closeSocket();
+    sender.closeSocket();
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <TimerWheel.hpp>
+
+using namespace libspeedwire;
+
+// test that timers on all levels expire exactly once, at the first call to advance() at or after their deadline
+TEST(TimerWheelTest, Expiry) {
+    const uint64_t start = 123456789;
+    TimerWheel<int> wheel(16, 10, start, 3);      // 16 slots per level, 10 ms ticks => levels cover 160 ms, 2.56 s and 40.96 s
+
+    std::map<int, uint64_t> deadlines;
+    for (int i = 0; i < 500; ++i) {
+        const uint64_t deadline = start + (uint64_t)i * i * 7 % 100000;    // includes deadlines beyond the highest level
+        deadlines[i] = deadline;
+        wheel.schedule(deadline, i);
+    }
+    wheel.schedule(start - 50, 1000);   // deadline in the past
+    deadlines[1000] = start - 50;
+    ASSERT_EQ(wheel.size(), 501);
+
+    std::map<int, uint64_t> expired;
+    uint64_t now = start;
+    while (wheel.size() > 0) {
+        ASSERT_LT(now, start + 200000);
+        const uint64_t next_deadline = wheel.getNextDeadline();
+        ASSERT_LE(now, (next_deadline > start ? next_deadline : start) + 13);
+        wheel.advance(now, [&expired, now](const int value) {
+            ASSERT_EQ(expired.count(value), 0);
+            expired[value] = now;
+        });
+        now += 13;  // not a multiple of the resolution
+    }
+    ASSERT_EQ(expired.size(), deadlines.size());
+    for (const auto& entry : deadlines) {
+        const uint64_t expiry = expired[entry.first];
+        ASSERT_GE(expiry, entry.second);
+        ASSERT_LT(expiry, (entry.second > start ? entry.second : start) + 13);
+    }
+}
+
+// test large steps of the clock and scheduling from within the expiry callback
+TEST(TimerWheelTest, Reschedule) {
+    TimerWheel<int> wheel(8, 1, 0, 2);
+    wheel.advance(1000, [](const int) {});
+    ASSERT_EQ(wheel.getNextDeadline(), (uint64_t)-1);
+
+    int count = 0;
+    wheel.schedule(1005, 0);
+    for (uint64_t now = 1000; now < 1200; now += 37) {
+        wheel.advance(now, [&wheel, &count, now](const int value) {
+            ++count;
+            if (value < 3) {
+                wheel.schedule(now + 20, value + 1);
+            }
+        });
+    }
+    ASSERT_EQ(count, 4);
+    ASSERT_EQ(wheel.size(), 0);
+}
+
+// test the earliest deadline against a linear search, skipping timers that are no longer pending
+TEST(TimerWheelTest, NextDeadline) {
+    const uint64_t start = 987654321;
+    TimerWheel<int> wheel(16, 10, start, 3);
+
+    std::map<int, uint64_t> pending;
+    for (int i = 0; i < 300; ++i) {
+        const uint64_t deadline = start + (uint64_t)i * i * 11 % 60000;
+        wheel.schedule(deadline, i);
+        if (i % 3 != 0) {
+            pending[i] = deadline;      // every third timer is cancelled by its owner
+        }
+    }
+    const auto is_pending = [&pending](const int value) { return pending.count(value) > 0; };
+
+    for (uint64_t now = start; wheel.size() > 0; now += 17) {
+        uint64_t expected = (uint64_t)-1;
+        for (const auto& entry : pending) {
+            if (entry.second < expected) expected = entry.second;
+        }
+        ASSERT_EQ(wheel.getNextDeadline(is_pending), expected);
+        wheel.advance(now, [&pending](const int value) { pending.erase(value); });
+    }
+    ASSERT_EQ(pending.size(), 0);
+}